@@ -33,6 +33,7 @@
 #include <thread>
 
 #include "EnumUtils.h"
+#include "Platform.h"
 
 #ifdef _WIN32
 // Windows Includes
@@ -468,6 +469,10 @@ void BaseLog::SetLogRotationEnabled(bool enabled) {
   mLogRotationEnabled = enabled;
 }
 
+bool BaseLog::SetThreadAffinity(const std::set<uint32_t>& cpus) {
+  return Platform::SetThreadAffinity(mThread, cpus);
+}
+
 bool BaseLog::GetLogCompression() const { return mLogCompression; }
 
 void BaseLog::SetLogCompression(bool enabled) { mLogCompression = enabled; }
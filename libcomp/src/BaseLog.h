@@ -32,6 +32,7 @@
 #include <functional>
 #include <list>
 #include <mutex>
+#include <set>
 #include <thread>
 #include <unordered_map>
 
@@ -238,6 +239,13 @@ class BaseLog {
    */
   void SetLogRotationEnabled(bool enabled);
 
+  /**
+   * Restrict the log thread to run on a set of CPUs.
+   * @param cpus Indexes of the CPUs the log thread may run on.
+   * @returns true if the thread was placed, false otherwise.
+   */
+  bool SetThreadAffinity(const std::set<uint32_t>& cpus);
+
   /**
    * Get if the log rotation will compress logs.
    * @return true if log rotation will compress logs.
@@ -30,6 +30,7 @@
 
 // Standard C++11 Includes
 #include <algorithm>
+#include <vector>
 
 #ifdef _WIN32
 // needed for _getcwd
@@ -48,10 +49,15 @@
 #include <DatabaseSQLite3.h>
 #include <MemoryManager.h>
 #include <MessageInit.h>
+#include <Platform.h>
 #include <ServerCommandLineParser.h>
 
 using namespace libcomp;
 
+/// Number of CPU indexes a CPU list may refer to. This matches the size of
+/// the Linux CPU set.
+static const uint32_t MAX_CPU_COUNT = 1024;
+
 std::string BaseServer::sConfigPath;
 
 BaseServer::BaseServer(const char* szProgram,
@@ -60,7 +66,12 @@ BaseServer::BaseServer(const char* szProgram,
     : TcpServer("any", config->GetPort()),
       mConfig(config),
       mCommandLine(commandLine),
-      mDataStore(szProgram) {
+      mDataStore(szProgram),
+      mTimerManager(objects::ServerConfig::TimerBackend_t::TIMING_WHEEL ==
+                            config->GetTimerBackend()
+                        ? TimerBackend_t::TIMING_WHEEL
+                        : TimerBackend_t::SORTED_SET,
+                    std::chrono::milliseconds(config->GetTimerResolution())) {
   mMainWorker = std::make_shared<Worker>();
   mQueueWorker = std::make_shared<Worker>();
 }
@@ -144,9 +155,26 @@ bool BaseServer::Initialize() {
       break;
   }
 
+  // Place the service threads before the workers are started.
+  if (!ApplyThreadPlacement()) {
+    return false;
+  }
+
   // Create the generic workers
   CreateWorkers();
 
+  // Run timer callbacks on the async worker so the timer thread only has
+  // to keep time.
+  if (mConfig->GetTimerDispatch()) {
+    mTimerManager.SetDefaultTarget(mQueueWorker);
+  }
+
+  // Log how far behind the timers are running (in seconds).
+  if (0 < mConfig->GetTimerStatsInterval()) {
+    mTimerManager.SetStatsLogInterval(
+        std::chrono::seconds(mConfig->GetTimerStatsInterval()));
+  }
+
   // Add the server as a system manager for libcomp::Message::Init.
   mMainWorker->AddManager(
       std::dynamic_pointer_cast<Manager>(shared_from_this()));
@@ -474,10 +502,47 @@ void BaseServer::CreateWorkers() {
     LogServerWarningMsg("Processing will be handled by a single worker.\n");
   }
 
+  // Determine the CPUs each worker should run on. The list was already
+  // checked by ApplyThreadPlacement.
+  std::set<uint32_t> workerCPUs;
+  ParseCPUList(mConfig->GetWorkerCPUs(), workerCPUs);
+
+  bool perCPU = objects::ServerConfig::WorkerPlacement_t::PER_CPU ==
+                mConfig->GetWorkerPlacement();
+
+  std::vector<uint32_t> cpuOrder(workerCPUs.begin(), workerCPUs.end());
+
+  // The main and async workers may run on any of the worker CPUs.
+  if (!workerCPUs.empty()) {
+    mMainWorker->SetPlacement(workerCPUs, mConfig->GetWorkerLocalMemory());
+  }
+
+  LogThreadPlacement("main_worker", workerCPUs);
+
   if (mConfig->GetMultithreadMode()) {
+    if (!workerCPUs.empty()) {
+      mQueueWorker->SetPlacement(workerCPUs, mConfig->GetWorkerLocalMemory());
+    }
+
+    LogThreadPlacement("async_worker", workerCPUs);
+
     for (unsigned int i = 0; i < numberOfWorkers; i++) {
       auto worker = std::shared_ptr<Worker>(new Worker);
-      worker->Start(libcomp::String("worker%1").Arg(i));
+      auto name = libcomp::String("worker%1").Arg(i);
+
+      std::set<uint32_t> cpus = workerCPUs;
+
+      if (!cpuOrder.empty()) {
+        if (perCPU) {
+          cpus = {cpuOrder[i % cpuOrder.size()]};
+        }
+
+        worker->SetPlacement(cpus, mConfig->GetWorkerLocalMemory());
+      }
+
+      LogThreadPlacement(name, cpus);
+
+      worker->Start(name);
       mWorkers.push_back(worker);
     }
   } else {
@@ -488,6 +553,121 @@ void BaseServer::CreateWorkers() {
   }
 }
 
+bool BaseServer::ParseCPUList(const libcomp::String& cpuList,
+                              std::set<uint32_t>& cpus) {
+  for (auto range : cpuList.Split(",")) {
+    range = range.Trimmed();
+
+    if (range.IsEmpty()) {
+      continue;
+    }
+
+    auto bounds = range.Split("-");
+
+    if (2 < bounds.size()) {
+      return false;
+    }
+
+    bool ok = false;
+    uint32_t first = bounds.front().Trimmed().ToInteger<uint32_t>(&ok);
+
+    if (!ok) {
+      return false;
+    }
+
+    uint32_t last = bounds.back().Trimmed().ToInteger<uint32_t>(&ok);
+
+    if (!ok || last < first || MAX_CPU_COUNT <= last) {
+      return false;
+    }
+
+    for (uint32_t cpu = first; cpu <= last; ++cpu) {
+      cpus.insert(cpu);
+    }
+  }
+
+  return true;
+}
+
+bool BaseServer::ApplyThreadPlacement() {
+  std::set<uint32_t> workerCPUs, ioCPUs, timerCPUs, logCPUs;
+
+  // The worker list is only checked here; the workers are placed when
+  // they are created.
+  if (!ParseCPUList(mConfig->GetWorkerCPUs(), workerCPUs) ||
+      !ParseCPUList(mConfig->GetIOCPUs(), ioCPUs) ||
+      !ParseCPUList(mConfig->GetTimerCPUs(), timerCPUs) ||
+      !ParseCPUList(mConfig->GetLogCPUs(), logCPUs)) {
+    LogServerCriticalMsg("Invalid CPU list specified in the config.\n");
+
+    return false;
+  }
+
+  // The ASIO service thread is placed when the server starts and is
+  // reported by ServiceThreadPlaced when the thread starts.
+  if (!ioCPUs.empty()) {
+    SetServiceAffinity(ioCPUs);
+  }
+
+  if (!timerCPUs.empty() && !mTimerManager.SetThreadAffinity(timerCPUs)) {
+    LogServerWarningMsg("Failed to set the CPU affinity of the timer "
+                        "thread.\n");
+
+    timerCPUs.clear();
+  }
+
+  LogThreadPlacement("timer", timerCPUs);
+
+  if (!logCPUs.empty() &&
+      !BaseLog::GetBaseSingletonPtr()->SetThreadAffinity(logCPUs)) {
+    LogServerWarningMsg("Failed to set the CPU affinity of the log "
+                        "thread.\n");
+
+    logCPUs.clear();
+  }
+
+  LogThreadPlacement("log", logCPUs);
+
+  return true;
+}
+
+void BaseServer::ServiceThreadPlaced(const std::set<uint32_t>& cpus) {
+  LogThreadPlacement("asio", cpus);
+}
+
+void BaseServer::LogThreadPlacement(const libcomp::String& name,
+                                    const std::set<uint32_t>& cpus) const {
+  if (cpus.empty()) {
+    LogServerInfo([&]() {
+      return String("Thread '%1' is unpinned.\n").Arg(name);
+    });
+
+    return;
+  }
+
+  std::list<libcomp::String> cpuStrings;
+  std::set<int32_t> nodes;
+
+  for (auto cpu : cpus) {
+    cpuStrings.push_back(libcomp::String("%1").Arg(cpu));
+    nodes.insert(Platform::GetCPUNode(cpu));
+  }
+
+  std::list<libcomp::String> nodeStrings;
+
+  for (auto node : nodes) {
+    nodeStrings.push_back(
+        node < 0 ? libcomp::String("?") : libcomp::String("%1").Arg(node));
+  }
+
+  LogServerInfo([&]() {
+    return String("Thread '%1' placed on CPU(s) %2 (NUMA node(s) %3).\n")
+        .Arg(name)
+        .Arg(libcomp::String::Join(cpuStrings, ","))
+        .Arg(libcomp::String::Join(nodeStrings, ","));
+  });
+}
+
 bool BaseServer::AssignMessageQueue(
     const std::shared_ptr<libcomp::EncryptedConnection>& connection) {
   std::shared_ptr<libcomp::Worker> worker =
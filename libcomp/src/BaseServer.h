@@ -197,6 +197,16 @@ class BaseServer : public TcpServer,
   static bool ReadConfig(std::shared_ptr<objects::ServerConfig> config,
                          tinyxml2::XMLDocument& doc);
 
+  /**
+   * Parse a list of CPU indexes and ranges such as "0-3,8,10-11".
+   * Indexes of 1024 or higher are rejected.
+   * @param cpuList String representation of the CPU list
+   * @param cpus Output set of the CPU indexes in the list
+   * @return true if the list was valid, false otherwise
+   */
+  static bool ParseCPUList(const libcomp::String& cpuList,
+                           std::set<uint32_t>& cpus);
+
   /**
    * Get the server config file read during the constructor steps.
    * @return Pointer to the server config
@@ -243,6 +253,32 @@ class BaseServer : public TcpServer,
    */
   void CreateWorkers();
 
+  /**
+   * Place the ASIO service, timer and log threads on the CPUs specified
+   * in the server config and report where each thread was placed. The
+   * worker CPU list is checked here as well so any invalid list fails
+   * the server initialization. The workers are placed by
+   * @ref CreateWorkers.
+   * @return true on success, false if the config is invalid
+   */
+  bool ApplyThreadPlacement();
+
+  /**
+   * Report the CPUs and NUMA nodes a thread has been placed on.
+   * @param name Name of the thread
+   * @param cpus Indexes of the CPUs the thread may run on (empty if the
+   *  thread is unpinned)
+   */
+  void LogThreadPlacement(const libcomp::String& name,
+                          const std::set<uint32_t>& cpus) const;
+
+  /**
+   * Report the placement of the ASIO service thread when it starts.
+   * @param cpus Indexes of the CPUs the service thread may run on (empty
+   *  if the thread is unpinned)
+   */
+  virtual void ServiceThreadPlaced(const std::set<uint32_t>& cpus);
+
   /**
    * Retrieve and assign a message queue to use for a new connection.
    * The method of deciding which worker to use is not contained in this
@@ -33,53 +33,1381 @@
 #include "BaseScriptEngine.h"
 #include "BaseServer.h"
 #include "DataStore.h"
+#include "DatabaseBind.h"
+#include "DatabaseQueryRow.h"
+#include "Exception.h"
+#include "ObjectResidency.h"
+
+// Standard C++11 Includes
+#include <algorithm>
+#include <condition_variable>
+#include <cmath>
+#include <deque>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <thread>
 
 using namespace libcomp;
 
-Database::Database(const std::shared_ptr<objects::DatabaseConfig>& config) {
+/// Most rows written by a single batched INSERT statement.
+static const size_t MAX_INSERT_BATCH_ROWS = 500;
+
+/// Most rows written by a single batched UPDATE statement. Each row adds a
+/// branch to the CASE expression of every column so these are kept small.
+static const size_t MAX_UPDATE_BATCH_ROWS = 50;
+
+/// Most records changed by a single batched explicit update. Each record
+/// adds a branch to the CASE expression of every column and a condition to
+/// the WHERE clause.
+static const size_t MAX_EXPLICIT_BATCH_ROWS = 50;
+
+/// Most objects selected by a single batched load by UID.
+static const size_t MAX_LOAD_BATCH_ROWS = 500;
+
+/// Rows loaded on the calling thread before a parallel load starts its
+/// threads.
+static const size_t MIN_PARALLEL_LOAD_ROWS = 64;
+
+/// Copied rows allowed to wait for each parallel load thread.
+static const size_t MAX_QUEUED_LOAD_ROWS = 32;
+
+namespace {
+
+/**
+ * Objects of the same type writing the same set of columns.
+ */
+struct ObjectBatch {
+  /// Type of every object in the batch
+  std::shared_ptr<libobjgen::MetaObject> metaObject;
+
+  /// Columns written for each object
+  std::list<String> columns;
+
+  /// UID and values (in column order) of each object
+  std::list<std::pair<libobjgen::UUID, std::vector<DatabaseBind*>>> rows;
+};
+
+}  // namespace
+
+/**
+ * Group objects by type and set of columns to write.
+ * @param objs Objects to group.
+ * @param insert true to write every column of new objects, false to write
+ *  the changed columns of existing objects.
+ * @param batches List of batches to add the objects to. Batches are added
+ *  in the order their first object is listed so the statements written
+ *  from them run in the order of the objects.
+ * @return false if an object could not be saved.
+ */
+static bool GroupObjects(
+    const std::list<std::shared_ptr<PersistentObject>>& objs, bool insert,
+    std::list<ObjectBatch>& batches) {
+  std::unordered_map<std::string, ObjectBatch*> batchLookup;
+
+  for (auto obj : objs) {
+    std::stringstream objstream;
+    if (!obj->Save(objstream)) {
+      return false;
+    }
+
+    if (insert) {
+      if (obj->GetUUID().IsNull() && !obj->Register(obj)) {
+        return false;
+      }
+    } else if (obj->GetUUID().IsNull()) {
+      return false;
+    }
+
+    auto values = obj->GetMemberBindValues(insert);
+
+    if (values.empty() && !insert) {
+      // Nothing updated, nothing to do
+      continue;
+    }
+
+    std::list<String> columns;
+
+    for (auto value : values) {
+      columns.push_back(value->GetColumn());
+    }
+
+    auto metaObject = obj->GetObjectMetadata();
+    auto key = String("%1:%2")
+                   .Arg(metaObject->GetName())
+                   .Arg(String::Join(columns, ","))
+                   .ToUtf8();
+
+    auto& pBatch = batchLookup[key];
+
+    if (nullptr == pBatch) {
+      batches.push_back(ObjectBatch());
+
+      pBatch = &batches.back();
+      pBatch->metaObject = metaObject;
+      pBatch->columns = columns;
+    }
+
+    pBatch->rows.push_back(std::make_pair(
+        obj->GetUUID(),
+        std::vector<DatabaseBind*>(values.begin(), values.end())));
+  }
+
+  return true;
+}
+
+/**
+ * Explicit updates changing the same columns of the same table.
+ */
+struct ExplicitUpdateBatch {
+  /// Table every update changes
+  String table;
+
+  /// Columns every update changes in name order
+  std::list<String> columns;
+
+  /// Updates in the order they were added
+  std::vector<std::shared_ptr<DBExplicitUpdate>> updates;
+};
+
+/**
+ * Write bytes as a hexadecimal literal.
+ * @param pData Bytes to write.
+ * @param size Number of bytes to write.
+ * @return Hexadecimal literal of the bytes.
+ */
+static String HexLiteral(const char* pData, size_t size) {
+  static const char digits[] = "0123456789ABCDEF";
+
+  std::string literal;
+  literal.reserve((size * 2) + 3);
+  literal += "X'";
+
+  for (size_t i = 0; i < size; ++i) {
+    auto byte = (uint8_t)pData[i];
+
+    literal += digits[byte >> 4];
+    literal += digits[byte & 0x0F];
+  }
+
+  literal += "'";
+
+  return literal;
+}
+
+/**
+ * Write a floating point value as a literal that reads back as the same
+ * value.
+ * @param value Value to write.
+ * @return Literal of the value or an empty string if the value is not a
+ *  finite number.
+ */
+template <typename T>
+static String RealLiteral(T value) {
+  if (!std::isfinite(value)) {
+    return String();
+  }
+
+  std::stringstream ss;
+  ss << std::setprecision(std::numeric_limits<T>::max_digits10) << value;
+
+  return ss.str();
+}
+
+/**
+ * Free the values of every object in the batches.
+ * @param batches Batches to free.
+ */
+static void FreeBatches(std::list<ObjectBatch>& batches) {
+  for (auto& batch : batches) {
+    for (auto& row : batch.rows) {
+      for (auto value : row.second) {
+        delete value;
+      }
+    }
+  }
+
+  batches.clear();
+}
+
+Database::Database(const std::shared_ptr<objects::DatabaseConfig>& config)
+    : mBatchInsertStatements(0),
+      mBatchInsertRows(0),
+      mBatchUpdateStatements(0),
+      mBatchUpdateRows(0),
+      mBatchExplicitStatements(0),
+      mBatchExplicitRows(0),
+      mBatchExplicitFallbacks(0),
+      mGroupCommitTransactions(0),
+      mGroupCommitChangeSets(0),
+      mGroupCommitRolledBack(0),
+      mGroupCommitFallbacks(0),
+      mLoadThreadsRunning(true) {
   mConfig = config;
+  mDeferredFlushDue = false;
+  mLastDeferredFlush = std::chrono::steady_clock::now();
+
+  if (nullptr != mConfig) {
+    DatabaseQueryStats::Configure(mConfig->GetQueryStats(),
+                                  mConfig->GetSlowQueryThreshold());
+    ObjectResidency::Configure((uint64_t)mConfig->GetResidencyBudget() *
+                               1024 * 1024);
+  }
+}
+
+Database::~Database() { StopLoadThreads(); }
+
+DatabaseQuery Database::PrepareRead(const String& query) {
+  return Prepare(query);
+}
+
+DatabaseQuery Database::PrepareLargeRead(const String& query) {
+  return PrepareRead(query);
+}
+
+bool Database::Execute(const String& query) { return Prepare(query).Execute(); }
+
+String Database::GetLastError() { return mError; }
+
+std::shared_ptr<void> Database::HoldConnection() { return nullptr; }
+
+DatabaseStatementCacheStats Database::GetStatementCacheStats() {
+  return DatabaseStatementCacheStats();
+}
+
+DatabaseBatchStats Database::GetBatchStats() const {
+  DatabaseBatchStats stats;
+  stats.insertStatements = mBatchInsertStatements;
+  stats.insertRows = mBatchInsertRows;
+  stats.updateStatements = mBatchUpdateStatements;
+  stats.updateRows = mBatchUpdateRows;
+  stats.explicitStatements = mBatchExplicitStatements;
+  stats.explicitRows = mBatchExplicitRows;
+  stats.explicitFallbacks = mBatchExplicitFallbacks;
+
+  return stats;
+}
+
+String Database::QuoteIdentifier(const String& name) const { return name; }
+
+size_t Database::GetMaxBindCount() const { return 999; }
+
+size_t Database::GetLoadBatchSize() const {
+  return std::max((size_t)1, std::min(MAX_LOAD_BATCH_ROWS, GetMaxBindCount()));
+}
+
+size_t Database::GetFirstBindIndex() const { return 0; }
+
+bool Database::InsertObjects(
+    const std::list<std::shared_ptr<PersistentObject>>& objs) {
+  std::list<ObjectBatch> batches;
+
+  bool result = GroupObjects(objs, true, batches);
+
+  for (auto& batch : batches) {
+    if (!result) {
+      break;
+    }
+
+    size_t bindsPerRow = batch.columns.size() + 1;
+    size_t maxRows = std::max((size_t)1,
+                              std::min(MAX_INSERT_BATCH_ROWS,
+                                       GetMaxBindCount() / bindsPerRow));
+
+    std::list<String> columnNames;
+    columnNames.push_back(QuoteIdentifier("UID"));
+
+    for (auto column : batch.columns) {
+      columnNames.push_back(QuoteIdentifier(column));
+    }
+
+    String rowBinds = String("(%1)").Arg(
+        String::Join(std::list<String>(bindsPerRow, "?"), ", "));
+
+    auto rowIter = batch.rows.begin();
+
+    while (result && rowIter != batch.rows.end()) {
+      size_t rowCount = std::min(
+          maxRows, (size_t)std::distance(rowIter, batch.rows.end()));
+
+      String sql =
+          String("INSERT INTO %1 (%2) VALUES %3;")
+              .Arg(QuoteIdentifier(batch.metaObject->GetName()))
+              .Arg(String::Join(columnNames, ", "))
+              .Arg(String::Join(std::list<String>(rowCount, rowBinds), ", "));
+
+      DatabaseQuery query = Prepare(sql);
+
+      if (!query.IsValid()) {
+        LogDatabaseError([&]() {
+          return String("Failed to prepare SQL query: %1\n").Arg(sql);
+        });
+
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+
+        result = false;
+        break;
+      }
+
+      size_t idx = GetFirstBindIndex();
+
+      for (size_t i = 0; result && i < rowCount; ++i, ++rowIter) {
+        if (!query.Bind(idx++, rowIter->first)) {
+          LogDatabaseErrorMsg("Failed to bind value: UID\n");
+
+          result = false;
+          break;
+        }
+
+        for (auto value : rowIter->second) {
+          if (!value->Bind(query, idx++)) {
+            LogDatabaseError([&]() {
+              return String("Failed to bind value: %1\n")
+                  .Arg(value->GetColumn());
+            });
+
+            result = false;
+            break;
+          }
+        }
+      }
+
+      if (result && !query.Execute()) {
+        LogDatabaseError(
+            [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
+
+        result = false;
+      }
+
+      if (!result) {
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+      } else {
+        mBatchInsertStatements++;
+        mBatchInsertRows += rowCount;
+      }
+    }
+  }
+
+  FreeBatches(batches);
+
+  return result;
+}
+
+bool Database::UpdateObjects(
+    const std::list<std::shared_ptr<PersistentObject>>& objs) {
+  std::list<ObjectBatch> batches;
+
+  bool result = GroupObjects(objs, false, batches);
+
+  for (auto& batch : batches) {
+    if (!result) {
+      break;
+    }
+
+    // Each row binds its UID and value for every column plus its UID in
+    // the WHERE clause.
+    size_t bindsPerRow = (batch.columns.size() * 2) + 1;
+    size_t maxRows = std::max((size_t)1,
+                              std::min(MAX_UPDATE_BATCH_ROWS,
+                                       GetMaxBindCount() / bindsPerRow));
+
+    String uidColumn = QuoteIdentifier("UID");
+
+    auto rowIter = batch.rows.begin();
+
+    while (result && rowIter != batch.rows.end()) {
+      size_t rowCount = std::min(
+          maxRows, (size_t)std::distance(rowIter, batch.rows.end()));
+
+      String cases = String::Join(std::list<String>(rowCount, "WHEN ? THEN ?"),
+                                  " ");
+
+      std::list<String> setters;
+
+      for (auto column : batch.columns) {
+        setters.push_back(String("%1 = CASE %2 %3 END")
+                              .Arg(QuoteIdentifier(column))
+                              .Arg(uidColumn)
+                              .Arg(cases));
+      }
+
+      String sql =
+          String("UPDATE %1 SET %2 WHERE %3 IN (%4);")
+              .Arg(QuoteIdentifier(batch.metaObject->GetName()))
+              .Arg(String::Join(setters, ", "))
+              .Arg(uidColumn)
+              .Arg(String::Join(std::list<String>(rowCount, "?"), ", "));
+
+      DatabaseQuery query = Prepare(sql);
+
+      if (!query.IsValid()) {
+        LogDatabaseError([&]() {
+          return String("Failed to prepare SQL query: %1\n").Arg(sql);
+        });
+
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+
+        result = false;
+        break;
+      }
+
+      auto chunkEnd = rowIter;
+      std::advance(chunkEnd, (std::ptrdiff_t)rowCount);
+
+      size_t idx = GetFirstBindIndex();
+
+      for (size_t col = 0; result && col < batch.columns.size(); ++col) {
+        for (auto it = rowIter; it != chunkEnd; ++it) {
+          if (!query.Bind(idx++, it->first) ||
+              !it->second[col]->Bind(query, idx++)) {
+            LogDatabaseError([&]() {
+              return String("Failed to bind value: %1\n")
+                  .Arg(it->second[col]->GetColumn());
+            });
+
+            result = false;
+            break;
+          }
+        }
+      }
+
+      for (auto it = rowIter; result && it != chunkEnd; ++it) {
+        if (!query.Bind(idx++, it->first)) {
+          LogDatabaseErrorMsg("Failed to bind value: UID\n");
+
+          result = false;
+        }
+      }
+
+      if (result && !query.Execute()) {
+        LogDatabaseError(
+            [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
+
+        result = false;
+      }
+
+      if (!result) {
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+      } else {
+        mBatchUpdateStatements++;
+        mBatchUpdateRows += rowCount;
+      }
+
+      rowIter = chunkEnd;
+    }
+  }
+
+  FreeBatches(batches);
+
+  return result;
+}
+
+bool Database::FormatChangeSet(
+    const std::shared_ptr<DBStandardChangeSet>& changes,
+    std::list<String>& statements) {
+  std::list<ObjectBatch> inserts;
+  std::list<ObjectBatch> updates;
+
+  bool result = GroupObjects(changes->GetInserts(), true, inserts) &&
+                GroupObjects(changes->GetUpdates(), false, updates);
+
+  String uidColumn = QuoteIdentifier("UID");
+
+  for (auto& batch : inserts) {
+    if (!result) {
+      break;
+    }
+
+    std::list<String> columnNames;
+    columnNames.push_back(uidColumn);
+
+    for (auto column : batch.columns) {
+      columnNames.push_back(QuoteIdentifier(column));
+    }
+
+    std::list<String> rows;
+
+    for (auto& row : batch.rows) {
+      std::list<String> values;
+      values.push_back(FormatUUIDLiteral(row.first));
+
+      for (auto value : row.second) {
+        auto literal = FormatLiteral(value);
+
+        if (literal.IsEmpty()) {
+          result = false;
+          break;
+        }
+
+        values.push_back(literal);
+      }
+
+      if (!result) {
+        break;
+      }
+
+      rows.push_back(String("(%1)").Arg(String::Join(values, ", ")));
+
+      if (MAX_INSERT_BATCH_ROWS == rows.size() ||
+          &row == &batch.rows.back()) {
+        statements.push_back(
+            String("INSERT INTO %1 (%2) VALUES %3;")
+                .Arg(QuoteIdentifier(batch.metaObject->GetName()))
+                .Arg(String::Join(columnNames, ", "))
+                .Arg(String::Join(rows, ", ")));
+        rows.clear();
+      }
+    }
+  }
+
+  for (auto& batch : updates) {
+    if (!result) {
+      break;
+    }
+
+    for (auto& row : batch.rows) {
+      std::list<String> setters;
+
+      for (auto value : row.second) {
+        auto literal = FormatLiteral(value);
+
+        if (literal.IsEmpty()) {
+          result = false;
+          break;
+        }
+
+        setters.push_back(String("%1 = %2")
+                              .Arg(QuoteIdentifier(value->GetColumn()))
+                              .Arg(literal));
+      }
+
+      if (!result) {
+        break;
+      }
+
+      statements.push_back(String("UPDATE %1 SET %2 WHERE %3 = %4;")
+                               .Arg(QuoteIdentifier(batch.metaObject->GetName()))
+                               .Arg(String::Join(setters, ", "))
+                               .Arg(uidColumn)
+                               .Arg(FormatUUIDLiteral(row.first)));
+    }
+  }
+
+  FreeBatches(inserts);
+  FreeBatches(updates);
+
+  if (!result) {
+    LogDatabaseErrorMsg("Failed to write the change set as statements.\n");
+
+    return false;
+  }
+
+  // Delete the objects of each type with one statement.
+  std::list<String> tables;
+  std::unordered_map<std::string, std::list<String>> deletes;
+
+  for (auto obj : changes->GetDeletes()) {
+    if (obj->GetUUID().IsNull()) {
+      return false;
+    }
+
+    auto table = QuoteIdentifier(obj->GetObjectMetadata()->GetName());
+    auto& uids = deletes[table.ToUtf8()];
+
+    if (uids.empty()) {
+      tables.push_back(table);
+    }
+
+    uids.push_back(FormatUUIDLiteral(obj->GetUUID()));
+  }
+
+  for (auto table : tables) {
+    statements.push_back(String("DELETE FROM %1 WHERE %2 IN (%3);")
+                             .Arg(table)
+                             .Arg(uidColumn)
+                             .Arg(String::Join(deletes[table.ToUtf8()], ", ")));
+  }
+
+  return true;
+}
+
+String Database::FormatLiteral(const DatabaseBind* pValue) const {
+  if (auto pText = dynamic_cast<const DatabaseBindText*>(pValue)) {
+    return String("'%1'").Arg(pText->GetValue().Replace("'", "''"));
+  } else if (auto pBlob = dynamic_cast<const DatabaseBindBlob*>(pValue)) {
+    auto value = pBlob->GetValue();
+
+    return HexLiteral(value.data(), value.size());
+  } else if (auto pUUID = dynamic_cast<const DatabaseBindUUID*>(pValue)) {
+    return FormatUUIDLiteral(pUUID->GetValue());
+  } else if (auto pInt = dynamic_cast<const DatabaseBindInt*>(pValue)) {
+    return String("%1").Arg(pInt->GetValue());
+  } else if (auto pBigInt = dynamic_cast<const DatabaseBindBigInt*>(pValue)) {
+    return String("%1").Arg(pBigInt->GetValue());
+  } else if (auto pFloat = dynamic_cast<const DatabaseBindFloat*>(pValue)) {
+    return RealLiteral(pFloat->GetValue());
+  } else if (auto pDouble = dynamic_cast<const DatabaseBindDouble*>(pValue)) {
+    return RealLiteral(pDouble->GetValue());
+  } else if (auto pBool = dynamic_cast<const DatabaseBindBool*>(pValue)) {
+    return pBool->GetValue() ? "1" : "0";
+  }
+
+  return String();
+}
+
+String Database::FormatUUIDLiteral(const libobjgen::UUID& uuid) const {
+  if (mConfig->GetBinaryUUIDs()) {
+    auto data = uuid.ToData();
+
+    return HexLiteral(data.data(), data.size());
+  }
+
+  return String("'%1'").Arg(uuid.ToString());
+}
+
+bool Database::ProcessExplicitUpdates(
+    const std::list<std::shared_ptr<DBExplicitUpdate>>& updates) {
+  // Batches in the order their first update was added.
+  std::list<ExplicitUpdateBatch> batches;
+  std::unordered_map<std::string, ExplicitUpdateBatch*> batchLookup;
+  std::unordered_set<libobjgen::UUID> records;
+
+  bool result = true;
+
+  auto runBatches = [&]() {
+    for (auto& batch : batches) {
+      // Each record binds its UID and value for every column plus its UID and
+      // expected value for every column in the WHERE clause.
+      size_t bindsPerRow = (batch.columns.size() * 3) + 1;
+      size_t maxRows = std::max((size_t)1,
+                                std::min(MAX_EXPLICIT_BATCH_ROWS,
+                                         GetMaxBindCount() / bindsPerRow));
+
+      auto rowIter = batch.updates.begin();
+
+      while (result && rowIter != batch.updates.end()) {
+        size_t rowCount = std::min(
+            maxRows, (size_t)std::distance(rowIter, batch.updates.end()));
+
+        std::vector<std::shared_ptr<DBExplicitUpdate>> chunk(
+            rowIter, rowIter + (std::ptrdiff_t)rowCount);
+
+        rowIter += (std::ptrdiff_t)rowCount;
+
+        if (1 == rowCount) {
+          if (1 != ExecuteExplicitUpdates(batch.table, batch.columns, chunk)) {
+            chunk.front()->SetFailed(true);
+            result = false;
+          }
+
+          continue;
+        }
+
+        // Without a savepoint a batch that only matches some records can
+        // not be undone so each update is run on its own instead.
+        bool savepoint =
+            ExecuteTransactionControl("SAVEPOINT explicit_updates");
+
+        if (savepoint) {
+          if ((int64_t)rowCount ==
+              ExecuteExplicitUpdates(batch.table, batch.columns, chunk)) {
+            result =
+                ExecuteTransactionControl("RELEASE SAVEPOINT explicit_updates");
+            continue;
+          }
+
+          // Undo the records that did match and run each update on its own
+          // to find the ones that failed.
+          if (!ExecuteTransactionControl(
+                  "ROLLBACK TO SAVEPOINT explicit_updates")) {
+            result = false;
+            break;
+          }
+        }
+
+        mBatchExplicitFallbacks++;
+
+        for (auto& update : chunk) {
+          std::vector<std::shared_ptr<DBExplicitUpdate>> single = {update};
+
+          if (1 != ExecuteExplicitUpdates(batch.table, batch.columns, single)) {
+            update->SetFailed(true);
+            result = false;
+          }
+        }
+
+        if (savepoint) {
+          // The batch only got here because a record did not match.
+          result = false;
+
+          ExecuteTransactionControl("RELEASE SAVEPOINT explicit_updates");
+        }
+      }
+
+      if (!result) {
+        break;
+      }
+    }
+
+    batches.clear();
+    batchLookup.clear();
+    records.clear();
+  };
+
+  for (auto& update : updates) {
+    auto obj = update ? update->GetRecord() : nullptr;
+
+    if (!obj) {
+      result = false;
+      break;
+    }
+
+    update->SetFailed(false);
+
+    auto expectedVals = update->GetExpectedValues();
+    auto changedVals = update->GetChanges();
+
+    std::list<String> columns;
+
+    for (auto& cPair : changedVals) {
+      if (expectedVals.find(cPair.first) == expectedVals.end()) {
+        break;
+      }
+
+      columns.push_back(cPair.first);
+    }
+
+    if (changedVals.empty() || columns.size() != changedVals.size()) {
+      result = false;
+      break;
+    }
+
+    // Sort the columns so every update with the same shape builds the same
+    // statement and can use the same cached prepared statement.
+    columns.sort();
+
+    // Later updates to a record may expect the values set by earlier ones
+    // so run everything so far before updating the same record again.
+    if (!records.insert(obj->GetUUID()).second) {
+      runBatches();
+
+      if (!result) {
+        break;
+      }
+
+      records.insert(obj->GetUUID());
+    }
+
+    auto table = obj->GetObjectMetadata()->GetName();
+    auto key = String("%1:%2")
+                   .Arg(table)
+                   .Arg(String::Join(columns, ","))
+                   .ToUtf8();
+
+    auto& pBatch = batchLookup[key];
+
+    if (!pBatch) {
+      batches.push_back(ExplicitUpdateBatch());
+
+      pBatch = &batches.back();
+      pBatch->table = table;
+      pBatch->columns = columns;
+    }
+
+    pBatch->updates.push_back(update);
+  }
+
+  if (result) {
+    runBatches();
+  }
+
+  return result;
+}
+
+int64_t Database::ExecuteExplicitUpdates(
+    const String& table, const std::list<String>& columns,
+    const std::vector<std::shared_ptr<DBExplicitUpdate>>& updates) {
+  String uidColumn = QuoteIdentifier("UID");
+
+  std::list<String> setters;
+  std::list<String> conditions;
+
+  for (auto& column : columns) {
+    conditions.push_back(String("%1 = ?").Arg(QuoteIdentifier(column)));
+  }
+
+  String rowCondition = String("%1 = ? AND %2")
+                            .Arg(uidColumn)
+                            .Arg(String::Join(conditions, " AND "));
+
+  String sql;
+
+  if (1 == updates.size()) {
+    for (auto& column : columns) {
+      setters.push_back(String("%1 = ?").Arg(QuoteIdentifier(column)));
+    }
+
+    sql = String("UPDATE %1 SET %2 WHERE %3;")
+              .Arg(QuoteIdentifier(table))
+              .Arg(String::Join(setters, ", "))
+              .Arg(rowCondition);
+  } else {
+    String cases = String::Join(
+        std::list<String>(updates.size(), "WHEN ? THEN ?"), " ");
+
+    for (auto& column : columns) {
+      setters.push_back(String("%1 = CASE %2 %3 ELSE %1 END")
+                            .Arg(QuoteIdentifier(column))
+                            .Arg(uidColumn)
+                            .Arg(cases));
+    }
+
+    sql = String("UPDATE %1 SET %2 WHERE %3;")
+              .Arg(QuoteIdentifier(table))
+              .Arg(String::Join(setters, ", "))
+              .Arg(String::Join(std::list<String>(updates.size(),
+                                                  String("(%1)").Arg(
+                                                      rowCondition)),
+                                " OR "));
+  }
+
+  DatabaseQuery query = Prepare(sql);
+
+  if (!query.IsValid()) {
+    LogDatabaseError(
+        [&]() { return String("Failed to prepare SQL query: %1\n").Arg(sql); });
+
+    LogDatabaseError(
+        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+    return -1;
+  }
+
+  size_t idx = GetFirstBindIndex();
+
+  // Bind the new value of each column by UID.
+  for (auto& column : columns) {
+    std::string key = column.ToUtf8();
+
+    for (auto& update : updates) {
+      auto changedVals = update->GetChanges();
+
+      if ((1 < updates.size() &&
+           !query.Bind(idx++, update->GetRecord()->GetUUID())) ||
+          !changedVals[key]->Bind(query, idx++)) {
+        LogDatabaseError([&]() {
+          return String("Failed to bind value: %1\n").Arg(column);
+        });
+
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+
+        return -1;
+      }
+    }
+  }
+
+  // Now bind the UID and expected values of each record.
+  for (auto& update : updates) {
+    if (!query.Bind(idx++, update->GetRecord()->GetUUID())) {
+      LogDatabaseErrorMsg("Failed to bind value: UID\n");
+
+      LogDatabaseError(
+          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+      return -1;
+    }
+
+    auto expectedVals = update->GetExpectedValues();
+
+    for (auto& column : columns) {
+      if (!expectedVals[column.ToUtf8()]->Bind(query, idx++)) {
+        LogDatabaseError([&]() {
+          return String("Failed to bind where clause for value: %1\n")
+              .Arg(column);
+        });
+
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+
+        return -1;
+      }
+    }
+  }
+
+  if (!query.Execute()) {
+    LogDatabaseError(
+        [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
+
+    LogDatabaseError(
+        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+    return -1;
+  }
+
+  mBatchExplicitStatements++;
+  mBatchExplicitRows += updates.size();
+
+  return query.AffectedRowCount();
+}
+
+std::shared_ptr<objects::DatabaseConfig> Database::GetConfig() const {
+  return mConfig;
+}
+
+bool Database::TableHasRows(const String& table) {
+  libcomp::DatabaseQuery query =
+      PrepareRead(String("SELECT COUNT(1) FROM %1").Arg(table));
+
+  if (!query.IsValid()) {
+    return false;
+  }
+
+  if (!query.Execute()) {
+    return false;
+  }
+
+  if (!query.Next()) {
+    return false;
+  }
+
+  int64_t count;
+
+  if (!query.GetValue(0, count)) {
+    return false;
+  }
+
+  return 0 < count;
+}
+
+std::shared_ptr<PersistentObject> Database::LoadSingleObject(
+    size_t typeHash, DatabaseBind* pValue) {
+  auto objects = LoadObjects(typeHash, pValue);
+
+  return objects.size() > 0 ? objects.front() : nullptr;
+}
+
+bool Database::ForEachObject(
+    size_t typeHash, DatabaseBind* pValue,
+    const std::function<bool(const std::shared_ptr<PersistentObject>&)>&
+        callback) {
+  auto metaObject = PersistentObject::GetRegisteredMetadata(typeHash);
+
+  if (nullptr == metaObject) {
+    LogDatabaseErrorMsg("Failed to lookup MetaObject.\n");
+
+    return false;
+  }
+
+  DatabaseQuery query(nullptr);
+
+  if (!ExecuteLoadQuery(metaObject, pValue, query)) {
+    return false;
+  }
+
+  int failures = 0;
+
+  while (query.Next()) {
+    auto obj = LoadSingleObjectFromRow(typeHash, query);
+
+    if (nullptr == obj) {
+      failures++;
+    } else if (!callback(obj)) {
+      break;
+    }
+  }
+
+  if (failures > 0) {
+    LogDatabaseError([&]() {
+      return String("%1 '%2' row%3 failed to load.\n")
+          .Arg(failures)
+          .Arg(metaObject->GetName())
+          .Arg(failures != 1 ? "s" : "");
+    });
+  }
+
+  return true;
+}
+
+std::list<std::shared_ptr<PersistentObject>> Database::LoadObjectsParallel(
+    size_t typeHash, DatabaseBind* pValue, bool preserveOrder,
+    size_t threadCount) {
+  if (0 == threadCount) {
+    threadCount = (size_t)mConfig->GetLoadThreadCount();
+  }
+
+  std::list<std::shared_ptr<PersistentObject>> objects;
+
+  if (threadCount <= 1) {
+    ForEachObject(typeHash, pValue,
+                  [&objects](const std::shared_ptr<PersistentObject>& obj) {
+                    objects.push_back(obj);
+
+                    return true;
+                  });
+
+    return objects;
+  }
+
+  auto metaObject = PersistentObject::GetRegisteredMetadata(typeHash);
+
+  if (nullptr == metaObject) {
+    LogDatabaseErrorMsg("Failed to lookup MetaObject.\n");
+
+    return {};
+  }
+
+  DatabaseQuery query(nullptr);
+
+  if (!ExecuteLoadQuery(metaObject, pValue, query)) {
+    return {};
+  }
+
+  // Objects by row index when the order is kept. Every member below is
+  // shared with the load threads and guarded by the lock.
+  std::vector<std::shared_ptr<PersistentObject>> ordered;
+  std::deque<std::pair<size_t, DatabaseQueryRow*>> rows;
+  std::mutex lock;
+  std::condition_variable rowReady;
+  std::condition_variable rowTaken;
+  bool done = false;
+  int failures = 0;
+
+  size_t maxQueued = threadCount * MAX_QUEUED_LOAD_ROWS;
+
+  auto addObject = [&](size_t index,
+                       const std::shared_ptr<PersistentObject>& obj) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (nullptr == obj) {
+      failures++;
+    } else if (preserveOrder) {
+      ordered[index] = obj;
+    } else {
+      objects.push_back(obj);
+    }
+  };
+
+  // Number of load jobs that have not finished.
+  size_t running = 0;
+  std::condition_variable jobsDone;
+
+  auto loadRows = [&]() {
+    while (true) {
+      std::pair<size_t, DatabaseQueryRow*> row;
+
+      {
+        std::unique_lock<std::mutex> guard(lock);
+
+        rowReady.wait(guard, [&]() { return done || !rows.empty(); });
+
+        if (rows.empty()) {
+          break;
+        }
+
+        row = rows.front();
+        rows.pop_front();
+      }
+
+      rowTaken.notify_one();
+
+      DatabaseQuery rowQuery(row.second);
+
+      addObject(row.first, LoadSingleObjectFromRow(typeHash, rowQuery));
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (0 == --running) {
+      jobsDone.notify_all();
+    }
+  };
+
+  std::shared_ptr<const std::vector<std::string>> columnNames;
+
+  size_t rowCount = 0;
+
+  while (query.Next()) {
+    size_t index = rowCount++;
+
+    if (preserveOrder) {
+      std::lock_guard<std::mutex> guard(lock);
+
+      ordered.push_back(nullptr);
+    }
+
+    // Small results are not worth handing to the load threads so the
+    // first rows are always loaded here.
+    if (index < MIN_PARALLEL_LOAD_ROWS) {
+      addObject(index, LoadSingleObjectFromRow(typeHash, query));
+
+      continue;
+    }
+
+    if (MIN_PARALLEL_LOAD_ROWS == index) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+
+        running = threadCount;
+      }
+
+      for (size_t i = 0; i < threadCount; ++i) {
+        QueueLoadJob(threadCount, loadRows);
+      }
+    }
+
+    auto row = new DatabaseQueryRow(columnNames);
+
+    if (!query.CopyRow(*row)) {
+      delete row;
+
+      addObject(index, nullptr);
+
+      continue;
+    }
+
+    columnNames = row->GetColumnNames();
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+
+      rowTaken.wait(guard, [&]() { return rows.size() < maxQueued; });
+
+      rows.push_back(std::make_pair(index, row));
+    }
+
+    rowReady.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    done = true;
+  }
+
+  rowReady.notify_all();
+
+  {
+    // The jobs use the state above so wait for all of them to finish.
+    std::unique_lock<std::mutex> guard(lock);
+
+    jobsDone.wait(guard, [&]() { return 0 == running; });
+  }
+
+  if (failures > 0) {
+    LogDatabaseError([&]() {
+      return String("%1 '%2' row%3 failed to load.\n")
+          .Arg(failures)
+          .Arg(metaObject->GetName())
+          .Arg(failures != 1 ? "s" : "");
+    });
+  }
+
+  if (preserveOrder) {
+    for (auto& obj : ordered) {
+      if (nullptr != obj) {
+        objects.push_back(obj);
+      }
+    }
+  }
+
+  return objects;
 }
 
-Database::~Database() {}
+void Database::QueueLoadJob(size_t threadCount,
+                            const std::function<void()>& job) {
+  {
+    std::lock_guard<std::mutex> guard(mLoadLock);
 
-bool Database::Execute(const String& query) { return Prepare(query).Execute(); }
+    while (mLoadThreads.size() < threadCount) {
+      mLoadThreads.push_back(std::thread([this]() {
+#if !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
+        pthread_setname_np(pthread_self(), "db_load");
+#endif  // !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
 
-String Database::GetLastError() { return mError; }
+        libcomp::Exception::RegisterSignalHandler();
 
-std::shared_ptr<objects::DatabaseConfig> Database::GetConfig() const {
-  return mConfig;
+        while (true) {
+          std::function<void()> nextJob;
+
+          {
+            std::unique_lock<std::mutex> lock(mLoadLock);
+
+            mLoadJobReady.wait(lock, [this]() {
+              return !mLoadThreadsRunning || !mLoadJobs.empty();
+            });
+
+            if (mLoadJobs.empty()) {
+              break;
+            }
+
+            nextJob = mLoadJobs.front();
+            mLoadJobs.pop_front();
+          }
+
+          nextJob();
+        }
+      }));
+    }
+
+    mLoadJobs.push_back(job);
+  }
+
+  mLoadJobReady.notify_one();
 }
 
-bool Database::TableHasRows(const String& table) {
-  libcomp::DatabaseQuery query =
-      Prepare(String("SELECT COUNT(1) FROM %1").Arg(table));
+void Database::StopLoadThreads() {
+  {
+    std::lock_guard<std::mutex> guard(mLoadLock);
 
-  if (!query.IsValid()) {
-    return false;
+    mLoadThreadsRunning = false;
   }
 
-  if (!query.Execute()) {
-    return false;
+  mLoadJobReady.notify_all();
+
+  for (auto& t : mLoadThreads) {
+    t.join();
   }
 
-  if (!query.Next()) {
-    return false;
+  mLoadThreads.clear();
+}
+
+std::list<std::shared_ptr<PersistentObject>> Database::LoadObjectsByUUIDs(
+    size_t typeHash, const std::list<libobjgen::UUID>& uuids, bool reload,
+    size_t* pQueryCount) {
+  auto metaObject = PersistentObject::GetRegisteredMetadata(typeHash);
+
+  if (nullptr == metaObject) {
+    LogDatabaseErrorMsg("Failed to lookup MetaObject.\n");
+
+    return {};
   }
 
-  int64_t count;
+  // Objects by UID (nullptr until loaded) and the UIDs that are not
+  // already in the cache.
+  std::unordered_map<libobjgen::UUID, std::shared_ptr<PersistentObject>>
+      objects;
+  std::list<libobjgen::UUID> missing;
 
-  if (!query.GetValue(0, count)) {
-    return false;
+  for (auto& uuid : uuids) {
+    if (uuid.IsNull() || objects.end() != objects.find(uuid)) {
+      continue;
+    }
+
+    auto obj = !reload ? PersistentObject::GetObjectByUUID(uuid) : nullptr;
+
+    objects[uuid] = obj;
+
+    if (nullptr == obj) {
+      missing.push_back(uuid);
+    }
   }
 
-  return 0 < count;
-}
+  size_t maxRows = GetLoadBatchSize();
 
-std::shared_ptr<PersistentObject> Database::LoadSingleObject(
-    size_t typeHash, DatabaseBind* pValue) {
-  auto objects = LoadObjects(typeHash, pValue);
+  String table = QuoteIdentifier(metaObject->GetName());
+  String uidColumn = QuoteIdentifier("UID");
 
-  return objects.size() > 0 ? objects.front() : nullptr;
+  int failures = 0;
+
+  auto uuidIter = missing.begin();
+
+  while (uuidIter != missing.end()) {
+    size_t rowCount = std::min(
+        maxRows, (size_t)std::distance(uuidIter, missing.end()));
+
+    String sql =
+        String("SELECT * FROM %1 WHERE %2 IN (%3);")
+            .Arg(table)
+            .Arg(uidColumn)
+            .Arg(String::Join(std::list<String>(rowCount, "?"), ", "));
+
+    DatabaseQuery query = PrepareRead(sql);
+
+    if (!query.IsValid()) {
+      LogDatabaseError([&]() {
+        return String("Failed to prepare SQL query: %1\n").Arg(sql);
+      });
+
+      LogDatabaseError(
+          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+      return {};
+    }
+
+    size_t idx = GetFirstBindIndex();
+
+    for (size_t i = 0; i < rowCount; ++i, ++uuidIter) {
+      if (!query.Bind(idx++, *uuidIter)) {
+        LogDatabaseErrorMsg("Failed to bind value: UID\n");
+
+        LogDatabaseError([&]() {
+          return String("Database said: %1\n").Arg(GetLastError());
+        });
+
+        return {};
+      }
+    }
+
+    if (nullptr != pQueryCount) {
+      (*pQueryCount)++;
+    }
+
+    if (!query.Execute()) {
+      LogDatabaseError(
+          [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
+
+      LogDatabaseError(
+          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+      return {};
+    }
+
+    while (query.Next()) {
+      auto obj = LoadSingleObjectFromRow(typeHash, query);
+
+      if (nullptr != obj) {
+        objects[obj->GetUUID()] = obj;
+      } else {
+        failures++;
+      }
+    }
+  }
+
+  if (failures > 0) {
+    LogDatabaseError([&]() {
+      return String("%1 '%2' row%3 failed to load.\n")
+          .Arg(failures)
+          .Arg(metaObject->GetName())
+          .Arg(failures != 1 ? "s" : "");
+    });
+  }
+
+  // Return the objects in the order they were requested.
+  std::list<std::shared_ptr<PersistentObject>> result;
+
+  for (auto& uuid : uuids) {
+    auto it = objects.find(uuid);
+
+    if (objects.end() != it && nullptr != it->second) {
+      result.push_back(it->second);
+
+      // Only return each object once.
+      it->second = nullptr;
+    }
+  }
+
+  return result;
 }
 
 bool Database::DeleteSingleObject(std::shared_ptr<PersistentObject>& obj) {
@@ -97,6 +1425,12 @@ void Database::QueueInsert(std::shared_ptr<PersistentObject> obj,
 
 void Database::QueueUpdate(std::shared_ptr<PersistentObject> obj,
                            const libobjgen::UUID& uuid) {
+  if (uuid.IsNull() && mConfig && mConfig->GetWriteBehind()) {
+    DeferUpdate(obj);
+
+    return;
+  }
+
   auto s = DatabaseChangeSet::Create(uuid);
   s->Update(obj);
   QueueChangeSet(s);
@@ -112,7 +1446,6 @@ void Database::QueueDelete(std::shared_ptr<PersistentObject> obj,
 bool Database::QueueChangeSet(
     const std::shared_ptr<DatabaseChangeSet>& changes) {
   auto uuid = changes->GetTransactionUUID();
-  std::string key = uuid.ToString();
 
   auto opChanges = std::dynamic_pointer_cast<DBOperationalChangeSet>(changes);
   if (opChanges) {
@@ -124,7 +1457,7 @@ bool Database::QueueChangeSet(
 
     if (standardChanges) {
       std::lock_guard<std::mutex> lock(mTransactionLock);
-      auto queueEntry = mTransactionQueue[key];
+      auto queueEntry = mTransactionQueue[uuid];
       if (queueEntry == nullptr) {
         queueEntry = std::make_shared<DBStandardChangeSet>(uuid);
       }
@@ -139,9 +1472,14 @@ bool Database::QueueChangeSet(
 
       for (auto obj : standardChanges->GetDeletes()) {
         queueEntry->Delete(obj);
+
+        // Nothing is left to update once the object is deleted.
+        if (mDeferredUIDs.erase(obj->GetUUID())) {
+          mDeferredUpdates.remove(obj);
+        }
       }
 
-      mTransactionQueue[key] = queueEntry;
+      mTransactionQueue[uuid] = queueEntry;
 
       return true;
     }
@@ -152,11 +1490,27 @@ bool Database::QueueChangeSet(
 
 std::list<libobjgen::UUID> Database::ProcessTransactionQueue() {
   std::list<libobjgen::UUID> failures;
+  size_t deferred = 0;
 
-  std::unordered_map<std::string, std::shared_ptr<DBStandardChangeSet>> queue;
+  std::unordered_map<libobjgen::UUID, std::shared_ptr<DBStandardChangeSet>>
+      queue;
   {
     std::lock_guard<std::mutex> lock(mTransactionLock);
 
+    if (!mDeferredUpdates.empty()) {
+      auto interval =
+          std::chrono::milliseconds(mConfig->GetWriteBehindInterval());
+
+      if (mDeferredFlushDue ||
+          (std::chrono::steady_clock::now() - mLastDeferredFlush) >=
+              interval) {
+        deferred = TakeDeferredUpdates(mTransactionQueue);
+      }
+    } else {
+      // Deletes may have removed every object that made the flush due.
+      mDeferredFlushDue = false;
+    }
+
     if (mTransactionQueue.size() == 0) {
       return failures;
     }
@@ -166,24 +1520,264 @@ std::list<libobjgen::UUID> Database::ProcessTransactionQueue() {
   }
 
   // Process the general queue transaction first
-  auto nullKey = NULLUUID.ToString();
-  if (queue.find(nullKey) != queue.end()) {
-    if (!ProcessChangeSet(queue[nullKey])) {
-      failures.push_back(nullKey);
+  std::list<std::shared_ptr<DBStandardChangeSet>> changeSets;
+
+  auto nullIter = queue.find(NULLUUID);
+  if (nullIter != queue.end()) {
+    changeSets.push_back(nullIter->second);
+    queue.erase(nullIter);
+  }
+
+  for (auto& kv : queue) {
+    changeSets.push_back(kv.second);
+  }
+
+  if (mConfig && mConfig->GetGroupCommit() && 1 < changeSets.size()) {
+    size_t maxChangeSets =
+        std::max((size_t)1, (size_t)mConfig->GetGroupCommitMaxChangeSets());
+
+    while (!changeSets.empty()) {
+      std::list<std::shared_ptr<DBStandardChangeSet>> group;
+
+      auto end = changeSets.begin();
+      std::advance(end, std::min(maxChangeSets, changeSets.size()));
+      group.splice(group.end(), changeSets, changeSets.begin(), end);
+
+      failures.splice(failures.end(),
+                      1 < group.size()
+                          ? ProcessStandardChangeSets(group)
+                          : Database::ProcessStandardChangeSets(group));
+    }
+  } else {
+    for (auto& changes : changeSets) {
+      if (!ProcessChangeSet(changes)) {
+        failures.push_back(changes->GetTransactionUUID());
+      }
+    }
+  }
+
+  // The deferred updates are written with the ungrouped changes so they
+  // fail together and are reported as the null transaction UUID.
+  if (0 != deferred) {
+    bool failed =
+        failures.end() != std::find(failures.begin(), failures.end(), NULLUUID);
+
+    if (failed) {
+      LogDatabaseErrorMsg("Failed to write the deferred updates.\n");
+    }
+
+    std::lock_guard<std::mutex> lock(mTransactionLock);
+    mWriteBehindStats.flushes++;
+
+    if (failed) {
+      mWriteBehindStats.failures++;
+      mWriteBehindStats.failed += (uint64_t)deferred;
+    } else {
+      mWriteBehindStats.written += (uint64_t)deferred;
+    }
+  }
+
+  return failures;
+}
+
+void Database::DeferUpdate(const std::shared_ptr<PersistentObject>& obj) {
+  if (!obj) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mTransactionLock);
+
+  mWriteBehindStats.deferred++;
+
+  if (mDeferredUIDs.insert(obj->GetUUID()).second) {
+    mDeferredUpdates.push_back(obj);
+  } else {
+    // The pending update writes this change too.
+    mWriteBehindStats.absorbed++;
+  }
+
+  // Leave the write to the next ProcessTransactionQueue call instead of
+  // blocking the caller.
+  if (mDeferredUpdates.size() >= mConfig->GetWriteBehindMaxObjects()) {
+    mDeferredFlushDue = true;
+  }
+}
+
+bool Database::FlushDeferredUpdates() {
+  {
+    std::lock_guard<std::mutex> lock(mTransactionLock);
+
+    if (mDeferredUpdates.empty()) {
+      return true;
     }
-    queue.erase(nullKey);
+
+    mDeferredFlushDue = true;
+  }
+
+  // Write the rest of the queue too so any insert of a deferred object is
+  // written before it is updated.
+  auto failures = ProcessTransactionQueue();
+
+  if (!failures.empty()) {
+    LogDatabaseError([&]() {
+      return String("Failed to write %1 queued change set(s) while flushing "
+                    "the deferred updates.\n")
+          .Arg(failures.size());
+    });
+
+    return false;
   }
 
-  // Process the remaining transactions
-  for (auto kv : queue) {
-    if (!ProcessChangeSet(kv.second)) {
-      failures.push_back(kv.second->GetTransactionUUID());
+  return true;
+}
+
+DatabaseWriteBehindStats Database::GetWriteBehindStats() {
+  std::lock_guard<std::mutex> lock(mTransactionLock);
+
+  DatabaseWriteBehindStats stats = mWriteBehindStats;
+  stats.pending = (uint64_t)mDeferredUpdates.size();
+
+  return stats;
+}
+
+DatabaseGroupCommitStats Database::GetGroupCommitStats() const {
+  DatabaseGroupCommitStats stats;
+  stats.transactions = mGroupCommitTransactions;
+  stats.changeSets = mGroupCommitChangeSets;
+  stats.rolledBack = mGroupCommitRolledBack;
+  stats.fallbacks = mGroupCommitFallbacks;
+
+  return stats;
+}
+
+std::list<libobjgen::UUID> Database::ProcessStandardChangeSets(
+    const std::list<std::shared_ptr<DBStandardChangeSet>>& changes) {
+  std::list<libobjgen::UUID> failures;
+
+  for (auto& changeSet : changes) {
+    if (!ProcessStandardChangeSet(changeSet)) {
+      failures.push_back(changeSet->GetTransactionUUID());
     }
   }
 
   return failures;
 }
 
+bool Database::WriteChangeSet(
+    const std::shared_ptr<DBStandardChangeSet>& changes) {
+  // Write the inserts and updates in multi-row batches.
+  bool result = InsertObjects(changes->GetInserts()) &&
+                UpdateObjects(changes->GetUpdates());
+
+  auto deletes = changes->GetDeletes();
+  if (result && deletes.size()) {
+    result = DeleteObjects(deletes);
+  }
+
+  return result;
+}
+
+bool Database::ExecuteTransactionControl(const String& statement) {
+  return Execute(statement);
+}
+
+bool Database::WriteChangeSetsWithSavepoints(
+    const std::list<std::shared_ptr<DBStandardChangeSet>>& changes,
+    std::list<libobjgen::UUID>& failures) {
+  mGroupCommitTransactions++;
+
+  size_t index = 0;
+
+  for (auto& changeSet : changes) {
+    String savepoint = String("changes_%1").Arg(index++);
+
+    if (!ExecuteTransactionControl(String("SAVEPOINT %1").Arg(savepoint))) {
+      return false;
+    }
+
+    if (WriteChangeSet(changeSet)) {
+      mGroupCommitChangeSets++;
+    } else {
+      LogDatabaseWarning([&]() {
+        return String("Rolling back change set %1 of the group commit.\n")
+            .Arg(changeSet->GetTransactionUUID().ToString());
+      });
+
+      if (!ExecuteTransactionControl(
+              String("ROLLBACK TO SAVEPOINT %1").Arg(savepoint))) {
+        return false;
+      }
+
+      failures.push_back(changeSet->GetTransactionUUID());
+      mGroupCommitRolledBack++;
+    }
+
+    if (!ExecuteTransactionControl(
+            String("RELEASE SAVEPOINT %1").Arg(savepoint))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Database::DirtyFieldList Database::GetDirtyFields(
+    const std::list<std::shared_ptr<DBStandardChangeSet>>& changes) const {
+  DirtyFieldList dirtyFields;
+
+  for (auto& changeSet : changes) {
+    for (auto& obj : changeSet->GetUpdates()) {
+      dirtyFields.push_back(std::make_pair(obj, obj->GetDirtyFields()));
+    }
+  }
+
+  return dirtyFields;
+}
+
+std::list<libobjgen::UUID> Database::FallbackChangeSets(
+    const std::list<std::shared_ptr<DBStandardChangeSet>>& changes,
+    const DirtyFieldList& dirtyFields) {
+  // The group commit attempt cleared the changed fields it wrote.
+  for (auto& pair : dirtyFields) {
+    pair.first->RestoreDirtyFields(pair.second);
+  }
+
+  if (1 < changes.size()) {
+    mGroupCommitFallbacks++;
+
+    LogDatabaseWarning([&]() {
+      return String("Group commit of %1 change sets failed; writing them "
+                    "one at a time.\n")
+          .Arg(changes.size());
+    });
+  }
+
+  return Database::ProcessStandardChangeSets(changes);
+}
+
+size_t Database::TakeDeferredUpdates(
+    std::unordered_map<libobjgen::UUID, std::shared_ptr<DBStandardChangeSet>>&
+        queue) {
+  auto& changes = queue[NULLUUID];
+
+  if (!changes) {
+    changes = std::make_shared<DBStandardChangeSet>(NULLUUID);
+  }
+
+  for (auto obj : mDeferredUpdates) {
+    changes->Update(obj);
+  }
+
+  size_t count = mDeferredUpdates.size();
+
+  mDeferredUpdates.clear();
+  mDeferredUIDs.clear();
+  mDeferredFlushDue = false;
+  mLastDeferredFlush = std::chrono::steady_clock::now();
+
+  return count;
+}
+
 bool Database::ProcessChangeSet(
     const std::shared_ptr<DatabaseChangeSet>& changes) {
   auto opChanges = std::dynamic_pointer_cast<DBOperationalChangeSet>(changes);
@@ -205,6 +1799,57 @@ bool Database::UsingDefaultDatabaseType() {
   return mConfig->GetDatabaseType() == mConfig->GetDefaultDatabaseType();
 }
 
+bool Database::ExecuteLoadQuery(
+    const std::shared_ptr<libobjgen::MetaObject>& metaObject,
+    DatabaseBind* pValue, DatabaseQuery& query) {
+  String sql =
+      String("SELECT * FROM %1%2")
+          .Arg(QuoteIdentifier(metaObject->GetName()))
+          .Arg((nullptr != pValue
+                    ? String(" WHERE %1 = :%2")
+                          .Arg(QuoteIdentifier(pValue->GetColumn()))
+                          .Arg(pValue->GetColumn())
+                    : ""));
+
+  // Loading by anything other than the UID may return many rows.
+  query = (nullptr != pValue && "UID" == pValue->GetColumn())
+              ? PrepareRead(sql)
+              : PrepareLargeRead(sql);
+
+  if (!query.IsValid()) {
+    LogDatabaseError(
+        [&]() { return String("Failed to prepare SQL query: %1\n").Arg(sql); });
+
+    LogDatabaseError(
+        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+    return false;
+  }
+
+  if (nullptr != pValue && !pValue->Bind(query)) {
+    LogDatabaseError([&]() {
+      return String("Failed to bind value: %1\n").Arg(pValue->GetColumn());
+    });
+
+    LogDatabaseError(
+        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+    return false;
+  }
+
+  if (!query.Execute()) {
+    LogDatabaseError(
+        [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
+
+    LogDatabaseError(
+        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+
+    return false;
+  }
+
+  return true;
+}
+
 std::shared_ptr<PersistentObject> Database::LoadSingleObjectFromRow(
     size_t typeHash, DatabaseQuery& query) {
   bool isNew = false;
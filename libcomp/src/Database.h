@@ -34,8 +34,19 @@
 #include "DatabaseChangeSet.h"
 #include "DatabaseConfig.h"
 #include "DatabaseQuery.h"
+#include "DatabaseStatementCache.h"
 #include "PersistentObject.h"
 
+// Standard C++11 Includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
 namespace libcomp {
 
 class BaseScriptEngine;
@@ -43,6 +54,130 @@ class BaseServer;
 class DatabaseBind;
 class DataStore;
 
+/**
+ * Number of rows written by the multi-row statements used to process
+ * standard change sets and the explicit updates of operational change sets.
+ */
+struct DatabaseBatchStats {
+  DatabaseBatchStats()
+      : insertStatements(0),
+        insertRows(0),
+        updateStatements(0),
+        updateRows(0),
+        explicitStatements(0),
+        explicitRows(0),
+        explicitFallbacks(0) {}
+
+  /**
+   * Get the average number of rows written by each insert statement.
+   * @return Average rows per insert statement
+   */
+  double InsertRowsPerStatement() const {
+    return insertStatements ? ((double)insertRows / (double)insertStatements)
+                            : 0.0;
+  }
+
+  /**
+   * Get the average number of rows written by each update statement.
+   * @return Average rows per update statement
+   */
+  double UpdateRowsPerStatement() const {
+    return updateStatements ? ((double)updateRows / (double)updateStatements)
+                            : 0.0;
+  }
+
+  /**
+   * Get the average number of explicit updates run by each statement.
+   * @return Average explicit updates per statement
+   */
+  double ExplicitRowsPerStatement() const {
+    return explicitStatements
+               ? ((double)explicitRows / (double)explicitStatements)
+               : 0.0;
+  }
+
+  /// Number of insert statements executed
+  uint64_t insertStatements;
+
+  /// Number of rows inserted
+  uint64_t insertRows;
+
+  /// Number of update statements executed
+  uint64_t updateStatements;
+
+  /// Number of rows updated
+  uint64_t updateRows;
+
+  /// Number of explicit update statements executed
+  uint64_t explicitStatements;
+
+  /// Number of explicit updates run
+  uint64_t explicitRows;
+
+  /// Number of explicit update batches run one record at a time to find
+  /// the records that failed or because no savepoint could be created
+  uint64_t explicitFallbacks;
+};
+
+/**
+ * Statistics of the updates deferred by @ref Database::DeferUpdate.
+ */
+struct DatabaseWriteBehindStats {
+  DatabaseWriteBehindStats()
+      : deferred(0), absorbed(0), written(0), flushes(0), failures(0),
+        failed(0), pending(0) {}
+
+  /// Number of updates deferred
+  uint64_t deferred;
+
+  /// Number of deferred updates merged into an update already pending
+  uint64_t absorbed;
+
+  /// Number of objects written by flushes that succeeded
+  uint64_t written;
+
+  /// Number of flushes
+  uint64_t flushes;
+
+  /// Number of flushes that failed
+  uint64_t failures;
+
+  /// Number of objects in flushes that failed
+  uint64_t failed;
+
+  /// Number of objects waiting for the next flush
+  uint64_t pending;
+};
+
+/**
+ * Statistics of the change sets written together by group commit.
+ */
+struct DatabaseGroupCommitStats {
+  DatabaseGroupCommitStats()
+      : transactions(0), changeSets(0), rolledBack(0), fallbacks(0) {}
+
+  /**
+   * Get the average number of change sets written by each transaction.
+   * @return Average change sets per transaction
+   */
+  double ChangeSetsPerTransaction() const {
+    return transactions ? ((double)changeSets / (double)transactions) : 0.0;
+  }
+
+  /// Number of transactions that wrote more than one change set
+  uint64_t transactions;
+
+  /// Number of change sets written by the transactions
+  uint64_t changeSets;
+
+  /// Number of change sets rolled back to their savepoint
+  uint64_t rolledBack;
+
+  /// Number of transactions that failed and were retried one change set
+  /// at a time
+  uint64_t fallbacks;
+};
+
 /**
  * Abstract base class that represents a database to use for loading
  * and modifying @ref PersistentObject instances as well as utility
@@ -89,6 +224,24 @@ class Database : public std::enable_shared_from_this<Database> {
    */
   virtual DatabaseQuery Prepare(const String& query) = 0;
 
+  /**
+   * Prepare a query that only reads from the database. Databases with
+   * separate read connections run these queries on one of them.
+   * @param query Query text to prepare
+   * @return Prepared query
+   */
+  virtual DatabaseQuery PrepareRead(const String& query);
+
+  /**
+   * Prepare a query that only reads from the database and may return many
+   * rows, such as loading every object of a type. Databases that can read
+   * a result a number of rows at a time instead of all at once do so for
+   * these queries.
+   * @param query Query text to prepare
+   * @return Prepared query
+   */
+  virtual DatabaseQuery PrepareLargeRead(const String& query);
+
   /**
    * Prepare and execute a database query for execution based upon
    * query text.  Queries that return results should not use this
@@ -144,6 +297,43 @@ class Database : public std::enable_shared_from_this<Database> {
   virtual std::list<std::shared_ptr<PersistentObject>> LoadObjects(
       size_t typeHash, DatabaseBind* pValue) = 0;
 
+  /**
+   * Load @ref PersistentObject instances from a single bound database
+   * column and value one row at a time. Each object is passed to the
+   * callback as soon as its row is read so objects the callback does not
+   * keep are freed before the next row is loaded.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param pValue Database agnostic column binding or null to load every
+   *  object of the type
+   * @param callback Function to pass each object to that returns false to
+   *  stop loading
+   * @return false if the query failed, true otherwise
+   */
+  virtual bool ForEachObject(
+      size_t typeHash, DatabaseBind* pValue,
+      const std::function<bool(const std::shared_ptr<PersistentObject>&)>&
+          callback);
+
+  /**
+   * Load multiple @ref PersistentObject instances from a single bound
+   * database column and value while other threads build the objects.
+   * The calling thread reads the rows and copies them for a set of load
+   * threads to deserialize so types with large blob columns load faster.
+   * The load threads are kept between calls. Small results are loaded on
+   * the calling thread alone.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param pValue Database agnostic column binding or null to load every
+   *  object of the type
+   * @param preserveOrder Return the objects in the order the rows were
+   *  read instead of the order they finished loading
+   * @param threadCount Number of load threads (0 to use the count in the
+   *  database config)
+   * @return List of pointers to loaded objects from the query results
+   */
+  std::list<std::shared_ptr<PersistentObject>> LoadObjectsParallel(
+      size_t typeHash, DatabaseBind* pValue, bool preserveOrder = true,
+      size_t threadCount = 0);
+
   /**
    * Load one @ref PersistentObject instance from a single bound
    * database column and value to select upon.  This simply filters
@@ -156,6 +346,29 @@ class Database : public std::enable_shared_from_this<Database> {
   virtual std::shared_ptr<PersistentObject> LoadSingleObject(
       size_t typeHash, DatabaseBind* pValue);
 
+  /**
+   * Load multiple @ref PersistentObject instances of one type by UUID.
+   * Objects already in the @ref PersistentObject cache are not queried
+   * again and the rest are selected with as few IN (...) queries as the
+   * parameter limit of the database allows.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param uuids UUIDs of the objects to load
+   * @param reload Forces every object to be reloaded from the database
+   * @param pQueryCount Optional count to add the number of queries
+   *  executed to
+   * @return List of pointers to the objects that exist in the order they
+   *  were requested
+   */
+  virtual std::list<std::shared_ptr<PersistentObject>> LoadObjectsByUUIDs(
+      size_t typeHash, const std::list<libobjgen::UUID>& uuids,
+      bool reload = false, size_t* pQueryCount = nullptr);
+
+  /**
+   * Get the most objects @ref LoadObjectsByUUIDs selects with one query.
+   * @return Maximum number of objects loaded per query
+   */
+  size_t GetLoadBatchSize() const;
+
   /**
    * Insert one @ref PersistentObject instance into the database.
    * @param obj Pointer to the object to insert
@@ -219,7 +432,9 @@ class Database : public std::enable_shared_from_this<Database> {
 
   /**
    * Queue an object to update during the next call to
-   * ProcessTransactionQueue.
+   * ProcessTransactionQueue. If write-behind is enabled in the config
+   * updates that are not part of a group are deferred with
+   * @ref DeferUpdate instead.
    * @param obj Pointer to the object to update
    * @param uuid UUID used to group changes together
    */
@@ -245,10 +460,45 @@ class Database : public std::enable_shared_from_this<Database> {
 
   /**
    * Pop and process all transactions stored in the transaction queue.
+   * Deferred updates are written with the ungrouped changes once the
+   * write-behind interval has passed or enough objects are pending. If
+   * group commit is enabled in the config the queued change sets are
+   * written together by @ref ProcessStandardChangeSets instead of each
+   * in its own transaction.
    * @return List of all transaction group UUIDs that failed to process
    */
   std::list<libobjgen::UUID> ProcessTransactionQueue();
 
+  /**
+   * Defer an update to an object until the next write-behind flush.
+   * Deferring an object that is already pending writes nothing extra
+   * since the fields changed by both updates stay dirty on the object
+   * and are written together by the flush. Once enough objects are
+   * pending the next call to @ref ProcessTransactionQueue flushes them.
+   * @param obj Pointer to the object to update
+   */
+  void DeferUpdate(const std::shared_ptr<PersistentObject>& obj);
+
+  /**
+   * Write every deferred update by processing the transaction queue.
+   * This is done when the database is closed so nothing deferred is lost
+   * on shutdown.
+   * @return true if every queued change set was written, false otherwise
+   */
+  bool FlushDeferredUpdates();
+
+  /**
+   * Get the statistics of the deferred updates.
+   * @return Write-behind statistics
+   */
+  DatabaseWriteBehindStats GetWriteBehindStats();
+
+  /**
+   * Get the statistics of the change sets written by group commit.
+   * @return Group commit statistics
+   */
+  DatabaseGroupCommitStats GetGroupCommitStats() const;
+
   /**
    * Process one or many database changes as a single transaction.
    * @param changes Grouping of changes to apply to the database
@@ -271,6 +521,29 @@ class Database : public std::enable_shared_from_this<Database> {
    */
   virtual String GetLastError();
 
+  /**
+   * Hold a connection for the calling thread so every query it makes
+   * uses the same connection until the returned pointer is released.
+   * @return Handle to release the connection with or null if the database
+   *  only has one connection
+   */
+  virtual std::shared_ptr<void> HoldConnection();
+
+  /**
+   * Get the statistics of the prepared statement cache of every
+   * connection to the database.
+   * @return Combined statement cache statistics
+   */
+  virtual DatabaseStatementCacheStats GetStatementCacheStats();
+
+  /**
+   * Get the number of rows written by each batched insert and update
+   * statement used to process standard change sets and by each explicit
+   * update statement used to process operational change sets.
+   * @return Batched statement statistics
+   */
+  DatabaseBatchStats GetBatchStats() const;
+
   /**
    * Get the database config.
    * @return Pointer to the database config
@@ -278,6 +551,11 @@ class Database : public std::enable_shared_from_this<Database> {
   std::shared_ptr<objects::DatabaseConfig> GetConfig() const;
 
  protected:
+  /// List of updated objects paired with the fields they had changed
+  typedef std::list<
+      std::pair<std::shared_ptr<PersistentObject>, std::set<std::string>>>
+      DirtyFieldList;
+
   /**
    * Get a pointer to a new @ref PersistentObject of the specified
    * type populated with the current row being read from a database
@@ -289,6 +567,86 @@ class Database : public std::enable_shared_from_this<Database> {
   std::shared_ptr<PersistentObject> LoadSingleObjectFromRow(
       size_t typeHash, DatabaseQuery& query);
 
+  /**
+   * Prepare, bind and execute the query that loads objects from a single
+   * bound database column and value.
+   * @param metaObject Definition of the object type to load
+   * @param pValue Database agnostic column binding or null to load every
+   *  object of the type
+   * @param query Output parameter to return the executed query in
+   * @return true on success, false on failure
+   */
+  bool ExecuteLoadQuery(const std::shared_ptr<libobjgen::MetaObject>& metaObject,
+                        DatabaseBind* pValue, DatabaseQuery& query);
+
+  /**
+   * Insert multiple @ref PersistentObject instances. Objects of the same
+   * type are written together with multi-row INSERT statements in chunks
+   * that fit the parameter limit of the database.
+   * @param objs List of pointers to the objects to insert
+   * @return true on success, false on failure
+   */
+  bool InsertObjects(const std::list<std::shared_ptr<PersistentObject>>& objs);
+
+  /**
+   * Update the changed fields of multiple @ref PersistentObject instances.
+   * Objects of the same type with the same changed fields are written
+   * together with multi-row UPDATE statements that select the new value of
+   * each column by UID.
+   * @param objs List of pointers to the objects to update
+   * @return true on success, false on failure
+   */
+  bool UpdateObjects(const std::list<std::shared_ptr<PersistentObject>>& objs);
+
+  /**
+   * Build the statements that write a standard change set with every value
+   * written into the statement text instead of bound, so they can be sent
+   * to the database together. The changed fields of the objects are marked
+   * as saved. Deleted objects are not unregistered.
+   * @param changes Change set to write
+   * @param statements Output list of the statements in the order they must
+   *  be executed
+   * @return false if an object could not be saved or a value could not be
+   *  written as a literal
+   */
+  bool FormatChangeSet(const std::shared_ptr<DBStandardChangeSet>& changes,
+                       std::list<String>& statements);
+
+  /**
+   * Write a bound value as a literal for use in a query.
+   * @param pValue Value to write
+   * @return Literal of the value or an empty string if the value can not
+   *  be written as a literal
+   */
+  virtual String FormatLiteral(const DatabaseBind* pValue) const;
+
+  /**
+   * Write a UUID as a literal matching the configured UUID storage.
+   * @param uuid UUID to write
+   * @return Literal of the UUID
+   */
+  String FormatUUIDLiteral(const libobjgen::UUID& uuid) const;
+
+  /**
+   * Quote a table or column name for use in a query.
+   * @param name Name to quote
+   * @return Quoted name
+   */
+  virtual String QuoteIdentifier(const String& name) const;
+
+  /**
+   * Get the maximum number of parameters that may be bound to a single
+   * query.
+   * @return Maximum number of parameters per query
+   */
+  virtual size_t GetMaxBindCount() const;
+
+  /**
+   * Get the index of the first parameter when binding by index.
+   * @return Index of the first parameter
+   */
+  virtual size_t GetFirstBindIndex() const;
+
   /**
    * Process one or many standard database changes as a single transaction.
    * @param changes Grouping of changes to apply to the database
@@ -297,6 +655,70 @@ class Database : public std::enable_shared_from_this<Database> {
   virtual bool ProcessStandardChangeSet(
       const std::shared_ptr<DBStandardChangeSet>& changes) = 0;
 
+  /**
+   * Process many independent standard change sets in one transaction.
+   * Each change set is written inside its own savepoint so one that fails
+   * is rolled back without affecting the others. The default
+   * implementation processes each change set in its own transaction.
+   * @param changes Change sets to apply to the database
+   * @return List of the transaction UUIDs of the change sets that failed
+   */
+  virtual std::list<libobjgen::UUID> ProcessStandardChangeSets(
+      const std::list<std::shared_ptr<DBStandardChangeSet>>& changes);
+
+  /**
+   * Write the inserts, updates and deletes of a standard change set
+   * without starting a transaction.
+   * @param changes Grouping of changes to write
+   * @return true on success, false on failure
+   */
+  bool WriteChangeSet(const std::shared_ptr<DBStandardChangeSet>& changes);
+
+  /**
+   * Execute a statement that controls the open transaction such as
+   * creating, releasing or rolling back to a savepoint. The default
+   * implementation prepares the statement like @ref Execute.
+   * @param statement Statement to execute
+   * @return true on success, false on error
+   */
+  virtual bool ExecuteTransactionControl(const String& statement);
+
+  /**
+   * Write change sets inside a transaction that is already open, each
+   * within its own savepoint. A change set that fails is rolled back to
+   * its savepoint and added to the failures.
+   * @param changes Change sets to write
+   * @param failures Output list of the transaction UUIDs of the change
+   *  sets that failed
+   * @return false if a savepoint could not be created, released or rolled
+   *  back so the whole transaction must be rolled back, true otherwise
+   */
+  bool WriteChangeSetsWithSavepoints(
+      const std::list<std::shared_ptr<DBStandardChangeSet>>& changes,
+      std::list<libobjgen::UUID>& failures);
+
+  /**
+   * Get the changed fields of every object updated by the change sets so
+   * they can be restored if the group commit transaction is rolled back.
+   * @param changes Change sets about to be written
+   * @return List of each updated object paired with its changed fields
+   */
+  DirtyFieldList GetDirtyFields(
+      const std::list<std::shared_ptr<DBStandardChangeSet>>& changes) const;
+
+  /**
+   * Process change sets one at a time after a group commit transaction
+   * failed and was rolled back. The changed fields cleared by the group
+   * commit attempt are restored first so the updates are written again.
+   * @param changes Change sets to apply to the database
+   * @param dirtyFields Changed fields from @ref GetDirtyFields taken before
+   *  the group commit was attempted
+   * @return List of the transaction UUIDs of the change sets that failed
+   */
+  std::list<libobjgen::UUID> FallbackChangeSets(
+      const std::list<std::shared_ptr<DBStandardChangeSet>>& changes,
+      const DirtyFieldList& dirtyFields);
+
   /**
    * Process an operational change set as a single transaction.
    * @param changes Grouping of changes to apply to the database
@@ -305,6 +727,20 @@ class Database : public std::enable_shared_from_this<Database> {
   virtual bool ProcessOperationalChangeSet(
       const std::shared_ptr<DBOperationalChangeSet>& changes) = 0;
 
+  /**
+   * Run the explicit updates of an operational change set inside a
+   * transaction that is already open. Updates to the same columns of the
+   * same table are run together with multi-row UPDATE statements. If a
+   * batch does not update every record it is rolled back and run again one
+   * record at a time so each update that failed is marked with
+   * DBExplicitUpdate::SetFailed. A batch is also run one record at a time
+   * if the savepoint to roll it back to can not be created.
+   * @param updates Explicit updates to run in order
+   * @return true if every update was applied, false otherwise
+   */
+  bool ProcessExplicitUpdates(
+      const std::list<std::shared_ptr<DBExplicitUpdate>>& updates);
+
   /**
    * Get the list of objects mapped to the current database type
    * configured for the database.
@@ -321,11 +757,111 @@ class Database : public std::enable_shared_from_this<Database> {
 
  private:
   /// Map of transaction pointers by UUID
-  std::unordered_map<std::string, std::shared_ptr<DBStandardChangeSet>>
+  std::unordered_map<libobjgen::UUID, std::shared_ptr<DBStandardChangeSet>>
       mTransactionQueue;
 
+  /**
+   * Move the deferred updates into the ungrouped change set of a
+   * transaction queue (the transaction lock must be held).
+   * @param queue Transaction queue to add the updates to
+   * @return Number of deferred updates moved
+   */
+  size_t TakeDeferredUpdates(
+      std::unordered_map<libobjgen::UUID,
+                         std::shared_ptr<DBStandardChangeSet>>& queue);
+
+  /**
+   * Run explicit updates to the same columns of the same table as a single
+   * UPDATE statement.
+   * @param table Name of the table to update
+   * @param columns Names of the columns each update changes in name order
+   * @param updates Explicit updates to run
+   * @return Number of records updated or -1 if the statement failed
+   */
+  int64_t ExecuteExplicitUpdates(
+      const String& table, const std::list<String>& columns,
+      const std::vector<std::shared_ptr<DBExplicitUpdate>>& updates);
+
+  /**
+   * Run a job on the load threads used by @ref LoadObjectsParallel. The
+   * threads are started the first time they are needed and kept until
+   * the database is destroyed.
+   * @param threadCount Number of load threads that should be running
+   * @param job Function to run on a load thread
+   */
+  void QueueLoadJob(size_t threadCount, const std::function<void()>& job);
+
+  /**
+   * Stop the load threads once every queued job has run.
+   */
+  void StopLoadThreads();
+
   /// Mutex to lock accessing the transaction queue
   std::mutex mTransactionLock;
+
+  /// Objects with deferred updates in the order they were first deferred
+  std::list<std::shared_ptr<PersistentObject>> mDeferredUpdates;
+
+  /// UIDs of the objects in mDeferredUpdates
+  std::unordered_set<libobjgen::UUID> mDeferredUIDs;
+
+  /// Indicates enough updates are deferred to flush them with the next
+  /// transaction queue
+  bool mDeferredFlushDue;
+
+  /// Time the deferred updates were last flushed
+  std::chrono::steady_clock::time_point mLastDeferredFlush;
+
+  /// Statistics of the deferred updates
+  DatabaseWriteBehindStats mWriteBehindStats;
+
+  /// Number of batched insert statements executed
+  std::atomic<uint64_t> mBatchInsertStatements;
+
+  /// Number of rows written by batched insert statements
+  std::atomic<uint64_t> mBatchInsertRows;
+
+  /// Number of batched update statements executed
+  std::atomic<uint64_t> mBatchUpdateStatements;
+
+  /// Number of rows written by batched update statements
+  std::atomic<uint64_t> mBatchUpdateRows;
+
+  /// Number of explicit update statements executed
+  std::atomic<uint64_t> mBatchExplicitStatements;
+
+  /// Number of explicit updates run
+  std::atomic<uint64_t> mBatchExplicitRows;
+
+  /// Number of explicit update batches run one record at a time
+  std::atomic<uint64_t> mBatchExplicitFallbacks;
+
+  /// Number of group commit transactions
+  std::atomic<uint64_t> mGroupCommitTransactions;
+
+  /// Number of change sets written by group commit transactions
+  std::atomic<uint64_t> mGroupCommitChangeSets;
+
+  /// Number of change sets rolled back to their savepoint
+  std::atomic<uint64_t> mGroupCommitRolledBack;
+
+  /// Number of group commit transactions that were retried
+  std::atomic<uint64_t> mGroupCommitFallbacks;
+
+  /// Threads that build objects for @ref LoadObjectsParallel
+  std::list<std::thread> mLoadThreads;
+
+  /// Jobs waiting for a load thread
+  std::deque<std::function<void()>> mLoadJobs;
+
+  /// Indicates the load threads should keep running
+  bool mLoadThreadsRunning;
+
+  /// Signaled when a load job is queued or the load threads stop
+  std::condition_variable mLoadJobReady;
+
+  /// Lock for the load threads and jobs
+  std::mutex mLoadLock;
 };
 
 }  // namespace libcomp
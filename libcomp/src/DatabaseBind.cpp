@@ -60,6 +60,10 @@ DatabaseBindBlob::DatabaseBindBlob(const String& column,
                                    const std::vector<char>& value)
     : DatabaseBind(column), mValue(value) {}
 
+DatabaseBindBlob::DatabaseBindBlob(const String& column,
+                                   std::vector<char>&& value)
+    : DatabaseBind(column), mValue(std::move(value)) {}
+
 DatabaseBindBlob::~DatabaseBindBlob() {}
 
 bool DatabaseBindBlob::Bind(DatabaseQuery& db) {
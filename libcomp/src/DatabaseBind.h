@@ -135,6 +135,14 @@ class DatabaseBindBlob : public DatabaseBind {
    */
   DatabaseBindBlob(const String& column, const std::vector<char>& value);
 
+  /**
+   * Create a new database blob column binding that takes ownership of a
+   * value without copying it.
+   * @param column Database blob column to bind the actions to
+   * @param value Value to bind to the column
+   */
+  DatabaseBindBlob(const String& column, std::vector<char>&& value);
+
   /**
    * Clean up the binding.
    */
@@ -109,7 +109,8 @@ std::shared_ptr<PersistentObject> DBOperationalChange::GetRecord() {
 
 DBExplicitUpdate::DBExplicitUpdate(
     const std::shared_ptr<PersistentObject>& record)
-    : DBOperationalChange(record, DBOperationType::DBOP_EXPLICIT) {
+    : DBOperationalChange(record, DBOperationType::DBOP_EXPLICIT),
+      mFailed(false) {
   if (mRecord) {
     mMetadata = record->GetObjectMetadata();
     for (auto bind : record->GetMemberBindValues(true, false)) {
@@ -179,6 +180,10 @@ std::unordered_map<std::string, DatabaseBind*> DBExplicitUpdate::GetChanges()
   return mChanges;
 }
 
+bool DBExplicitUpdate::HasFailed() const { return mFailed; }
+
+void DBExplicitUpdate::SetFailed(bool failed) { mFailed = failed; }
+
 DBOperationalChangeSet::DBOperationalChangeSet() {}
 
 DBOperationalChangeSet::DBOperationalChangeSet(const libobjgen::UUID& uuid)
@@ -196,6 +201,21 @@ void DBOperationalChangeSet::AddOperation(
   mOperations.push_back(op);
 }
 
+std::list<std::shared_ptr<DBExplicitUpdate>>
+DBOperationalChangeSet::GetFailedUpdates() {
+  std::list<std::shared_ptr<DBExplicitUpdate>> failed;
+
+  for (auto op : mOperations) {
+    auto update = std::dynamic_pointer_cast<DBExplicitUpdate>(op);
+
+    if (update && update->HasFailed()) {
+      failed.push_back(update);
+    }
+  }
+
+  return failed;
+}
+
 void DBOperationalChangeSet::Insert(
     const std::shared_ptr<PersistentObject>& obj) {
   if (obj) {
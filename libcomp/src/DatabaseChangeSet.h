@@ -331,6 +331,19 @@ class DBExplicitUpdate : public DBOperationalChange {
    */
   std::unordered_map<std::string, DatabaseBind*> GetChanges() const;
 
+  /**
+   * Check if the update was not applied the last time its change set was
+   * processed because the record did not have the expected values.
+   * @return true if the update failed, false if it did not
+   */
+  bool HasFailed() const;
+
+  /**
+   * Set if the update failed when its change set was processed.
+   * @param failed true if the update failed, false if it did not
+   */
+  void SetFailed(bool failed);
+
  private:
   /**
    * Verify that the supplied column is not already bound and is a real
@@ -378,6 +391,9 @@ class DBExplicitUpdate : public DBOperationalChange {
 
   /// Pointer to the metadata of the affected record
   std::shared_ptr<libobjgen::MetaObject> mMetadata;
+
+  /// Indicates if the update failed when its change set was processed
+  bool mFailed;
 };
 
 /**
@@ -447,6 +463,13 @@ class DBOperationalChangeSet : public DatabaseChangeSet {
    */
   void AddOperation(const std::shared_ptr<DBOperationalChange>& op);
 
+  /**
+   * Get the explicit updates that failed because their record did not
+   * have the expected values the last time the change set was processed
+   * @return List of the failed explicit updates in the change set
+   */
+  std::list<std::shared_ptr<DBExplicitUpdate>> GetFailedUpdates();
+
   virtual void Insert(const std::shared_ptr<PersistentObject>& obj);
   virtual void Update(const std::shared_ptr<PersistentObject>& obj);
   virtual void Delete(const std::shared_ptr<PersistentObject>& obj);
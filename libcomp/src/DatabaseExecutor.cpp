@@ -0,0 +1,294 @@
+/**
+ * @file libcomp/src/DatabaseExecutor.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Runs database operations on dedicated threads.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseExecutor.h"
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "DatabaseBind.h"
+#include "DatabaseChangeSet.h"
+#include "Exception.h"
+
+// object Includes
+#include "DatabaseConfig.h"
+
+// Standard C++11 Includes
+#include <algorithm>
+#include <unordered_set>
+
+using namespace libcomp;
+
+/**
+ * Run a callback in a worker or right away if there is no worker.
+ * @param worker Worker to run the callback in
+ * @param f Callback to run
+ */
+static void Complete(const std::shared_ptr<Worker>& worker,
+                     const std::function<void()>& f) {
+  if (!worker || !worker->ExecuteInWorker(f)) {
+    f();
+  }
+}
+
+/**
+ * Get the number of microseconds between two points in time.
+ * @param start Start time
+ * @param end End time
+ * @return Microseconds from the start to the end time
+ */
+static uint64_t ElapsedMicroseconds(std::chrono::steady_clock::time_point start,
+                                    std::chrono::steady_clock::time_point end) {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             end - start)
+      .count();
+}
+
+DatabaseExecutor::DatabaseExecutor(const std::shared_ptr<Database>& db,
+                                   size_t threadCount)
+    : mDatabase(db), mThreadCount(threadCount), mRunning(false) {
+  if (0 == mThreadCount && nullptr != db && nullptr != db->GetConfig()) {
+    mThreadCount = (size_t)db->GetConfig()->GetAsyncThreadCount();
+  }
+
+  mThreadCount = std::max((size_t)1, mThreadCount);
+}
+
+DatabaseExecutor::~DatabaseExecutor() { Shutdown(); }
+
+void DatabaseExecutor::Start(const libcomp::String& name) {
+  std::lock_guard<std::mutex> lock(mLock);
+
+  if (mRunning || !mThreads.empty()) {
+    return;
+  }
+
+  mRunning = true;
+
+  for (size_t i = 0; i < mThreadCount; ++i) {
+    mThreads.push_back(std::thread(
+        [this](const libcomp::String& _name) {
+          (void)_name;
+
+#if !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
+          pthread_setname_np(pthread_self(), _name.C());
+#endif  // !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
+
+          libcomp::Exception::RegisterSignalHandler();
+
+          Run();
+        },
+        String("%1%2").Arg(name).Arg(i)));
+  }
+}
+
+void DatabaseExecutor::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    mRunning = false;
+  }
+
+  mOperationReady.notify_all();
+
+  for (auto& t : mThreads) {
+    t.join();
+  }
+
+  mThreads.clear();
+}
+
+bool DatabaseExecutor::LoadObjectsAsync(size_t typeHash, DatabaseBind* pValue,
+                                        const std::shared_ptr<Worker>& worker,
+                                        const LoadCallback_t& callback) {
+  auto db = mDatabase;
+  std::shared_ptr<DatabaseBind> value(pValue);
+
+  return Enqueue(
+      DatabaseOperation_t::LOAD, [db, typeHash, value, worker, callback]() {
+        std::list<std::shared_ptr<PersistentObject>> objs;
+
+        // Unlike LoadObjects this reports if the query itself failed.
+        bool result = db->ForEachObject(
+            typeHash, value.get(),
+            [&objs](const std::shared_ptr<PersistentObject>& obj) {
+              objs.push_back(obj);
+
+              return true;
+            });
+
+        Complete(worker, [callback, objs]() { callback(objs); });
+
+        return result;
+      });
+}
+
+bool DatabaseExecutor::LoadObjectsByUUIDsAsync(
+    size_t typeHash, const std::list<libobjgen::UUID>& uuids,
+    const std::shared_ptr<Worker>& worker, const LoadCallback_t& callback) {
+  auto db = mDatabase;
+
+  return Enqueue(DatabaseOperation_t::LOAD,
+                 [db, typeHash, uuids, worker, callback]() {
+                   auto objs = db->LoadObjectsByUUIDs(typeHash, uuids);
+
+                   // The load failed if any requested object is missing.
+                   std::unordered_set<libobjgen::UUID> requested;
+
+                   for (auto& uuid : uuids) {
+                     if (!uuid.IsNull()) {
+                       requested.insert(uuid);
+                     }
+                   }
+
+                   Complete(worker, [callback, objs]() { callback(objs); });
+
+                   return requested.size() == objs.size();
+                 });
+}
+
+bool DatabaseExecutor::QueueChangeSetAsync(
+    const std::shared_ptr<DatabaseChangeSet>& changes,
+    const std::shared_ptr<Worker>& worker, const ResultCallback_t& callback) {
+  return RunAsync(
+      [changes](const std::shared_ptr<Database>& db) {
+        return db->ProcessChangeSet(changes);
+      },
+      worker, callback, DatabaseOperation_t::CHANGE_SET);
+}
+
+bool DatabaseExecutor::ExecuteAsync(const String& sql,
+                                    const std::shared_ptr<Worker>& worker,
+                                    const ResultCallback_t& callback) {
+  return RunAsync(
+      [sql](const std::shared_ptr<Database>& db) { return db->Execute(sql); },
+      worker, callback);
+}
+
+bool DatabaseExecutor::RunAsync(const Job_t& job,
+                                const std::shared_ptr<Worker>& worker,
+                                const ResultCallback_t& callback) {
+  return RunAsync(job, worker, callback, DatabaseOperation_t::EXECUTE);
+}
+
+bool DatabaseExecutor::RunAsync(const Job_t& job,
+                                const std::shared_ptr<Worker>& worker,
+                                const ResultCallback_t& callback,
+                                DatabaseOperation_t type) {
+  auto db = mDatabase;
+
+  return Enqueue(type, [db, job, worker, callback]() {
+    bool result = job(db);
+
+    if (callback) {
+      Complete(worker, [callback, result]() { callback(result); });
+    }
+
+    return result;
+  });
+}
+
+DatabaseExecutorStats DatabaseExecutor::GetStats() {
+  std::lock_guard<std::mutex> lock(mLock);
+
+  DatabaseExecutorStats stats = mStats;
+  stats.queueDepth = (uint64_t)mOperations.size();
+
+  return stats;
+}
+
+bool DatabaseExecutor::Enqueue(DatabaseOperation_t type,
+                               const std::function<bool()>& run) {
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (!mRunning || nullptr == mDatabase) {
+      return false;
+    }
+
+    Operation op;
+    op.type = type;
+    op.run = run;
+    op.queued = std::chrono::steady_clock::now();
+
+    mOperations.push_back(op);
+
+    mStats.maxQueueDepth =
+        std::max(mStats.maxQueueDepth, (uint64_t)mOperations.size());
+  }
+
+  mOperationReady.notify_one();
+
+  return true;
+}
+
+void DatabaseExecutor::Run() {
+  // Keep one connection for every operation this thread runs.
+  auto connection = mDatabase->HoldConnection();
+
+  while (true) {
+    Operation op;
+
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+
+      mOperationReady.wait(
+          lock, [this]() { return !mRunning || !mOperations.empty(); });
+
+      // Finish everything queued before stopping.
+      if (mOperations.empty()) {
+        break;
+      }
+
+      op = mOperations.front();
+      mOperations.pop_front();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    bool result = op.run();
+
+    auto end = std::chrono::steady_clock::now();
+
+    uint64_t queueTime = ElapsedMicroseconds(op.queued, start);
+    uint64_t runTime = ElapsedMicroseconds(start, end);
+
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto& stats = mStats.operations[static_cast<size_t>(op.type)];
+    stats.count++;
+    stats.totalQueueTime += queueTime;
+    stats.maxQueueTime = std::max(stats.maxQueueTime, queueTime);
+    stats.totalRunTime += runTime;
+    stats.maxRunTime = std::max(stats.maxRunTime, runTime);
+
+    if (!result) {
+      stats.failures++;
+    }
+  }
+}
+
+#endif  // !EXOTIC_PLATFORM
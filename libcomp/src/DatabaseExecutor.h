@@ -0,0 +1,314 @@
+/**
+ * @file libcomp/src/DatabaseExecutor.h
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Runs database operations on dedicated threads.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCOMP_SRC_DATABASEEXECUTOR_H
+#define LIBCOMP_SRC_DATABASEEXECUTOR_H
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "Database.h"
+#include "Worker.h"
+
+// Standard C++11 Includes
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+
+namespace libcomp {
+
+/**
+ * Type of operation run by a @ref DatabaseExecutor.
+ */
+enum class DatabaseOperation_t : uint8_t {
+  LOAD = 0,    //!< Object loads.
+  CHANGE_SET,  //!< Change sets processed as a transaction.
+  EXECUTE,     //!< Raw SQL and custom jobs.
+  COUNT,
+};
+
+/**
+ * Statistics for one type of operation run by a @ref DatabaseExecutor.
+ */
+struct DatabaseOperationStats {
+  DatabaseOperationStats()
+      : count(0),
+        failures(0),
+        totalQueueTime(0),
+        maxQueueTime(0),
+        totalRunTime(0),
+        maxRunTime(0) {}
+
+  /// Number of operations run
+  uint64_t count;
+
+  /// Number of operations that failed
+  uint64_t failures;
+
+  /// Sum of the time operations waited in the queue (microseconds)
+  uint64_t totalQueueTime;
+
+  /// Longest time an operation waited in the queue (microseconds)
+  uint64_t maxQueueTime;
+
+  /// Sum of the time operations took to run (microseconds)
+  uint64_t totalRunTime;
+
+  /// Longest time an operation took to run (microseconds)
+  uint64_t maxRunTime;
+};
+
+/**
+ * Statistics of a @ref DatabaseExecutor.
+ */
+struct DatabaseExecutorStats {
+  DatabaseExecutorStats() : queueDepth(0), maxQueueDepth(0) {}
+
+  /// Number of operations waiting to run
+  uint64_t queueDepth;
+
+  /// Most operations that have been waiting to run at once
+  uint64_t maxQueueDepth;
+
+  /// Statistics by operation type
+  DatabaseOperationStats operations[static_cast<size_t>(
+      DatabaseOperation_t::COUNT)];
+};
+
+/**
+ * Runs database operations on a set of dedicated threads so the calling
+ * @ref Worker is not blocked while the database works. Each thread holds
+ * its own database connection and takes operations from a shared queue.
+ * Once an operation is done its callback is run in the @ref Worker that
+ * was passed in (or on the database thread if no worker was given).
+ */
+class DatabaseExecutor {
+ public:
+  /**
+   * Callback run with the objects loaded by an operation.
+   */
+  typedef std::function<void(const std::list<std::shared_ptr<PersistentObject>>&)>
+      LoadCallback_t;
+
+  /**
+   * Callback run with the result of an operation.
+   */
+  typedef std::function<void(bool)> ResultCallback_t;
+
+  /**
+   * Job that runs on a database thread.
+   */
+  typedef std::function<bool(const std::shared_ptr<Database>&)> Job_t;
+
+  /**
+   * Create the executor. Call @ref Start to start the threads.
+   * @param db Database to run the operations on
+   * @param threadCount Number of database threads to run (0 to use the
+   *  count in the database config)
+   */
+  DatabaseExecutor(const std::shared_ptr<Database>& db,
+                   size_t threadCount = 0);
+
+  /**
+   * Finish every queued operation and stop the threads.
+   */
+  ~DatabaseExecutor();
+
+  /**
+   * Start the database threads.
+   * @param name Name to give the threads
+   */
+  void Start(const libcomp::String& name = "database");
+
+  /**
+   * Stop accepting operations, finish the ones already queued and wait
+   * for the database threads to stop.
+   */
+  void Shutdown();
+
+  /**
+   * Load every object of a type matching a single bound column. The
+   * operation counts as failed if the query fails.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param pValue Column binding to select on (the executor takes
+   *  ownership) or null to load every object
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the loaded objects
+   * @return true if the operation was queued
+   */
+  bool LoadObjectsAsync(size_t typeHash, DatabaseBind* pValue,
+                        const std::shared_ptr<Worker>& worker,
+                        const LoadCallback_t& callback);
+
+  /**
+   * Load every object of a type matching a single bound column.
+   * @param pValue Column binding to select on (the executor takes
+   *  ownership) or null to load every object
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the loaded objects
+   * @return true if the operation was queued
+   */
+  template <class T>
+  bool LoadObjectsAsync(
+      DatabaseBind* pValue, const std::shared_ptr<Worker>& worker,
+      const std::function<void(const std::list<std::shared_ptr<T>>&)>&
+          callback) {
+    return LoadObjectsAsync(
+        typeid(T).hash_code(), pValue, worker,
+        [callback](const std::list<std::shared_ptr<PersistentObject>>& objs) {
+          std::list<std::shared_ptr<T>> retval;
+          for (auto obj : objs) {
+            retval.push_back(std::dynamic_pointer_cast<T>(obj));
+          }
+
+          callback(retval);
+        });
+  }
+
+  /**
+   * Load multiple objects of a type by UUID. The operation counts as
+   * failed if any of the objects could not be loaded.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param uuids UUIDs of the objects to load
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the loaded objects
+   * @return true if the operation was queued
+   * @sa Database::LoadObjectsByUUIDs
+   */
+  bool LoadObjectsByUUIDsAsync(size_t typeHash,
+                               const std::list<libobjgen::UUID>& uuids,
+                               const std::shared_ptr<Worker>& worker,
+                               const LoadCallback_t& callback);
+
+  /**
+   * Process a set of changes as a single transaction.
+   * @param changes Changes to apply to the database
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the result (may be empty)
+   * @return true if the operation was queued
+   */
+  bool QueueChangeSetAsync(const std::shared_ptr<DatabaseChangeSet>& changes,
+                           const std::shared_ptr<Worker>& worker,
+                           const ResultCallback_t& callback = {});
+
+  /**
+   * Execute a raw SQL statement.
+   * @param sql SQL statement to execute
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the result (may be empty)
+   * @return true if the operation was queued
+   */
+  bool ExecuteAsync(const String& sql, const std::shared_ptr<Worker>& worker,
+                    const ResultCallback_t& callback = {});
+
+  /**
+   * Run a custom job with the database.
+   * @param job Function to run on a database thread
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the result of the job (may be
+   *  empty)
+   * @return true if the operation was queued
+   */
+  bool RunAsync(const Job_t& job, const std::shared_ptr<Worker>& worker,
+                const ResultCallback_t& callback = {});
+
+  /**
+   * Get the statistics of the executor.
+   * @return Executor statistics
+   */
+  DatabaseExecutorStats GetStats();
+
+ private:
+  /**
+   * Queued operation.
+   */
+  struct Operation {
+    /// Type of operation for the statistics
+    DatabaseOperation_t type;
+
+    /// Function that runs the operation and queues its callback
+    std::function<bool()> run;
+
+    /// Time the operation was queued
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  /**
+   * Add an operation to the queue.
+   * @param type Type of operation
+   * @param run Function that runs the operation and queues its callback
+   * @return true if the operation was queued
+   */
+  bool Enqueue(DatabaseOperation_t type, const std::function<bool()>& run);
+
+  /**
+   * Queue a custom job with the database.
+   * @param job Function to run on a database thread
+   * @param worker Worker to run the callback in
+   * @param callback Function to run with the result of the job
+   * @param type Type of operation the job is counted as
+   * @return true if the operation was queued
+   */
+  bool RunAsync(const Job_t& job, const std::shared_ptr<Worker>& worker,
+                const ResultCallback_t& callback, DatabaseOperation_t type);
+
+  /**
+   * Run operations until the executor is shut down.
+   */
+  void Run();
+
+  /// Database the operations run on
+  std::shared_ptr<Database> mDatabase;
+
+  /// Number of database threads to run
+  size_t mThreadCount;
+
+  /// Database threads
+  std::list<std::thread> mThreads;
+
+  /// Operations waiting to run
+  std::deque<Operation> mOperations;
+
+  /// Indicates operations may be queued
+  bool mRunning;
+
+  /// Signaled when an operation is queued or the executor shuts down
+  std::condition_variable mOperationReady;
+
+  /// Statistics of the executor
+  DatabaseExecutorStats mStats;
+
+  /// Lock for the queue and statistics
+  std::mutex mLock;
+};
+
+}  // namespace libcomp
+
+#endif  // !EXOTIC_PLATFORM
+
+#endif  // LIBCOMP_SRC_DATABASEEXECUTOR_H
@@ -39,10 +39,18 @@
 #define bool bool
 
 // MariaDB Includes
+#include <errmsg.h>
 #include <mysql.h>
 
+// Standard C++11 Includes
+#include <algorithm>
+
 using namespace libcomp;
 
+/// Most bytes of statements sent to the server in one pipelined batch. This
+/// stays well below the default max_allowed_packet of the server.
+static const size_t MAX_PIPELINE_BATCH_BYTES = 1024 * 1024;
+
 static libcomp::String ConnectionString(MYSQL* pConnection) {
   return libcomp::String("{%1-%2}")
       .Arg((uint32_t)(((uint64_t)pConnection) >> 32), 8, 16, '0')
@@ -51,28 +59,66 @@ static libcomp::String ConnectionString(MYSQL* pConnection) {
 
 DatabaseMariaDB::DatabaseMariaDB(
     const std::shared_ptr<objects::DatabaseConfigMariaDB>& config)
-    : Database(std::dynamic_pointer_cast<objects::DatabaseConfig>(config)) {}
+    : Database(std::dynamic_pointer_cast<objects::DatabaseConfig>(config)),
+      mOpenConnections(0),
+      mGeneration(0),
+      mUseDatabase(false),
+      mOpen(false),
+      mPipelineChangeSets(0),
+      mPipelineStatements(0),
+      mPipelineRoundTrips(0),
+      mPipelineFailures(0) {}
 
 DatabaseMariaDB::~DatabaseMariaDB() { Close(); }
 
 bool DatabaseMariaDB::Open() {
-  return ConnectToDatabase(GetConnection(false), "");
+  {
+    std::lock_guard<std::mutex> lock(mConnectionLock);
+
+    // Connect without selecting a database until Use is called.
+    CloseIdleConnections();
+    mGeneration++;
+    mUseDatabase = false;
+    mOpen = true;
+  }
+
+  if (nullptr == AcquireConnection()) {
+    mOpen = false;
+
+    return false;
+  }
+
+  return true;
 }
 
 bool DatabaseMariaDB::Close() {
-  bool result = true;
+  // Write anything still deferred before the connections go away.
+  bool result = !mOpen || FlushDeferredUpdates();
 
   std::lock_guard<std::mutex> lock(mConnectionLock);
-  for (auto kv : mConnections) {
-    result &= Close(kv.second);
-  }
-  mConnections.clear();
 
-  return result;
+  mOpen = false;
+
+  // Wake anything waiting on the pool so it can give up.
+  mConnectionReady.notify_all();
+
+  return CloseIdleConnections() && result;
 }
 
 bool DatabaseMariaDB::Close(MYSQL*& connection) {
-  if (nullptr != connection && nullptr != connection) {
+  if (nullptr != connection) {
+    {
+      // Cached statements must be freed before the connection closes.
+      std::lock_guard<std::mutex> lock(mStatementCacheLock);
+
+      auto it = mStatementCaches.find(connection);
+
+      if (mStatementCaches.end() != it) {
+        it->second->Clear();
+        mStatementCaches.erase(it);
+      }
+    }
+
     mysql_close(connection);
 
     LogDatabaseDebug([&]() {
@@ -91,14 +137,71 @@ bool DatabaseMariaDB::Close(MYSQL*& connection) {
   return true;
 }
 
-bool DatabaseMariaDB::IsOpen() const {
-  // Connections are only added when they are valid
-  return mConnections.size() > 0;
-}
+bool DatabaseMariaDB::IsOpen() const { return mOpen; }
 
 DatabaseQuery DatabaseMariaDB::Prepare(const String& query) {
-  auto connection = GetConnection(true);
-  return DatabaseQuery(new DatabaseQueryMariaDB(connection), query);
+  auto connection = AcquireConnection();
+  return DatabaseQuery(
+      new DatabaseQueryMariaDB(connection, GetStatementCache(connection.get()),
+                               mConfig->GetBinaryUUIDs()),
+      query);
+}
+
+DatabaseQuery DatabaseMariaDB::PrepareLargeRead(const String& query) {
+  auto config =
+      std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig);
+  auto connection = AcquireConnection();
+  return DatabaseQuery(
+      new DatabaseQueryMariaDB(connection, GetStatementCache(connection.get()),
+                               mConfig->GetBinaryUUIDs(),
+                               config->GetPrefetchRows()),
+      query);
+}
+
+DatabaseStatementCache<DatabaseStatementMariaDB>*
+DatabaseMariaDB::GetStatementCache(MYSQL* pConnection) {
+  if (nullptr == pConnection) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mStatementCacheLock);
+
+  auto& cache = mStatementCaches[pConnection];
+
+  if (!cache) {
+    cache = std::make_shared<DatabaseStatementCache<DatabaseStatementMariaDB>>(
+        (size_t)mConfig->GetStatementCacheSize(),
+        [](DatabaseStatementMariaDB& statement) {
+          mysql_stmt_close(statement.statement);
+        });
+  }
+
+  return cache.get();
+}
+
+String DatabaseMariaDB::QuoteIdentifier(const String& name) const {
+  return String("`%1`").Arg(name);
+}
+
+size_t DatabaseMariaDB::GetMaxBindCount() const {
+  // The client protocol stores the parameter count in 16 bits.
+  return 65535;
+}
+
+std::shared_ptr<void> DatabaseMariaDB::HoldConnection() {
+  return AcquireConnection();
+}
+
+DatabaseStatementCacheStats DatabaseMariaDB::GetStatementCacheStats() {
+  DatabaseStatementCacheStats stats;
+
+  std::lock_guard<std::mutex> lock(mStatementCacheLock);
+
+  for (auto& pair : mStatementCaches) {
+    stats.Add(pair.second->GetStats());
+  }
+
+  return stats;
 }
 
 bool DatabaseMariaDB::Exists() {
@@ -264,87 +367,32 @@ bool DatabaseMariaDB::Setup(bool rebuild,
 }
 
 bool DatabaseMariaDB::Use() {
-  // USE not supported so close the connection and re-open
-  auto config =
-      std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig);
-
-  return ConnectToDatabase(GetConnection(false), config->GetDatabaseName());
-}
-
-std::list<std::shared_ptr<PersistentObject>> DatabaseMariaDB::LoadObjects(
-    size_t typeHash, DatabaseBind* pValue) {
-  std::list<std::shared_ptr<PersistentObject>> objects;
+  // USE not supported so close the connections and re-open
+  {
+    std::lock_guard<std::mutex> lock(mConnectionLock);
 
-  auto metaObject = PersistentObject::GetRegisteredMetadata(typeHash);
-
-  if (nullptr == metaObject) {
-    LogDatabaseErrorMsg("Failed to lookup MetaObject.\n");
-
-    return {};
-  }
+    // A query or lease of this thread still points at its connection (and
+    // the statement cache of it) so the connection can not be replaced.
+    if (mConnections.end() != mConnections.find(std::this_thread::get_id())) {
+      LogDatabaseErrorMsg(
+          "Can not use the database while this thread holds a database "
+          "connection.\n");
 
-  String sql =
-      String("SELECT * FROM `%1`%2")
-          .Arg(metaObject->GetName())
-          .Arg((nullptr != pValue
-                    ? String(" WHERE `%1` = :%1").Arg(pValue->GetColumn())
-                    : ""));
-
-  DatabaseQuery query = Prepare(sql);
-
-  if (!query.IsValid()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to prepare SQL query: %1\n").Arg(sql); });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return {};
-  }
-
-  if (nullptr != pValue && !pValue->Bind(query)) {
-    LogDatabaseError([&]() {
-      return String("Failed to bind value: %1\n").Arg(pValue->GetColumn());
-    });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return {};
-  }
-
-  if (!query.Execute()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return {};
-  }
-
-  int failures = 0;
-
-  while (query.Next()) {
-    auto obj = LoadSingleObjectFromRow(typeHash, query);
-
-    if (nullptr != obj) {
-      objects.push_back(obj);
-    } else {
-      failures++;
+      return false;
     }
-  }
 
-  if (failures > 0) {
-    LogDatabaseError([&]() {
-      return String("%1 '%2' row%3 failed to load.\n")
-          .Arg(failures)
-          .Arg(metaObject->GetName())
-          .Arg(failures != 1 ? "s" : "");
-    });
+    // Connections checked out by other threads are closed once returned.
+    CloseIdleConnections();
+    mGeneration++;
+    mUseDatabase = true;
   }
 
-  return objects;
+  return nullptr != AcquireConnection();
+}
+
+std::list<std::shared_ptr<PersistentObject>> DatabaseMariaDB::LoadObjects(
+    size_t typeHash, DatabaseBind* pValue) {
+  return LoadObjectsParallel(typeHash, pValue);
 }
 
 bool DatabaseMariaDB::InsertSingleObject(
@@ -528,8 +576,12 @@ bool DatabaseMariaDB::DeleteObjects(
 
       obj->Unregister();
 
-      std::string uuidStr = obj->GetUUID().ToString();
-      uidBindings.push_back(String("'%1'").Arg(uuidStr));
+      String uuidStr = obj->GetUUID().ToString();
+      if (mConfig->GetBinaryUUIDs()) {
+        uidBindings.push_back(String("X'%1'").Arg(uuidStr.Replace("-", "")));
+      } else {
+        uidBindings.push_back(String("'%1'").Arg(uuidStr));
+      }
     }
 
     if (!Execute(String("DELETE FROM `%1` WHERE `UID` in (%2);")
@@ -639,7 +691,9 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
     bool creating = false;
     bool recreating = false;
     bool updating = false;
+    bool migrating = false;
     std::set<std::string> needsIndex;
+    std::set<std::string> uuidColumns;
     auto tableIter = fieldMap.find(objNameLower);
     if (tableIter == fieldMap.end()) {
       creating = true;
@@ -648,6 +702,12 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
 
       std::unordered_map<std::string, String> columns = tableIter->second;
 
+      // UUID columns stored as the other type are converted instead of
+      // recreating the table.
+      if (columns["uid"] != GetUUIDType().Split("(").front()) {
+        uuidColumns.insert("UID");
+      }
+
       auto indexes = indexedFields[objNameLower];
       columns.erase("uid");
       for (auto var : vars) {
@@ -662,7 +722,12 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
         if (columns.find(name) == columns.end()) {
           updating = true;
         } else if (columns[name] != type) {
-          recreating = true;
+          if (var->GetMetaType() ==
+              libobjgen::MetaVariable::MetaVariableType_t::TYPE_REF) {
+            uuidColumns.insert(var->GetName());
+          } else {
+            recreating = true;
+          }
         }
 
         auto indexName =
@@ -673,6 +738,23 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
       }
     }
 
+    if (!recreating && !uuidColumns.empty()) {
+      LogDatabaseInfo([&]() {
+        return String("Converting UUID columns of table '%1'...\n")
+            .Arg(metaObject.GetName());
+      });
+
+      if (MigrateUUIDColumns(objName, uuidColumns)) {
+        LogDatabaseInfoMsg("Conversion complete\n");
+      } else {
+        LogDatabaseErrorMsg("Conversion failed\n");
+
+        return false;
+      }
+
+      migrating = true;
+    }
+
     if (recreating) {
       if (mConfig->GetAutoSchemaUpdate()) {
         LogDatabaseInfo([&]() {
@@ -711,8 +793,8 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
       bool success = false;
 
       std::stringstream ss;
-      ss << "CREATE TABLE IF NOT EXISTS `" << objName
-         << "` (`UID` varchar(36) PRIMARY KEY";
+      ss << "CREATE TABLE IF NOT EXISTS `" << objName << "` (`UID` "
+         << GetUUIDType() << " PRIMARY KEY";
       for (size_t i = 0; i < vars.size(); i++) {
         auto var = vars[i];
         String type = GetVariableType(var);
@@ -842,7 +924,8 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
       }
     }
 
-    if (!creating && !recreating && !updating && needsIndex.size() == 0) {
+    if (!creating && !recreating && !updating && !migrating &&
+        needsIndex.size() == 0) {
       LogDatabaseInfo([&]() {
         return String("'%1': Verified\n").Arg(metaObject.GetName());
       });
@@ -856,11 +939,20 @@ bool DatabaseMariaDB::VerifyAndSetupSchema(bool recreateTables) {
 
 bool DatabaseMariaDB::ProcessStandardChangeSet(
     const std::shared_ptr<DBStandardChangeSet>& changes) {
-  auto connection = GetConnection(true);
-  if (connection == nullptr) {
+  if (std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig)
+          ->GetPipelineChangeSets()) {
+    return PipelineChangeSet(changes);
+  }
+
+  // Hold one connection for the whole transaction. Every query this
+  // thread prepares until it is released uses the same connection.
+  auto lease = AcquireConnection();
+  if (lease == nullptr) {
     return false;
   }
 
+  MYSQL* connection = lease.get();
+
   if (mysql_autocommit(connection, false)) {
     LogDatabaseDebug([&]() {
       return String("mysql_autocommit failed for connection: %1\n")
@@ -874,27 +966,7 @@ bool DatabaseMariaDB::ProcessStandardChangeSet(
     return false;
   }
 
-  bool result = true;
-  for (auto obj : changes->GetInserts()) {
-    if (!InsertSingleObject(obj)) {
-      result = false;
-      break;
-    }
-  }
-
-  if (result) {
-    for (auto obj : changes->GetUpdates()) {
-      if (!UpdateSingleObject(obj)) {
-        result = false;
-        break;
-      }
-    }
-  }
-
-  auto deletes = changes->GetDeletes();
-  if (result && deletes.size()) {
-    result = DeleteObjects(deletes);
-  }
+  bool result = WriteChangeSet(changes);
 
   if (result) {
     result = !mysql_commit(connection);
@@ -939,13 +1011,91 @@ bool DatabaseMariaDB::ProcessStandardChangeSet(
   return result;
 }
 
+std::list<libobjgen::UUID> DatabaseMariaDB::ProcessStandardChangeSets(
+    const std::list<std::shared_ptr<DBStandardChangeSet>>& changes) {
+  auto dirtyFields = GetDirtyFields(changes);
+
+  std::list<libobjgen::UUID> failures;
+  bool result = false;
+
+  {
+    // Hold one connection for the whole transaction.
+    auto lease = AcquireConnection();
+    if (lease == nullptr) {
+      return FallbackChangeSets(changes, dirtyFields);
+    }
+
+    MYSQL* connection = lease.get();
+
+    if (mysql_autocommit(connection, false)) {
+      LogDatabaseDebug([&]() {
+        return String("mysql_autocommit failed for connection: %1\n")
+            .Arg(ConnectionString(connection));
+      });
+
+      return FallbackChangeSets(changes, dirtyFields);
+    }
+
+    result = WriteChangeSetsWithSavepoints(changes, failures) &&
+             !mysql_commit(connection);
+
+    if (!result && mysql_rollback(connection)) {
+      LogDatabaseDebug([&]() {
+        return String("Last SQL error: %1\n").Arg(GetLastError(connection));
+      });
+
+      // If this happens the server may need to be shut down
+      LogDatabaseCriticalMsg("Rollback failed!\n");
+    }
+
+    if (mysql_autocommit(connection, true)) {
+      LogDatabaseDebug([&]() {
+        return String("mysql_autocommit failed for connection: %1\n")
+            .Arg(ConnectionString(connection));
+      });
+    }
+  }
+
+  return result ? failures : FallbackChangeSets(changes, dirtyFields);
+}
+
+bool DatabaseMariaDB::ExecuteTransactionControl(const String& statement) {
+  // This is the connection holding the transaction when one is open.
+  auto lease = AcquireConnection();
+  if (lease == nullptr) {
+    return false;
+  }
+
+  MYSQL* connection = lease.get();
+
+  auto sql = statement.ToUtf8();
+
+  if (mysql_real_query(connection, sql.c_str(), (unsigned long)sql.size())) {
+    LogDatabaseError([&]() {
+      return String("Failed to execute query: %1\n").Arg(statement);
+    });
+
+    LogDatabaseError([&]() {
+      return String("Database said: %1\n").Arg(GetLastError(connection));
+    });
+
+    return false;
+  }
+
+  return true;
+}
+
 bool DatabaseMariaDB::ProcessOperationalChangeSet(
     const std::shared_ptr<DBOperationalChangeSet>& changes) {
-  auto connection = GetConnection(true);
-  if (connection == nullptr) {
+  // Hold one connection for the whole transaction. Every query this
+  // thread prepares until it is released uses the same connection.
+  auto lease = AcquireConnection();
+  if (lease == nullptr) {
     return false;
   }
 
+  MYSQL* connection = lease.get();
+
   if (mysql_autocommit(connection, false)) {
     LogDatabaseDebug([&]() {
       return String("mysql_autocommit failed for connection: %1\n")
@@ -961,8 +1111,22 @@ bool DatabaseMariaDB::ProcessOperationalChangeSet(
 
   bool result = true;
   std::set<std::shared_ptr<libcomp::PersistentObject>> objs;
+  std::list<std::shared_ptr<DBExplicitUpdate>> explicitUpdates;
   for (auto op : changes->GetOperations()) {
     auto obj = op->GetRecord();
+
+    // Run the explicit updates collected so far together before any other
+    // kind of operation.
+    if (op->GetType() != DBOperationalChange::DBOperationType::DBOP_EXPLICIT &&
+        !explicitUpdates.empty()) {
+      result = ProcessExplicitUpdates(explicitUpdates);
+      explicitUpdates.clear();
+
+      if (!result) {
+        break;
+      }
+    }
+
     switch (op->GetType()) {
       case DBOperationalChange::DBOperationType::DBOP_INSERT:
         result &= InsertSingleObject(obj);
@@ -975,7 +1139,7 @@ bool DatabaseMariaDB::ProcessOperationalChangeSet(
         break;
       case DBOperationalChange::DBOperationType::DBOP_EXPLICIT:
         objs.insert(obj);
-        result &= ProcessExplicitUpdate(
+        explicitUpdates.push_back(
             std::dynamic_pointer_cast<DBExplicitUpdate>(op));
         break;
     }
@@ -985,6 +1149,10 @@ bool DatabaseMariaDB::ProcessOperationalChangeSet(
     }
   }
 
+  if (result && !explicitUpdates.empty()) {
+    result = ProcessExplicitUpdates(explicitUpdates);
+  }
+
   if (result) {
     result = !mysql_commit(connection);
 
@@ -1032,6 +1200,7 @@ bool DatabaseMariaDB::ProcessOperationalChangeSet(
                                libcomp::PersistentObject::GetTypeHashByName(
                                    obj->GetObjectMetadata()->GetName(), result),
                                bind));
+      delete bind;
 
       if (!result) {
         break;
@@ -1042,178 +1211,436 @@ bool DatabaseMariaDB::ProcessOperationalChangeSet(
   return result;
 }
 
-bool DatabaseMariaDB::ProcessExplicitUpdate(
-    const std::shared_ptr<DBExplicitUpdate>& update) {
-  auto obj = update->GetRecord();
-  auto expectedVals = update->GetExpectedValues();
-  auto changedVals = update->GetChanges();
-  if (changedVals.size() == 0) {
+bool DatabaseMariaDB::ConnectToDatabase(MYSQL*& connection,
+                                        const libcomp::String& databaseName) {
+  Close(connection);
+
+  connection = mysql_init(NULL);
+  if (connection == NULL) {
+    LogDatabaseErrorMsg("mysql_init failed\n");
+
     return false;
   }
 
-  size_t idx = 0;
-  std::list<String> updateClause;
-  std::list<String> whereClause;
-  // Bind the update clause values
-  for (auto cPair : changedVals) {
-    auto it = expectedVals.find(cPair.first);
-    if (it == expectedVals.end()) {
-      return false;
-    }
+  auto config =
+      std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig);
+  auto hostIP = config->GetIP();
+  auto username = config->GetUsername();
+  auto password = config->GetPassword();
+
+  // Report the rows matched as affected rows so an explicit update that
+  // leaves a value unchanged is still counted as applied.
+  unsigned long flags = CLIENT_FOUND_ROWS;
 
-    updateClause.push_back(String("`%1` = :%2").Arg(cPair.first).Arg(idx++));
+  // Pipelined change sets send many statements in one query.
+  if (config->GetPipelineChangeSets()) {
+    flags |= CLIENT_MULTI_STATEMENTS;
   }
 
-  auto uidIdx = idx++;
+  connection = mysql_real_connect(
+      connection, (!hostIP.IsEmpty() ? hostIP.C() : "localhost"),
+      (!username.IsEmpty() ? username.C() : NULL),
+      (!password.IsEmpty() ? password.C() : NULL),
+      (!databaseName.IsEmpty() ? databaseName.C() : NULL), config->GetPort(),
+      NULL, flags);
+  if (connection == NULL) {
+    LogDatabaseErrorMsg("Failed to open database connection\n");
+
+    Close(connection);
 
-  // Now bind the where clause values
-  for (auto cPair : changedVals) {
-    whereClause.push_back(String("`%1` = :%2").Arg(cPair.first).Arg(idx++));
+    return false;
   }
 
-  String sql = String("UPDATE `%1` SET %2 WHERE `UID` = :%3 AND %4;")
-                   .Arg(obj->GetObjectMetadata()->GetName())
-                   .Arg(String::Join(updateClause, ", "))
-                   .Arg(uidIdx)
-                   .Arg(String::Join(whereClause, " AND "));
+  // Set the encoding of the connection.
+  if (mysql_set_character_set(connection, "utf8mb4")) {
+    LogDatabaseErrorMsg(
+        "Failed to set character set for database connection\n");
 
-  DatabaseQuery query = Prepare(sql);
+    Close(connection);
 
-  if (!query.IsValid()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to prepare SQL query: %1\n").Arg(sql); });
+    return false;
+  }
 
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+  // Do not reconnect automatically. A reconnect silently drops every
+  // statement in the cache of the connection so a lost connection is
+  // closed and replaced by the pool instead.
+  bool reconnect = 0;
+  if (mysql_options(connection, MYSQL_OPT_RECONNECT, &reconnect)) {
+    LogDatabaseErrorMsg("Failed to set MYSQL_OPT_RECONNECT on the database.\n");
+
+    Close(connection);
 
     return false;
   }
 
-  idx = 0;
-  for (auto cPair : changedVals) {
-    if (!cPair.second->Bind(query, idx++)) {
-      LogDatabaseError([&]() {
-        return String("Failed to bind value: %1\n").Arg(cPair.first);
-      });
+  LogDatabaseDebug([&]() {
+    return String("New database connection opened: %1\n")
+        .Arg(ConnectionString(connection));
+  });
 
-      LogDatabaseError(
-          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+  return true;
+}
 
-      return false;
+std::shared_ptr<MYSQL> DatabaseMariaDB::AcquireConnection() {
+  auto config =
+      std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig);
+
+  auto threadID = std::this_thread::get_id();
+
+  std::shared_ptr<PooledConnection> pooled;
+  String databaseName;
+  bool checkHealth = false;
+
+  {
+    std::unique_lock<std::mutex> lock(mConnectionLock);
+
+    auto it = mConnections.find(threadID);
+
+    if (mConnections.end() != it) {
+      // The thread already holds a connection so share it.
+      pooled = it->second;
+      pooled->leases++;
+
+      mPoolStats.checkouts++;
+
+      return std::shared_ptr<MYSQL>(
+          pooled->connection,
+          [this, pooled](MYSQL*) { ReleaseConnection(pooled); });
     }
-  }
 
-  if (!query.Bind(idx++, obj->GetUUID())) {
-    LogDatabaseErrorMsg("Failed to bind value: UID\n");
+    ReapIdleConnectionsLocked();
 
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+    size_t poolSize = std::max((size_t)1, (size_t)config->GetPoolSize());
 
-    return false;
-  }
+    auto start = std::chrono::steady_clock::now();
+    auto deadline =
+        start + std::chrono::milliseconds(config->GetPoolWaitTimeout());
 
-  for (auto cPair : changedVals) {
-    if (!expectedVals[cPair.first]->Bind(query, idx++)) {
-      LogDatabaseError([&]() {
-        return String("Failed to bind where clause for value: %1\n")
-            .Arg(cPair.first);
-      });
+    bool waited = false;
 
-      LogDatabaseError(
-          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+    while (!pooled) {
+      if (!mOpen) {
+        return nullptr;
+      }
 
-      return false;
+      if (!mIdleConnections.empty()) {
+        pooled = mIdleConnections.front();
+        mIdleConnections.pop_front();
+
+        auto healthCheckInterval =
+            std::chrono::seconds(config->GetPoolHealthCheckInterval());
+
+        checkHealth = (std::chrono::steady_clock::now() - pooled->lastUsed) >=
+                      healthCheckInterval;
+      } else if (mOpenConnections < poolSize) {
+        // Reserve a slot and connect once the lock is released.
+        pooled = std::make_shared<PooledConnection>();
+        pooled->connection = nullptr;
+        pooled->generation = mGeneration;
+
+        mOpenConnections++;
+      } else if (std::cv_status::timeout ==
+                     mConnectionReady.wait_until(lock, deadline) &&
+                 mIdleConnections.empty() &&
+                 mOpenConnections >= poolSize) {
+        mPoolStats.timeouts++;
+
+        LogDatabaseError([&]() {
+          return String(
+                     "Timed out waiting for one of %1 database connections.\n")
+              .Arg(poolSize);
+        });
+
+        return nullptr;
+      } else {
+        waited = true;
+      }
+    }
+
+    if (waited) {
+      auto waitTime = (uint64_t)std::chrono::duration_cast<
+                          std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+      mPoolStats.waits++;
+      mPoolStats.totalWaitTime += waitTime;
+      mPoolStats.maxWaitTime = std::max(mPoolStats.maxWaitTime, waitTime);
+    }
+
+    pooled->leases = 1;
+    mConnections[threadID] = pooled;
+
+    mPoolStats.checkouts++;
+
+    if (mUseDatabase) {
+      databaseName = config->GetDatabaseName();
     }
   }
 
-  if (!query.Execute()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
+  // Wrap the connection first so it is released if anything below fails.
+  std::shared_ptr<MYSQL> lease(nullptr, [this, pooled](MYSQL*) {
+    ReleaseConnection(pooled);
+  });
 
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
+  if (checkHealth && nullptr != pooled->connection &&
+      mysql_ping(pooled->connection)) {
+    LogDatabaseDebug([&]() {
+      return String("Database connection failed health check: %1\n")
+          .Arg(ConnectionString(pooled->connection));
+    });
 
-    return false;
+    {
+      std::lock_guard<std::mutex> lock(mConnectionLock);
+      mPoolStats.healthCheckFailures++;
+    }
+
+    Close(pooled->connection);
   }
 
-  return query.AffectedRowCount() == 1;
+  if (nullptr == pooled->connection) {
+    if (!ConnectToDatabase(pooled->connection, databaseName)) {
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mConnectionLock);
+    mPoolStats.opened++;
+  }
+
+  return std::shared_ptr<MYSQL>(lease, pooled->connection);
 }
 
-bool DatabaseMariaDB::ConnectToDatabase(MYSQL*& connection,
-                                        const libcomp::String& databaseName) {
-  Close(connection);
+void DatabaseMariaDB::ReleaseConnection(
+    const std::shared_ptr<PooledConnection>& pooled) {
+  std::lock_guard<std::mutex> lock(mConnectionLock);
 
-  connection = mysql_init(NULL);
-  if (connection == NULL) {
-    LogDatabaseErrorMsg("mysql_init failed\n");
+  if (0 != --pooled->leases) {
+    return;
+  }
 
-    return false;
+  for (auto it = mConnections.begin(); it != mConnections.end(); ++it) {
+    if (it->second == pooled) {
+      // Keep the last error around for GetLastError.
+      if (nullptr != pooled->connection && mysql_errno(pooled->connection)) {
+        mLastErrors[it->first] = GetLastError(pooled->connection);
+      } else {
+        mLastErrors.erase(it->first);
+      }
+
+      mConnections.erase(it);
+      break;
+    }
   }
 
+  // A connection that was lost is closed so the next checkout opens a new
+  // one with an empty statement cache.
+  if (mOpen && nullptr != pooled->connection &&
+      pooled->generation == mGeneration &&
+      !IsConnectionError(mysql_errno(pooled->connection))) {
+    pooled->lastUsed = std::chrono::steady_clock::now();
+    mIdleConnections.push_front(pooled);
+  } else {
+    Close(pooled->connection);
+    mOpenConnections--;
+  }
+
+  mConnectionReady.notify_one();
+}
+
+bool DatabaseMariaDB::CloseIdleConnections() {
+  bool result = true;
+
+  for (auto pooled : mIdleConnections) {
+    result &= Close(pooled->connection);
+    mOpenConnections--;
+  }
+
+  mIdleConnections.clear();
+
+  return result;
+}
+
+void DatabaseMariaDB::ReapIdleConnections() {
+  std::lock_guard<std::mutex> lock(mConnectionLock);
+
+  ReapIdleConnectionsLocked();
+}
+
+void DatabaseMariaDB::ReapIdleConnectionsLocked() {
   auto config =
       std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig);
-  auto hostIP = config->GetIP();
-  auto username = config->GetUsername();
-  auto password = config->GetPassword();
 
-  connection = mysql_real_connect(
-      connection, (!hostIP.IsEmpty() ? hostIP.C() : "localhost"),
-      (!username.IsEmpty() ? username.C() : NULL),
-      (!password.IsEmpty() ? password.C() : NULL),
-      (!databaseName.IsEmpty() ? databaseName.C() : NULL), config->GetPort(),
-      NULL, 0);
-  if (connection == NULL) {
-    LogDatabaseErrorMsg("Failed to open database connection\n");
+  if (0 == config->GetPoolIdleTimeout()) {
+    return;
+  }
 
-    Close(connection);
+  auto cutoff = std::chrono::steady_clock::now() -
+                std::chrono::seconds(config->GetPoolIdleTimeout());
 
-    return false;
+  // The least recently used connections are at the back.
+  while (!mIdleConnections.empty() &&
+         mIdleConnections.back()->lastUsed < cutoff) {
+    Close(mIdleConnections.back()->connection);
+    mIdleConnections.pop_back();
+    mOpenConnections--;
+
+    mPoolStats.reaped++;
   }
+}
 
-  // Set the encoding of the connection.
-  if (mysql_set_character_set(connection, "utf8mb4")) {
-    LogDatabaseErrorMsg(
-        "Failed to set character set for database connection\n");
+DatabaseConnectionPoolStats DatabaseMariaDB::GetConnectionPoolStats() {
+  std::lock_guard<std::mutex> lock(mConnectionLock);
 
-    Close(connection);
+  DatabaseConnectionPoolStats stats = mPoolStats;
+  stats.open = (uint64_t)mOpenConnections;
+  stats.idle = (uint64_t)mIdleConnections.size();
+  stats.inUse = (uint64_t)mConnections.size();
+
+  return stats;
+}
+
+DatabasePipelineStats DatabaseMariaDB::GetPipelineStats() const {
+  DatabasePipelineStats stats;
+  stats.changeSets = mPipelineChangeSets;
+  stats.statements = mPipelineStatements;
+  stats.roundTrips = mPipelineRoundTrips;
+  stats.failures = mPipelineFailures;
+
+  return stats;
+}
+
+String DatabaseMariaDB::FormatLiteral(const DatabaseBind* pValue) const {
+  // Write text as hexadecimal so the literal does not depend on the
+  // backslash escaping mode of the server.
+  if (auto pText = dynamic_cast<const DatabaseBindText*>(pValue)) {
+    auto text = pText->GetValue().ToUtf8();
+
+    DatabaseBindBlob blob(pValue->GetColumn(),
+                          std::vector<char>(text.begin(), text.end()));
+
+    return String("_utf8mb4 %1").Arg(Database::FormatLiteral(&blob));
+  }
+
+  return Database::FormatLiteral(pValue);
+}
 
+bool DatabaseMariaDB::PipelineChangeSet(
+    const std::shared_ptr<DBStandardChangeSet>& changes) {
+  std::list<String> statements;
+
+  if (!FormatChangeSet(changes, statements)) {
     return false;
   }
 
-  // Set auto reconnect in case a connection idles too long
-  bool reconnect = 1;
-  if (mysql_options(connection, MYSQL_OPT_RECONNECT, &reconnect)) {
-    LogDatabaseErrorMsg("Failed to set MYSQL_OPT_RECONNECT on the database.\n");
+  if (statements.empty()) {
+    return true;
+  }
 
-    Close(connection);
+  // Hold one connection for the whole transaction.
+  auto lease = AcquireConnection();
+  if (lease == nullptr) {
+    return false;
+  }
+
+  MYSQL* connection = lease.get();
+
+  statements.push_front("START TRANSACTION;");
+  statements.push_back("COMMIT;");
+
+  mPipelineChangeSets++;
+
+  if (!ExecutePipeline(connection, statements)) {
+    mPipelineFailures++;
+
+    // Nothing after the statement that failed was run (including the
+    // commit) so the transaction is still open.
+    if (mysql_rollback(connection)) {
+      LogDatabaseDebug([&]() {
+        return String("mysql_rollback failed for connection: %1\n")
+            .Arg(ConnectionString(connection));
+      });
+
+      LogDatabaseDebug([&]() {
+        return String("Last SQL error: %1\n").Arg(GetLastError(connection));
+      });
+
+      // If this happens the server may need to be shut down
+      LogDatabaseCriticalMsg("Rollback failed!\n");
+    }
 
     return false;
   }
 
-  LogDatabaseDebug([&]() {
-    return String("New database connection opened: %1\n")
-        .Arg(ConnectionString(connection));
-  });
+  for (auto obj : changes->GetDeletes()) {
+    obj->Unregister();
+  }
 
   return true;
 }
 
-MYSQL*& DatabaseMariaDB::GetConnection(bool autoConnect) {
-  auto threadID = std::this_thread::get_id();
-  std::lock_guard<std::mutex> lock(mConnectionLock);
-  if (mConnections.find(threadID) == mConnections.end()) {
-    MYSQL* connection = nullptr;
+bool DatabaseMariaDB::ExecutePipeline(MYSQL* connection,
+                                      const std::list<String>& statements) {
+  auto statement = statements.begin();
+
+  while (statements.end() != statement) {
+    // Send as many statements as fit in the batch (but at least one).
+    std::string batch;
+    size_t count = 0;
+
+    for (; statements.end() != statement; ++statement, ++count) {
+      auto sql = statement->ToUtf8();
+
+      if (0 < count && MAX_PIPELINE_BATCH_BYTES < batch.size() + sql.size()) {
+        break;
+      }
 
-    if (autoConnect) {
-      auto config =
-          std::dynamic_pointer_cast<objects::DatabaseConfigMariaDB>(mConfig);
-      ConnectToDatabase(connection, config->GetDatabaseName());
+      batch += sql;
     }
 
-    mConnections[threadID] = connection;
+    mPipelineRoundTrips++;
+
+    size_t executed = 0;
+    bool result =
+        !mysql_real_query(connection, batch.c_str(), (unsigned long)batch.size());
+
+    // Read the result of every statement in the batch. The server stops at
+    // the first statement that fails.
+    while (result) {
+      executed++;
+
+      MYSQL_RES* pResult = mysql_store_result(connection);
+
+      if (nullptr != pResult) {
+        mysql_free_result(pResult);
+      } else if (0 != mysql_field_count(connection)) {
+        result = false;
+        break;
+      }
+
+      int next = mysql_next_result(connection);
+
+      if (-1 == next) {
+        break;
+      }
+
+      result = 0 == next;
+    }
+
+    mPipelineStatements += executed;
+
+    if (!result) {
+      LogDatabaseError([&]() {
+        return String("Pipelined statement %1 of %2 failed: %3\n")
+            .Arg(executed + 1)
+            .Arg(count)
+            .Arg(GetLastError(connection));
+      });
+
+      return false;
+    }
   }
 
-  return mConnections[threadID];
+  return true;
 }
 
 String DatabaseMariaDB::GetVariableType(
@@ -1222,7 +1649,7 @@ String DatabaseMariaDB::GetVariableType(
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_STRING:
       return "text";
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_REF:
-      return "varchar(36)";
+      return GetUUIDType();
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_BOOL:
       return "bit";
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_S8:
@@ -1251,17 +1678,86 @@ String DatabaseMariaDB::GetVariableType(
   return "blob";
 }
 
-String DatabaseMariaDB::GetLastError() {
-  auto connection = GetConnection(false);
+String DatabaseMariaDB::GetUUIDType() const {
+  return mConfig->GetBinaryUUIDs() ? "binary(16)" : "varchar(36)";
+}
 
-  if (connection) {
-    const char* szError = mysql_error(connection);
+bool DatabaseMariaDB::MigrateUUIDColumns(
+    const String& table, const std::set<std::string>& uuidColumns) {
+  bool binary = mConfig->GetBinaryUUIDs();
 
-    if (nullptr != szError && 0 != szError[0]) {
-      return szError;
+  std::list<String> rawColumns;
+  std::list<String> conversions;
+  std::list<String> uuidTypes;
+
+  for (auto& column : uuidColumns) {
+    String name = String("`%1`").Arg(column);
+
+    // Hold the values as raw bytes while they are converted so neither
+    // form is rejected or truncated by the column type.
+    rawColumns.push_back(String("MODIFY %1 varbinary(36)").Arg(name));
+    uuidTypes.push_back(String("MODIFY %1 %2").Arg(name).Arg(GetUUIDType()));
+
+    // Values already in the configured form are left alone so a
+    // conversion that was interrupted can be run again.
+    if (binary) {
+      conversions.push_back(
+          String("%1 = IF(LENGTH(%1) = 36, UNHEX(REPLACE(%1, '-', '')), %1)")
+              .Arg(name));
+    } else {
+      conversions.push_back(
+          String("%1 = IF(LENGTH(%1) = 16, LOWER(CONCAT_WS('-', "
+                 "HEX(SUBSTRING(%1, 1, 4)), HEX(SUBSTRING(%1, 5, 2)), "
+                 "HEX(SUBSTRING(%1, 7, 2)), HEX(SUBSTRING(%1, 9, 2)), "
+                 "HEX(SUBSTRING(%1, 11, 6)))), %1)")
+              .Arg(name));
+    }
+  }
+
+  std::list<String> statements = {
+      String("ALTER TABLE `%1` %2;")
+          .Arg(table)
+          .Arg(String::Join(rawColumns, ", ")),
+      String("UPDATE `%1` SET %2;")
+          .Arg(table)
+          .Arg(String::Join(conversions, ", ")),
+      String("ALTER TABLE `%1` %2;")
+          .Arg(table)
+          .Arg(String::Join(uuidTypes, ", ")),
+  };
+
+  for (auto& statement : statements) {
+    if (!Execute(statement)) {
+      LogDatabaseError([&]() {
+        return String("Failed to convert UUID columns: %1\n")
+            .Arg(GetLastError());
+      });
+
+      return false;
     }
   }
 
+  return true;
+}
+
+String DatabaseMariaDB::GetLastError() {
+  auto threadID = std::this_thread::get_id();
+
+  std::lock_guard<std::mutex> lock(mConnectionLock);
+
+  auto it = mConnections.find(threadID);
+
+  if (mConnections.end() != it) {
+    return GetLastError(it->second->connection);
+  }
+
+  // The connection was returned to the pool since the error.
+  auto errorIter = mLastErrors.find(threadID);
+
+  if (mLastErrors.end() != errorIter) {
+    return errorIter->second;
+  }
+
   return "Invalid connection.";
 }
 
@@ -1277,6 +1773,10 @@ String DatabaseMariaDB::GetLastError(MYSQL* connection) {
   return "Invalid connection.";
 }
 
+bool DatabaseMariaDB::IsConnectionError(unsigned int errorCode) {
+  return CR_SERVER_GONE_ERROR == errorCode || CR_SERVER_LOST == errorCode;
+}
+
 bool DatabaseMariaDB::TableExists(const libcomp::String& table) {
   int64_t tableExists = 0;
 
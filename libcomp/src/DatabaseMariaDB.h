@@ -37,12 +37,106 @@
 #include <MetaVariable.h>
 
 // Standard C++ Includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <set>
 #include <thread>
 
 typedef struct st_mysql MYSQL;
 
 namespace libcomp {
 
+struct DatabaseStatementMariaDB;
+
+/**
+ * Statistics of the connection pool of a @ref DatabaseMariaDB.
+ */
+struct DatabaseConnectionPoolStats {
+  DatabaseConnectionPoolStats()
+      : checkouts(0),
+        opened(0),
+        reaped(0),
+        healthCheckFailures(0),
+        waits(0),
+        totalWaitTime(0),
+        maxWaitTime(0),
+        timeouts(0),
+        open(0),
+        idle(0),
+        inUse(0) {}
+
+  /**
+   * Get the average time a checkout waited for a free connection.
+   * @return Average wait time in microseconds of checkouts that waited
+   */
+  double AverageWaitTime() const {
+    return waits ? ((double)totalWaitTime / (double)waits) : 0.0;
+  }
+
+  /// Number of times a connection was checked out
+  uint64_t checkouts;
+
+  /// Number of connections opened by the pool
+  uint64_t opened;
+
+  /// Number of idle connections closed for being unused too long
+  uint64_t reaped;
+
+  /// Number of idle connections that failed a health check
+  uint64_t healthCheckFailures;
+
+  /// Number of checkouts that had to wait for a free connection
+  uint64_t waits;
+
+  /// Total time checkouts waited for a free connection (microseconds)
+  uint64_t totalWaitTime;
+
+  /// Longest time a checkout waited for a free connection (microseconds)
+  uint64_t maxWaitTime;
+
+  /// Number of checkouts that gave up waiting for a free connection
+  uint64_t timeouts;
+
+  /// Number of connections currently open (or opening)
+  uint64_t open;
+
+  /// Number of open connections not checked out
+  uint64_t idle;
+
+  /// Number of connections checked out by a thread
+  uint64_t inUse;
+};
+
+/**
+ * Statistics of the change sets a @ref DatabaseMariaDB sent as pipelined
+ * multi-statement batches.
+ */
+struct DatabasePipelineStats {
+  DatabasePipelineStats()
+      : changeSets(0), statements(0), roundTrips(0), failures(0) {}
+
+  /**
+   * Get the average number of statements sent in each round trip.
+   * @return Average statements per round trip
+   */
+  double StatementsPerRoundTrip() const {
+    return roundTrips ? ((double)statements / (double)roundTrips) : 0.0;
+  }
+
+  /// Number of change sets written
+  uint64_t changeSets;
+
+  /// Number of statements executed (including the transaction statements)
+  uint64_t statements;
+
+  /// Number of multi-statement batches sent to the server
+  uint64_t roundTrips;
+
+  /// Number of change sets that failed and were rolled back
+  uint64_t failures;
+};
+
 /**
  * Represents a MariaDB database connection via the supplied config.
  */
@@ -67,7 +161,8 @@ class DatabaseMariaDB : public Database {
   virtual bool Open();
 
   /**
-   * Close dall database connections.
+   * Close all idle database connections. Connections still checked out
+   * are closed once they are returned.
    * @return true on success, false on failure
    */
   virtual bool Close();
@@ -82,6 +177,7 @@ class DatabaseMariaDB : public Database {
   virtual bool IsOpen() const;
 
   virtual DatabaseQuery Prepare(const String& query);
+  virtual DatabaseQuery PrepareLargeRead(const String& query);
 
   /**
    * Check if the database exists.
@@ -131,20 +227,81 @@ class DatabaseMariaDB : public Database {
    */
   String GetLastError(MYSQL* pConnection);
 
+  /**
+   * Check if an error code means the connection to the server was lost.
+   * The prepared statements of the connection are gone on the server once
+   * this happens so the connection and its statements must be closed.
+   * @param errorCode MariaDB client or server error code.
+   * @return true if the connection was lost, false otherwise
+   */
+  static bool IsConnectionError(unsigned int errorCode);
+
+  virtual std::shared_ptr<void> HoldConnection();
+
+  virtual DatabaseStatementCacheStats GetStatementCacheStats();
+
+  /**
+   * Get the statistics of the connection pool.
+   * @return Connection pool statistics
+   */
+  DatabaseConnectionPoolStats GetConnectionPoolStats();
+
+  /**
+   * Get the statistics of the pipelined change sets.
+   * @return Pipelined change set statistics
+   */
+  DatabasePipelineStats GetPipelineStats() const;
+
+  /**
+   * Close every idle connection that has not been used for longer than
+   * the configured idle timeout. This is also done whenever a connection
+   * is checked out.
+   */
+  void ReapIdleConnections();
+
  protected:
   virtual bool ProcessStandardChangeSet(
       const std::shared_ptr<DBStandardChangeSet>& changes);
+  virtual std::list<libobjgen::UUID> ProcessStandardChangeSets(
+      const std::list<std::shared_ptr<DBStandardChangeSet>>& changes);
   virtual bool ProcessOperationalChangeSet(
       const std::shared_ptr<DBOperationalChangeSet>& changes);
 
+  /**
+   * Execute a transaction control statement with the text protocol on the
+   * connection this thread holds. The server can not prepare savepoint
+   * statements (ER_UNSUPPORTED_PS) so they are not sent through
+   * @ref Prepare.
+   * @param statement Statement to execute
+   * @return true on success, false on error
+   */
+  virtual bool ExecuteTransactionControl(const String& statement);
+
+  virtual String QuoteIdentifier(const String& name) const;
+  virtual size_t GetMaxBindCount() const;
+  virtual String FormatLiteral(const DatabaseBind* pValue) const;
+
  private:
   /**
-   * Process and explicit update to a single record, checking each column's
-   * state before and verifying it set to the expected value afterwards.
-   * @param update Pointer to the explicit update
-   * @return true if the the updated succeeded, false if it did not
+   * Write a standard change set as one transaction by sending all of its
+   * statements with their values in the text as multi-statement batches
+   * and reading every result before the next batch is sent. A change set
+   * that fits one batch takes a single round trip to the server.
+   * @param changes Change set to write
+   * @return true on success, false on failure
+   */
+  bool PipelineChangeSet(const std::shared_ptr<DBStandardChangeSet>& changes);
+
+  /**
+   * Execute statements as multi-statement batches on a connection. Each
+   * batch is sent with one query and the result of every statement in it
+   * is read before the next batch is sent. Execution stops at the first
+   * statement that fails.
+   * @param connection Connection opened with multiple statement support
+   * @param statements Statements to execute in order
+   * @return true if every statement succeeded, false otherwise
    */
-  bool ProcessExplicitUpdate(const std::shared_ptr<DBExplicitUpdate>& update);
+  bool ExecutePipeline(MYSQL* connection, const std::list<String>& statements);
 
   /**
    * Establish a connection to a MariaDB database.
@@ -157,12 +314,60 @@ class DatabaseMariaDB : public Database {
                          const libcomp::String& databaseName);
 
   /**
-   * Get a connection for the executing thread.
-   * @param autoConnect true if the connection should be established before
-   *  returning it, false if it should just return the conection reference
-   * @return Reference to the executing thread's connection pointer
+   * Connection owned by the pool.
    */
-  MYSQL*& GetConnection(bool autoConnect);
+  struct PooledConnection {
+    /// MariaDB connection (null until connected)
+    MYSQL* connection;
+
+    /// Number of checkouts currently holding the connection
+    size_t leases;
+
+    /// Pool generation the connection was opened for
+    uint64_t generation;
+
+    /// Time the connection was last returned to the pool
+    std::chrono::steady_clock::time_point lastUsed;
+  };
+
+  /**
+   * Check out a connection for the executing thread. A thread that already
+   * holds a connection gets the same one back so every query it makes
+   * (including the ones in a transaction) uses one connection. Otherwise
+   * an idle connection is taken from the pool, a new one is opened if the
+   * pool is not full or the call waits for a connection to be returned.
+   * @return Connection that is returned to the pool when the last copy
+   *  of the pointer is released or null if no connection is available
+   */
+  std::shared_ptr<MYSQL> AcquireConnection();
+
+  /**
+   * Release one checkout of a connection. Once nothing holds the
+   * connection it is put back in the pool or closed if the pool has been
+   * closed or reset since it was opened.
+   * @param pooled Connection to release
+   */
+  void ReleaseConnection(const std::shared_ptr<PooledConnection>& pooled);
+
+  /**
+   * Close every idle connection (the connection lock must be held).
+   * @return true if every connection closed
+   */
+  bool CloseIdleConnections();
+
+  /**
+   * Close idle connections that timed out (the connection lock must be
+   * held).
+   */
+  void ReapIdleConnectionsLocked();
+
+  /**
+   * Get the prepared statement cache for a connection.
+   * @param pConnection Connection to get the cache for
+   * @return Pointer to the cache or null if there is no connection
+   */
+  DatabaseStatementCache<DatabaseStatementMariaDB>* GetStatementCache(
+      MYSQL* pConnection);
 
   /**
    * Get the MariaDB type represented by a MetaVariable type.
@@ -171,14 +376,73 @@ class DatabaseMariaDB : public Database {
    */
   String GetVariableType(const std::shared_ptr<libobjgen::MetaVariable> var);
 
-  /// Mutex to lock access to the database connection map
+  /**
+   * Get the MariaDB type of UID and reference columns.
+   * @return Data type string of UUID columns
+   */
+  String GetUUIDType() const;
+
+  /**
+   * Convert the UUID columns of a table between text and 16 bytes to
+   * match the configured UUID storage.
+   * @param table Name of the table to convert
+   * @param uuidColumns UUID columns to convert
+   * @return true if the table was converted, false otherwise
+   */
+  bool MigrateUUIDColumns(const String& table,
+                          const std::set<std::string>& uuidColumns);
+
+  /// Mutex to lock access to the connection pool
   std::mutex mConnectionLock;
 
-  /// Pointers to the MariaDB representation of a database connection per
-  /// thread. References to the pointers in this collection are passed around
-  /// for use throughout the class as they are not removed or modified until the
-  /// database is closed.
-  std::unordered_map<std::thread::id, MYSQL*> mConnections;
+  /// Signaled when a connection is returned to the pool
+  std::condition_variable mConnectionReady;
+
+  /// Connections checked out by each thread
+  std::unordered_map<std::thread::id, std::shared_ptr<PooledConnection>>
+      mConnections;
+
+  /// Connections not checked out from most to least recently used
+  std::list<std::shared_ptr<PooledConnection>> mIdleConnections;
+
+  /// Last error of the connection each thread most recently returned
+  std::unordered_map<std::thread::id, String> mLastErrors;
+
+  /// Number of connections open or opening
+  size_t mOpenConnections;
+
+  /// Incremented to close every existing connection once it is returned
+  uint64_t mGeneration;
+
+  /// Indicates new connections should use the configured database
+  bool mUseDatabase;
+
+  /// Indicates the database has been opened and not closed
+  std::atomic<bool> mOpen;
+
+  /// Statistics of the connection pool
+  DatabaseConnectionPoolStats mPoolStats;
+
+  /// Number of change sets written as pipelined batches
+  std::atomic<uint64_t> mPipelineChangeSets;
+
+  /// Number of statements executed in pipelined batches
+  std::atomic<uint64_t> mPipelineStatements;
+
+  /// Number of pipelined batches sent to the server
+  std::atomic<uint64_t> mPipelineRoundTrips;
+
+  /// Number of pipelined change sets that failed
+  std::atomic<uint64_t> mPipelineFailures;
+
+  /// Mutex to lock access to the statement cache map
+  std::mutex mStatementCacheLock;
+
+  /// Prepared statements cached for each connection
+  std::unordered_map<
+      MYSQL*,
+      std::shared_ptr<DatabaseStatementCache<DatabaseStatementMariaDB>>>
+      mStatementCaches;
 };
 
 }  // namespace libcomp
@@ -28,6 +28,10 @@
 
 #ifndef EXOTIC_PLATFORM
 
+// Standard C++11 Includes
+#include <algorithm>
+#include <chrono>
+
 using namespace libcomp;
 
 DatabaseQueryImpl::DatabaseQueryImpl() : mAffectedRowCount(0) {}
@@ -59,6 +63,12 @@ bool DatabaseQueryImpl::GetRows(
   return false;
 }
 
+bool DatabaseQueryImpl::CopyRow(DatabaseQueryRow& row) {
+  (void)row;
+
+  return false;
+}
+
 int64_t DatabaseQueryImpl::AffectedRowCount() const {
   return mAffectedRowCount;
 }
@@ -70,11 +80,19 @@ DatabaseQuery::DatabaseQuery(DatabaseQueryImpl* pImpl, const String& query)
   Prepare(query);
 }
 
-DatabaseQuery::DatabaseQuery(DatabaseQuery&& other) : mImpl(other.mImpl) {
+DatabaseQuery::DatabaseQuery(DatabaseQuery&& other)
+    : mImpl(other.mImpl),
+      mSQL(std::move(other.mSQL)),
+      mBindTypes(std::move(other.mBindTypes)),
+      mStats(other.mStats) {
   other.mImpl = nullptr;
+  other.mSQL.Clear();
+  other.mStats = DatabaseQueryShapeStats();
 }
 
 DatabaseQuery::~DatabaseQuery() {
+  FlushStats();
+
   delete mImpl;
   mImpl = nullptr;
 }
@@ -82,10 +100,19 @@ DatabaseQuery::~DatabaseQuery() {
 bool DatabaseQuery::Prepare(const String& query) {
   bool result = false;
 
+  FlushStats();
+
   if (nullptr != mImpl) {
     result = mImpl->Prepare(query);
   }
 
+  // Only keep the SQL when the query will be timed.
+  if (DatabaseQueryStats::IsEnabled()) {
+    mSQL = query;
+  } else {
+    mSQL.Clear();
+  }
+
   return result;
 }
 
@@ -93,7 +120,32 @@ bool DatabaseQuery::Execute() {
   bool result = false;
 
   if (nullptr != mImpl) {
-    result = mImpl->Execute();
+    if (mSQL.IsEmpty()) {
+      result = mImpl->Execute();
+    } else {
+      auto start = std::chrono::steady_clock::now();
+
+      result = mImpl->Execute();
+
+      uint64_t time =
+          (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+
+      mStats.count++;
+      mStats.totalTime += time;
+      mStats.maxTime = std::max(mStats.maxTime, time);
+
+      if (result && mImpl->AffectedRowCount() > 0) {
+        mStats.rowsAffected += (uint64_t)mImpl->AffectedRowCount();
+      }
+
+      if (DatabaseQueryStats::CheckSlowQuery(mSQL, time, mBindTypes)) {
+        mStats.slowCount++;
+      }
+
+      mBindTypes.clear();
+    }
   }
 
   return result;
@@ -106,6 +158,10 @@ bool DatabaseQuery::Next() {
     result = mImpl->Next();
   }
 
+  if (result && !mSQL.IsEmpty()) {
+    mStats.rowsReturned++;
+  }
+
   return result;
 }
 
@@ -116,6 +172,8 @@ bool DatabaseQuery::Bind(size_t index, const String& value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("text");
+
   return result;
 }
 
@@ -126,6 +184,8 @@ bool DatabaseQuery::Bind(const String& name, const String& value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("text");
+
   return result;
 }
 
@@ -136,6 +196,8 @@ bool DatabaseQuery::Bind(size_t index, const std::vector<char>& value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("blob");
+
   return result;
 }
 
@@ -146,6 +208,8 @@ bool DatabaseQuery::Bind(const String& name, const std::vector<char>& value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("blob");
+
   return result;
 }
 
@@ -156,6 +220,8 @@ bool DatabaseQuery::Bind(size_t index, const libobjgen::UUID& value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("uuid");
+
   return result;
 }
 
@@ -166,6 +232,8 @@ bool DatabaseQuery::Bind(const String& name, const libobjgen::UUID& value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("uuid");
+
   return result;
 }
 
@@ -176,6 +244,8 @@ bool DatabaseQuery::Bind(size_t index, int32_t value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("int");
+
   return result;
 }
 
@@ -186,6 +256,8 @@ bool DatabaseQuery::Bind(const String& name, int32_t value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("int");
+
   return result;
 }
 
@@ -196,6 +268,8 @@ bool DatabaseQuery::Bind(size_t index, int64_t value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("bigint");
+
   return result;
 }
 
@@ -206,6 +280,8 @@ bool DatabaseQuery::Bind(const String& name, int64_t value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("bigint");
+
   return result;
 }
 
@@ -216,6 +292,8 @@ bool DatabaseQuery::Bind(size_t index, float value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("float");
+
   return result;
 }
 
@@ -226,6 +304,8 @@ bool DatabaseQuery::Bind(const String& name, float value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("float");
+
   return result;
 }
 
@@ -236,6 +316,8 @@ bool DatabaseQuery::Bind(size_t index, double value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("double");
+
   return result;
 }
 
@@ -246,6 +328,8 @@ bool DatabaseQuery::Bind(const String& name, double value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("double");
+
   return result;
 }
 
@@ -256,6 +340,8 @@ bool DatabaseQuery::Bind(size_t index, bool value) {
     result = mImpl->Bind(index, value);
   }
 
+  RecordBind("bool");
+
   return result;
 }
 
@@ -266,6 +352,8 @@ bool DatabaseQuery::Bind(const String& name, bool value) {
     result = mImpl->Bind(name, value);
   }
 
+  RecordBind("bool");
+
   return result;
 }
 
@@ -288,6 +376,8 @@ bool DatabaseQuery::Bind(
     result = mImpl->Bind(index, values);
   }
 
+  RecordBind("map");
+
   return result;
 }
 
@@ -300,6 +390,8 @@ bool DatabaseQuery::Bind(
     result = mImpl->Bind(name, values);
   }
 
+  RecordBind("map");
+
   return result;
 }
 
@@ -343,6 +435,27 @@ bool DatabaseQuery::GetValue(const String& name, std::vector<char>& value) {
   return result;
 }
 
+bool DatabaseQuery::GetBlob(size_t index, const char*& data, size_t& size) {
+  bool result = false;
+
+  if (nullptr != mImpl) {
+    result = mImpl->GetBlob(index, data, size);
+  }
+
+  return result;
+}
+
+bool DatabaseQuery::GetBlob(const String& name, const char*& data,
+                            size_t& size) {
+  bool result = false;
+
+  if (nullptr != mImpl) {
+    result = mImpl->GetBlob(name, data, size);
+  }
+
+  return result;
+}
+
 bool DatabaseQuery::GetValue(size_t index, libobjgen::UUID& value) {
   bool result = false;
 
@@ -474,6 +587,16 @@ bool DatabaseQuery::GetRows(
   return result;
 }
 
+bool DatabaseQuery::CopyRow(DatabaseQueryRow& row) {
+  bool result = false;
+
+  if (nullptr != mImpl) {
+    result = mImpl->CopyRow(row);
+  }
+
+  return result;
+}
+
 int64_t DatabaseQuery::AffectedRowCount() const {
   int64_t result = false;
 
@@ -485,12 +608,37 @@ int64_t DatabaseQuery::AffectedRowCount() const {
 }
 
 DatabaseQuery& DatabaseQuery::operator=(DatabaseQuery&& other) {
+  FlushStats();
+
   delete mImpl;
 
   mImpl = other.mImpl;
   other.mImpl = nullptr;
 
+  mSQL = std::move(other.mSQL);
+  mBindTypes = std::move(other.mBindTypes);
+  mStats = other.mStats;
+
+  other.mSQL.Clear();
+  other.mStats = DatabaseQueryShapeStats();
+
   return *this;
 }
 
+void DatabaseQuery::RecordBind(const char* type) {
+  if (!mSQL.IsEmpty()) {
+    mBindTypes.push_back(type);
+  }
+}
+
+void DatabaseQuery::FlushStats() {
+  if (0 != mStats.count) {
+    DatabaseQueryStats::Record(mSQL, mStats);
+
+    mStats = DatabaseQueryShapeStats();
+  }
+
+  mBindTypes.clear();
+}
+
 #endif  // !EXOTIC_PLATFORM
@@ -34,12 +34,15 @@
 
 // libcomp Includes
 #include "CString.h"
+#include "DatabaseQueryStats.h"
 
 // Standard C++11 Includes
 #include <unordered_map>
 
 namespace libcomp {
 
+class DatabaseQueryRow;
+
 /**
  * Abstract base class to be implemented by specific database types to
  * facilitate column binding and data retrieval.
@@ -258,6 +261,27 @@ class DatabaseQueryImpl {
    */
   virtual bool GetValue(const String& name, std::vector<char>& value) = 0;
 
+  /**
+   * Get a pointer to the data of a blob column by its index without
+   * copying it. The data is only valid until the next row is read.
+   * @param index The column's index
+   * @param data Output pointer to the blob data
+   * @param size Output size of the blob data
+   * @return true on success, false on failure
+   */
+  virtual bool GetBlob(size_t index, const char*& data, size_t& size) = 0;
+
+  /**
+   * Get a pointer to the data of a blob column by its name without
+   * copying it. The data is only valid until the next row is read.
+   * @param name The column's name
+   * @param data Output pointer to the blob data
+   * @param size Output size of the blob data
+   * @return true on success, false on failure
+   */
+  virtual bool GetBlob(const String& name, const char*& data,
+                       size_t& size) = 0;
+
   /**
    * Get a UUID column value by its index.
    * @param index The column's index
@@ -364,6 +388,14 @@ class DatabaseQueryImpl {
   virtual bool GetRows(
       std::list<std::unordered_map<std::string, std::vector<char>>>& rows);
 
+  /**
+   * Copy the values of the current result row so they can be read after
+   * the query moves to the next row.
+   * @param row Row to add the column values to
+   * @return true on success, false on failure
+   */
+  virtual bool CopyRow(DatabaseQueryRow& row);
+
   /**
    * Get the count of affected rows from the last query
    * execution.
@@ -623,6 +655,28 @@ class DatabaseQuery {
    */
   bool GetValue(const String& name, std::vector<char>& value);
 
+  /**
+   * Get a pointer to the data of an implementation's blob column by its
+   * index without copying it. The data is only valid until the next row
+   * is read.
+   * @param index The column's index
+   * @param data Output pointer to the blob data
+   * @param size Output size of the blob data
+   * @return true on success, false on failure
+   */
+  bool GetBlob(size_t index, const char*& data, size_t& size);
+
+  /**
+   * Get a pointer to the data of an implementation's blob column by its
+   * name without copying it. The data is only valid until the next row is
+   * read.
+   * @param name The column's name
+   * @param data Output pointer to the blob data
+   * @param size Output size of the blob data
+   * @return true on success, false on failure
+   */
+  bool GetBlob(const String& name, const char*& data, size_t& size);
+
   /**
    * Get an implementation's UUID column value by its index.
    * @param index The column's index
@@ -729,6 +783,14 @@ class DatabaseQuery {
   virtual bool GetRows(
       std::list<std::unordered_map<std::string, std::vector<char>>>& rows);
 
+  /**
+   * Copy the values of the query implementation's current result row so
+   * they can be read after the query moves to the next row.
+   * @param row Row to add the column values to
+   * @return true on success, false on failure
+   */
+  bool CopyRow(DatabaseQueryRow& row);
+
   /**
    * Check current query implementation's state validity.
    * @return true on valid, false on invalid
@@ -752,6 +814,28 @@ class DatabaseQuery {
  protected:
   /// Database specific implementation
   DatabaseQueryImpl* mImpl;
+
+ private:
+  /**
+   * Remember the type of a bound parameter for the slow query log.
+   * @param type Name of the parameter type
+   */
+  void RecordBind(const char* type);
+
+  /**
+   * Add the statistics of the query to those of its statement shape.
+   */
+  void FlushStats();
+
+  /// SQL the query was prepared with (only kept while query statistics
+  /// or the slow query log are enabled)
+  String mSQL;
+
+  /// Types of the parameters bound since the last execution
+  std::vector<const char*> mBindTypes;
+
+  /// Statistics of the query not yet added to its statement shape
+  DatabaseQueryShapeStats mStats;
 };
 
 }  // namespace libcomp
@@ -28,6 +28,7 @@
 
 #include "BaseLog.h"
 #include "DatabaseMariaDB.h"
+#include "DatabaseQueryRow.h"
 
 #ifndef EXOTIC_PLATFORM
 
@@ -37,8 +38,16 @@
 // MariaDB Includes
 #include <mysql.h>
 
+// Standard C++11 Includes
+#include <algorithm>
+#include <chrono>
+
 using namespace libcomp;
 
+/// Largest buffer allocated up front for a string or blob column read
+/// through a cursor. Larger values grow the buffer when they are fetched.
+static const unsigned long MAX_CURSOR_COLUMN_BUFFER = 1024;
+
 static libcomp::String ConnectionString(void* pConnection) {
   return libcomp::String("{%1-%2}")
       .Arg((uint32_t)(((uint64_t)pConnection) >> 32), 8, 16, '0')
@@ -57,11 +66,42 @@ static libcomp::String GetLastError(MYSQL* connection) {
   return "Invalid connection.";
 }
 
-DatabaseQueryMariaDB::DatabaseQueryMariaDB(MYSQL* pDatabase)
-    : mDatabase(pDatabase), mStatement(nullptr), mStatus(0) {}
+DatabaseQueryMariaDB::DatabaseQueryMariaDB(
+    const std::shared_ptr<MYSQL>& connection,
+    DatabaseStatementCache<DatabaseStatementMariaDB>* pCache, bool binaryUUIDs,
+    uint32_t prefetchRows)
+    : mConnection(connection),
+      mDatabase(connection.get()),
+      mStatement(nullptr),
+      mStatus(0),
+      mCache(pCache),
+      mPrepareTime(0),
+      mBinaryUUIDs(binaryUUIDs),
+      mPrefetchRows(prefetchRows),
+      mCursor(false) {}
+
+DatabaseQueryMariaDB::~DatabaseQueryMariaDB() { ReleaseStatement(); }
+
+void DatabaseQueryMariaDB::ReleaseStatement() {
+  if (nullptr == mStatement) {
+    return;
+  }
+
+  // A statement that failed because the connection was lost no longer
+  // exists on the server so it must not go back in the cache.
+  if (!mCachedSQL.IsEmpty() &&
+      !DatabaseMariaDB::IsConnectionError(mysql_stmt_errno(mStatement))) {
+    // Drop any remaining results and bound data so the statement can be
+    // executed again with new bindings.
+    mysql_stmt_free_result(mStatement);
+    mysql_stmt_reset(mStatement);
 
-DatabaseQueryMariaDB::~DatabaseQueryMariaDB() {
-  if (nullptr != mStatement) {
+    DatabaseStatementMariaDB cached;
+    cached.statement = mStatement;
+    cached.paramNames = mParamNames;
+
+    mCache->Return(mCachedSQL, cached, mPrepareTime);
+  } else {
     mysql_stmt_close(mStatement);
 
     LogDatabaseDebug([&]() {
@@ -69,9 +109,40 @@ DatabaseQueryMariaDB::~DatabaseQueryMariaDB() {
           .Arg(ConnectionString(mStatement));
     });
   }
+
+  mStatement = nullptr;
+  mCachedSQL.Clear();
+  mBindings.clear();
+  mResultBindings.clear();
+  mResultBuffers.clear();
+  mResultColumnNames.clear();
+  mResultColumnTypes.clear();
 }
 
 bool DatabaseQueryMariaDB::Prepare(const String& query) {
+  ReleaseStatement();
+
+  if (nullptr == mDatabase) {
+    LogDatabaseDebugMsg("No database connection to prepare the query on.\n");
+
+    return false;
+  }
+
+  bool cacheable = nullptr != mCache && mCache->IsCacheable(query);
+
+  DatabaseStatementMariaDB cached;
+
+  if (cacheable && mCache->Take(query, cached, mPrepareTime)) {
+    mStatement = cached.statement;
+    mParamNames = cached.paramNames;
+    mCachedSQL = query;
+    mStatus = 0;
+
+    return IsValid();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
   // MySQL/MariaDB does not support named parameter binding so
   // the query to prepare will need to have named parameters that
   // we will replace here in case the query needs access to the
@@ -127,6 +198,14 @@ bool DatabaseQueryMariaDB::Prepare(const String& query) {
     });
   }
 
+  mPrepareTime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  if (cacheable && IsValid()) {
+    mCachedSQL = query;
+  }
+
   return IsValid();
 }
 
@@ -153,6 +232,34 @@ bool DatabaseQueryMariaDB::Execute() {
     return false;
   }
 
+  // Read large results through a read-only cursor that fetches a number of
+  // rows at a time instead of storing the whole result when the statement
+  // is executed. Cached statements keep their attributes so the cursor type
+  // is always set.
+  bool hasResult = 0 < mysql_stmt_field_count(mStatement);
+
+  mCursor = hasResult && 0 < mPrefetchRows;
+
+  if (hasResult) {
+    unsigned long cursorType = mCursor ? (unsigned long)CURSOR_TYPE_READ_ONLY
+                                       : (unsigned long)CURSOR_TYPE_NO_CURSOR;
+    unsigned long prefetchRows = mCursor ? (unsigned long)mPrefetchRows : 1;
+
+    if (mysql_stmt_attr_set(mStatement, STMT_ATTR_CURSOR_TYPE, &cursorType) ||
+        mysql_stmt_attr_set(mStatement, STMT_ATTR_PREFETCH_ROWS,
+                            &prefetchRows)) {
+      LogDatabaseDebug([&]() {
+        return String(
+                   "Failed to set the cursor type of statement %1 for "
+                   "connection %2\n")
+            .Arg(ConnectionString(mStatement))
+            .Arg(ConnectionString(mDatabase));
+      });
+
+      mCursor = false;
+    }
+  }
+
   mStatus = mysql_stmt_execute(mStatement);
   mAffectedRowCount = (int64_t)mysql_affected_rows(mDatabase);
 
@@ -179,7 +286,10 @@ bool DatabaseQueryMariaDB::Execute() {
 
   my_bool aBool = 1;
 
-  if (mysql_stmt_attr_set(mStatement, STMT_ATTR_UPDATE_MAX_LENGTH, &aBool)) {
+  // Rows read through a cursor are fetched later so the result can not be
+  // stored and the column sizes are not known yet.
+  if (!mCursor &&
+      mysql_stmt_attr_set(mStatement, STMT_ATTR_UPDATE_MAX_LENGTH, &aBool)) {
     LogDatabaseDebug([&]() {
       return String(
                  "mysql_stmt_attr_set of statement %1 failed for connection "
@@ -193,7 +303,7 @@ bool DatabaseQueryMariaDB::Execute() {
     });
   }
 
-  if (mysql_stmt_store_result(mStatement)) {
+  if (!mCursor && mysql_stmt_store_result(mStatement)) {
     LogDatabaseDebug([&]() {
       return String(
                  "mysql_stmt_store_result of statement %1 failed for "
@@ -211,6 +321,7 @@ bool DatabaseQueryMariaDB::Execute() {
 
   if (result != nullptr) {
     mResultBindings.clear();
+    mResultBuffers.clear();
 
     MYSQL_FIELD* field = mysql_fetch_field(result);
     while (field) {
@@ -226,6 +337,9 @@ bool DatabaseQueryMariaDB::Execute() {
       b.buffer_type = field->type;
       b.is_null = &mBufferNulls.back();
       b.length = &mBufferLengths.back();
+
+      std::vector<char>* pBuffer = nullptr;
+
       switch (field->type) {
         case MYSQL_TYPE_LONG: {
           mBufferInt.push_back(0);
@@ -246,12 +360,17 @@ bool DatabaseQueryMariaDB::Execute() {
         case MYSQL_TYPE_BLOB:
         case MYSQL_TYPE_VAR_STRING:
         case MYSQL_TYPE_STRING: {
+          unsigned long size =
+              mCursor ? std::min(field->length, MAX_CURSOR_COLUMN_BUFFER)
+                      : field->max_length;
+
           std::vector<char> buff;
           // Insert at least one character to represent the null terminator
-          for (unsigned long i = 0; i < field->max_length || i < 1; i++) {
+          for (unsigned long i = 0; i < size || i < 1; i++) {
             buff.push_back(0);
           }
           mBufferBlob.push_back(buff);
+          pBuffer = &mBufferBlob.back();
           b.buffer = &mBufferBlob.back()[0];
           b.buffer_length = (unsigned long)buff.size();
         } break;
@@ -265,6 +384,7 @@ bool DatabaseQueryMariaDB::Execute() {
           break;
       }
       mResultBindings.push_back(b);
+      mResultBuffers.push_back(pBuffer);
 
       field = mysql_fetch_field(result);
     }
@@ -292,6 +412,12 @@ bool DatabaseQueryMariaDB::Execute() {
 bool DatabaseQueryMariaDB::Next() {
   mStatus = mysql_stmt_fetch(mStatement);
 
+  // Values read through a cursor may not fit the buffers sized before the
+  // first row was fetched.
+  if (mCursor && (0 == mStatus || MYSQL_DATA_TRUNCATED == mStatus)) {
+    mStatus = FetchTruncatedColumns() ? 0 : -1;
+  }
+
   if (mStatus && MYSQL_NO_DATA != mStatus) {
     LogDatabaseDebug([&]() {
       return String(
@@ -373,6 +499,10 @@ bool DatabaseQueryMariaDB::Bind(const String& name,
 }
 
 bool DatabaseQueryMariaDB::Bind(size_t index, const libobjgen::UUID& value) {
+  if (mBinaryUUIDs) {
+    return Bind(index, value.ToData());
+  }
+
   auto bind = PrepareBinding(index, MYSQL_TYPE_VAR_STRING);
   if (bind == nullptr) {
     return false;
@@ -554,17 +684,13 @@ bool DatabaseQueryMariaDB::GetValue(const String& name, String& value) {
 }
 
 bool DatabaseQueryMariaDB::GetValue(size_t index, std::vector<char>& value) {
-  if (mResultColumnTypes.size() <= index ||
-      mResultColumnTypes[index] != MYSQL_TYPE_BLOB) {
+  const char* val;
+  size_t bytes;
+
+  if (!GetBlob(index, val, bytes)) {
     return false;
   }
 
-  auto column = mResultBindings[index];
-
-  size_t bytes = *column.length;
-
-  auto val = (char*)column.buffer;
-
   value.clear();
   value.insert(value.begin(), val, val + bytes);
 
@@ -581,13 +707,53 @@ bool DatabaseQueryMariaDB::GetValue(const String& name,
   return GetValue(index, value);
 }
 
+bool DatabaseQueryMariaDB::GetBlob(size_t index, const char*& data,
+                                   size_t& size) {
+  if (mResultColumnTypes.size() <= index ||
+      mResultColumnTypes[index] != MYSQL_TYPE_BLOB) {
+    return false;
+  }
+
+  auto& column = mResultBindings[index];
+
+  data = (const char*)column.buffer;
+  size = *column.length;
+
+  return true;
+}
+
+bool DatabaseQueryMariaDB::GetBlob(const String& name, const char*& data,
+                                   size_t& size) {
+  size_t index;
+  if (!GetResultColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetBlob(index, data, size);
+}
+
 bool DatabaseQueryMariaDB::GetValue(size_t index, libobjgen::UUID& value) {
-  libcomp::String uuidStr;
-  if (GetValue(index, uuidStr)) {
-    value = libobjgen::UUID(uuidStr.ToUtf8());
-    return true;
+  if (mResultColumnTypes.size() <= index ||
+      (mResultColumnTypes[index] != MYSQL_TYPE_STRING &&
+       mResultColumnTypes[index] != MYSQL_TYPE_VAR_STRING &&
+       mResultColumnTypes[index] != MYSQL_TYPE_BLOB)) {
+    return false;
   }
-  return false;
+
+  auto column = mResultBindings[index];
+
+  size_t bytes = *column.length;
+
+  auto val = (char*)column.buffer;
+
+  // Binary UUID columns hold the 16 bytes of the UUID.
+  if (16 == bytes) {
+    value = libobjgen::UUID(std::vector<char>(val, val + bytes));
+  } else {
+    value = libobjgen::UUID(std::string(val, val + bytes));
+  }
+
+  return true;
 }
 
 bool DatabaseQueryMariaDB::GetValue(const String& name,
@@ -781,6 +947,52 @@ bool DatabaseQueryMariaDB::GetRows(
   return IsValid();
 }
 
+bool DatabaseQueryMariaDB::CopyRow(DatabaseQueryRow& row) {
+  if (!IsValid() || 0 != mStatus) {
+    return false;
+  }
+
+  if (nullptr == row.GetColumnNames()) {
+    row.SetColumnNames(mResultColumnNames);
+  }
+
+  size_t colCount = mResultColumnTypes.size();
+
+  for (size_t i = 0; i < colCount; i++) {
+    auto& column = mResultBindings[i];
+
+    switch (mResultColumnTypes[i]) {
+      case MYSQL_TYPE_LONG:
+        row.AddInteger(*((int32_t*)column.buffer));
+        break;
+      case MYSQL_TYPE_LONGLONG:
+        row.AddInteger(*((int64_t*)column.buffer));
+        break;
+      case MYSQL_TYPE_BIT:
+        row.AddInteger(*((bool*)column.buffer) ? 1 : 0);
+        break;
+      case MYSQL_TYPE_FLOAT:
+        row.AddReal(*((float*)column.buffer));
+        break;
+      case MYSQL_TYPE_DOUBLE:
+        row.AddReal(*((double*)column.buffer));
+        break;
+      case MYSQL_TYPE_BLOB:
+        row.AddBlob((const char*)column.buffer, *column.length);
+        break;
+      case MYSQL_TYPE_STRING:
+      case MYSQL_TYPE_VAR_STRING:
+        row.AddText((const char*)column.buffer, *column.length);
+        break;
+      default:
+        row.AddNull();
+        break;
+    }
+  }
+
+  return true;
+}
+
 bool DatabaseQueryMariaDB::IsValid() const {
   return nullptr != mDatabase && nullptr != mStatement &&
          (mStatus == 0 || mStatus == MYSQL_NO_DATA);
@@ -807,6 +1019,51 @@ bool DatabaseQueryMariaDB::GetResultColumnIndex(const String& name,
   return true;
 }
 
+bool DatabaseQueryMariaDB::FetchTruncatedColumns() {
+  bool rebind = false;
+
+  for (size_t i = 0; i < mResultBindings.size(); ++i) {
+    auto& column = mResultBindings[i];
+    auto pBuffer = mResultBuffers[i];
+
+    if (nullptr == pBuffer || *column.length <= column.buffer_length) {
+      continue;
+    }
+
+    pBuffer->resize(*column.length);
+    column.buffer = &(*pBuffer)[0];
+    column.buffer_length = (unsigned long)pBuffer->size();
+
+    if (mysql_stmt_fetch_column(mStatement, &column, (unsigned int)i, 0)) {
+      LogDatabaseDebug([&]() {
+        return String(
+                   "mysql_stmt_fetch_column of statement %1 failed for "
+                   "connection %2\n")
+            .Arg(ConnectionString(mStatement))
+            .Arg(ConnectionString(mDatabase));
+      });
+
+      return false;
+    }
+
+    rebind = true;
+  }
+
+  if (rebind && mysql_stmt_bind_result(mStatement, &mResultBindings[0])) {
+    LogDatabaseDebug([&]() {
+      return String(
+                 "mysql_stmt_bind_result of statement %1 failed for "
+                 "connection %2\n")
+          .Arg(ConnectionString(mStatement))
+          .Arg(ConnectionString(mDatabase));
+    });
+
+    return false;
+  }
+
+  return true;
+}
+
 MYSQL_BIND* DatabaseQueryMariaDB::PrepareBinding(size_t index, int type) {
   if (mStatement == nullptr || index >= mStatement->param_count) {
     return nullptr;
@@ -31,6 +31,10 @@
 
 // libcomp Includes
 #include "DatabaseQuery.h"
+#include "DatabaseStatementCache.h"
+
+// Standard C++11 Includes
+#include <memory>
 
 typedef struct st_mysql MYSQL;
 typedef struct st_mysql_bind MYSQL_BIND;
@@ -40,6 +44,18 @@ namespace libcomp {
 
 class DatabaseMariaDB;
 
+/**
+ * Prepared MariaDB statement along with the named parameters that were
+ * replaced when it was prepared.
+ */
+struct DatabaseStatementMariaDB {
+  /// Prepared statement
+  MYSQL_STMT* statement;
+
+  /// Param names pulled from the statement text in order
+  std::vector<std::string> paramNames;
+};
+
 /**
  * MariaDB database specific implementation of a query with binding and
  * data retrieval functionality. The connector for MariaDB is the same
@@ -50,13 +66,23 @@ class DatabaseQueryMariaDB : public DatabaseQueryImpl {
  public:
   /**
    * Create a new MariaDB database query.
-   * @param pDatabase Pointer to the executing MariaDB database
+   * @param connection Connection checked out of the pool of the executing
+   *  MariaDB database that is held until the query is destroyed
    * @param maxRetryCount Maximum number of retry attempts allowed
    *  when access to the DB during query execution returns as busy
    * @param retryDelay Delay in milliseconds between execution retry
    *  attempts
+   * @param pCache Cache of prepared statements for the connection (or
+   *  null to always prepare a new statement)
+   * @param binaryUUIDs true to bind UUIDs as 16 bytes instead of text
+   * @param prefetchRows Number of rows a select reads from the server at a
+   *  time through a read-only cursor (0 to read the whole result when the
+   *  query is executed)
    */
-  DatabaseQueryMariaDB(MYSQL* pDatabase);
+  DatabaseQueryMariaDB(
+      const std::shared_ptr<MYSQL>& connection,
+      DatabaseStatementCache<DatabaseStatementMariaDB>* pCache = nullptr,
+      bool binaryUUIDs = false, uint32_t prefetchRows = 0);
 
   /**
    * Clean up the query.
@@ -94,6 +120,8 @@ class DatabaseQueryMariaDB : public DatabaseQueryImpl {
   virtual bool GetValue(const String& name, String& value);
   virtual bool GetValue(size_t index, std::vector<char>& value);
   virtual bool GetValue(const String& name, std::vector<char>& value);
+  virtual bool GetBlob(size_t index, const char*& data, size_t& size);
+  virtual bool GetBlob(const String& name, const char*& data, size_t& size);
   virtual bool GetValue(size_t index, libobjgen::UUID& value);
   virtual bool GetValue(const String& name, libobjgen::UUID& value);
   virtual bool GetValue(size_t index, int32_t& value);
@@ -108,10 +136,16 @@ class DatabaseQueryMariaDB : public DatabaseQueryImpl {
   virtual bool GetValue(const String& name, bool& value);
   virtual bool GetRows(
       std::list<std::unordered_map<std::string, std::vector<char>>>& rows);
+  virtual bool CopyRow(DatabaseQueryRow& row);
 
   virtual bool IsValid() const;
 
  private:
+  /**
+   * Return the statement to the cache or close it if it was not cached.
+   */
+  void ReleaseStatement();
+
   /**
    * Get the index of a named binding.
    * @param name Name of the binding
@@ -137,6 +171,17 @@ class DatabaseQueryMariaDB : public DatabaseQueryImpl {
    */
   MYSQL_BIND* PrepareBinding(size_t index, int type);
 
+  /**
+   * Grow the buffers of the string and blob columns of the current row that
+   * did not fit and fetch those columns again. Later rows are read into the
+   * larger buffers.
+   * @return true if every column was fetched, false otherwise
+   */
+  bool FetchTruncatedColumns();
+
+  /// Checked out connection the query executes on
+  std::shared_ptr<MYSQL> mConnection;
+
   /// Pointer to the MariaDB database the query executes on
   MYSQL* mDatabase;
 
@@ -149,6 +194,9 @@ class DatabaseQueryMariaDB : public DatabaseQueryImpl {
   /// Bindings configured to contain all results returned by a query
   std::vector<MYSQL_BIND> mResultBindings;
 
+  /// Buffer of each string or blob result column (null for other columns)
+  std::vector<std::vector<char>*> mResultBuffers;
+
   /// Current status of the query as a MariaDB defined integer status
   /// code
   int mStatus;
@@ -186,6 +234,25 @@ class DatabaseQueryMariaDB : public DatabaseQueryImpl {
 
   /// Buffer containing length values for bound and selected values
   std::list<unsigned long> mBufferLengths;
+
+  /// Cache the statement is returned to (or null)
+  DatabaseStatementCache<DatabaseStatementMariaDB>* mCache;
+
+  /// SQL text the statement is cached under (empty if it is not cacheable)
+  String mCachedSQL;
+
+  /// Time it took to prepare the statement (microseconds)
+  uint64_t mPrepareTime;
+
+  /// Indicates UUIDs are bound as 16 bytes instead of text
+  bool mBinaryUUIDs;
+
+  /// Number of rows a select reads at a time through a cursor (0 to read
+  /// the whole result at once)
+  uint32_t mPrefetchRows;
+
+  /// Indicates the current result is read through a cursor
+  bool mCursor;
 };
 
 }  // namespace libcomp
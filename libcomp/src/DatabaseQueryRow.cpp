@@ -0,0 +1,467 @@
+/**
+ * @file libcomp/src/DatabaseQueryRow.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief A copy of one database query result row.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseQueryRow.h"
+
+#ifndef EXOTIC_PLATFORM
+
+// Standard C++11 Includes
+#include <algorithm>
+
+using namespace libcomp;
+
+DatabaseQueryRow::DatabaseQueryRow(
+    const std::shared_ptr<const std::vector<std::string>>& columnNames)
+    : mColumnNames(columnNames) {
+  if (nullptr != mColumnNames) {
+    mColumns.reserve(mColumnNames->size());
+  }
+}
+
+DatabaseQueryRow::~DatabaseQueryRow() {}
+
+bool DatabaseQueryRow::Prepare(const String& query) {
+  (void)query;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Execute() { return false; }
+
+bool DatabaseQueryRow::Next() { return false; }
+
+bool DatabaseQueryRow::Bind(size_t index, const String& value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, const String& value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, const std::vector<char>& value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, const std::vector<char>& value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, const libobjgen::UUID& value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, const libobjgen::UUID& value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, int32_t value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, int32_t value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, int64_t value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, int64_t value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, float value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, float value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, double value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, double value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, bool value) {
+  (void)index;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, bool value) {
+  (void)name;
+  (void)value;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(size_t index, const std::unordered_map<std::string, std::vector<char>>& values) {
+  (void)index;
+  (void)values;
+
+  return false;
+}
+
+bool DatabaseQueryRow::Bind(const String& name, const std::unordered_map<std::string, std::vector<char>>& values) {
+  (void)name;
+  (void)values;
+
+  return false;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, String& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::TEXT);
+
+  if (nullptr == pColumn) {
+    // Text may be stored in a binary column.
+    pColumn = GetColumn(index, DatabaseColumnType_t::BLOB);
+  }
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = String(std::string(pColumn->data.begin(), pColumn->data.end()));
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, std::vector<char>& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::BLOB);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = pColumn->data;
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetBlob(size_t index, const char*& data, size_t& size) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::BLOB);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  data = pColumn->data.data();
+  size = pColumn->data.size();
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, libobjgen::UUID& value) {
+  // Binary UUID columns hold the 16 bytes of the UUID.
+  std::vector<char> data;
+  if (GetValue(index, data) && 16 == data.size()) {
+    value = libobjgen::UUID(data);
+    return true;
+  }
+
+  libcomp::String uuidStr;
+  if (GetValue(index, uuidStr)) {
+    value = libobjgen::UUID(uuidStr.ToUtf8());
+    return true;
+  }
+  return false;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, int32_t& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::INTEGER);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = (int32_t)pColumn->integer;
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, int64_t& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::INTEGER);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = pColumn->integer;
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, float& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::REAL);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = (float)pColumn->real;
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, double& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::REAL);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = pColumn->real;
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(size_t index, bool& value) {
+  auto pColumn = GetColumn(index, DatabaseColumnType_t::INTEGER);
+
+  if (nullptr == pColumn) {
+    return false;
+  }
+
+  value = 0 != pColumn->integer;
+
+  return true;
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, String& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, std::vector<char>& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetBlob(const String& name, const char*& data,
+                               size_t& size) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetBlob(index, data, size);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, libobjgen::UUID& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, int32_t& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, int64_t& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, float& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, double& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::GetValue(const String& name, bool& value) {
+  size_t index;
+  if (!GetColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetValue(index, value);
+}
+
+bool DatabaseQueryRow::IsValid() const { return nullptr != mColumnNames; }
+
+std::shared_ptr<const std::vector<std::string>>
+DatabaseQueryRow::GetColumnNames() const {
+  return mColumnNames;
+}
+
+void DatabaseQueryRow::SetColumnNames(
+    const std::vector<std::string>& columnNames) {
+  mColumnNames = std::make_shared<const std::vector<std::string>>(columnNames);
+  mColumns.reserve(columnNames.size());
+}
+
+void DatabaseQueryRow::AddNull() {
+  Column column;
+  column.type = DatabaseColumnType_t::NONE;
+  column.integer = 0;
+  column.real = 0.0;
+
+  mColumns.push_back(std::move(column));
+}
+
+void DatabaseQueryRow::AddInteger(int64_t value) {
+  Column column;
+  column.type = DatabaseColumnType_t::INTEGER;
+  column.integer = value;
+  column.real = 0.0;
+
+  mColumns.push_back(std::move(column));
+}
+
+void DatabaseQueryRow::AddReal(double value) {
+  Column column;
+  column.type = DatabaseColumnType_t::REAL;
+  column.integer = 0;
+  column.real = value;
+
+  mColumns.push_back(std::move(column));
+}
+
+void DatabaseQueryRow::AddText(const char* pData, size_t size) {
+  Column column;
+  column.type = DatabaseColumnType_t::TEXT;
+  column.integer = 0;
+  column.real = 0.0;
+  column.data.assign(pData, pData + size);
+
+  mColumns.push_back(std::move(column));
+}
+
+void DatabaseQueryRow::AddBlob(const char* pData, size_t size) {
+  Column column;
+  column.type = DatabaseColumnType_t::BLOB;
+  column.integer = 0;
+  column.real = 0.0;
+  column.data.assign(pData, pData + size);
+
+  mColumns.push_back(std::move(column));
+}
+
+const DatabaseQueryRow::Column* DatabaseQueryRow::GetColumn(
+    size_t index, DatabaseColumnType_t type) const {
+  if (mColumns.size() <= index || mColumns[index].type != type) {
+    return nullptr;
+  }
+
+  return &mColumns[index];
+}
+
+bool DatabaseQueryRow::GetColumnIndex(const String& name,
+                                      size_t& index) const {
+  if (nullptr == mColumnNames) {
+    return false;
+  }
+
+  auto iter =
+      std::find(mColumnNames->begin(), mColumnNames->end(), name.ToUtf8());
+  if (iter == mColumnNames->end()) {
+    return false;
+  }
+
+  index = (size_t)(iter - mColumnNames->begin());
+  return true;
+}
+
+#endif  // !EXOTIC_PLATFORM
@@ -0,0 +1,211 @@
+/**
+ * @file libcomp/src/DatabaseQueryRow.h
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief A copy of one database query result row.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCOMP_SRC_DATABASEQUERYROW_H
+#define LIBCOMP_SRC_DATABASEQUERYROW_H
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "DatabaseQuery.h"
+
+// Standard C++11 Includes
+#include <memory>
+
+namespace libcomp {
+
+/**
+ * Type of a column stored in a @ref DatabaseQueryRow.
+ */
+enum class DatabaseColumnType_t : uint8_t {
+  NONE = 0,  //!< NULL or unsupported value.
+  INTEGER,   //!< Integer or boolean value.
+  REAL,      //!< Floating point value.
+  TEXT,      //!< Text value.
+  BLOB,      //!< Binary value.
+};
+
+/**
+ * Query implementation that holds a copy of a single result row so the
+ * row can be read after the query that produced it has moved on, or from
+ * another thread. Rows are filled by @ref DatabaseQuery::CopyRow and only
+ * support retrieving values; every bind and execution function fails.
+ */
+class DatabaseQueryRow : public DatabaseQueryImpl {
+ public:
+  /**
+   * Create an empty row.
+   * @param columnNames Column names shared with other rows of the same
+   *  result (or null to let @ref DatabaseQuery::CopyRow set them)
+   */
+  DatabaseQueryRow(
+      const std::shared_ptr<const std::vector<std::string>>& columnNames =
+          nullptr);
+
+  /**
+   * Clean up the row.
+   */
+  virtual ~DatabaseQueryRow();
+
+  virtual bool Prepare(const String& query);
+  virtual bool Execute();
+  virtual bool Next();
+
+  virtual bool Bind(size_t index, const String& value);
+  virtual bool Bind(const String& name, const String& value);
+  virtual bool Bind(size_t index, const std::vector<char>& value);
+  virtual bool Bind(const String& name, const std::vector<char>& value);
+  virtual bool Bind(size_t index, const libobjgen::UUID& value);
+  virtual bool Bind(const String& name, const libobjgen::UUID& value);
+  virtual bool Bind(size_t index, int32_t value);
+  virtual bool Bind(const String& name, int32_t value);
+  virtual bool Bind(size_t index, int64_t value);
+  virtual bool Bind(const String& name, int64_t value);
+  virtual bool Bind(size_t index, float value);
+  virtual bool Bind(const String& name, float value);
+  virtual bool Bind(size_t index, double value);
+  virtual bool Bind(const String& name, double value);
+  virtual bool Bind(size_t index, bool value);
+  virtual bool Bind(const String& name, bool value);
+  virtual bool Bind(
+      size_t index,
+      const std::unordered_map<std::string, std::vector<char>>& values);
+  virtual bool Bind(
+      const String& name,
+      const std::unordered_map<std::string, std::vector<char>>& values);
+
+  virtual bool GetValue(size_t index, String& value);
+  virtual bool GetValue(const String& name, String& value);
+  virtual bool GetValue(size_t index, std::vector<char>& value);
+  virtual bool GetValue(const String& name, std::vector<char>& value);
+  virtual bool GetBlob(size_t index, const char*& data, size_t& size);
+  virtual bool GetBlob(const String& name, const char*& data, size_t& size);
+  virtual bool GetValue(size_t index, libobjgen::UUID& value);
+  virtual bool GetValue(const String& name, libobjgen::UUID& value);
+  virtual bool GetValue(size_t index, int32_t& value);
+  virtual bool GetValue(const String& name, int32_t& value);
+  virtual bool GetValue(size_t index, int64_t& value);
+  virtual bool GetValue(const String& name, int64_t& value);
+  virtual bool GetValue(size_t index, float& value);
+  virtual bool GetValue(const String& name, float& value);
+  virtual bool GetValue(size_t index, double& value);
+  virtual bool GetValue(const String& name, double& value);
+  virtual bool GetValue(size_t index, bool& value);
+  virtual bool GetValue(const String& name, bool& value);
+
+  virtual bool IsValid() const;
+
+  /**
+   * Get the column names of the row.
+   * @return Column names (or null if they have not been set)
+   */
+  std::shared_ptr<const std::vector<std::string>> GetColumnNames() const;
+
+  /**
+   * Set the column names of the row. Values must be added in the same
+   * order as the names.
+   * @param columnNames Names of the columns
+   */
+  void SetColumnNames(const std::vector<std::string>& columnNames);
+
+  /**
+   * Add a NULL column value.
+   */
+  void AddNull();
+
+  /**
+   * Add an integer column value.
+   * @param value Value of the column
+   */
+  void AddInteger(int64_t value);
+
+  /**
+   * Add a floating point column value.
+   * @param value Value of the column
+   */
+  void AddReal(double value);
+
+  /**
+   * Add a text column value.
+   * @param pData Text of the column
+   * @param size Number of bytes of text
+   */
+  void AddText(const char* pData, size_t size);
+
+  /**
+   * Add a binary column value.
+   * @param pData Data of the column
+   * @param size Number of bytes of data
+   */
+  void AddBlob(const char* pData, size_t size);
+
+ private:
+  /**
+   * Value of a single column.
+   */
+  struct Column {
+    /// Type of value stored
+    DatabaseColumnType_t type;
+
+    /// Integer value of the column
+    int64_t integer;
+
+    /// Floating point value of the column
+    double real;
+
+    /// Text or binary value of the column
+    std::vector<char> data;
+  };
+
+  /**
+   * Get a column by its index.
+   * @param index Index of the column
+   * @param type Type the column must have
+   * @return Pointer to the column or null if it does not exist or has a
+   *  different type
+   */
+  const Column* GetColumn(size_t index, DatabaseColumnType_t type) const;
+
+  /**
+   * Get the index of a column by its name.
+   * @param name Name of the column
+   * @param index Output parameter to return the index in
+   * @return true if the column exists, false otherwise
+   */
+  bool GetColumnIndex(const String& name, size_t& index) const;
+
+  /// Names of the columns in the row
+  std::shared_ptr<const std::vector<std::string>> mColumnNames;
+
+  /// Values of the columns in the row
+  std::vector<Column> mColumns;
+};
+
+}  // namespace libcomp
+
+#endif  // !EXOTIC_PLATFORM
+
+#endif  // LIBCOMP_SRC_DATABASEQUERYROW_H
@@ -26,6 +26,7 @@
 
 #include "DatabaseQuerySQLite3.h"
 
+#include "DatabaseQueryRow.h"
 #include "DatabaseSQLite3.h"
 
 #ifndef EXOTIC_PLATFORM
@@ -39,29 +40,72 @@
 
 using namespace libcomp;
 
-DatabaseQuerySQLite3::DatabaseQuerySQLite3(sqlite3* pDatabase,
-                                           uint8_t maxRetryCount,
-                                           uint16_t retryDelay)
+DatabaseQuerySQLite3::DatabaseQuerySQLite3(
+    sqlite3* pDatabase, uint8_t maxRetryCount, uint16_t retryDelay,
+    DatabaseStatementCache<sqlite3_stmt*>* pCache,
+    const std::shared_ptr<void>& connection, bool binaryUUIDs)
     : mDatabase(pDatabase),
       mStatement(nullptr),
       mStatus(SQLITE_OK),
       mDidJustExecute(false),
       mMaxRetryCount(maxRetryCount),
-      mRetryDelay(retryDelay) {}
+      mRetryDelay(retryDelay),
+      mCache(pCache),
+      mPrepareTime(0),
+      mConnection(connection),
+      mBinaryUUIDs(binaryUUIDs) {}
 
-DatabaseQuerySQLite3::~DatabaseQuerySQLite3() {
-  if (nullptr != mStatement) {
-    sqlite3_finalize(mStatement);
-  }
-}
+DatabaseQuerySQLite3::~DatabaseQuerySQLite3() { ReleaseStatement(); }
 
 bool DatabaseQuerySQLite3::Prepare(const String& query) {
+  ReleaseStatement();
+
+  bool cacheable = nullptr != mCache && mCache->IsCacheable(query);
+
+  if (cacheable && mCache->Take(query, mStatement, mPrepareTime)) {
+    mCachedSQL = query;
+    mStatus = SQLITE_OK;
+
+    return IsValid();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
   int len = (int)query.Length();
   mStatus = sqlite3_prepare_v2(mDatabase, query.C(), len, &mStatement, nullptr);
 
+  mPrepareTime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  if (cacheable && IsValid()) {
+    mCachedSQL = query;
+  }
+
   return IsValid();
 }
 
+void DatabaseQuerySQLite3::ReleaseStatement() {
+  if (nullptr == mStatement) {
+    return;
+  }
+
+  if (!mCachedSQL.IsEmpty()) {
+    // Clear the previous execution so the statement can be bound again.
+    sqlite3_reset(mStatement);
+    sqlite3_clear_bindings(mStatement);
+
+    mCache->Return(mCachedSQL, mStatement, mPrepareTime);
+  } else {
+    sqlite3_finalize(mStatement);
+  }
+
+  mStatement = nullptr;
+  mCachedSQL.Clear();
+  mResultColumnNames.clear();
+  mResultColumnTypes.clear();
+}
+
 bool DatabaseQuerySQLite3::Execute() {
   if (!IsValid()) {
     return false;
@@ -148,12 +192,20 @@ bool DatabaseQuerySQLite3::Bind(const String& name,
 }
 
 bool DatabaseQuerySQLite3::Bind(size_t index, const libobjgen::UUID& value) {
+  if (mBinaryUUIDs) {
+    return Bind(index, value.ToData());
+  }
+
   auto uuidStr = libcomp::String(value.ToString());
   return Bind(index, uuidStr);
 }
 
 bool DatabaseQuerySQLite3::Bind(const String& name,
                                 const libobjgen::UUID& value) {
+  if (mBinaryUUIDs) {
+    return Bind(name, value.ToData());
+  }
+
   auto uuidStr = libcomp::String(value.ToString());
   return Bind(name, uuidStr);
 }
@@ -288,17 +340,13 @@ bool DatabaseQuerySQLite3::GetValue(const String& name, String& value) {
 }
 
 bool DatabaseQuerySQLite3::GetValue(size_t index, std::vector<char>& value) {
-  if (mResultColumnTypes.size() <= index ||
-      mResultColumnTypes[index] != SQLITE_BLOB) {
+  const char* val;
+  size_t bytes;
+
+  if (!GetBlob(index, val, bytes)) {
     return false;
   }
 
-  int idx = (int)index;
-
-  size_t bytes = (size_t)sqlite3_column_bytes(mStatement, idx);
-
-  auto val = (const char*)sqlite3_column_blob(mStatement, idx);
-
   value.clear();
   value.insert(value.begin(), val, val + bytes);
 
@@ -315,7 +363,44 @@ bool DatabaseQuerySQLite3::GetValue(const String& name,
   return GetValue(index, value);
 }
 
+bool DatabaseQuerySQLite3::GetBlob(size_t index, const char*& data,
+                                   size_t& size) {
+  if (mResultColumnTypes.size() <= index ||
+      mResultColumnTypes[index] != SQLITE_BLOB) {
+    return false;
+  }
+
+  int idx = (int)index;
+
+  // Get the data before the size so the size is of the blob format.
+  data = (const char*)sqlite3_column_blob(mStatement, idx);
+  size = (size_t)sqlite3_column_bytes(mStatement, idx);
+
+  return true;
+}
+
+bool DatabaseQuerySQLite3::GetBlob(const String& name, const char*& data,
+                                   size_t& size) {
+  size_t index;
+  if (!GetResultColumnIndex(name, index)) {
+    return false;
+  }
+
+  return GetBlob(index, data, size);
+}
+
 bool DatabaseQuerySQLite3::GetValue(size_t index, libobjgen::UUID& value) {
+  // Binary UUID columns hold the 16 bytes of the UUID.
+  std::vector<char> data;
+  if (GetValue(index, data)) {
+    if (16 != data.size()) {
+      return false;
+    }
+
+    value = libobjgen::UUID(data);
+    return true;
+  }
+
   libcomp::String uuidStr;
   if (GetValue(index, uuidStr)) {
     value = libobjgen::UUID(uuidStr.ToUtf8());
@@ -500,6 +585,44 @@ bool DatabaseQuerySQLite3::GetRows(
   return IsValid();
 }
 
+bool DatabaseQuerySQLite3::CopyRow(DatabaseQueryRow& row) {
+  if (!IsValid() || SQLITE_ROW != mStatus) {
+    return false;
+  }
+
+  if (nullptr == row.GetColumnNames()) {
+    row.SetColumnNames(mResultColumnNames);
+  }
+
+  size_t colCount = mResultColumnTypes.size();
+
+  for (size_t i = 0; i < colCount; i++) {
+    int idx = (int)i;
+
+    switch (mResultColumnTypes[i]) {
+      case SQLITE_INTEGER:
+        row.AddInteger((int64_t)sqlite3_column_int64(mStatement, idx));
+        break;
+      case SQLITE_FLOAT:
+        row.AddReal(sqlite3_column_double(mStatement, idx));
+        break;
+      case SQLITE_TEXT:
+        row.AddText((const char*)sqlite3_column_text(mStatement, idx),
+                    (size_t)sqlite3_column_bytes(mStatement, idx));
+        break;
+      case SQLITE_BLOB:
+        row.AddBlob((const char*)sqlite3_column_blob(mStatement, idx),
+                    (size_t)sqlite3_column_bytes(mStatement, idx));
+        break;
+      default:
+        row.AddNull();
+        break;
+    }
+  }
+
+  return true;
+}
+
 bool DatabaseQuerySQLite3::IsValid() const {
   return nullptr != mDatabase && nullptr != mStatement &&
          (SQLITE_OK == mStatus || SQLITE_ROW == mStatus ||
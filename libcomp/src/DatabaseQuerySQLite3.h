@@ -31,10 +31,14 @@
 
 // libcomp Includes
 #include "DatabaseQuery.h"
+#include "DatabaseStatementCache.h"
 
 // sqlite3 Includes
 #include <sqlite3.h>
 
+// Standard C++11 Includes
+#include <memory>
+
 namespace libcomp {
 
 class DatabaseSQLite3;
@@ -52,9 +56,17 @@ class DatabaseQuerySQLite3 : public DatabaseQueryImpl {
    *  when access to the DB during query execution returns as busy
    * @param retryDelay Delay in milliseconds between execution retry
    *  attempts
+   * @param pCache Cache of prepared statements for the database (or null
+   *  to always prepare a new statement)
+   * @param connection Pooled connection to keep until the query is freed
+   *  (or null if the connection is not pooled)
+   * @param binaryUUIDs true to bind UUIDs as 16 byte blobs instead of text
    */
-  DatabaseQuerySQLite3(sqlite3* pDatabase, uint8_t maxRetryCount = 3,
-                       uint16_t retryDelay = 500);
+  DatabaseQuerySQLite3(
+      sqlite3* pDatabase, uint8_t maxRetryCount = 3, uint16_t retryDelay = 500,
+      DatabaseStatementCache<sqlite3_stmt*>* pCache = nullptr,
+      const std::shared_ptr<void>& connection = nullptr,
+      bool binaryUUIDs = false);
 
   /**
    * Clean up the query.
@@ -92,6 +104,8 @@ class DatabaseQuerySQLite3 : public DatabaseQueryImpl {
   virtual bool GetValue(const String& name, String& value);
   virtual bool GetValue(size_t index, std::vector<char>& value);
   virtual bool GetValue(const String& name, std::vector<char>& value);
+  virtual bool GetBlob(size_t index, const char*& data, size_t& size);
+  virtual bool GetBlob(const String& name, const char*& data, size_t& size);
   virtual bool GetValue(size_t index, libobjgen::UUID& value);
   virtual bool GetValue(const String& name, libobjgen::UUID& value);
   virtual bool GetValue(size_t index, int32_t& value);
@@ -106,6 +120,7 @@ class DatabaseQuerySQLite3 : public DatabaseQueryImpl {
   virtual bool GetValue(const String& name, bool& value);
   virtual bool GetRows(
       std::list<std::unordered_map<std::string, std::vector<char>>>& rows);
+  virtual bool CopyRow(DatabaseQueryRow& row);
 
   virtual bool IsValid() const;
 
@@ -117,6 +132,11 @@ class DatabaseQuerySQLite3 : public DatabaseQueryImpl {
   int GetStatus() const;
 
  private:
+  /**
+   * Return the statement to the cache or free it if it was not cached.
+   */
+  void ReleaseStatement();
+
   /**
    * Get the index of a named binding.
    * @param name Name of the binding
@@ -166,6 +186,21 @@ class DatabaseQuerySQLite3 : public DatabaseQueryImpl {
   /// Column data types from the current result set represented as SQLite3
   /// data type integers
   std::vector<int> mResultColumnTypes;
+
+  /// Cache the statement is returned to (or null)
+  DatabaseStatementCache<sqlite3_stmt*>* mCache;
+
+  /// SQL text the statement is cached under (empty if it is not cacheable)
+  String mCachedSQL;
+
+  /// Time it took to prepare the statement (microseconds)
+  uint64_t mPrepareTime;
+
+  /// Pooled connection the query runs on (released after the statement)
+  std::shared_ptr<void> mConnection;
+
+  /// Indicates UUIDs are bound as 16 byte blobs instead of text
+  bool mBinaryUUIDs;
 };
 
 }  // namespace libcomp
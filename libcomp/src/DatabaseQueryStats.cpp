@@ -0,0 +1,290 @@
+/**
+ * @file libcomp/src/DatabaseQueryStats.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Timing statistics of database queries by statement shape.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseQueryStats.h"
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "BaseLog.h"
+
+// Standard C++11 Includes
+#include <algorithm>
+#include <cctype>
+#include <list>
+
+using namespace libcomp;
+
+/// Most statement shapes tracked at once. Executions of any other shape
+/// are added to a single overflow entry.
+static const size_t MAX_QUERY_SHAPES = 1000;
+
+/// Shape used for the executions that do not fit in the shape table.
+static const char* OVERFLOW_SHAPE = "(other)";
+
+std::atomic<bool> DatabaseQueryStats::sEnabled(false);
+std::atomic<uint64_t> DatabaseQueryStats::sSlowQueryThreshold(0);
+std::unordered_map<std::string, DatabaseQueryShapeStats>
+    DatabaseQueryStats::sShapes;
+std::mutex DatabaseQueryStats::sLock;
+
+void DatabaseQueryStats::Configure(bool enabled, uint32_t slowQueryThreshold) {
+  sEnabled = enabled;
+  sSlowQueryThreshold = (uint64_t)slowQueryThreshold * 1000;
+}
+
+bool DatabaseQueryStats::IsEnabled() {
+  return sEnabled || 0 != sSlowQueryThreshold;
+}
+
+bool DatabaseQueryStats::CheckSlowQuery(
+    const String& sql, uint64_t time,
+    const std::vector<const char*>& bindTypes) {
+  uint64_t threshold = sSlowQueryThreshold;
+
+  if (0 == threshold || time < threshold) {
+    return false;
+  }
+
+  LogDatabaseWarning([&]() {
+    std::list<String> types;
+
+    for (auto type : bindTypes) {
+      types.push_back(type);
+    }
+
+    return String("Slow query (%1 ms) with parameters [%2]: %3\n")
+        .Arg((double)time / 1000.0)
+        .Arg(String::Join(types, ", "))
+        .Arg(sql);
+  });
+
+  return true;
+}
+
+void DatabaseQueryStats::Record(const String& sql,
+                                const DatabaseQueryShapeStats& stats) {
+  if (!sEnabled || 0 == stats.count) {
+    return;
+  }
+
+  std::string shape = NormalizeSQL(sql).ToUtf8();
+
+  std::lock_guard<std::mutex> lock(sLock);
+
+  auto it = sShapes.find(shape);
+
+  if (sShapes.end() == it) {
+    if (MAX_QUERY_SHAPES <= sShapes.size()) {
+      shape = OVERFLOW_SHAPE;
+    }
+
+    it = sShapes.find(shape);
+
+    if (sShapes.end() == it) {
+      it = sShapes.insert(std::make_pair(shape, DatabaseQueryShapeStats()))
+               .first;
+      it->second.shape = shape;
+    }
+  }
+
+  auto& total = it->second;
+  total.count += stats.count;
+  total.totalTime += stats.totalTime;
+  total.maxTime = std::max(total.maxTime, stats.maxTime);
+  total.rowsReturned += stats.rowsReturned;
+  total.rowsAffected += stats.rowsAffected;
+  total.slowCount += stats.slowCount;
+}
+
+std::vector<DatabaseQueryShapeStats> DatabaseQueryStats::GetTopShapes(
+    size_t count) {
+  std::vector<DatabaseQueryShapeStats> shapes;
+
+  {
+    std::lock_guard<std::mutex> lock(sLock);
+
+    shapes.reserve(sShapes.size());
+
+    for (auto& pair : sShapes) {
+      shapes.push_back(pair.second);
+    }
+  }
+
+  std::sort(shapes.begin(), shapes.end(),
+            [](const DatabaseQueryShapeStats& a,
+               const DatabaseQueryShapeStats& b) {
+              return a.totalTime > b.totalTime;
+            });
+
+  if (0 != count && shapes.size() > count) {
+    shapes.resize(count);
+  }
+
+  return shapes;
+}
+
+void DatabaseQueryStats::LogTopShapes(size_t count) {
+  auto shapes = GetTopShapes(count);
+
+  LogDatabaseInfo([&]() {
+    return String("Top %1 query shape%2 by total execution time:\n")
+        .Arg(shapes.size())
+        .Arg(shapes.size() != 1 ? "s" : "");
+  });
+
+  for (auto& stats : shapes) {
+    LogDatabaseInfo([&]() {
+      return String(
+                 "  %1 ms total, %2 executions, %3 ms average, %4 ms max, "
+                 "%5 rows returned, %6 rows affected, %7 slow: %8\n")
+          .Arg((double)stats.totalTime / 1000.0)
+          .Arg(stats.count)
+          .Arg(stats.AverageTime() / 1000.0)
+          .Arg((double)stats.maxTime / 1000.0)
+          .Arg(stats.rowsReturned)
+          .Arg(stats.rowsAffected)
+          .Arg(stats.slowCount)
+          .Arg(stats.shape);
+    });
+  }
+}
+
+void DatabaseQueryStats::Reset() {
+  std::lock_guard<std::mutex> lock(sLock);
+
+  sShapes.clear();
+}
+
+/**
+ * Check if a character may be part of an identifier or keyword.
+ * @param c Character to check
+ * @return true if the character may be part of an identifier
+ */
+static bool IsIdentifierChar(char c) {
+  return 0 != std::isalnum((unsigned char)c) || '_' == c;
+}
+
+/**
+ * Replace a repeated pattern with a single copy until it no longer appears.
+ * @param sql SQL to collapse the pattern in
+ * @param pattern Two copies of the pattern
+ * @param single One copy of the pattern
+ * @return true if anything was collapsed
+ */
+static bool CollapseRepeats(std::string& sql, const std::string& pattern,
+                            const std::string& single) {
+  bool changed = false;
+  size_t pos = 0;
+
+  while (std::string::npos != (pos = sql.find(pattern, pos))) {
+    sql.replace(pos, pattern.size(), single);
+    changed = true;
+  }
+
+  return changed;
+}
+
+String DatabaseQueryStats::NormalizeSQL(const String& sql) {
+  std::string in = sql.ToUtf8();
+  std::string out;
+  out.reserve(in.size());
+
+  bool space = false;
+
+  for (size_t i = 0; i < in.size(); ++i) {
+    char c = in[i];
+
+    if (0 != std::isspace((unsigned char)c)) {
+      space = true;
+      continue;
+    }
+
+    if (',' == c) {
+      out += ", ";
+      space = false;
+      continue;
+    }
+
+    if (space && !out.empty() && ' ' != out.back()) {
+      out += ' ';
+    }
+
+    space = false;
+
+    if ('\'' == c || '"' == c) {
+      // String literal (quotes are escaped by doubling them).
+      for (++i; i < in.size(); ++i) {
+        if (c == in[i]) {
+          if (i + 1 < in.size() && c == in[i + 1]) {
+            ++i;
+          } else {
+            break;
+          }
+        }
+      }
+
+      out += '?';
+    } else if (':' == c && i + 1 < in.size() && IsIdentifierChar(in[i + 1])) {
+      // Named parameter.
+      while (i + 1 < in.size() && IsIdentifierChar(in[i + 1])) {
+        ++i;
+      }
+
+      out += '?';
+    } else if (0 != std::isdigit((unsigned char)c) &&
+               (out.empty() ||
+                (!IsIdentifierChar(out.back()) && '`' != out.back()))) {
+      // Numeric literal.
+      while (i + 1 < in.size() &&
+             (IsIdentifierChar(in[i + 1]) || '.' == in[i + 1])) {
+        ++i;
+      }
+
+      out += '?';
+    } else {
+      out += c;
+    }
+  }
+
+  while (!out.empty() && ' ' == out.back()) {
+    out.pop_back();
+  }
+
+  // Collapse the parameter lists of batched statements.
+  bool changed = true;
+
+  while (changed) {
+    changed = CollapseRepeats(out, "?, ?", "?");
+    changed |= CollapseRepeats(out, "(?), (?)", "(?)");
+    changed |= CollapseRepeats(out, "WHEN ? THEN ? WHEN ? THEN ?",
+                               "WHEN ? THEN ?");
+  }
+
+  return out;
+}
+
+#endif  // !EXOTIC_PLATFORM
@@ -0,0 +1,170 @@
+/**
+ * @file libcomp/src/DatabaseQueryStats.h
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Timing statistics of database queries by statement shape.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCOMP_SRC_DATABASEQUERYSTATS_H
+#define LIBCOMP_SRC_DATABASEQUERYSTATS_H
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "CString.h"
+
+// Standard C++11 Includes
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace libcomp {
+
+/**
+ * Statistics of every query executed with the same statement shape.
+ */
+struct DatabaseQueryShapeStats {
+  DatabaseQueryShapeStats()
+      : count(0),
+        totalTime(0),
+        maxTime(0),
+        rowsReturned(0),
+        rowsAffected(0),
+        slowCount(0) {}
+
+  /**
+   * Get the average time taken to execute the statement.
+   * @return Average execution time in microseconds
+   */
+  double AverageTime() const {
+    return count ? ((double)totalTime / (double)count) : 0.0;
+  }
+
+  /// Normalized SQL of the statement
+  String shape;
+
+  /// Number of times the statement was executed
+  uint64_t count;
+
+  /// Sum of the time taken to execute the statement (microseconds)
+  uint64_t totalTime;
+
+  /// Longest time taken to execute the statement (microseconds)
+  uint64_t maxTime;
+
+  /// Number of rows read from the results
+  uint64_t rowsReturned;
+
+  /// Number of rows changed by the statement
+  uint64_t rowsAffected;
+
+  /// Number of executions that went over the slow query threshold
+  uint64_t slowCount;
+};
+
+/**
+ * Collects execution statistics of every @ref DatabaseQuery grouped by the
+ * shape of its SQL. Literals and bound parameters are replaced in the
+ * shape and repeated parameter lists (multi-row inserts, IN lists and
+ * batched CASE updates) are collapsed so a statement has one shape no
+ * matter how many rows it was built for. Executions that take longer than
+ * the slow query threshold are logged with the types of their parameters.
+ */
+class DatabaseQueryStats {
+ public:
+  /**
+   * Set which statistics are collected.
+   * @param enabled true to collect statistics by statement shape
+   * @param slowQueryThreshold Time in milliseconds after which an
+   *  execution is logged as slow (0 to disable the slow query log)
+   */
+  static void Configure(bool enabled, uint32_t slowQueryThreshold);
+
+  /**
+   * Check if queries should be timed for either the statistics or the
+   * slow query log.
+   * @return true if queries should be timed
+   */
+  static bool IsEnabled();
+
+  /**
+   * Log an execution of a query if it went over the slow query threshold.
+   * @param sql SQL the query was prepared with
+   * @param time Time taken to execute the query (microseconds)
+   * @param bindTypes Types of the parameters bound to the query
+   * @return true if the execution went over the slow query threshold
+   */
+  static bool CheckSlowQuery(const String& sql, uint64_t time,
+                             const std::vector<const char*>& bindTypes);
+
+  /**
+   * Add the statistics of a query to those of its statement shape.
+   * @param sql SQL the query was prepared with
+   * @param stats Statistics of the query
+   */
+  static void Record(const String& sql, const DatabaseQueryShapeStats& stats);
+
+  /**
+   * Get the statement shapes that took the most total execution time.
+   * @param count Maximum number of shapes to return (0 for every shape)
+   * @return Statement shapes sorted by total execution time
+   */
+  static std::vector<DatabaseQueryShapeStats> GetTopShapes(size_t count);
+
+  /**
+   * Log the statement shapes that took the most total execution time.
+   * @param count Maximum number of shapes to log
+   */
+  static void LogTopShapes(size_t count);
+
+  /**
+   * Clear every collected statistic.
+   */
+  static void Reset();
+
+  /**
+   * Get the shape of a SQL statement.
+   * @param sql SQL to normalize
+   * @return Normalized SQL
+   */
+  static String NormalizeSQL(const String& sql);
+
+ private:
+  /// Indicates statistics by statement shape are collected
+  static std::atomic<bool> sEnabled;
+
+  /// Time after which an execution is logged as slow (microseconds)
+  static std::atomic<uint64_t> sSlowQueryThreshold;
+
+  /// Statistics by statement shape
+  static std::unordered_map<std::string, DatabaseQueryShapeStats> sShapes;
+
+  /// Lock for the statistics by statement shape
+  static std::mutex sLock;
+};
+
+}  // namespace libcomp
+
+#endif  // !EXOTIC_PLATFORM
+
+#endif  // LIBCOMP_SRC_DATABASEQUERYSTATS_H
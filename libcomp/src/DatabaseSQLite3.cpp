@@ -44,36 +44,88 @@
 
 using namespace libcomp;
 
+/**
+ * SQL function that converts a text UUID to its 16 byte blob. Any other
+ * value is returned unchanged.
+ */
+static void UUIDToBlob(sqlite3_context* pContext, int argc,
+                       sqlite3_value** argv) {
+  (void)argc;
+
+  if (SQLITE_TEXT != sqlite3_value_type(argv[0])) {
+    sqlite3_result_value(pContext, argv[0]);
+
+    return;
+  }
+
+  auto pText = (const char*)sqlite3_value_text(argv[0]);
+  auto bytes = sqlite3_value_bytes(argv[0]);
+
+  auto data = libobjgen::UUID(std::string(pText, pText + bytes)).ToData();
+
+  sqlite3_result_blob(pContext, &data[0], (int)data.size(), SQLITE_TRANSIENT);
+}
+
+/**
+ * SQL function that converts a 16 byte blob UUID to its text. Any other
+ * value is returned unchanged.
+ */
+static void UUIDToText(sqlite3_context* pContext, int argc,
+                       sqlite3_value** argv) {
+  (void)argc;
+
+  if (SQLITE_BLOB != sqlite3_value_type(argv[0]) ||
+      16 != sqlite3_value_bytes(argv[0])) {
+    sqlite3_result_value(pContext, argv[0]);
+
+    return;
+  }
+
+  auto pData = (const char*)sqlite3_value_blob(argv[0]);
+
+  auto text = libobjgen::UUID(std::vector<char>(pData, pData + 16)).ToString();
+
+  sqlite3_result_text(pContext, text.c_str(), (int)text.size(),
+                      SQLITE_TRANSIENT);
+}
+
 DatabaseSQLite3::DatabaseSQLite3(
     const std::shared_ptr<objects::DatabaseConfigSQLite3>& config)
     : Database(std::dynamic_pointer_cast<objects::DatabaseConfig>(config)),
-      mDatabase(nullptr) {}
+      mDatabase(nullptr),
+      mStatementCache(new DatabaseStatementCache<sqlite3_stmt*>(
+          (size_t)config->GetStatementCacheSize(),
+          [](sqlite3_stmt*& pStatement) { sqlite3_finalize(pStatement); })),
+      mReadConnectionsEnabled(false) {}
 
 DatabaseSQLite3::~DatabaseSQLite3() { Close(); }
 
 bool DatabaseSQLite3::Open() {
   auto filepath = GetFilepath();
 
-  if (SQLITE_OK == sqlite3_open(filepath.C(), &mDatabase)) {
-    return true;
-  }
-
-  // On failure, try to create the parent directory and try again
-  auto last_separator = std::find_if(filepath.crbegin(), filepath.crend(),
-                                     Platform::IsPathSeparator);
-  if (last_separator != filepath.crend()) {
-    // Calculate the index of the path separator and try to create the directory
-    size_t last_separator_idx =
-        (size_t)std::distance(filepath.cbegin(), last_separator.base()) - 1;
-
-    if (Platform::CreateDirectory(filepath.Left(last_separator_idx))) {
-      // Try to open the database again
-      if (SQLITE_OK == sqlite3_open(filepath.C(), &mDatabase)) {
-        return true;
+  bool opened = SQLITE_OK == sqlite3_open(filepath.C(), &mDatabase);
+
+  if (!opened) {
+    // On failure, try to create the parent directory and try again
+    auto last_separator = std::find_if(filepath.crbegin(), filepath.crend(),
+                                       Platform::IsPathSeparator);
+    if (last_separator != filepath.crend()) {
+      // Calculate the index of the path separator and try to create the
+      // directory
+      size_t last_separator_idx =
+          (size_t)std::distance(filepath.cbegin(), last_separator.base()) - 1;
+
+      if (Platform::CreateDirectory(filepath.Left(last_separator_idx))) {
+        // Try to open the database again
+        opened = SQLITE_OK == sqlite3_open(filepath.C(), &mDatabase);
       }
     }
   }
 
+  if (opened && ConfigureConnection(mDatabase, true)) {
+    return true;
+  }
+
   LogDatabaseError([&]() {
     return String("Failed to open database connection: %1\n")
         .Arg(sqlite3_errmsg(mDatabase));
@@ -83,10 +135,120 @@ bool DatabaseSQLite3::Open() {
   return false;
 }
 
+bool DatabaseSQLite3::ConfigureConnection(sqlite3* pDatabase, bool writer) {
+  auto config =
+      std::dynamic_pointer_cast<objects::DatabaseConfigSQLite3>(mConfig);
+
+  std::list<String> pragmas;
+
+  if (0 != config->GetCacheSize()) {
+    // A negative size is the size of the cache in KiB instead of pages.
+    pragmas.push_back(
+        String("PRAGMA cache_size = -%1;").Arg(config->GetCacheSize()));
+  }
+
+  if (0 != config->GetMmapSize()) {
+    pragmas.push_back(String("PRAGMA mmap_size = %1;")
+                          .Arg((uint64_t)config->GetMmapSize() * 1024 * 1024));
+  }
+
+  for (auto& pragma : pragmas) {
+    if (SQLITE_OK != sqlite3_exec(pDatabase, pragma.C(), nullptr, nullptr,
+                                  nullptr)) {
+      LogDatabaseError([&]() {
+        return String("Failed to configure the database connection: %1\n")
+            .Arg(sqlite3_errmsg(pDatabase));
+      });
+
+      return false;
+    }
+  }
+
+  if (!writer || !config->GetWAL()) {
+    return true;
+  }
+
+  std::string mode;
+
+  if (SQLITE_OK !=
+      sqlite3_exec(
+          pDatabase, "PRAGMA journal_mode = WAL;",
+          [](void* pMode, int count, char** values, char**) {
+            if (0 < count && nullptr != values[0]) {
+              *static_cast<std::string*>(pMode) = values[0];
+            }
+
+            return 0;
+          },
+          &mode, nullptr)) {
+    LogDatabaseError([&]() {
+      return String("Failed to enable WAL mode: %1\n")
+          .Arg(sqlite3_errmsg(pDatabase));
+    });
+
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mReadConnectionLock);
+
+  // Read-only connections only see committed data without blocking the
+  // writer when the database is in WAL mode.
+  mReadConnectionsEnabled =
+      "wal" == String(mode).ToLower() && 0 < config->GetReadConnections();
+
+  if (!mReadConnectionsEnabled) {
+    LogDatabaseWarning([&]() {
+      return String(
+                 "Database is in %1 journal mode so reads will use the write "
+                 "connection.\n")
+          .Arg(mode);
+    });
+  }
+
+  return true;
+}
+
 bool DatabaseSQLite3::Close() {
   bool result = true;
 
   if (nullptr != mDatabase) {
+    // Write anything still deferred before the connection goes away.
+    if (!FlushDeferredUpdates()) {
+      result = false;
+    }
+
+    auto stats = mStatementCache->GetStats();
+
+    if (0 < (stats.hits + stats.misses)) {
+      LogDatabaseDebug([&]() {
+        return String(
+                   "Statement cache: %1 hits, %2 misses (%3% hit rate), %4 "
+                   "evictions, %5 us of prepare time saved\n")
+            .Arg(stats.hits)
+            .Arg(stats.misses)
+            .Arg(stats.HitRate() * 100.0)
+            .Arg(stats.evictions)
+            .Arg(stats.prepareTimeSaved);
+      });
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mReadConnectionLock);
+
+      mReadConnectionsEnabled = false;
+
+      // Connections still in use are closed when they are released.
+      for (auto pConnection : mIdleReadConnections) {
+        mReadConnections.remove(pConnection);
+        CloseReadConnection(pConnection);
+      }
+
+      mIdleReadConnections.clear();
+    }
+
+    // Cached statements must be freed before the connection can close.
+    mStatementCache->Clear();
+
     if (SQLITE_OK != sqlite3_close(mDatabase)) {
       result = false;
 
@@ -106,11 +268,137 @@ DatabaseQuery DatabaseSQLite3::Prepare(const String& query) {
       std::dynamic_pointer_cast<objects::DatabaseConfigSQLite3>(mConfig);
   return DatabaseQuery(
       new DatabaseQuerySQLite3(mDatabase, config->GetMaxRetryCount(),
-                               config->GetRetryDelay()),
+                               config->GetRetryDelay(), mStatementCache.get(),
+                               nullptr, config->GetBinaryUUIDs()),
+      query);
+}
+
+DatabaseQuery DatabaseSQLite3::PrepareRead(const String& query) {
+  auto connection = AcquireReadConnection();
+
+  if (nullptr == connection) {
+    return Prepare(query);
+  }
+
+  auto config =
+      std::dynamic_pointer_cast<objects::DatabaseConfigSQLite3>(mConfig);
+  return DatabaseQuery(
+      new DatabaseQuerySQLite3(
+          connection->database, config->GetMaxRetryCount(),
+          config->GetRetryDelay(), connection->statementCache.get(),
+          connection, config->GetBinaryUUIDs()),
       query);
 }
 
+std::shared_ptr<DatabaseSQLite3::ReadConnection>
+DatabaseSQLite3::AcquireReadConnection() {
+  auto config =
+      std::dynamic_pointer_cast<objects::DatabaseConfigSQLite3>(mConfig);
+
+  ReadConnection* pConnection = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(mReadConnectionLock);
+
+    if (!mReadConnectionsEnabled) {
+      return nullptr;
+    }
+
+    if (!mIdleReadConnections.empty()) {
+      pConnection = mIdleReadConnections.front();
+      mIdleReadConnections.pop_front();
+    } else if (mReadConnections.size() <
+               (size_t)config->GetReadConnections()) {
+      sqlite3* pDatabase = nullptr;
+
+      if (SQLITE_OK != sqlite3_open_v2(GetFilepath().C(), &pDatabase,
+                                       SQLITE_OPEN_READONLY |
+                                           SQLITE_OPEN_NOMUTEX,
+                                       nullptr) ||
+          !ConfigureConnection(pDatabase, false)) {
+        LogDatabaseError([&]() {
+          return String("Failed to open read-only database connection: %1\n")
+              .Arg(sqlite3_errmsg(pDatabase));
+        });
+
+        sqlite3_close(pDatabase);
+
+        return nullptr;
+      }
+
+      pConnection = new ReadConnection;
+      pConnection->database = pDatabase;
+      pConnection->statementCache.reset(
+          new DatabaseStatementCache<sqlite3_stmt*>(
+              (size_t)config->GetStatementCacheSize(),
+              [](sqlite3_stmt*& pStatement) {
+                sqlite3_finalize(pStatement);
+              }));
+
+      mReadConnections.push_back(pConnection);
+    } else {
+      // Every read-only connection is busy (possibly with a query this
+      // thread is still reading) so use the write connection instead of
+      // waiting.
+      return nullptr;
+    }
+  }
+
+  return std::shared_ptr<ReadConnection>(
+      pConnection,
+      [this](ReadConnection* pReleased) { ReleaseReadConnection(pReleased); });
+}
+
+void DatabaseSQLite3::ReleaseReadConnection(ReadConnection* pConnection) {
+  std::lock_guard<std::mutex> lock(mReadConnectionLock);
+
+  if (mReadConnectionsEnabled) {
+    mIdleReadConnections.push_front(pConnection);
+  } else {
+    mReadConnections.remove(pConnection);
+    CloseReadConnection(pConnection);
+  }
+}
+
+void DatabaseSQLite3::CloseReadConnection(ReadConnection* pConnection) {
+  // Cached statements must be freed before the connection can close.
+  pConnection->statementCache->Clear();
+
+  if (SQLITE_OK != sqlite3_close(pConnection->database)) {
+    LogDatabaseErrorMsg("Failed to close read-only database connection.\n");
+  }
+
+  delete pConnection;
+}
+
+DatabaseStatementCacheStats DatabaseSQLite3::GetStatementCacheStats() {
+  auto stats = mStatementCache->GetStats();
+
+  std::lock_guard<std::mutex> lock(mReadConnectionLock);
+
+  for (auto pConnection : mReadConnections) {
+    stats.Add(pConnection->statementCache->GetStats());
+  }
+
+  return stats;
+}
+
+size_t DatabaseSQLite3::GetMaxBindCount() const {
+  if (nullptr == mDatabase) {
+    return Database::GetMaxBindCount();
+  }
+
+  return (size_t)sqlite3_limit(mDatabase, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+}
+
+size_t DatabaseSQLite3::GetFirstBindIndex() const { return 1; }
+
 bool DatabaseSQLite3::Exists() {
+  // An in-memory database only exists while its connection is open.
+  if (IsInMemory()) {
+    return IsOpen();
+  }
+
   auto filepath = GetFilepath();
 
   // Check if the database file exists
@@ -268,78 +556,7 @@ bool DatabaseSQLite3::TableHasRows(const String& table) {
 
 std::list<std::shared_ptr<PersistentObject>> DatabaseSQLite3::LoadObjects(
     size_t typeHash, DatabaseBind* pValue) {
-  std::list<std::shared_ptr<PersistentObject>> objects;
-
-  auto metaObject = PersistentObject::GetRegisteredMetadata(typeHash);
-
-  if (nullptr == metaObject) {
-    LogDatabaseErrorMsg("Failed to lookup MetaObject.\n");
-
-    return {};
-  }
-
-  String sql =
-      String("SELECT * FROM %1%2")
-          .Arg(metaObject->GetName())
-          .Arg((nullptr != pValue
-                    ? String(" WHERE %1 = :%1").Arg(pValue->GetColumn())
-                    : ""));
-
-  DatabaseQuery query = Prepare(sql);
-
-  if (!query.IsValid()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to prepare SQL query: %1\n").Arg(sql); });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return {};
-  }
-
-  if (nullptr != pValue && !pValue->Bind(query)) {
-    LogDatabaseError([&]() {
-      return String("Failed to bind value: %1\n").Arg(pValue->GetColumn());
-    });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return {};
-  }
-
-  if (!query.Execute()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return {};
-  }
-
-  int failures = 0;
-
-  while (query.Next()) {
-    auto obj = LoadSingleObjectFromRow(typeHash, query);
-
-    if (nullptr != obj) {
-      objects.push_back(obj);
-    } else {
-      failures++;
-    }
-  }
-
-  if (failures > 0) {
-    LogDatabaseError([&]() {
-      return String("%1 '%2' row%3 failed to load.\n")
-          .Arg(failures)
-          .Arg(metaObject->GetName())
-          .Arg(failures != 1 ? "s" : "");
-    });
-  }
-
-  return objects;
+  return LoadObjectsParallel(typeHash, pValue);
 }
 
 bool DatabaseSQLite3::InsertSingleObject(
@@ -523,8 +740,12 @@ bool DatabaseSQLite3::DeleteObjects(
 
       obj->Unregister();
 
-      std::string uuidStr = obj->GetUUID().ToString();
-      uidBindings.push_back(String("'%1'").Arg(uuidStr));
+      String uuidStr = obj->GetUUID().ToString();
+      if (mConfig->GetBinaryUUIDs()) {
+        uidBindings.push_back(String("X'%1'").Arg(uuidStr.Replace("-", "")));
+      } else {
+        uidBindings.push_back(String("'%1'").Arg(uuidStr));
+      }
     }
 
     if (!Execute(String("DELETE FROM %1 WHERE UID in (%2);")
@@ -587,8 +808,9 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
         String colName;
         String dataType;
 
+        // Some versions of SQLite report the declared type in upper case.
         if (sq.GetValue("name", colName) && sq.GetValue("type", dataType)) {
-          m[colName.ToUtf8()] = dataType;
+          m[colName.ToUtf8()] = dataType.ToLower();
         }
       } while (sq.Next());
     } else if (type == "index") {
@@ -623,7 +845,9 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
     bool creating = false;
     bool recreating = false;
     bool updating = false;
+    bool migrating = false;
     std::set<std::string> needsIndex;
+    std::set<std::string> uuidColumns;
     auto tableIter = fieldMap.find(objName);
     if (tableIter == fieldMap.end()) {
       creating = true;
@@ -632,6 +856,12 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
 
       std::unordered_map<std::string, String> columns = tableIter->second;
 
+      // UUID columns stored as the other type are converted instead of
+      // recreating the table.
+      if (columns["UID"] != GetUUIDType()) {
+        uuidColumns.insert("UID");
+      }
+
       auto indexes = indexedFields[objName];
       columns.erase("UID");
       for (auto var : vars) {
@@ -641,7 +871,12 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
         if (columns.find(name) == columns.end()) {
           updating = true;
         } else if (columns[name] != type) {
-          recreating = true;
+          if (var->GetMetaType() ==
+              libobjgen::MetaVariable::MetaVariableType_t::TYPE_REF) {
+            uuidColumns.insert(name);
+          } else {
+            recreating = true;
+          }
         }
 
         auto indexName = String("idx_%1_%2").Arg(objName).Arg(name).ToUtf8();
@@ -651,6 +886,23 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
       }
     }
 
+    if (!recreating && !uuidColumns.empty()) {
+      LogDatabaseInfo([&]() {
+        return String("Converting UUID columns of table '%1'...\n")
+            .Arg(metaObject.GetName());
+      });
+
+      if (MigrateUUIDColumns(objName, uuidColumns)) {
+        LogDatabaseInfoMsg("Conversion complete\n");
+      } else {
+        LogDatabaseErrorMsg("Conversion failed\n");
+
+        return false;
+      }
+
+      migrating = true;
+    }
+
     if (recreating) {
       if (mConfig->GetAutoSchemaUpdate()) {
         LogDatabaseInfo([&]() {
@@ -686,8 +938,8 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
       bool success = false;
 
       std::stringstream ss;
-      ss << "CREATE TABLE IF NOT EXISTS " << objName
-         << " (UID string PRIMARY KEY";
+      ss << "CREATE TABLE IF NOT EXISTS " << objName << " (UID "
+         << GetUUIDType() << " PRIMARY KEY";
       for (size_t i = 0; i < vars.size(); i++) {
         auto var = vars[i];
         String type = GetVariableType(var);
@@ -774,12 +1026,12 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
     }
 
     // If we made the table or are missing an index, make them now
-    if (needsIndex.size() > 0 || creating) {
+    if (needsIndex.size() > 0 || creating || migrating) {
       for (size_t i = 0; i < vars.size(); i++) {
         auto var = vars[i];
 
         if (!var->IsLookupKey() ||
-            (!creating &&
+            (!creating && !migrating &&
              needsIndex.find(var->GetName()) == needsIndex.end())) {
           continue;
         }
@@ -806,7 +1058,8 @@ bool DatabaseSQLite3::VerifyAndSetupSchema(bool recreateTables) {
       }
     }
 
-    if (!creating && !recreating && !updating && needsIndex.size() == 0) {
+    if (!creating && !recreating && !updating && !migrating &&
+        needsIndex.size() == 0) {
       LogDatabaseInfo([&]() {
         return String("'%1': Verified\n").Arg(metaObject.GetName());
       });
@@ -827,27 +1080,7 @@ bool DatabaseSQLite3::ProcessStandardChangeSet(
     return false;
   }
 
-  bool result = true;
-  for (auto obj : changes->GetInserts()) {
-    if (!InsertSingleObject(obj)) {
-      result = false;
-      break;
-    }
-  }
-
-  if (result) {
-    for (auto obj : changes->GetUpdates()) {
-      if (!UpdateSingleObject(obj)) {
-        result = false;
-        break;
-      }
-    }
-  }
-
-  auto deletes = changes->GetDeletes();
-  if (result && deletes.size()) {
-    result = DeleteObjects(deletes);
-  }
+  bool result = WriteChangeSet(changes);
 
   if (result) {
     if (!Prepare(libcomp::String("COMMIT TRANSACTION %1").Arg(transactionID))
@@ -867,6 +1100,34 @@ bool DatabaseSQLite3::ProcessStandardChangeSet(
   return result;
 }
 
+std::list<libobjgen::UUID> DatabaseSQLite3::ProcessStandardChangeSets(
+    const std::list<std::shared_ptr<DBStandardChangeSet>>& changes) {
+  auto dirtyFields = GetDirtyFields(changes);
+
+  libcomp::String transactionID = libcomp::String("_%1").Arg(
+      libcomp::String(libobjgen::UUID::Random().ToString()).Replace("-", "_"));
+  if (!Prepare(libcomp::String("BEGIN TRANSACTION %1").Arg(transactionID))
+           .Execute()) {
+    return FallbackChangeSets(changes, dirtyFields);
+  }
+
+  std::list<libobjgen::UUID> failures;
+
+  if (WriteChangeSetsWithSavepoints(changes, failures) &&
+      Prepare(libcomp::String("COMMIT TRANSACTION %1").Arg(transactionID))
+          .Execute()) {
+    return failures;
+  }
+
+  if (!Prepare(libcomp::String("ROLLBACK TRANSACTION %1").Arg(transactionID))
+           .Execute()) {
+    // If this happens the server may need to be shut down
+    LogDatabaseCriticalMsg("Rollback failed!\n");
+  }
+
+  return FallbackChangeSets(changes, dirtyFields);
+}
+
 bool DatabaseSQLite3::ProcessOperationalChangeSet(
     const std::shared_ptr<DBOperationalChangeSet>& changes) {
   libcomp::String transactionID = libcomp::String("_%1").Arg(
@@ -878,8 +1139,22 @@ bool DatabaseSQLite3::ProcessOperationalChangeSet(
 
   bool result = true;
   std::set<std::shared_ptr<libcomp::PersistentObject>> objs;
+  std::list<std::shared_ptr<DBExplicitUpdate>> explicitUpdates;
   for (auto op : changes->GetOperations()) {
     auto obj = op->GetRecord();
+
+    // Run the explicit updates collected so far together before any other
+    // kind of operation.
+    if (op->GetType() != DBOperationalChange::DBOperationType::DBOP_EXPLICIT &&
+        !explicitUpdates.empty()) {
+      result = ProcessExplicitUpdates(explicitUpdates);
+      explicitUpdates.clear();
+
+      if (!result) {
+        break;
+      }
+    }
+
     switch (op->GetType()) {
       case DBOperationalChange::DBOperationType::DBOP_INSERT:
         result &= InsertSingleObject(obj);
@@ -892,7 +1167,7 @@ bool DatabaseSQLite3::ProcessOperationalChangeSet(
         break;
       case DBOperationalChange::DBOperationType::DBOP_EXPLICIT:
         objs.insert(obj);
-        result &= ProcessExplicitUpdate(
+        explicitUpdates.push_back(
             std::dynamic_pointer_cast<DBExplicitUpdate>(op));
         break;
     }
@@ -902,6 +1177,10 @@ bool DatabaseSQLite3::ProcessOperationalChangeSet(
     }
   }
 
+  if (result && !explicitUpdates.empty()) {
+    result = ProcessExplicitUpdates(explicitUpdates);
+  }
+
   if (result) {
     if (!Prepare(libcomp::String("COMMIT TRANSACTION %1").Arg(transactionID))
              .Execute()) {
@@ -924,6 +1203,7 @@ bool DatabaseSQLite3::ProcessOperationalChangeSet(
                               libcomp::PersistentObject::GetTypeHashByName(
                                   obj->GetObjectMetadata()->GetName(), result),
                               bind);
+      delete bind;
 
       if (!result) {
         break;
@@ -934,104 +1214,17 @@ bool DatabaseSQLite3::ProcessOperationalChangeSet(
   return result;
 }
 
-bool DatabaseSQLite3::ProcessExplicitUpdate(
-    const std::shared_ptr<DBExplicitUpdate>& update) {
-  auto obj = update->GetRecord();
-  auto expectedVals = update->GetExpectedValues();
-  auto changedVals = update->GetChanges();
-  if (changedVals.size() == 0) {
-    return false;
-  }
-
-  size_t idx = 1;
-  std::list<String> updateClause;
-  std::list<String> whereClause;
-  // Bind the update clause values
-  for (auto cPair : changedVals) {
-    auto it = expectedVals.find(cPair.first);
-    if (it == expectedVals.end()) {
-      return false;
-    }
-
-    updateClause.push_back(String("%1 = ?%2").Arg(cPair.first).Arg(idx++));
-  }
-
-  auto uidIdx = idx++;
-
-  // Now bind the where clause values
-  for (auto cPair : changedVals) {
-    whereClause.push_back(String("%1 = ?%2").Arg(cPair.first).Arg(idx++));
-  }
-
-  String sql = String("UPDATE `%1` SET %2 WHERE `UID` = :%3 AND %4;")
-                   .Arg(obj->GetObjectMetadata()->GetName())
-                   .Arg(String::Join(updateClause, ", "))
-                   .Arg(uidIdx)
-                   .Arg(String::Join(whereClause, " AND "));
-
-  DatabaseQuery query = Prepare(sql);
-
-  if (!query.IsValid()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to prepare SQL query: %1\n").Arg(sql); });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return false;
-  }
-
-  idx = 1;
-  for (auto cPair : changedVals) {
-    if (!cPair.second->Bind(query, idx++)) {
-      LogDatabaseError([&]() {
-        return String("Failed to bind value: %1\n").Arg(cPair.first);
-      });
-
-      LogDatabaseError(
-          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-      return false;
-    }
-  }
-
-  if (!query.Bind(idx++, obj->GetUUID())) {
-    LogDatabaseErrorMsg("Failed to bind value: UID\n");
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return false;
-  }
-
-  for (auto cPair : changedVals) {
-    if (!expectedVals[cPair.first]->Bind(query, idx++)) {
-      LogDatabaseError([&]() {
-        return String("Failed to bind where clause for value: %1\n")
-            .Arg(cPair.first);
-      });
-
-      LogDatabaseError(
-          [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-      return false;
-    }
-  }
-
-  if (!query.Execute()) {
-    LogDatabaseError(
-        [&]() { return String("Failed to execute query: %1\n").Arg(sql); });
-
-    LogDatabaseError(
-        [&]() { return String("Database said: %1\n").Arg(GetLastError()); });
-
-    return false;
-  }
-
-  return query.AffectedRowCount() == 1;
+bool DatabaseSQLite3::IsInMemory() const {
+  return ":memory:" ==
+         std::dynamic_pointer_cast<objects::DatabaseConfigSQLite3>(mConfig)
+             ->GetDatabaseName();
 }
 
 String DatabaseSQLite3::GetFilepath() const {
+  if (IsInMemory()) {
+    return ":memory:";
+  }
+
   auto config =
       std::dynamic_pointer_cast<objects::DatabaseConfigSQLite3>(mConfig);
   auto directory = config->GetFileDirectory();
@@ -1047,8 +1240,9 @@ String DatabaseSQLite3::GetVariableType(
     const std::shared_ptr<libobjgen::MetaVariable> var) {
   switch (var->GetMetaType()) {
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_STRING:
-    case libobjgen::MetaVariable::MetaVariableType_t::TYPE_REF:
       return "string";
+    case libobjgen::MetaVariable::MetaVariableType_t::TYPE_REF:
+      return GetUUIDType();
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_BOOL:
       return "bit";
     case libobjgen::MetaVariable::MetaVariableType_t::TYPE_S8:
@@ -1077,6 +1271,98 @@ String DatabaseSQLite3::GetVariableType(
   return "blob";
 }
 
+String DatabaseSQLite3::GetUUIDType() const {
+  return mConfig->GetBinaryUUIDs() ? "blob(16)" : "string";
+}
+
+bool DatabaseSQLite3::MigrateUUIDColumns(
+    const String& table, const std::set<std::string>& uuidColumns) {
+  bool binary = mConfig->GetBinaryUUIDs();
+  String function = binary ? "comp_uuid_blob" : "comp_uuid_text";
+
+  if (SQLITE_OK != sqlite3_create_function(mDatabase, function.C(), 1,
+                                           SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                           nullptr,
+                                           binary ? UUIDToBlob : UUIDToText,
+                                           nullptr, nullptr)) {
+    LogDatabaseError([&]() {
+      return String("Failed to register UUID conversion function: %1\n")
+          .Arg(sqlite3_errmsg(mDatabase));
+    });
+
+    return false;
+  }
+
+  std::list<String> definitions;
+  std::list<String> names;
+  std::list<String> values;
+
+  // Keep the existing column order and types other than the UUIDs.
+  {
+    DatabaseQuery q = Prepare(String("PRAGMA table_info('%1');").Arg(table));
+    if (!q.Execute()) {
+      LogDatabaseError([&]() {
+        return String("Failed to query for '%1' columns.\n").Arg(table);
+      });
+
+      return false;
+    }
+
+    while (q.Next()) {
+      String name;
+      String type;
+
+      if (!q.GetValue("name", name) || !q.GetValue("type", type)) {
+        return false;
+      }
+
+      bool convert = uuidColumns.find(name.ToUtf8()) != uuidColumns.end();
+
+      definitions.push_back(String("%1 %2%3")
+                                .Arg(name)
+                                .Arg(convert ? GetUUIDType() : type)
+                                .Arg(name == "UID" ? " PRIMARY KEY" : ""));
+      names.push_back(name);
+      values.push_back(convert ? String("%1(%2)").Arg(function).Arg(name)
+                               : name);
+    }
+  }
+
+  String oldTable = String("%1_uuid_migration").Arg(table);
+
+  std::list<String> statements = {
+      String("ALTER TABLE %1 RENAME TO %2;").Arg(table).Arg(oldTable),
+      String("CREATE TABLE %1 (%2);")
+          .Arg(table)
+          .Arg(String::Join(definitions, ", ")),
+      String("INSERT INTO %1 (%2) SELECT %3 FROM %4;")
+          .Arg(table)
+          .Arg(String::Join(names, ", "))
+          .Arg(String::Join(values, ", "))
+          .Arg(oldTable),
+      String("DROP TABLE %1;").Arg(oldTable),
+  };
+
+  if (!Execute("BEGIN TRANSACTION;")) {
+    return false;
+  }
+
+  for (auto& statement : statements) {
+    if (!Execute(statement)) {
+      LogDatabaseError([&]() {
+        return String("Failed to convert UUID columns: %1\n")
+            .Arg(sqlite3_errmsg(mDatabase));
+      });
+
+      Execute("ROLLBACK TRANSACTION;");
+
+      return false;
+    }
+  }
+
+  return Execute("COMMIT TRANSACTION;");
+}
+
 bool DatabaseSQLite3::TableExists(const libcomp::String& table) {
   String name;
 
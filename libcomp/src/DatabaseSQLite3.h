@@ -36,7 +36,12 @@
 // libobjgen Includes
 #include <MetaVariable.h>
 
+// Standard C++11 Includes
+#include <mutex>
+#include <set>
+
 typedef struct sqlite3 sqlite3;
+typedef struct sqlite3_stmt sqlite3_stmt;
 
 namespace libcomp {
 
@@ -73,6 +78,15 @@ class DatabaseSQLite3 : public Database {
 
   virtual DatabaseQuery Prepare(const String& query);
 
+  /**
+   * Prepare a query that only reads from the database. In WAL mode the
+   * query runs on one of the read-only connections if one is free and on
+   * the write connection otherwise.
+   * @param query Query text to prepare
+   * @return Prepared query
+   */
+  virtual DatabaseQuery PrepareRead(const String& query);
+
   /**
    * Check if the database file exists.
    * @return true if it exists, false if it does not
@@ -102,6 +116,8 @@ class DatabaseSQLite3 : public Database {
 
   virtual bool TableExists(const libcomp::String& table);
 
+  virtual DatabaseStatementCacheStats GetStatementCacheStats();
+
   /**
    * Verify/create any missing tables based off of @ref PersistentObject
    * types used by the database as well as any utility tables needed.  Tables
@@ -118,21 +134,67 @@ class DatabaseSQLite3 : public Database {
  protected:
   virtual bool ProcessStandardChangeSet(
       const std::shared_ptr<DBStandardChangeSet>& changes);
+  virtual std::list<libobjgen::UUID> ProcessStandardChangeSets(
+      const std::list<std::shared_ptr<DBStandardChangeSet>>& changes);
   virtual bool ProcessOperationalChangeSet(
       const std::shared_ptr<DBOperationalChangeSet>& changes);
 
+  virtual size_t GetMaxBindCount() const;
+  virtual size_t GetFirstBindIndex() const;
+
  private:
   /**
-   * Process and explicit update to a single record, checking each column's
-   * state before and verifying it set to the expected value afterwards.
-   * @param update Pointer to the explicit update
-   * @return true if the the updated succeeded, false if it did not
+   * Read-only connection used in WAL mode.
+   */
+  struct ReadConnection {
+    /// SQLite3 connection to the database file
+    sqlite3* database;
+
+    /// Prepared statements cached for the connection
+    std::unique_ptr<DatabaseStatementCache<sqlite3_stmt*>> statementCache;
+  };
+
+  /**
+   * Apply the page cache and memory map settings to a connection and
+   * switch the write connection to WAL mode if it is configured.
+   * @param pDatabase Connection to configure
+   * @param writer true if this is the write connection
+   * @return true on success, false on failure
+   */
+  bool ConfigureConnection(sqlite3* pDatabase, bool writer);
+
+  /**
+   * Take a free read-only connection, opening a new one if the pool is
+   * not full yet.
+   * @return Connection that returns to the pool when released or null if
+   *  no read-only connection is available
+   */
+  std::shared_ptr<ReadConnection> AcquireReadConnection();
+
+  /**
+   * Return a read-only connection to the pool or close it if the database
+   * has been closed.
+   * @param pConnection Connection to return
    */
-  bool ProcessExplicitUpdate(const std::shared_ptr<DBExplicitUpdate>& update);
+  void ReleaseReadConnection(ReadConnection* pConnection);
+
+  /**
+   * Close a read-only connection.
+   * @param pConnection Connection to close
+   */
+  void CloseReadConnection(ReadConnection* pConnection);
+
+  /**
+   * Check if the database is kept in memory instead of a file. This is the
+   * case when the database name is ":memory:".
+   * @return true if the database is in memory
+   */
+  bool IsInMemory() const;
 
   /**
    * Get the path to the database file to use.
-   * @return Path to the database file to use
+   * @return Path to the database file to use (":memory:" for an in-memory
+   *  database)
    */
   String GetFilepath() const;
 
@@ -143,8 +205,41 @@ class DatabaseSQLite3 : public Database {
    */
   String GetVariableType(const std::shared_ptr<libobjgen::MetaVariable> var);
 
+  /**
+   * Get the SQLite3 type of UID and reference columns.
+   * @return Data type string of UUID columns
+   */
+  String GetUUIDType() const;
+
+  /**
+   * Rebuild a table to convert its UUID columns between text and 16 byte
+   * blobs to match the configured UUID storage. Indexes of the table are
+   * dropped and must be created again.
+   * @param table Name of the table to rebuild
+   * @param uuidColumns UUID columns to convert
+   * @return true if the table was converted, false otherwise
+   */
+  bool MigrateUUIDColumns(const String& table,
+                          const std::set<std::string>& uuidColumns);
+
   /// Pointer to the SQLite3 representation of the database file connection
   sqlite3* mDatabase;
+
+  /// Prepared statements cached for the connection
+  std::unique_ptr<DatabaseStatementCache<sqlite3_stmt*>> mStatementCache;
+
+  /// Every open read-only connection
+  std::list<ReadConnection*> mReadConnections;
+
+  /// Read-only connections not in use (most recently used first)
+  std::list<ReadConnection*> mIdleReadConnections;
+
+  /// Indicates the database is in WAL mode and read-only connections may
+  /// be used
+  bool mReadConnectionsEnabled;
+
+  /// Lock for the read-only connections
+  std::mutex mReadConnectionLock;
 };
 
 }  // namespace libcomp
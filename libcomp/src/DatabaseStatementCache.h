@@ -0,0 +1,267 @@
+/**
+ * @file libcomp/src/DatabaseStatementCache.h
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Bounded LRU cache of prepared database statements.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCOMP_SRC_DATABASESTATEMENTCACHE_H
+#define LIBCOMP_SRC_DATABASESTATEMENTCACHE_H
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "CString.h"
+
+// Standard C++11 Includes
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace libcomp {
+
+/**
+ * Statistics of one or more @ref DatabaseStatementCache instances.
+ */
+struct DatabaseStatementCacheStats {
+  DatabaseStatementCacheStats()
+      : hits(0), misses(0), evictions(0), prepareTimeSaved(0), size(0) {}
+
+  /**
+   * Get the fraction of cacheable statements that were found in the cache.
+   * @return Hit rate from 0 to 1.
+   */
+  double HitRate() const {
+    return (hits + misses) ? ((double)hits / (double)(hits + misses)) : 0.0;
+  }
+
+  /**
+   * Add the statistics of another cache to these.
+   * @param other Statistics to add.
+   */
+  void Add(const DatabaseStatementCacheStats& other) {
+    hits += other.hits;
+    misses += other.misses;
+    evictions += other.evictions;
+    prepareTimeSaved += other.prepareTimeSaved;
+    size += other.size;
+  }
+
+  /// Number of statements taken from the cache
+  uint64_t hits;
+
+  /// Number of cacheable statements that had to be prepared
+  uint64_t misses;
+
+  /// Number of statements finalized to make room in the cache
+  uint64_t evictions;
+
+  /// Time the cache hits would have spent preparing (microseconds)
+  uint64_t prepareTimeSaved;
+
+  /// Number of statements currently in the cache
+  uint64_t size;
+};
+
+/**
+ * Bounded least recently used cache of prepared statements for a single
+ * database connection keyed by the SQL text. A statement is taken out of
+ * the cache while a query uses it and returned (after being reset) when
+ * the query is done with it so the same statement is never used by two
+ * queries at once.
+ * @tparam T Database specific prepared statement type.
+ */
+template <typename T>
+class DatabaseStatementCache {
+ public:
+  /**
+   * Function that frees a statement that will not be used again.
+   */
+  typedef std::function<void(T&)> Finalizer_t;
+
+  /**
+   * Create the cache.
+   * @param capacity Maximum number of statements to keep (0 disables the
+   *  cache).
+   * @param finalize Function to free statements that are evicted.
+   */
+  DatabaseStatementCache(size_t capacity, const Finalizer_t& finalize)
+      : mCapacity(capacity), mFinalize(finalize) {}
+
+  /**
+   * Free every cached statement.
+   */
+  ~DatabaseStatementCache() { Clear(); }
+
+  /**
+   * Check if a statement should be cached. Only data manipulation
+   * statements are cached since schema and transaction statements are
+   * rarely repeated with the same text.
+   * @param sql SQL text of the statement.
+   * @return true if the statement may be cached.
+   */
+  bool IsCacheable(const String& sql) const {
+    if (0 == mCapacity) {
+      return false;
+    }
+
+    auto verb = sql.LeftTrimmed().Left(7).ToUpper();
+    auto verb6 = verb.Left(6);
+
+    return "SELECT" == verb6 || "INSERT" == verb6 || "UPDATE" == verb6 ||
+           "DELETE" == verb6 || "REPLACE" == verb;
+  }
+
+  /**
+   * Take a statement out of the cache.
+   * @param sql SQL text of the statement.
+   * @param statement Output statement if one was cached.
+   * @param prepareTime Output time it took to prepare the statement.
+   * @return true if the statement was in the cache.
+   */
+  bool Take(const String& sql, T& statement, uint64_t& prepareTime) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto it = mIndex.find(sql.ToUtf8());
+
+    if (mIndex.end() == it) {
+      mStats.misses++;
+
+      return false;
+    }
+
+    statement = it->second->statement;
+    prepareTime = it->second->prepareTime;
+
+    mEntries.erase(it->second);
+    mIndex.erase(it);
+
+    mStats.hits++;
+    mStats.prepareTimeSaved += prepareTime;
+
+    return true;
+  }
+
+  /**
+   * Put a statement back in the cache once it has been reset. If the
+   * cache already has a statement for the SQL or the cache is disabled the
+   * statement is freed instead.
+   * @param sql SQL text of the statement.
+   * @param statement Statement to return.
+   * @param prepareTime Time it took to prepare the statement.
+   */
+  void Return(const String& sql, T statement, uint64_t prepareTime) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto key = sql.ToUtf8();
+
+    if (0 == mCapacity || mIndex.end() != mIndex.find(key)) {
+      mFinalize(statement);
+
+      return;
+    }
+
+    while (mEntries.size() >= mCapacity) {
+      auto& oldest = mEntries.back();
+
+      mFinalize(oldest.statement);
+      mIndex.erase(oldest.sql);
+      mEntries.pop_back();
+
+      mStats.evictions++;
+    }
+
+    Entry entry;
+    entry.sql = key;
+    entry.statement = statement;
+    entry.prepareTime = prepareTime;
+
+    mEntries.push_front(entry);
+    mIndex[key] = mEntries.begin();
+  }
+
+  /**
+   * Free every cached statement. This must be called before the
+   * connection the statements belong to is closed.
+   */
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (auto& entry : mEntries) {
+      mFinalize(entry.statement);
+    }
+
+    mEntries.clear();
+    mIndex.clear();
+  }
+
+  /**
+   * Get the statistics of the cache.
+   * @return Statistics of the cache.
+   */
+  DatabaseStatementCacheStats GetStats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    DatabaseStatementCacheStats stats = mStats;
+    stats.size = (uint64_t)mEntries.size();
+
+    return stats;
+  }
+
+ private:
+  /// Statement in the cache
+  struct Entry {
+    /// SQL text of the statement
+    std::string sql;
+
+    /// Prepared statement
+    T statement;
+
+    /// Time it took to prepare the statement (microseconds)
+    uint64_t prepareTime;
+  };
+
+  /// Maximum number of statements to keep
+  size_t mCapacity;
+
+  /// Function to free statements
+  Finalizer_t mFinalize;
+
+  /// Cached statements from most to least recently returned
+  std::list<Entry> mEntries;
+
+  /// Cached statements by SQL text
+  std::unordered_map<std::string, typename std::list<Entry>::iterator> mIndex;
+
+  /// Statistics of the cache
+  DatabaseStatementCacheStats mStats;
+
+  /// Lock for the cache
+  mutable std::mutex mLock;
+};
+
+}  // namespace libcomp
+
+#endif  // !EXOTIC_PLATFORM
+
+#endif  // LIBCOMP_SRC_DATABASESTATEMENTCACHE_H
@@ -70,6 +70,8 @@ bool EncryptedConnection::Close() {
     auto self = shared_from_this();
 
     if (nullptr != self) {
+      // Queue in the same lane as the packets of the connection so they
+      // are all handled before the close.
       messageQueue->Enqueue(new Message::ConnectionClosed(self));
     }
 
@@ -29,6 +29,7 @@
 
 // libcomp Includes
 #include "CString.h"
+#include "MessageQueue.h"
 
 namespace libcomp {
 
@@ -50,6 +51,11 @@ enum class MessageType : int32_t {
  */
 class Message {
  public:
+  /**
+   * Create the message in the normal priority lane.
+   */
+  Message() : mPriority(MessagePriority_t::PRIORITY_NORMAL) {}
+
   /**
    * Cleanup the message.
    */
@@ -66,8 +72,36 @@ class Message {
    * @return String representation of the message.
    */
   virtual libcomp::String Dump() const = 0;
+
+  /**
+   * Get the lane the message is queued in when no priority is given. This
+   * is also used to keep the lane when a worker forwards the message.
+   * @return Priority lane of the message.
+   */
+  MessagePriority_t GetPriority() const { return mPriority; }
+
+  /**
+   * Set the lane the message is queued in when no priority is given.
+   * @param priority Priority lane of the message.
+   */
+  void SetPriority(MessagePriority_t priority) { mPriority = priority; }
+
+ private:
+  /// Priority lane of the message
+  MessagePriority_t mPriority;
 };
 
+/**
+ * Get the lane a message is queued in when no priority is given. This is
+ * found by @ref MessageQueue::Enqueue through argument dependent lookup.
+ * @param pMessage Message being queued.
+ * @return Priority lane of the message.
+ */
+inline MessagePriority_t DefaultPriority(Message* pMessage) {
+  return pMessage ? pMessage->GetPriority()
+                  : MessagePriority_t::PRIORITY_NORMAL;
+}
+
 }  // namespace Message
 
 }  // namespace libcomp
@@ -27,29 +27,116 @@
 #ifndef LIBCOMP_SRC_MESSAGEQUEUE_H
 #define LIBCOMP_SRC_MESSAGEQUEUE_H
 
+// Standard C++11 Includes
+#include <array>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <list>
 #include <mutex>
+#include <utility>
 
 namespace libcomp {
 
+/**
+ * Priority lane an item is placed in when added to a @ref MessageQueue.
+ * Lanes are drained in order from highest to lowest priority.
+ */
+enum class MessagePriority_t : uint8_t {
+  PRIORITY_HIGH = 0,  //!< System messages such as timeouts.
+  PRIORITY_NORMAL,    //!< Default lane for packets and general work.
+  PRIORITY_LOW,       //!< Bulk work that may be deferred.
+  PRIORITY_COUNT,
+};
+
+/**
+ * Get the lane an item is queued in when no priority is given. Item types
+ * that know their own priority overload this in their own namespace.
+ * @param item Item being queued.
+ * @return Normal priority lane.
+ */
+template <class T>
+MessagePriority_t DefaultPriority(const T& item) {
+  (void)item;
+
+  return MessagePriority_t::PRIORITY_NORMAL;
+}
+
+/**
+ * Statistics for a single priority lane of a @ref MessageQueue.
+ */
+struct MessageQueueLaneStats {
+  /// Number of items currently waiting in the lane
+  uint64_t depth;
+
+  /// Total number of items added to the lane
+  uint64_t enqueueCount;
+
+  /// Total number of items removed from the lane
+  uint64_t dequeueCount;
+
+  /// Sum of the time each dequeued item waited in the lane (microseconds)
+  uint64_t totalWait;
+
+  /// Longest time a single dequeued item waited in the lane (microseconds)
+  uint64_t maxWait;
+};
+
 /**
  * A thread safe collection of @ref Message instances to be created and
  * handled by a server. Messages queues are shared by both server
  * @ref Worker instances as well as each @ref EncryptedConnection that
  * connects to the server but is not limited to this usage.
+ *
+ * Each queue is split into a fixed number of priority lanes (see
+ * @ref MessagePriority_t). Items added without a priority go into the
+ * lane returned by @ref DefaultPriority, which is the normal lane unless
+ * the item type says otherwise, so a queue used without priorities
+ * behaves as a FIFO.
+ * @ref DequeueWeighted drains the lanes in priority order but takes at
+ * most the weight of each lane per call so lower lanes are not starved
+ * by a flood of higher priority items.
  */
 template <class T>
 class MessageQueue {
  public:
+  /// Number of priority lanes in each queue
+  static const size_t LANE_COUNT =
+      static_cast<size_t>(MessagePriority_t::PRIORITY_COUNT);
+
+  /**
+   * Create an empty message queue with the default lane weights.
+   */
+  MessageQueue() : mCount(0) {
+    mWeights[LaneIndex(MessagePriority_t::PRIORITY_HIGH)] = 64;
+    mWeights[LaneIndex(MessagePriority_t::PRIORITY_NORMAL)] = 16;
+    mWeights[LaneIndex(MessagePriority_t::PRIORITY_LOW)] = 4;
+
+    for (auto& stats : mStats) {
+      stats = MessageQueueLaneStats();
+    }
+  }
+
+  /**
+   * Enqueue a message in its default lane.
+   * @param Message to add
+   */
+  void Enqueue(T item) { Enqueue(item, DefaultPriority(item)); }
+
   /**
    * Enqueue a message.
    * @param Message to add
+   * @param priority Lane to add the message to
    */
-  void Enqueue(T item) {
+  void Enqueue(T item, MessagePriority_t priority) {
+    auto now = std::chrono::steady_clock::now();
+    size_t lane = LaneIndex(priority);
+
     mQueueLock.lock();
-    bool wasEmpty = mQueue.empty();
-    mQueue.push_back(item);
+    bool wasEmpty = 0 == mCount;
+    mLanes[lane].push_back(std::make_pair(item, now));
+    mStats[lane].enqueueCount++;
+    mCount++;
     mQueueLock.unlock();
 
     if (wasEmpty) {
@@ -61,79 +148,278 @@ class MessageQueue {
   /**
    * Enqueue multiple messages.
    * @param Messages to add
+   * @param priority Lane to add the messages to
    */
-  void Enqueue(std::list<T>& items) {
+  void Enqueue(std::list<T>& items, MessagePriority_t priority =
+                                        MessagePriority_t::PRIORITY_NORMAL) {
+    auto now = std::chrono::steady_clock::now();
+    size_t lane = LaneIndex(priority);
+
+    // Build the entries outside of the lock.
+    std::list<Entry> entries;
+
+    for (auto& item : items) {
+      entries.push_back(std::make_pair(item, now));
+    }
+
+    size_t count = entries.size();
+
+    items.clear();
+
     mQueueLock.lock();
-    bool wasEmpty = mQueue.empty();
-    mQueue.splice(mQueue.end(), items);
+    bool wasEmpty = 0 == mCount;
+    mLanes[lane].splice(mLanes[lane].end(), entries);
+    mStats[lane].enqueueCount += count;
+    mCount += count;
     mQueueLock.unlock();
 
-    if (wasEmpty) {
+    if (wasEmpty && 0 != count) {
       std::unique_lock<std::mutex> uniqueLock(mEmptyConditionLock);
       mEmptyCondition.notify_one();
     }
   }
 
   /**
-   * Dequeue the first message added and wait if empty.
-   * @return The first message added
+   * Dequeue the first message of the highest priority lane and wait if
+   * the queue is empty.
+   * @return The first message added to the highest priority lane
    */
   T Dequeue() {
     mQueueLock.lock();
 
-    while (mQueue.empty()) {
-      std::unique_lock<std::mutex> uniqueLock(mEmptyConditionLock);
-      mQueueLock.unlock();
-      mEmptyCondition.wait(uniqueLock);
-      mQueueLock.lock();
+    WaitForItems();
+
+    auto now = std::chrono::steady_clock::now();
+
+    T item = T();
+
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+      if (!mLanes[lane].empty()) {
+        item = PopFront(lane, now);
+        break;
+      }
     }
 
-    T item = mQueue.front();
-    mQueue.pop_front();
     mQueueLock.unlock();
 
     return item;
   }
 
   /**
-   * Dequeue all the messages and wait if its empty.
+   * Dequeue all the messages and wait if its empty. Messages are added
+   * in order of their lane priority.
    * @param List to add the messages to
    */
   void DequeueAll(std::list<T>& destinationQueue) {
-    std::list<T> tempQueue;
-
     mQueueLock.lock();
 
-    while (mQueue.empty()) {
-      std::unique_lock<std::mutex> uniqueLock(mEmptyConditionLock);
-      mQueueLock.unlock();
-      mEmptyCondition.wait(uniqueLock);
-      mQueueLock.lock();
+    WaitForItems();
+
+    auto now = std::chrono::steady_clock::now();
+
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+      while (!mLanes[lane].empty()) {
+        destinationQueue.push_back(PopFront(lane, now));
+      }
     }
 
-    mQueue.swap(tempQueue);
     mQueueLock.unlock();
+  }
+
+  /**
+   * Dequeue a weighted batch of messages and wait if the queue is empty.
+   * Each lane, in order of priority, contributes at most its weight in
+   * messages so a busy lane can not starve the lanes below it.
+   * @param List to add the messages to
+   */
+  void DequeueWeighted(std::list<T>& destinationQueue) {
+    DequeueWeighted(destinationQueue, [](const T&) { return false; });
+  }
+
+  /**
+   * Dequeue a weighted batch of messages like @ref DequeueWeighted but
+   * end the batch early after the first message the stop function
+   * returns true for. Messages after it are left in the queue.
+   * @param List to add the messages to
+   * @param stop Function called with each message as it is dequeued
+   */
+  template <typename Function>
+  void DequeueWeighted(std::list<T>& destinationQueue, Function&& stop) {
+    mQueueLock.lock();
+
+    WaitForItems();
+
+    auto now = std::chrono::steady_clock::now();
+    bool stopped = false;
 
-    destinationQueue.splice(destinationQueue.end(), tempQueue);
+    for (size_t lane = 0; lane < LANE_COUNT && !stopped; ++lane) {
+      for (size_t i = 0;
+           i < mWeights[lane] && !mLanes[lane].empty() && !stopped; ++i) {
+        destinationQueue.push_back(PopFront(lane, now));
+        stopped = stop(destinationQueue.back());
+      }
+    }
+
+    mQueueLock.unlock();
   }
 
   /**
-   * Dequeue all the current messages.
+   * Dequeue all the current messages. Messages are added in order of
+   * their lane priority.
    * @param List to add the messages to
    */
   void DequeueAny(std::list<T>& destinationQueue) {
-    std::list<T> tempQueue;
+    mQueueLock.lock();
+
+    auto now = std::chrono::steady_clock::now();
+
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+      while (!mLanes[lane].empty()) {
+        destinationQueue.push_back(PopFront(lane, now));
+      }
+    }
+
+    mQueueLock.unlock();
+  }
 
+  /**
+   * Dequeue the messages that were added before the enqueue counts given
+   * were taken with @ref GetEnqueueCounts. Messages added after that are
+   * left in the queue. Messages are added in order of their lane priority.
+   * @param enqueueCounts Enqueue count of each lane to stop at
+   * @param List to add the messages to
+   */
+  void DequeueBefore(const std::array<uint64_t, LANE_COUNT>& enqueueCounts,
+                     std::list<T>& destinationQueue) {
     mQueueLock.lock();
-    mQueue.swap(tempQueue);
+
+    auto now = std::chrono::steady_clock::now();
+
+    // Each lane is a FIFO so the dequeue count is the enqueue count the
+    // item at the front of the lane was added at.
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+      while (!mLanes[lane].empty() &&
+             mStats[lane].dequeueCount < enqueueCounts[lane]) {
+        destinationQueue.push_back(PopFront(lane, now));
+      }
+    }
+
     mQueueLock.unlock();
+  }
+
+  /**
+   * Get the number of messages added to each lane so far.
+   * @return Enqueue count of each lane
+   */
+  std::array<uint64_t, LANE_COUNT> GetEnqueueCounts() {
+    std::lock_guard<std::mutex> lock(mQueueLock);
+
+    std::array<uint64_t, LANE_COUNT> enqueueCounts;
+
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+      enqueueCounts[lane] = mStats[lane].enqueueCount;
+    }
+
+    return enqueueCounts;
+  }
+
+  /**
+   * Set the maximum number of messages a lane will contribute to a single
+   * call to @ref DequeueWeighted.
+   * @param priority Lane to set the weight for
+   * @param weight Number of messages to take from the lane (at least 1)
+   */
+  void SetLaneWeight(MessagePriority_t priority, size_t weight) {
+    std::lock_guard<std::mutex> lock(mQueueLock);
+    mWeights[LaneIndex(priority)] = weight ? weight : 1;
+  }
+
+  /**
+   * Get the statistics for a lane of the queue.
+   * @param priority Lane to get the statistics for
+   * @return Copy of the current lane statistics
+   */
+  MessageQueueLaneStats GetLaneStats(MessagePriority_t priority) {
+    std::lock_guard<std::mutex> lock(mQueueLock);
+
+    size_t lane = LaneIndex(priority);
 
-    destinationQueue.splice(destinationQueue.end(), tempQueue);
+    MessageQueueLaneStats stats = mStats[lane];
+    stats.depth = static_cast<uint64_t>(mLanes[lane].size());
+
+    return stats;
   }
 
  private:
-  /// The list of messages
-  std::list<T> mQueue;
+  /// Queued item and the time it was added
+  typedef std::pair<T, std::chrono::steady_clock::time_point> Entry;
+
+  /**
+   * Convert a priority to a lane index.
+   * @param priority Priority to convert
+   * @return Index of the lane (clamped to the lowest priority)
+   */
+  static size_t LaneIndex(MessagePriority_t priority) {
+    size_t lane = static_cast<size_t>(priority);
+
+    return lane < LANE_COUNT ? lane : (LANE_COUNT - 1);
+  }
+
+  /**
+   * Wait until at least one item is queued. The queue lock must be held
+   * when this is called and will be held when it returns.
+   */
+  void WaitForItems() {
+    while (0 == mCount) {
+      std::unique_lock<std::mutex> uniqueLock(mEmptyConditionLock);
+      mQueueLock.unlock();
+      mEmptyCondition.wait(uniqueLock);
+      mQueueLock.lock();
+    }
+  }
+
+  /**
+   * Remove the first item of a lane and record how long it waited. The
+   * queue lock must be held when this is called.
+   * @param lane Index of the lane to remove from
+   * @param now Time the item is being removed
+   * @return Item removed from the lane
+   */
+  T PopFront(size_t lane,
+             const std::chrono::steady_clock::time_point& now) {
+    Entry& entry = mLanes[lane].front();
+
+    uint64_t wait = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                              entry.second)
+            .count());
+
+    MessageQueueLaneStats& stats = mStats[lane];
+    stats.dequeueCount++;
+    stats.totalWait += wait;
+
+    if (wait > stats.maxWait) {
+      stats.maxWait = wait;
+    }
+
+    T item = entry.first;
+    mLanes[lane].pop_front();
+    mCount--;
+
+    return item;
+  }
+
+  /// The list of messages in each lane
+  std::array<std::list<Entry>, LANE_COUNT> mLanes;
+
+  /// Maximum number of messages each lane contributes to a weighted dequeue
+  std::array<size_t, LANE_COUNT> mWeights;
+
+  /// Statistics for each lane
+  std::array<MessageQueueLaneStats, LANE_COUNT> mStats;
+
+  /// Total number of messages in all lanes
+  size_t mCount;
 
   /// Mutex lock to use when modifying the queue
   std::mutex mQueueLock;
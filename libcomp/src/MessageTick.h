@@ -41,9 +41,9 @@ namespace Message {
 class Tick : public Message {
  public:
   /**
-   * Create the message.
+   * Create the message in the high priority lane.
    */
-  Tick() {}
+  Tick() { SetPriority(MessagePriority_t::PRIORITY_HIGH); }
 
   /**
    * Cleanup the message.
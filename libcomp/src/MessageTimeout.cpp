@@ -28,7 +28,9 @@
 
 using namespace libcomp;
 
-Message::Timeout::Timeout() {}
+Message::Timeout::Timeout() {
+  SetPriority(MessagePriority_t::PRIORITY_HIGH);
+}
 
 Message::Timeout::~Timeout() {}
 
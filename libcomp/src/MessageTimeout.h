@@ -44,7 +44,7 @@ namespace Message {
 class Timeout : public Message {
  public:
   /**
-   * Create the message.
+   * Create the message in the high priority lane.
    */
   Timeout();
 
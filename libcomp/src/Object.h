@@ -305,7 +305,7 @@ class Object {
   Convert::Encoding_t mEncoding;
 
   /// Mutex to lock accessing the object fields
-  std::mutex mFieldLock;
+  mutable std::mutex mFieldLock;
 };
 
 }  // namespace libcomp
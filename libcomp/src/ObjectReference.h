@@ -29,6 +29,7 @@
 
 // libcomp Includes
 #include "Database.h"
+#include "ObjectResidency.h"
 #include "PersistentObject.h"
 
 #ifndef EXOTIC_PLATFORM
@@ -213,10 +214,8 @@ class ObjectReference {
    * @return true if it was loaded, false if it was not
    */
   static bool Unload(const libobjgen::UUID& uuid) {
-    std::string uuidStr = uuid.ToString();
-
     std::lock_guard<std::mutex> lock(mReferenceLock);
-    auto iter = sData.find(uuidStr);
+    auto iter = sData.find(uuid);
     if (iter != sData.end()) {
       bool loaded = iter->second->mRef != nullptr;
       iter->second->mRef = nullptr;
@@ -256,7 +255,8 @@ class ObjectReference {
    * This will do nothing if the UUID is not set, the load fails or
    * the templated type is a generic PersistentObject. Calling this
    * function without a DB set will pull from the PersistentObject
-   * cache instead.
+   * cache instead. The loaded object is marked as recently used by
+   * @ref ObjectResidency when residency tracking is enabled.
    * @param db Database to load from
    * @param reload Forces a reload from the DB if true
    * @return true on success, false on failure
@@ -281,6 +281,16 @@ class ObjectReference {
       SetReference(uuid, pRef, dbLoad);
     }
 
+    if (ObjectResidency::IsEnabled() && !mData->mUUID.IsNull()) {
+      std::shared_ptr<PersistentObject> pRef;
+      {
+        std::lock_guard<std::mutex> lock(mReferenceLock);
+        pRef = mData->mRef;
+      }
+
+      ObjectResidency::Access(pRef, &ObjectReference<T>::Unload);
+    }
+
     return IsNull() || nullptr != GetReference();
   }
 
@@ -298,22 +308,22 @@ class ObjectReference {
     ClearReference();
 
     if (!uuid.IsNull()) {
-      std::string uuidStr = uuid.ToString();
-
       std::lock_guard<std::mutex> lock(mReferenceLock);
-      auto iter = sData.find(uuidStr);
+      auto iter = sData.find(uuid);
       if (iter == sData.end()) {
-        sData[uuidStr] = std::shared_ptr<ObjectReferenceData>(
-            new ObjectReferenceData(ref, uuid));
-      } else if (sData[uuidStr]->mRef == nullptr) {
-        sData[uuidStr]->mRef = ref;
+        iter = sData
+                   .emplace(uuid, std::shared_ptr<ObjectReferenceData>(
+                                      new ObjectReferenceData(ref, uuid)))
+                   .first;
+      } else if (iter->second->mRef == nullptr) {
+        iter->second->mRef = ref;
       }
 
       if (ref == nullptr && setLoadFailure) {
-        sData[uuidStr]->mLoadFailed = true;
+        iter->second->mLoadFailed = true;
       }
 
-      mData = sData[uuidStr];
+      mData = iter->second;
     } else {
       if (ref != nullptr) {
         mData =
@@ -331,13 +341,14 @@ class ObjectReference {
    */
   void ClearReference() {
     if (mData != nullptr && !mData->mUUID.IsNull()) {
-      std::string uuidStr = mData->mUUID.ToString();
+      libobjgen::UUID uuid = mData->mUUID;
 
       std::lock_guard<std::mutex> lock(mReferenceLock);
       mData = sNull;
 
-      if (sData[uuidStr].use_count() == 1) {
-        sData.erase(uuidStr);
+      auto iter = sData.find(uuid);
+      if (iter != sData.end() && iter->second.use_count() == 1) {
+        sData.erase(iter);
       }
     } else {
       mData = sNull;
@@ -348,7 +359,8 @@ class ObjectReference {
   std::shared_ptr<ObjectReferenceData> mData;
 
   /// Static cache of non-null UUIDs to persistent objects
-  static std::unordered_map<std::string, std::shared_ptr<ObjectReferenceData>>
+  static std::unordered_map<libobjgen::UUID,
+                            std::shared_ptr<ObjectReferenceData>>
       sData;
 
   /// Default value of mData instantiated once to avoid newing up
@@ -360,7 +372,7 @@ class ObjectReference {
 };
 
 template <class T>
-std::unordered_map<std::string, std::shared_ptr<ObjectReferenceData>>
+std::unordered_map<libobjgen::UUID, std::shared_ptr<ObjectReferenceData>>
     ObjectReference<T>::sData;
 
 template <class T>
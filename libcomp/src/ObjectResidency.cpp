@@ -0,0 +1,331 @@
+/**
+ * @file libcomp/src/ObjectResidency.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Memory bounded residency of referenced persistent objects.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ObjectResidency.h"
+
+#ifndef EXOTIC_PLATFORM
+
+// libcomp Includes
+#include "PersistentObject.h"
+
+// Standard C++11 Includes
+#include <ostream>
+#include <streambuf>
+
+using namespace libcomp;
+
+/// Most objects checked for eviction each time an object is accessed. This
+/// bounds the cost of an access when the least recently used objects are
+/// all pinned or still in use.
+static const size_t MAX_ACCESS_EVICTION_SCAN = 64;
+
+/// Size added to the serialized size of every object for the object
+/// itself and the tracking entries.
+static const uint64_t OBJECT_OVERHEAD = 128;
+
+namespace {
+
+/**
+ * Stream buffer that only counts the bytes written to it.
+ */
+class CountingStreamBuffer : public std::streambuf {
+ public:
+  CountingStreamBuffer() : mCount(0) {}
+
+  /**
+   * Get the number of bytes written.
+   * @return Number of bytes written
+   */
+  uint64_t GetCount() const { return mCount; }
+
+ protected:
+  std::streamsize xsputn(const char*, std::streamsize count) override {
+    mCount += (uint64_t)count;
+
+    return count;
+  }
+
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      mCount++;
+    }
+
+    return traits_type::not_eof(c);
+  }
+
+ private:
+  /// Number of bytes written
+  uint64_t mCount;
+};
+
+}  // namespace
+
+std::atomic<uint64_t> ObjectResidency::sBudget(0);
+std::atomic<uint64_t> ObjectResidency::sHits(0);
+std::atomic<uint64_t> ObjectResidency::sMisses(0);
+uint64_t ObjectResidency::sEvictions = 0;
+uint64_t ObjectResidency::sResidentSize = 0;
+std::list<ObjectResidency::Entry> ObjectResidency::sEntries;
+std::unordered_map<libobjgen::UUID, std::list<ObjectResidency::Entry>::iterator>
+    ObjectResidency::sLookup;
+std::mutex ObjectResidency::sLock;
+
+void ObjectResidency::Configure(uint64_t budget) {
+  sBudget = budget;
+
+  if (0 == budget) {
+    Reset();
+  }
+}
+
+bool ObjectResidency::IsEnabled() { return 0 != sBudget; }
+
+void ObjectResidency::RecordLoad(bool hit) {
+  if (IsEnabled()) {
+    if (hit) {
+      sHits++;
+    } else {
+      sMisses++;
+    }
+  }
+}
+
+void ObjectResidency::Access(const std::shared_ptr<PersistentObject>& obj,
+                             UnloadFunction unload) {
+  if (!IsEnabled() || nullptr == obj) {
+    return;
+  }
+
+  auto uuid = obj->GetUUID();
+
+  if (uuid.IsNull()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(sLock);
+
+    auto it = sLookup.find(uuid);
+
+    if (sLookup.end() != it && it->second->obj.lock() == obj) {
+      it->second->unload = unload;
+      sEntries.splice(sEntries.begin(), sEntries, it->second);
+
+      return;
+    }
+  }
+
+  // The object is new or was reloaded. Serialize it without holding the
+  // lock so other loads are not held up behind large objects.
+  uint64_t size = EstimateSize(*obj);
+
+  std::list<Entry> evicted;
+
+  {
+    std::lock_guard<std::mutex> lock(sLock);
+
+    auto it = sLookup.find(uuid);
+
+    if (sLookup.end() != it) {
+      auto entry = it->second;
+
+      // A reload replaces the object so track the new one.
+      if (entry->obj.lock() != obj) {
+        sResidentSize -= entry->size;
+        entry->obj = obj;
+        entry->size = size;
+        sResidentSize += entry->size;
+      }
+
+      entry->unload = unload;
+      sEntries.splice(sEntries.begin(), sEntries, entry);
+    } else {
+      Entry entry;
+      entry.uuid = uuid;
+      entry.obj = obj;
+      entry.unload = unload;
+      entry.size = size;
+      entry.pins = 0;
+
+      sEntries.push_front(entry);
+      sLookup[uuid] = sEntries.begin();
+      sResidentSize += entry.size;
+    }
+
+    CollectEvictions(MAX_ACCESS_EVICTION_SCAN, evicted);
+  }
+
+  Unload(evicted);
+}
+
+void ObjectResidency::Pin(const libobjgen::UUID& uuid) {
+  if (uuid.IsNull()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(sLock);
+
+  auto it = sLookup.find(uuid);
+
+  if (sLookup.end() != it) {
+    it->second->pins++;
+
+    return;
+  }
+
+  // Pin objects that are not loaded yet so they are kept once they are.
+  Entry entry;
+  entry.uuid = uuid;
+  entry.unload = nullptr;
+  entry.size = 0;
+  entry.pins = 1;
+
+  sEntries.push_front(entry);
+  sLookup[uuid] = sEntries.begin();
+}
+
+void ObjectResidency::Unpin(const libobjgen::UUID& uuid) {
+  std::lock_guard<std::mutex> lock(sLock);
+
+  auto it = sLookup.find(uuid);
+
+  if (sLookup.end() != it && 0 < it->second->pins) {
+    auto entry = it->second;
+
+    // Drop the entry of an object that was pinned but never loaded.
+    if (0 == --entry->pins && nullptr == entry->unload &&
+        entry->obj.expired()) {
+      sResidentSize -= entry->size;
+      sEntries.erase(entry);
+      sLookup.erase(it);
+    }
+  }
+}
+
+size_t ObjectResidency::Evict() {
+  std::list<Entry> evicted;
+
+  {
+    std::lock_guard<std::mutex> lock(sLock);
+
+    CollectEvictions(0, evicted);
+  }
+
+  return Unload(evicted);
+}
+
+ObjectResidencyStats ObjectResidency::GetStats() {
+  ObjectResidencyStats stats;
+  stats.hits = sHits;
+  stats.misses = sMisses;
+  stats.budget = sBudget;
+
+  std::lock_guard<std::mutex> lock(sLock);
+
+  stats.evictions = sEvictions;
+  stats.resident = (uint64_t)sEntries.size();
+  stats.residentSize = sResidentSize;
+
+  return stats;
+}
+
+void ObjectResidency::Reset() {
+  std::lock_guard<std::mutex> lock(sLock);
+
+  sEntries.clear();
+  sLookup.clear();
+  sResidentSize = 0;
+  sEvictions = 0;
+  sHits = 0;
+  sMisses = 0;
+}
+
+uint64_t ObjectResidency::EstimateSize(const PersistentObject& obj) {
+  CountingStreamBuffer buffer;
+  std::ostream out(&buffer);
+
+  obj.Save(out);
+
+  return buffer.GetCount() + OBJECT_OVERHEAD;
+}
+
+void ObjectResidency::CollectEvictions(size_t maxScan,
+                                       std::list<Entry>& evicted) {
+  uint64_t budget = sBudget;
+  size_t scanned = 0;
+
+  auto it = sEntries.end();
+
+  while (budget < sResidentSize && sEntries.begin() != it &&
+         (0 == maxScan || scanned++ < maxScan)) {
+    --it;
+
+    auto obj = it->obj.lock();
+
+    if (nullptr == obj) {
+      // Untrack objects that were already freed unless they are pinned
+      // before being loaded.
+      if (0 == it->pins) {
+        sResidentSize -= it->size;
+        sLookup.erase(it->uuid);
+        it = sEntries.erase(it);
+      }
+
+      continue;
+    }
+
+    // Only unload objects the reference cache is the last owner of. Any
+    // other owner would keep the object in memory anyway.
+    if (0 != it->pins || nullptr == it->unload || 2 < obj.use_count()) {
+      continue;
+    }
+
+    // Do not drop changes that have not been saved yet.
+    if (obj->IsDirty()) {
+      continue;
+    }
+
+    sResidentSize -= it->size;
+    sEvictions++;
+    sLookup.erase(it->uuid);
+
+    evicted.splice(evicted.end(), sEntries, it++);
+  }
+}
+
+size_t ObjectResidency::Unload(const std::list<Entry>& evicted) {
+  size_t count = 0;
+
+  for (auto& entry : evicted) {
+    if (entry.unload(entry.uuid)) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+#endif  // !EXOTIC_PLATFORM
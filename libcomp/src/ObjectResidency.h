@@ -0,0 +1,228 @@
+/**
+ * @file libcomp/src/ObjectResidency.h
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Memory bounded residency of referenced persistent objects.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2012-2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCOMP_SRC_OBJECTRESIDENCY_H
+#define LIBCOMP_SRC_OBJECTRESIDENCY_H
+
+#ifndef EXOTIC_PLATFORM
+
+// libobjgen Includes
+#include <UUID.h>
+
+// Standard C++11 Includes
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace libcomp {
+
+class PersistentObject;
+
+/**
+ * Statistics of the objects tracked by @ref ObjectResidency.
+ */
+struct ObjectResidencyStats {
+  ObjectResidencyStats()
+      : hits(0),
+        misses(0),
+        evictions(0),
+        resident(0),
+        residentSize(0),
+        budget(0) {}
+
+  /// Number of object loads served from memory
+  uint64_t hits;
+
+  /// Number of object loads that had to read from the database
+  uint64_t misses;
+
+  /// Number of objects unloaded to stay within the memory budget
+  uint64_t evictions;
+
+  /// Number of objects currently tracked
+  uint64_t resident;
+
+  /// Approximate size of the objects currently tracked (bytes)
+  uint64_t residentSize;
+
+  /// Memory budget of the tracked objects (bytes)
+  uint64_t budget;
+};
+
+/**
+ * Keeps the persistent objects held by @ref ObjectReference within a
+ * memory budget. Every object a reference loads is tracked with its
+ * approximate size in least recently used order. Once the tracked objects
+ * go over the budget the least recently used ones that are clean, not
+ * pinned and only held by the reference cache are unloaded with
+ * ObjectReference::Unload so they can be loaded again when next accessed.
+ * Nothing is tracked until a budget is configured.
+ */
+class ObjectResidency {
+ public:
+  /// Function that unloads an object from the reference cache
+  typedef bool (*UnloadFunction)(const libobjgen::UUID&);
+
+  /**
+   * Set the memory budget of the referenced objects.
+   * @param budget Approximate size in bytes the referenced objects may
+   *  use before they are unloaded (0 to disable residency tracking)
+   */
+  static void Configure(uint64_t budget);
+
+  /**
+   * Check if the referenced objects are being tracked.
+   * @return true if a memory budget is set
+   */
+  static bool IsEnabled();
+
+  /**
+   * Record an object load by UUID.
+   * @param hit true if the object was already in memory, false if it had
+   *  to be loaded from the database
+   */
+  static void RecordLoad(bool hit);
+
+  /**
+   * Mark a referenced object as the most recently used, tracking it if it
+   * is not tracked yet. This may unload other objects to stay within the
+   * memory budget.
+   * @param obj Pointer to the referenced object
+   * @param unload Function that unloads the object from the reference cache
+   */
+  static void Access(const std::shared_ptr<PersistentObject>& obj,
+                     UnloadFunction unload);
+
+  /**
+   * Prevent an object from being unloaded until it is unpinned. Pins are
+   * counted so each call must be matched by a call to @ref Unpin.
+   * @param uuid UUID of the object to pin
+   */
+  static void Pin(const libobjgen::UUID& uuid);
+
+  /**
+   * Allow a pinned object to be unloaded again.
+   * @param uuid UUID of the object to unpin
+   */
+  static void Unpin(const libobjgen::UUID& uuid);
+
+  /**
+   * Unload the least recently used objects until the tracked objects are
+   * within the memory budget.
+   * @return Number of objects unloaded
+   */
+  static size_t Evict();
+
+  /**
+   * Get the residency statistics.
+   * @return Residency statistics
+   */
+  static ObjectResidencyStats GetStats();
+
+  /**
+   * Stop tracking every object and clear the statistics.
+   */
+  static void Reset();
+
+  /**
+   * Get the approximate size of an object from its serialized size.
+   * @param obj Object to get the size of
+   * @return Approximate size of the object in bytes
+   */
+  static uint64_t EstimateSize(const PersistentObject& obj);
+
+ private:
+  /**
+   * Object tracked in least recently used order.
+   */
+  struct Entry {
+    /// UUID of the object
+    libobjgen::UUID uuid;
+
+    /// Object being tracked
+    std::weak_ptr<PersistentObject> obj;
+
+    /// Function that unloads the object from the reference cache
+    UnloadFunction unload;
+
+    /// Approximate size of the object (bytes)
+    uint64_t size;
+
+    /// Number of times the object is pinned
+    uint32_t pins;
+  };
+
+  /**
+   * Collect the least recently used objects that can be unloaded until
+   * the tracked objects are within the memory budget. The caller must
+   * hold sLock.
+   * @param maxScan Most objects to check before giving up (0 to check
+   *  every object)
+   * @param evicted Output list of the objects to unload
+   */
+  static void CollectEvictions(size_t maxScan, std::list<Entry>& evicted);
+
+  /**
+   * Unload objects collected for eviction. This must be called without
+   * holding sLock.
+   * @param evicted Objects to unload
+   * @return Number of objects unloaded
+   */
+  static size_t Unload(const std::list<Entry>& evicted);
+
+  /// Memory budget of the tracked objects (0 when disabled)
+  static std::atomic<uint64_t> sBudget;
+
+  /// Number of object loads served from memory
+  static std::atomic<uint64_t> sHits;
+
+  /// Number of object loads read from the database
+  static std::atomic<uint64_t> sMisses;
+
+  /// Number of objects unloaded to stay within the memory budget
+  static uint64_t sEvictions;
+
+  /// Approximate size of the tracked objects (bytes)
+  static uint64_t sResidentSize;
+
+  /// Tracked objects from most to least recently used
+  static std::list<Entry> sEntries;
+
+  /// Position of each tracked object in sEntries by UUID
+  static std::unordered_map<libobjgen::UUID, std::list<Entry>::iterator>
+      sLookup;
+
+  /// Lock for the tracked objects
+  static std::mutex sLock;
+};
+
+}  // namespace libcomp
+
+#endif  // !EXOTIC_PLATFORM
+
+#endif  // LIBCOMP_SRC_OBJECTRESIDENCY_H
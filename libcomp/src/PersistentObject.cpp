@@ -35,12 +35,158 @@
 #include "DatabaseBind.h"
 #include "MetaObjectXmlParser.h"
 #include "MetaVariable.h"
+#include "ObjectResidency.h"
+
+// Standard C++11 Includes
+#include <unordered_set>
+#include <vector>
 
 using namespace libcomp;
 
-std::unordered_map<std::string, std::weak_ptr<PersistentObject>>
-    PersistentObject::sCached;
-std::mutex PersistentObject::mCacheLock;
+namespace {
+
+/**
+ * Members of an object whose references are prefetched.
+ */
+struct PrefetchNode {
+  PrefetchNode() : pAny(nullptr) {}
+
+  /**
+   * Get the node of the objects referenced by a member.
+   * @param member Name of the member
+   * @return Node of the referenced objects or nullptr if the member is
+   *  not prefetched
+   */
+  const PrefetchNode* GetChild(const std::string& member) const {
+    auto it = members.find(member);
+
+    return members.end() != it ? &it->second : pAny;
+  }
+
+  /**
+   * Check if the references of the objects at this node are prefetched.
+   * @return true if any member is prefetched
+   */
+  bool HasChildren() const { return nullptr != pAny || !members.empty(); }
+
+  /// Node used for every member not in members
+  const PrefetchNode* pAny;
+
+  /// Nodes by member name
+  std::unordered_map<std::string, PrefetchNode> members;
+};
+
+/**
+ * Load the references of objects level by level following prefetch nodes.
+ * @param db Database to load from
+ * @param roots Objects to start from
+ * @param root Node of the root objects
+ * @return Statistics of the prefetch
+ */
+PersistentObjectPrefetchStats Prefetch(
+    const std::shared_ptr<Database>& db,
+    const std::list<std::shared_ptr<PersistentObject>>& roots,
+    const PrefetchNode& root) {
+  PersistentObjectPrefetchStats stats;
+
+  if (nullptr == db || !root.HasChildren()) {
+    return stats;
+  }
+
+  typedef std::pair<std::shared_ptr<PersistentObject>, const PrefetchNode*>
+      PrefetchItem;
+
+  std::list<PrefetchItem> level;
+  std::unordered_set<libobjgen::UUID> visited;
+
+  for (auto& obj : roots) {
+    if (nullptr != obj) {
+      level.push_back(std::make_pair(obj, &root));
+      visited.insert(obj->GetUUID());
+    }
+  }
+
+  while (!level.empty()) {
+    stats.levels++;
+
+    // Group the references that are not loaded yet by type.
+    std::unordered_map<size_t, std::list<libobjgen::UUID>> unresolved;
+    std::unordered_set<libobjgen::UUID> requested;
+
+    for (auto& item : level) {
+      auto pNode = item.second;
+
+      item.first->VisitReferences(
+          [&](const std::string& member, size_t typeHash,
+              const libobjgen::UUID& uuid,
+              const std::shared_ptr<PersistentObject>& ref) {
+            if (nullptr == ref && !uuid.IsNull() &&
+                nullptr != pNode->GetChild(member) &&
+                requested.insert(uuid).second) {
+              unresolved[typeHash].push_back(uuid);
+            }
+          });
+    }
+
+    // Keep the loaded objects until the references are populated.
+    std::list<std::shared_ptr<PersistentObject>> loaded;
+
+    for (auto& pair : unresolved) {
+      size_t queries = 0;
+
+      auto objs =
+          db->LoadObjectsByUUIDs(pair.first, pair.second, false, &queries);
+
+      stats.references += (uint64_t)pair.second.size();
+      stats.loaded += (uint64_t)objs.size();
+      stats.queries += (uint64_t)queries;
+
+      loaded.splice(loaded.end(), objs);
+    }
+
+    // Visiting again picks the loaded objects up from the cache.
+    std::list<PrefetchItem> next;
+
+    for (auto& item : level) {
+      auto pNode = item.second;
+
+      item.first->VisitReferences(
+          [&](const std::string& member, size_t,
+              const libobjgen::UUID& uuid,
+              const std::shared_ptr<PersistentObject>& ref) {
+            auto pChild = pNode->GetChild(member);
+
+            if (nullptr != ref && nullptr != pChild &&
+                pChild->HasChildren() && visited.insert(uuid).second) {
+              next.push_back(std::make_pair(ref, pChild));
+            }
+          });
+    }
+
+    level = std::move(next);
+  }
+
+  if (stats.references > stats.queries) {
+    stats.queriesSaved = stats.references - stats.queries;
+  }
+
+  LogDatabaseDebug([&]() {
+    return String("Prefetched %1 of %2 references over %3 level(s) with %4 "
+                  "queries (%5 queries saved)\n")
+        .Arg(stats.loaded)
+        .Arg(stats.references)
+        .Arg(stats.levels)
+        .Arg(stats.queries)
+        .Arg(stats.queriesSaved);
+  });
+
+  return stats;
+}
+
+}  // namespace
+
+PersistentObject::CacheShard
+    PersistentObject::sCacheShards[PersistentObject::CACHE_SHARD_COUNT];
 PersistentObject::TypeMap PersistentObject::sTypeMap;
 std::unordered_map<std::string, size_t> PersistentObject::sTypeNames;
 std::unordered_map<size_t, std::function<PersistentObject*()>>
@@ -58,11 +204,13 @@ PersistentObject::PersistentObject(const PersistentObject& other)
 
 PersistentObject::~PersistentObject() {
   if (!mUUID.IsNull() && !IsDeleted()) {
-    std::lock_guard<std::mutex> lock(mCacheLock);
+    auto& shard = GetCacheShard(mUUID);
+    auto lock = WriteLockShard(shard);
 
-    std::string strUUID = mUUID.ToString();
-    if (sCached.find(strUUID) != sCached.end()) {
-      sCached.erase(strUUID);
+    // Keep the entry if another object was registered with the UUID.
+    auto it = shard.objects.find(mUUID);
+    if (it != shard.objects.end() && it->second.expired()) {
+      shard.objects.erase(it);
     }
   }
 }
@@ -76,12 +224,14 @@ bool PersistentObject::Register(const std::shared_ptr<PersistentObject>& self,
 
     libobjgen::UUID& uuid = self->mUUID;
 
-    std::lock_guard<std::mutex> lock(mCacheLock);
     if (!pUuid.IsNull() && !uuid.IsNull()) {
       // Unregister old UUID, keep if making a copy
-      auto it = sCached.find(uuid.ToString());
-      if (it != sCached.end() && it->second.lock() == self) {
-        sCached.erase(it);
+      auto& shard = GetCacheShard(uuid);
+      auto lock = WriteLockShard(shard);
+
+      auto it = shard.objects.find(uuid);
+      if (it != shard.objects.end() && it->second.lock() == self) {
+        shard.objects.erase(it);
       }
     }
 
@@ -92,20 +242,30 @@ bool PersistentObject::Register(const std::shared_ptr<PersistentObject>& self,
       registered = true;
     }
 
-    if (!registered && sCached.find(uuid.ToString()) == sCached.end()) {
-      registered = true;
-    }
+    auto& shard = GetCacheShard(uuid);
+    auto lock = WriteLockShard(shard);
 
-    std::string uuidString = uuid.ToString();
+    if (!registered) {
+      auto it = shard.objects.find(uuid);
+      registered = it == shard.objects.end() || it->second.expired();
+    }
 
     if (registered) {
       self->mSelf = self;
-      sCached[uuidString] = self;
+      shard.objects[uuid] = self;
+      shard.registrations++;
+
+      if (CACHE_PURGE_INTERVAL <= ++shard.sincePurge) {
+        PurgeExpired(shard);
+      }
 
       return true;
     } else {
+      lock.unlock();
+
       LogGeneralError([&]() {
-        return String("Duplicate object detected: %1\n").Arg(uuidString);
+        return String("Duplicate object detected: %1\n")
+            .Arg(uuid.ToString());
       });
     }
   }
@@ -116,33 +276,133 @@ bool PersistentObject::Register(const std::shared_ptr<PersistentObject>& self,
 void PersistentObject::Unregister() {
   mDeleted = true;
 
-  std::lock_guard<std::mutex> lock(mCacheLock);
+  auto& shard = GetCacheShard(mUUID);
+  auto lock = WriteLockShard(shard);
 
-  auto iter = sCached.find(mUUID.ToString());
-  if (iter != sCached.end()) {
-    sCached.erase(iter);
+  auto iter = shard.objects.find(mUUID);
+  if (iter != shard.objects.end()) {
+    shard.objects.erase(iter);
   }
 }
 
 bool PersistentObject::IsDeleted() { return mDeleted; }
 
+bool PersistentObject::IsDirty() const {
+  std::lock_guard<std::mutex> lock(mFieldLock);
+
+  return !mDirtyFields.empty();
+}
+
+std::set<std::string> PersistentObject::GetDirtyFields() const {
+  std::lock_guard<std::mutex> lock(mFieldLock);
+
+  return mDirtyFields;
+}
+
+void PersistentObject::RestoreDirtyFields(
+    const std::set<std::string>& fields) {
+  std::lock_guard<std::mutex> lock(mFieldLock);
+
+  mDirtyFields.insert(fields.begin(), fields.end());
+}
+
 std::shared_ptr<PersistentObject> PersistentObject::GetObjectByUUID(
     const libobjgen::UUID& uuid) {
-  std::lock_guard<std::mutex> lock(mCacheLock);
+  auto& shard = GetCacheShard(uuid);
+  auto lock = ReadLockShard(shard);
+
+  shard.lookups++;
 
-  auto iter = sCached.find(uuid.ToString());
-  if (iter != sCached.end()) {
+  auto iter = shard.objects.find(uuid);
+  if (iter != shard.objects.end()) {
     return iter->second.lock();
   }
 
   return nullptr;
 }
 
+size_t PersistentObject::PurgeExpiredObjects() {
+  size_t count = 0;
+
+  for (auto& shard : sCacheShards) {
+    auto lock = WriteLockShard(shard);
+
+    count += PurgeExpired(shard);
+  }
+
+  return count;
+}
+
+PersistentObjectCacheStats PersistentObject::GetCacheStats() {
+  PersistentObjectCacheStats stats;
+
+  for (auto& shard : sCacheShards) {
+    auto lock = ReadLockShard(shard);
+
+    stats.lookups += shard.lookups;
+    stats.contended += shard.contended;
+    stats.registrations += shard.registrations;
+    stats.purged += shard.purged;
+    stats.cached += (uint64_t)shard.objects.size();
+  }
+
+  return stats;
+}
+
+PersistentObject::CacheShard& PersistentObject::GetCacheShard(
+    const libobjgen::UUID& uuid) {
+  return sCacheShards[std::hash<libobjgen::UUID>()(uuid) % CACHE_SHARD_COUNT];
+}
+
+std::shared_lock<std::shared_timed_mutex> PersistentObject::ReadLockShard(
+    CacheShard& shard) {
+  std::shared_lock<std::shared_timed_mutex> lock(shard.lock, std::try_to_lock);
+
+  if (!lock.owns_lock()) {
+    shard.contended++;
+    lock.lock();
+  }
+
+  return lock;
+}
+
+std::unique_lock<std::shared_timed_mutex> PersistentObject::WriteLockShard(
+    CacheShard& shard) {
+  std::unique_lock<std::shared_timed_mutex> lock(shard.lock, std::try_to_lock);
+
+  if (!lock.owns_lock()) {
+    shard.contended++;
+    lock.lock();
+  }
+
+  return lock;
+}
+
+size_t PersistentObject::PurgeExpired(CacheShard& shard) {
+  size_t count = 0;
+
+  for (auto it = shard.objects.begin(); it != shard.objects.end();) {
+    if (it->second.expired()) {
+      it = shard.objects.erase(it);
+      count++;
+    } else {
+      ++it;
+    }
+  }
+
+  shard.purged += (uint64_t)count;
+  shard.sincePurge = 0;
+
+  return count;
+}
+
 std::shared_ptr<PersistentObject> PersistentObject::LoadObjectByUUID(
     size_t typeHash, const std::shared_ptr<Database>& db,
     const libobjgen::UUID& uuid, bool reload, bool reportError) {
   auto obj = !reload ? GetObjectByUUID(uuid) : nullptr;
 
+  ObjectResidency::RecordLoad(nullptr != obj);
+
   if (nullptr == obj) {
     auto bind = new DatabaseBindUUID("UID", uuid);
 
@@ -162,6 +422,65 @@ std::shared_ptr<PersistentObject> PersistentObject::LoadObjectByUUID(
   return obj;
 }
 
+std::list<std::shared_ptr<PersistentObject>>
+PersistentObject::LoadObjectsByUUID(size_t typeHash,
+                                    const std::shared_ptr<Database>& db,
+                                    const std::list<libobjgen::UUID>& uuids,
+                                    bool reload) {
+  if (nullptr != db) {
+    return db->LoadObjectsByUUIDs(typeHash, uuids, reload);
+  }
+
+  return std::list<std::shared_ptr<PersistentObject>>();
+}
+
+PersistentObjectPrefetchStats PersistentObject::PrefetchReferences(
+    const std::shared_ptr<Database>& db,
+    const std::list<std::shared_ptr<PersistentObject>>& roots,
+    size_t depth) {
+  // Chain one node per level that prefetches every member.
+  std::vector<PrefetchNode> nodes(depth + 1);
+
+  for (size_t i = 0; i < depth; ++i) {
+    nodes[i].pAny = &nodes[i + 1];
+  }
+
+  return Prefetch(db, roots, nodes.front());
+}
+
+PersistentObjectPrefetchStats PersistentObject::PrefetchReferences(
+    const std::shared_ptr<Database>& db,
+    const std::list<std::shared_ptr<PersistentObject>>& roots,
+    const std::list<std::string>& paths) {
+  PrefetchNode root;
+
+  for (auto& path : paths) {
+    auto pNode = &root;
+
+    for (auto& member : String(path).Split(".")) {
+      pNode = &pNode->members[member.ToUtf8()];
+    }
+  }
+
+  return Prefetch(db, roots, root);
+}
+
+void PersistentObject::VisitReferences(const ReferenceVisitor& visitor) {
+  (void)visitor;
+}
+
+bool PersistentObject::ForEachObject(
+    size_t typeHash, const std::shared_ptr<Database>& db,
+    DatabaseBind* pValue,
+    const std::function<bool(const std::shared_ptr<PersistentObject>&)>&
+        callback) {
+  if (nullptr != db) {
+    return db->ForEachObject(typeHash, pValue, callback);
+  }
+
+  return false;
+}
+
 std::shared_ptr<PersistentObject> PersistentObject::LoadObject(
     size_t typeHash, const std::shared_ptr<Database>& db,
     DatabaseBind* pValue) {
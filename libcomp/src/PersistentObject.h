@@ -36,6 +36,11 @@
 #include <UUID.h>
 
 // Standard C++ 11 Includes
+#include <atomic>
+#include <functional>
+#include <list>
+#include <shared_mutex>
+#include <tuple>
 #include <typeindex>
 
 #ifndef EXOTIC_PLATFORM
@@ -47,6 +52,53 @@ class DatabaseBind;
 class DatabaseQuery;
 class BaseScriptEngine;
 
+/**
+ * Statistics of the cache of registered @ref PersistentObject instances.
+ */
+struct PersistentObjectCacheStats {
+  PersistentObjectCacheStats()
+      : lookups(0), registrations(0), contended(0), purged(0), cached(0) {}
+
+  /// Number of objects looked up by UUID
+  uint64_t lookups;
+
+  /// Number of objects registered
+  uint64_t registrations;
+
+  /// Number of cache accesses that waited on a lock held by another thread
+  uint64_t contended;
+
+  /// Number of expired entries removed from the cache
+  uint64_t purged;
+
+  /// Number of entries in the cache
+  uint64_t cached;
+};
+
+/**
+ * Statistics of a prefetch of the references of persistent objects.
+ */
+struct PersistentObjectPrefetchStats {
+  PersistentObjectPrefetchStats()
+      : levels(0), references(0), loaded(0), queries(0), queriesSaved(0) {}
+
+  /// Number of levels of references walked
+  uint64_t levels;
+
+  /// Number of unloaded references found
+  uint64_t references;
+
+  /// Number of referenced objects loaded
+  uint64_t loaded;
+
+  /// Number of queries executed to load the referenced objects
+  uint64_t queries;
+
+  /// Number of single object queries the references would have executed
+  /// minus the queries executed by the prefetch
+  uint64_t queriesSaved;
+};
+
 /**
  * Base class of a all dynamically generated objects that persist in the
  * database. Persistent objects are cached upon load or by explicitly
@@ -61,6 +113,19 @@ class PersistentObject : public Object {
   typedef std::unordered_map<size_t, std::shared_ptr<libobjgen::MetaObject>>
       TypeMap;
 
+  /// Function passed the member name, referenced C++ type hash, UUID and
+  /// currently loaded object of each persistent object reference
+  typedef std::function<void(const std::string&, size_t,
+                             const libobjgen::UUID&,
+                             const std::shared_ptr<PersistentObject>&)>
+      ReferenceVisitor;
+
+  /// Member name, referenced C++ type hash, UUID and currently loaded
+  /// object of a reference collected to pass to a @ref ReferenceVisitor
+  typedef std::tuple<std::string, size_t, libobjgen::UUID,
+                     std::shared_ptr<PersistentObject>>
+      VisitedReference;
+
   /**
    * Create a persistent object with no UUID.
    * @param encoding Encoding to use for strings that are set to the default
@@ -111,6 +176,16 @@ class PersistentObject : public Object {
    */
   virtual bool LoadDatabaseValues(DatabaseQuery& query) = 0;
 
+  /**
+   * Pass every typed persistent object reference member of the object,
+   * including those held in lists, arrays and map values, to a visitor.
+   * References already in the cache are loaded into the reference before
+   * they are visited. The references are collected under the field lock
+   * and the visitor is called after it is released.
+   * @param visitor Function to pass each reference to
+   */
+  virtual void VisitReferences(const ReferenceVisitor& visitor);
+
   /**
    * Register a derived class object to the cache and get a new UUID if not
    * specified.
@@ -134,6 +209,25 @@ class PersistentObject : public Object {
    */
   bool IsDeleted();
 
+  /**
+   * Check if any field has changed since the object was last saved.
+   * @return true if the object has unsaved changes, false if it does not
+   */
+  bool IsDirty() const;
+
+  /**
+   * Get the fields that have changed since the object was last saved.
+   * @return Set of the names of the changed fields
+   */
+  std::set<std::string> GetDirtyFields() const;
+
+  /**
+   * Mark fields as changed again after a save that wrote them was rolled
+   * back. Fields changed since the save are kept.
+   * @param fields Set of the names of the fields to mark as changed
+   */
+  void RestoreDirtyFields(const std::set<std::string>& fields);
+
   /**
    * Check if a derived type failed to initialize (register).
    * @return true if no initialization error occurred, false otherwise
@@ -148,6 +242,19 @@ class PersistentObject : public Object {
   static std::shared_ptr<PersistentObject> GetObjectByUUID(
       const libobjgen::UUID& uuid);
 
+  /**
+   * Remove the entries of every object that no longer exists from the
+   * cache. This also happens periodically as objects are registered.
+   * @return Number of entries removed
+   */
+  static size_t PurgeExpiredObjects();
+
+  /**
+   * Get the statistics of the object cache.
+   * @return Statistics of the object cache
+   */
+  static PersistentObjectCacheStats GetCacheStats();
+
   /**
    * Retrieve all objects of the specified type by its UUID from the
    * database.  Use sparingly.
@@ -158,11 +265,11 @@ class PersistentObject : public Object {
   static std::list<std::shared_ptr<T>> LoadAll(
       const std::shared_ptr<Database>& db) {
     std::list<std::shared_ptr<T>> retval;
-    if (std::is_base_of<PersistentObject, T>::value) {
-      for (auto obj : LoadObjects(typeid(T).hash_code(), db, nullptr)) {
-        retval.push_back(std::dynamic_pointer_cast<T>(obj));
-      }
-    }
+    ForEachObject<T>(db, nullptr, [&retval](const std::shared_ptr<T>& obj) {
+      retval.push_back(obj);
+
+      return true;
+    });
 
     return retval;
   }
@@ -203,6 +310,118 @@ class PersistentObject : public Object {
       const libobjgen::UUID& uuid, bool reload = false,
       bool reportError = false);
 
+  /**
+   * Retrieve multiple objects of the specified type by UUID from the cache
+   * or database. Objects that are not cached are loaded in batches instead
+   * of one query per object.
+   * @param db Database to load from
+   * @param uuids UUIDs of the objects to load
+   * @param reload Forces a reload from the DB if true
+   * @return List of pointers to the objects that exist in the order they
+   *  were requested
+   */
+  template <class T>
+  static std::list<std::shared_ptr<T>> LoadObjectsByUUID(
+      const std::shared_ptr<Database>& db,
+      const std::list<libobjgen::UUID>& uuids, bool reload = false) {
+    std::list<std::shared_ptr<T>> retval;
+    if (std::is_base_of<PersistentObject, T>::value) {
+      for (auto obj :
+           LoadObjectsByUUID(typeid(T).hash_code(), db, uuids, reload)) {
+        retval.push_back(std::dynamic_pointer_cast<T>(obj));
+      }
+    }
+
+    return retval;
+  }
+
+  /**
+   * Retrieve multiple objects of the specified type ID by UUID from the
+   * cache or database.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param db Database to load from
+   * @param uuids UUIDs of the objects to load
+   * @param reload Forces a reload from the DB if true
+   * @return List of pointers to the objects that exist in the order they
+   *  were requested
+   */
+  static std::list<std::shared_ptr<PersistentObject>> LoadObjectsByUUID(
+      size_t typeHash, const std::shared_ptr<Database>& db,
+      const std::list<libobjgen::UUID>& uuids, bool reload = false);
+
+  /**
+   * Load the objects referenced by a set of objects and by the objects they
+   * reference up to a number of levels deep. The unloaded references of
+   * each level are grouped by type and each group is loaded with batched
+   * queries instead of one query per reference.
+   * @param db Database to load from
+   * @param roots Objects to start from
+   * @param depth Number of levels of references to load
+   * @return Statistics of the prefetch
+   */
+  static PersistentObjectPrefetchStats PrefetchReferences(
+      const std::shared_ptr<Database>& db,
+      const std::list<std::shared_ptr<PersistentObject>>& roots,
+      size_t depth);
+
+  /**
+   * Load the objects referenced by a set of objects following member
+   * paths. Each path is a list of member names separated by periods such
+   * as "Items.Enchantments" that loads the Items references of the roots
+   * and then the Enchantments references of those items.
+   * @param db Database to load from
+   * @param roots Objects to start from
+   * @param paths Member paths to load
+   * @return Statistics of the prefetch
+   */
+  static PersistentObjectPrefetchStats PrefetchReferences(
+      const std::shared_ptr<Database>& db,
+      const std::list<std::shared_ptr<PersistentObject>>& roots,
+      const std::list<std::string>& paths);
+
+  /**
+   * Pass every object of the specified type matching a field database
+   * binding to a callback one at a time instead of loading them into a
+   * list first.
+   * @param db Database to load from
+   * @param pValue Pointer to a field bound to a database column or null to
+   *  load every object of the type
+   * @param callback Function to pass each object to that returns false to
+   *  stop loading
+   * @return false if the objects could not be loaded, true otherwise
+   */
+  template <class T>
+  static bool ForEachObject(
+      const std::shared_ptr<Database>& db, DatabaseBind* pValue,
+      const std::function<bool(const std::shared_ptr<T>&)>& callback) {
+    if (!std::is_base_of<PersistentObject, T>::value) {
+      return false;
+    }
+
+    return ForEachObject(
+        typeid(T).hash_code(), db, pValue,
+        [&callback](const std::shared_ptr<PersistentObject>& obj) {
+          return callback(std::dynamic_pointer_cast<T>(obj));
+        });
+  }
+
+  /**
+   * Pass every object of the specified type ID matching a field database
+   * binding to a callback one at a time.
+   * @param typeHash C++ type hash representing the object type to load
+   * @param db Database to load from
+   * @param pValue Pointer to a field bound to a database column or null to
+   *  load every object of the type
+   * @param callback Function to pass each object to that returns false to
+   *  stop loading
+   * @return false if the objects could not be loaded, true otherwise
+   */
+  static bool ForEachObject(
+      size_t typeHash, const std::shared_ptr<Database>& db,
+      DatabaseBind* pValue,
+      const std::function<bool(const std::shared_ptr<PersistentObject>&)>&
+          callback);
+
   /**
    * Get all PersistentObject derived class MetaObject definitions.
    * @return Map of MetaObject definitions by the source object's C++ type
@@ -394,12 +613,78 @@ class PersistentObject : public Object {
   std::set<std::string> mDirtyFields;
 
  private:
-  /// Map of intantiated objects listed by their UUID
-  static std::unordered_map<std::string, std::weak_ptr<PersistentObject>>
-      sCached;
+  /// Number of shards the object cache is split into
+  static const size_t CACHE_SHARD_COUNT = 64;
+
+  /// Registrations to a shard between purges of its expired entries
+  static const size_t CACHE_PURGE_INTERVAL = 4096;
+
+  /**
+   * Part of the object cache with its own lock. Objects are assigned to a
+   * shard by the hash of their UUID so threads working with different
+   * objects rarely wait on each other.
+   */
+  struct alignas(64) CacheShard {
+    CacheShard()
+        : lookups(0), contended(0), registrations(0), purged(0),
+          sincePurge(0) {}
+
+    /// Map of intantiated objects listed by their UUID
+    std::unordered_map<libobjgen::UUID, std::weak_ptr<PersistentObject>>
+        objects;
+
+    /// Lock for the objects (shared for lookups)
+    std::shared_timed_mutex lock;
+
+    /// Number of objects looked up in the shard
+    std::atomic<uint64_t> lookups;
+
+    /// Number of accesses that waited on the lock
+    std::atomic<uint64_t> contended;
+
+    /// Number of objects registered to the shard
+    uint64_t registrations;
+
+    /// Number of expired entries removed from the shard
+    uint64_t purged;
+
+    /// Registrations since the expired entries were last removed
+    size_t sincePurge;
+  };
+
+  /**
+   * Get the cache shard an object is stored in.
+   * @param uuid UUID of the object
+   * @return Shard of the object cache
+   */
+  static CacheShard& GetCacheShard(const libobjgen::UUID& uuid);
+
+  /**
+   * Lock a cache shard for reading, counting the access if it has to wait.
+   * @param shard Shard to lock
+   * @return Shared lock of the shard
+   */
+  static std::shared_lock<std::shared_timed_mutex> ReadLockShard(
+      CacheShard& shard);
+
+  /**
+   * Lock a cache shard for writing, counting the access if it has to wait.
+   * @param shard Shard to lock
+   * @return Exclusive lock of the shard
+   */
+  static std::unique_lock<std::shared_timed_mutex> WriteLockShard(
+      CacheShard& shard);
+
+  /**
+   * Remove the entries of objects that no longer exist from a cache
+   * shard. The shard must be locked for writing.
+   * @param shard Shard to remove expired entries from
+   * @return Number of entries removed
+   */
+  static size_t PurgeExpired(CacheShard& shard);
 
-  /// Mutex to lock accessing the cache
-  static std::mutex mCacheLock;
+  /// Shards of the cache of intantiated objects
+  static CacheShard sCacheShards[CACHE_SHARD_COUNT];
 
   /// Static map of MetaObject definitions by the source object's C++ type hash
   static TypeMap sTypeMap;
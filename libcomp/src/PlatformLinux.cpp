@@ -29,10 +29,131 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+/// Allocate memory on the node of the CPU that triggered the allocation.
+/// This is MPOL_LOCAL from numaif.h (which requires libnuma headers).
+#define LIBCOMP_MPOL_LOCAL (4)
+#endif  // defined(__linux__) && defined(SYS_set_mempolicy)
+
 bool libcomp::Platform::CreateDirectory(const libcomp::String &path) {
   return mkdir(path.C(), 0770) == 0;
 }
 
 bool libcomp::Platform::IsPathSeparator(char c) { return c == '/'; }
 
+#ifdef __linux__
+static bool BuildCPUSet(const std::set<uint32_t> &cpus, cpu_set_t &cpuSet) {
+  CPU_ZERO(&cpuSet);
+
+  for (auto cpu : cpus) {
+    if (cpu >= CPU_SETSIZE) {
+      return false;
+    }
+
+    CPU_SET(cpu, &cpuSet);
+  }
+
+  return !cpus.empty();
+}
+#endif  // __linux__
+
+bool libcomp::Platform::SetThreadAffinity(std::thread &thread,
+                                          const std::set<uint32_t> &cpus) {
+#ifdef __linux__
+  cpu_set_t cpuSet;
+
+  if (!thread.joinable() || !BuildCPUSet(cpus, cpuSet)) {
+    return false;
+  }
+
+  return 0 == pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet),
+                                     &cpuSet);
+#else
+  (void)thread;
+  (void)cpus;
+
+  return false;
+#endif  // __linux__
+}
+
+bool libcomp::Platform::SetCurrentThreadAffinity(
+    const std::set<uint32_t> &cpus) {
+#ifdef __linux__
+  cpu_set_t cpuSet;
+
+  if (!BuildCPUSet(cpus, cpuSet)) {
+    return false;
+  }
+
+  return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+  (void)cpus;
+
+  return false;
+#endif  // __linux__
+}
+
+std::set<uint32_t> libcomp::Platform::GetCurrentThreadAffinity() {
+  std::set<uint32_t> cpus;
+
+#ifdef __linux__
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+
+  if (0 == pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet)) {
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpuSet)) {
+        cpus.insert(cpu);
+      }
+    }
+  }
+#endif  // __linux__
+
+  return cpus;
+}
+
+bool libcomp::Platform::SetCurrentThreadLocalMemory() {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+  return 0 == syscall(SYS_set_mempolicy, LIBCOMP_MPOL_LOCAL, nullptr, 0);
+#else
+  return false;
+#endif  // defined(__linux__) && defined(SYS_set_mempolicy)
+}
+
+int32_t libcomp::Platform::GetCPUNode(uint32_t cpu) {
+#ifdef __linux__
+  // Each CPU directory in sysfs links to the node it belongs to. Machines
+  // without NUMA support do not have any nodes and are reported as node 0.
+  struct stat info;
+
+  for (int32_t node = 0;; ++node) {
+    if (0 != stat(libcomp::String("/sys/devices/system/node/node%1")
+                      .Arg(node)
+                      .C(),
+                  &info)) {
+      return 0 == node ? 0 : -1;
+    }
+
+    if (0 == stat(libcomp::String("/sys/devices/system/cpu/cpu%1/node%2")
+                      .Arg(cpu)
+                      .Arg(node)
+                      .C(),
+                  &info)) {
+      return node;
+    }
+  }
+#else
+  (void)cpu;
+
+  return -1;
+#endif  // __linux__
+}
+
 #endif  // !_WIN32
@@ -29,6 +29,10 @@
 
 #include "CString.h"
 
+// Standard C++11 Includes
+#include <set>
+#include <thread>
+
 namespace libcomp {
 
 namespace Platform {
@@ -47,6 +51,46 @@ bool CreateDirectory(const libcomp::String &path);
  */
 bool IsPathSeparator(char c);
 
+/**
+ * Restrict a thread to run on a set of CPUs.
+ * @param thread Thread to place.
+ * @param cpus Indexes of the CPUs the thread may run on.
+ * @returns Whether the operation was successful or not.
+ * @ingroup Platform
+ */
+bool SetThreadAffinity(std::thread &thread, const std::set<uint32_t> &cpus);
+
+/**
+ * Restrict the calling thread to run on a set of CPUs.
+ * @param cpus Indexes of the CPUs the thread may run on.
+ * @returns Whether the operation was successful or not.
+ * @ingroup Platform
+ */
+bool SetCurrentThreadAffinity(const std::set<uint32_t> &cpus);
+
+/**
+ * Get the set of CPUs the calling thread may run on.
+ * @returns Indexes of the CPUs or an empty set on failure.
+ * @ingroup Platform
+ */
+std::set<uint32_t> GetCurrentThreadAffinity();
+
+/**
+ * Prefer memory local to the NUMA node the calling thread is running on
+ * for any allocation made by the thread.
+ * @returns Whether the operation was successful or not.
+ * @ingroup Platform
+ */
+bool SetCurrentThreadLocalMemory();
+
+/**
+ * Get the NUMA node a CPU belongs to.
+ * @param cpu Index of the CPU.
+ * @returns Index of the NUMA node or -1 if it could not be determined.
+ * @ingroup Platform
+ */
+int32_t GetCPUNode(uint32_t cpu);
+
 }  // namespace Platform
 
 }  // namespace libcomp
@@ -70,4 +70,82 @@ bool libcomp::Platform::IsPathSeparator(char c) {
   return c == '/' || c == '\\';
 }
 
+static bool BuildAffinityMask(const std::set<uint32_t> &cpus,
+                              DWORD_PTR &mask) {
+  mask = 0;
+
+  for (auto cpu : cpus) {
+    if (cpu >= sizeof(DWORD_PTR) * 8) {
+      return false;
+    }
+
+    mask |= (DWORD_PTR)1 << cpu;
+  }
+
+  return 0 != mask;
+}
+
+bool libcomp::Platform::SetThreadAffinity(std::thread &thread,
+                                          const std::set<uint32_t> &cpus) {
+  DWORD_PTR mask;
+
+  if (!thread.joinable() || !BuildAffinityMask(cpus, mask)) {
+    return false;
+  }
+
+  return 0 != SetThreadAffinityMask((HANDLE)thread.native_handle(), mask);
+}
+
+bool libcomp::Platform::SetCurrentThreadAffinity(
+    const std::set<uint32_t> &cpus) {
+  DWORD_PTR mask;
+
+  if (!BuildAffinityMask(cpus, mask)) {
+    return false;
+  }
+
+  return 0 != SetThreadAffinityMask(GetCurrentThread(), mask);
+}
+
+std::set<uint32_t> libcomp::Platform::GetCurrentThreadAffinity() {
+  std::set<uint32_t> cpus;
+
+  // There is no GetThreadAffinityMask so set the process mask and restore
+  // the previous value that is returned.
+  DWORD_PTR processMask, systemMask;
+
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processMask,
+                             &systemMask)) {
+    DWORD_PTR mask = SetThreadAffinityMask(GetCurrentThread(), processMask);
+
+    if (0 != mask) {
+      (void)SetThreadAffinityMask(GetCurrentThread(), mask);
+
+      for (uint32_t cpu = 0; cpu < sizeof(DWORD_PTR) * 8; ++cpu) {
+        if (mask & ((DWORD_PTR)1 << cpu)) {
+          cpus.insert(cpu);
+        }
+      }
+    }
+  }
+
+  return cpus;
+}
+
+bool libcomp::Platform::SetCurrentThreadLocalMemory() {
+  // Windows already allocates from the ideal node of the calling thread.
+  return true;
+}
+
+int32_t libcomp::Platform::GetCPUNode(uint32_t cpu) {
+  UCHAR node = 0;
+
+  if (cpu > 0xFF || !GetNumaProcessorNode((UCHAR)cpu, &node) ||
+      0xFF == node) {
+    return -1;
+  }
+
+  return (int32_t)node;
+}
+
 #endif  // _WIN32
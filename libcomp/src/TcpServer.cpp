@@ -28,6 +28,7 @@
 
 #include "BaseConstants.h"
 #include "BaseLog.h"
+#include "Platform.h"
 #include "TcpConnection.h"
 #include "WindowsService.h"
 
@@ -101,6 +102,17 @@ int TcpServer::Start(bool delayReady) {
     pthread_setname_np(pthread_self(), "asio");
 #endif  // !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
 
+    if (mServiceCPUs.empty()) {
+      ServiceThreadPlaced(mServiceCPUs);
+    } else if (Platform::SetCurrentThreadAffinity(mServiceCPUs)) {
+      ServiceThreadPlaced(mServiceCPUs);
+    } else {
+      LogGeneralWarningMsg("Failed to set the CPU affinity of the ASIO "
+                           "service thread.\n");
+
+      ServiceThreadPlaced(std::set<uint32_t>());
+    }
+
     mService.run();
   });
 
@@ -115,6 +127,10 @@ int TcpServer::Start(bool delayReady) {
   return returnCode;
 }
 
+void TcpServer::SetServiceAffinity(const std::set<uint32_t>& cpus) {
+  mServiceCPUs = cpus;
+}
+
 void TcpServer::RemoveConnection(std::shared_ptr<TcpConnection>& connection) {
   // Lock the mutex.
   std::lock_guard<std::mutex> lock(mConnectionsLock);
@@ -127,6 +143,10 @@ void TcpServer::RemoveConnection(std::shared_ptr<TcpConnection>& connection) {
 
 int TcpServer::Run() { return 0; }
 
+void TcpServer::ServiceThreadPlaced(const std::set<uint32_t>& cpus) {
+  (void)cpus;
+}
+
 void TcpServer::ServerReady() {
   LogGeneralInfoMsg("Server ready!\n");
 
@@ -43,6 +43,7 @@
 // Standard C++ Includes
 #include <memory>
 #include <mutex>
+#include <set>
 #include <thread>
 
 namespace libcomp {
@@ -84,6 +85,13 @@ class TcpServer {
    */
   virtual int Start(bool delayReady = false);
 
+  /**
+   * Set the CPUs the thread running the ASIO service should be placed on.
+   * This must be called before @ref Start to have any effect.
+   * @param cpus Indexes of the CPUs the service may run on (empty for any).
+   */
+  void SetServiceAffinity(const std::set<uint32_t>& cpus);
+
   /**
    * Remove a connection from the list of client connections.
    * @param connection Connection to remove.
@@ -124,6 +132,14 @@ class TcpServer {
   virtual std::shared_ptr<TcpConnection> CreateConnection(
       asio::ip::tcp::socket& socket);
 
+  /**
+   * Called from the ASIO service thread when it starts with the CPUs it
+   * was placed on by @ref SetServiceAffinity.
+   * @param cpus Indexes of the CPUs the service thread may run on or an
+   *  empty set if it was not pinned (or the placement failed).
+   */
+  virtual void ServiceThreadPlaced(const std::set<uint32_t>& cpus);
+
   /**
    * Get the Diffie-Hellman key pair used by this server.
    * @return Key pair or nullptr if one is not set.
@@ -161,6 +177,9 @@ class TcpServer {
   /// Thread that runs the ASIO service.
   std::thread mServiceThread;
 
+  /// CPUs the ASIO service thread should be placed on (empty for any).
+  std::set<uint32_t> mServiceCPUs;
+
   /// Diffie-Hellman key pair used to encrypt connections.
   std::shared_ptr<Crypto::DiffieHellman> mDiffieHellman;
 
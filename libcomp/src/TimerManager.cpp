@@ -26,44 +26,865 @@
 
 #include "TimerManager.h"
 
+// libcomp Includes
+#include "BaseLog.h"
+#include "Platform.h"
+#include "Worker.h"
+
+// Standard C++11 Includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
 namespace libcomp {
 
+/**
+ * Raise an atomic maximum to a value if it is higher.
+ * @param max Maximum to update.
+ * @param value Value to compare against.
+ */
+static void AtomicMax(std::atomic<uint64_t> &max, uint64_t value) {
+  uint64_t current = max;
+
+  while (value > current && !max.compare_exchange_weak(current, value)) {
+  }
+}
+
+/**
+ * Get the time between two points in microseconds.
+ * @param from Start time.
+ * @param to End time.
+ * @return Microseconds from the start to the end or 0 if the end is
+ *  before the start.
+ */
+static uint64_t ElapsedMicroseconds(
+    const std::chrono::steady_clock::time_point &from,
+    const std::chrono::steady_clock::time_point &to) {
+  auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+
+  return elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+}
+
+/**
+ * Thread safe version of @ref TimerHistogram that samples are recorded in.
+ */
+class TimerHistogramCounter {
+ public:
+  TimerHistogramCounter() : mCount(0), mTotal(0), mMax(0) {
+    for (auto &bucket : mBuckets) {
+      bucket = 0;
+    }
+  }
+
+  /**
+   * Add a sample to the histogram.
+   * @param value Sample to add (microseconds).
+   */
+  void Record(uint64_t value) {
+    size_t bucket = 0;
+
+    while (bucket < (TimerHistogram::BUCKET_COUNT - 1) &&
+           value >= ((uint64_t)1 << bucket)) {
+      bucket++;
+    }
+
+    mBuckets[bucket]++;
+    mCount++;
+    mTotal += value;
+
+    AtomicMax(mMax, value);
+  }
+
+  /**
+   * Copy the histogram.
+   * @param histogram Histogram to copy to.
+   */
+  void Snapshot(TimerHistogram &histogram) const {
+    for (size_t i = 0; i < TimerHistogram::BUCKET_COUNT; ++i) {
+      histogram.buckets[i] = mBuckets[i];
+    }
+
+    histogram.count = mCount;
+    histogram.total = mTotal;
+    histogram.max = mMax;
+  }
+
+ private:
+  std::atomic<uint64_t> mBuckets[TimerHistogram::BUCKET_COUNT];
+  std::atomic<uint64_t> mCount;
+  std::atomic<uint64_t> mTotal;
+  std::atomic<uint64_t> mMax;
+};
+
+/**
+ * Statistics shared by the timer thread and any worker callbacks are
+ * dispatched to along with the clock they are measured against.
+ */
+class TimerStatsCounters {
+ public:
+  explicit TimerStatsCounters(bool manualClock)
+      : mPeriodicOverruns(0),
+        mManualClock(manualClock),
+        mManualTime(
+            std::chrono::steady_clock::now().time_since_epoch().count()) {}
+
+  /**
+   * Get the current time of the clock events are scheduled against.
+   * @return Current time of the manual clock if there is one or the
+   *  steady clock otherwise.
+   */
+  std::chrono::steady_clock::time_point Now() const {
+    if (mManualClock) {
+      return std::chrono::steady_clock::time_point(
+          std::chrono::steady_clock::duration(mManualTime.load()));
+    }
+
+    return std::chrono::steady_clock::now();
+  }
+
+  /**
+   * Move the manual clock forward.
+   * @param elapsed Time to move the clock forward by.
+   */
+  void AdvanceClock(const std::chrono::milliseconds &elapsed) {
+    mManualTime +=
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            elapsed)
+            .count();
+  }
+
+  /**
+   * Record a callback that has run.
+   * @param period Period of the event or zero for a one-shot event.
+   * @param lateness Time the callback started after it was scheduled
+   *  (microseconds).
+   * @param runTime Time the callback took (microseconds).
+   */
+  void RecordRun(const std::chrono::milliseconds &period, uint64_t lateness,
+                 uint64_t runTime) {
+    if (0 < period.count()) {
+      mPeriodicLateness.Record(lateness);
+
+      // The callback finished after the next run was due.
+      if ((lateness + runTime) >= static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::microseconds>(period)
+                  .count())) {
+        mPeriodicOverruns++;
+      }
+    } else {
+      mOneShotLateness.Record(lateness);
+    }
+
+    mRunTime.Record(runTime);
+  }
+
+  /// How late one-shot callbacks started
+  TimerHistogramCounter mOneShotLateness;
+
+  /// How late periodic callbacks started
+  TimerHistogramCounter mPeriodicLateness;
+
+  /// How long callbacks took to run
+  TimerHistogramCounter mRunTime;
+
+  /// Number of periodic callbacks that finished after the next run was due
+  std::atomic<uint64_t> mPeriodicOverruns;
+
+ private:
+  /// Set when time only moves when the clock is advanced
+  bool mManualClock;
+
+  /// Current time of the manual clock (steady clock ticks)
+  std::atomic<std::chrono::steady_clock::rep> mManualTime;
+};
+
+/**
+ * State of a @ref TimerEvent node.
+ */
+enum class TimerEventState_t : uint8_t {
+  FREE = 0,  //!< Node is in the pool.
+  PENDING,   //!< Event is waiting in the queue.
+  FIRING,    //!< Event has been taken from the queue to run.
+};
+
+/**
+ * Worker timer events are dispatched to and how late the callbacks ran
+ * once they reached the worker.
+ */
+class TimerTarget {
+ public:
+  explicit TimerTarget(const std::shared_ptr<Worker> &worker)
+      : mWorker(worker),
+        mName(worker->GetWorkerName()),
+        mCount(0),
+        mTotalLateness(0),
+        mMaxLateness(0) {}
+
+  /**
+   * Record how late a callback ran on the worker. This is called from the
+   * worker thread.
+   * @param lateness Time between when the callback was scheduled and when
+   *  it ran (microseconds).
+   */
+  void RecordLateness(uint64_t lateness) {
+    mCount++;
+    mTotalLateness += lateness;
+
+    AtomicMax(mMaxLateness, lateness);
+  }
+
+  /// Worker the events are dispatched to
+  std::weak_ptr<Worker> mWorker;
+
+  /// Last known name of the worker
+  String mName;
+
+  /// Number of callbacks that ran on the worker
+  std::atomic<uint64_t> mCount;
+
+  /// Sum of how late each callback ran (microseconds)
+  std::atomic<uint64_t> mTotalLateness;
+
+  /// Longest a callback ran late (microseconds)
+  std::atomic<uint64_t> mMaxLateness;
+};
+
+/**
+ * Message queued on a worker when a dispatched timer event fires. The
+ * event message is shared so a periodic event may be queued again or
+ * cancelled while this is still waiting in the queue.
+ */
+class TimerDispatch : public libcomp::Message::Execute {
+ public:
+  TimerDispatch(const std::shared_ptr<libcomp::Message::Execute> &msg,
+                const std::chrono::steady_clock::time_point &time,
+                const std::chrono::milliseconds &period,
+                const std::shared_ptr<TimerTarget> &target,
+                const std::shared_ptr<TimerStatsCounters> &stats)
+      : mMessage(msg),
+        mTime(time),
+        mPeriod(period),
+        mTarget(target),
+        mStats(stats) {
+    SetPriority(MessagePriority_t::PRIORITY_HIGH);
+  }
+
+  virtual ~TimerDispatch() {}
+
+  libcomp::Message::MessageType GetType() const override {
+    return libcomp::Message::MessageType::MESSAGE_TYPE_SYSTEM;
+  }
+
+  libcomp::String Dump() const override {
+    return libcomp::String(
+               "Message: Timer Dispatch\n"
+               "%1")
+        .Arg(mMessage->Dump());
+  }
+
+  void Run() override {
+    auto start = mStats->Now();
+    uint64_t lateness = ElapsedMicroseconds(mTime, start);
+
+    mTarget->RecordLateness(lateness);
+    mMessage->Run();
+    mStats->RecordRun(mPeriod, lateness,
+                      ElapsedMicroseconds(start, mStats->Now()));
+  }
+
+ private:
+  /// Message of the timer event
+  std::shared_ptr<libcomp::Message::Execute> mMessage;
+
+  /// Time the event was scheduled to fire
+  std::chrono::steady_clock::time_point mTime;
+
+  /// Period of the event or zero for a one-shot event
+  std::chrono::milliseconds mPeriod;
+
+  /// Target the message was dispatched to
+  std::shared_ptr<TimerTarget> mTarget;
+
+  /// Statistics of the timer manager
+  std::shared_ptr<TimerStatsCounters> mStats;
+};
+
 class TimerEvent {
   friend class TimerEventComp;
   friend class TimerManager;
+  friend class TimerEventSet;
+  friend class TimerEventWheel;
 
  protected:
   TimerEvent();
   ~TimerEvent();
 
+  /**
+   * Free the message and clear the event so the node can be reused.
+   */
+  void Reset();
+
   std::chrono::steady_clock::time_point time;
   std::chrono::milliseconds period;
-  libcomp::Message::Execute *msg;
+  std::shared_ptr<libcomp::Message::Execute> msg;
   bool mIsPeriodic;
+
+  /// Worker to dispatch the message to (null to use the default target)
+  std::shared_ptr<TimerTarget> mTarget;
+
+  /// Set when the event is cancelled after it was taken to run
+  bool mCancelled;
+
+  /// State of the event node
+  TimerEventState_t mState;
+
+  /// Index of the node in the pool
+  uint32_t mIndex;
+
+  /// Generation of the node (changed each time it returns to the pool)
+  uint32_t mGeneration;
+
+  /// Tick the event expires on (timing wheel only)
+  uint64_t mExpiryTick;
+
+  /// Slot list the event is in (timing wheel only)
+  void *mSlot;
+
+  /// Previous event in the slot list (timing wheel only)
+  TimerEvent *mPrev;
+
+  /// Next event in the slot list (timing wheel only)
+  TimerEvent *mNext;
+};
+
+/**
+ * Ordered collection of pending @ref TimerEvent instances. All calls are
+ * made with the event lock of the owning @ref TimerManager held.
+ */
+class TimerEventQueue {
+ public:
+  virtual ~TimerEventQueue() {}
+
+  /**
+   * Add a pending event.
+   * @param pEvent Event to add.
+   */
+  virtual void Insert(TimerEvent *pEvent) = 0;
+
+  /**
+   * Remove a pending event.
+   * @param pEvent Event to remove.
+   */
+  virtual void Remove(TimerEvent *pEvent) = 0;
+
+  /**
+   * Remove every event that is due in the order they should fire.
+   * @param now Current time.
+   * @param expired List to add the due events to.
+   */
+  virtual void PopExpired(const std::chrono::steady_clock::time_point &now,
+                          std::list<TimerEvent *> &expired) = 0;
+
+  /**
+   * Get the time the timer thread should next wake up.
+   * @param time Output time to wake up at.
+   * @return false if there are no pending events.
+   */
+  virtual bool NextWakeTime(
+      std::chrono::steady_clock::time_point &time) const = 0;
+
+  /**
+   * Remove every pending event.
+   * @param events List to add the events to.
+   */
+  virtual void Clear(std::list<TimerEvent *> &events) = 0;
+
+  /**
+   * Get the number of pending events.
+   * @return Number of pending events.
+   */
+  virtual size_t Size() const = 0;
+};
+
+/**
+ * Pending events sorted by time in a multiset.
+ */
+class TimerEventSet : public TimerEventQueue {
+ public:
+  void Insert(TimerEvent *pEvent) override { mEvents.insert(pEvent); }
+
+  void Remove(TimerEvent *pEvent) override {
+    // Events are only compared by time so search the range of events
+    // with the same time for this exact event.
+    auto range = mEvents.equal_range(pEvent);
+
+    for (auto it = range.first; it != range.second; ++it) {
+      if (*it == pEvent) {
+        mEvents.erase(it);
+        break;
+      }
+    }
+  }
+
+  void PopExpired(const std::chrono::steady_clock::time_point &now,
+                  std::list<TimerEvent *> &expired) override {
+    while (!mEvents.empty()) {
+      auto it = mEvents.begin();
+
+      if ((*it)->time > now) {
+        break;
+      }
+
+      expired.push_back(*it);
+      mEvents.erase(it);
+    }
+  }
+
+  bool NextWakeTime(
+      std::chrono::steady_clock::time_point &time) const override {
+    if (mEvents.empty()) {
+      return false;
+    }
+
+    time = (*mEvents.begin())->time;
+
+    return true;
+  }
+
+  void Clear(std::list<TimerEvent *> &events) override {
+    events.insert(events.end(), mEvents.begin(), mEvents.end());
+    mEvents.clear();
+  }
+
+  size_t Size() const override { return mEvents.size(); }
+
+ private:
+  std::multiset<TimerEvent *, TimerEventComp> mEvents;
+};
+
+/**
+ * Pending events in a hierarchical timing wheel. Time is split into ticks
+ * of a fixed resolution. Each level of the wheel has 256 slots and covers
+ * 256 times the range of the level below it. Events are placed in the
+ * lowest level that covers their expiry and cascade down a level each
+ * time the level below wraps around. Events too far out for the top level
+ * wait in an overflow list.
+ */
+class TimerEventWheel : public TimerEventQueue {
+ public:
+  /// Number of bits of the tick used to index each level
+  static const uint32_t LEVEL_BITS = 8;
+
+  /// Number of slots in each level
+  static const uint32_t LEVEL_SIZE = 1 << LEVEL_BITS;
+
+  /// Mask to get the slot index of a level
+  static const uint64_t LEVEL_MASK = LEVEL_SIZE - 1;
+
+  /// Number of levels in the wheel
+  static const uint32_t LEVEL_COUNT = 4;
+
+  TimerEventWheel(const std::chrono::milliseconds &resolution,
+                  const std::chrono::steady_clock::time_point &start)
+      : mResolution(std::max(resolution, std::chrono::milliseconds(1))),
+        mStart(start),
+        mCurrentTick(0),
+        mCount(0) {
+    for (auto &count : mLevelCounts) {
+      count = 0;
+    }
+  }
+
+  void Insert(TimerEvent *pEvent) override {
+    pEvent->mExpiryTick = ToTickCeil(pEvent->time);
+
+    Place(pEvent);
+
+    mCount++;
+  }
+
+  void Remove(TimerEvent *pEvent) override {
+    Unlink(pEvent);
+
+    mCount--;
+  }
+
+  void PopExpired(const std::chrono::steady_clock::time_point &now,
+                  std::list<TimerEvent *> &expired) override {
+    uint64_t target = ToTickFloor(now);
+
+    if (0 == mCount) {
+      // Nothing can fire so skip straight to the current tick.
+      mCurrentTick = std::max(mCurrentTick, target + 1);
+
+      return;
+    }
+
+    while (mCurrentTick <= target) {
+      // Jump over the ticks where nothing can fire or cascade.
+      uint64_t next = NextActiveTick();
+
+      if (next > target) {
+        mCurrentTick = target + 1;
+        break;
+      }
+
+      mCurrentTick = next;
+
+      uint64_t index = mCurrentTick & LEVEL_MASK;
+
+      // Cascade each level that wraps on this tick into the level below.
+      if (0 == index) {
+        uint32_t level = 1;
+
+        for (; level < LEVEL_COUNT; ++level) {
+          uint64_t levelIndex =
+              (mCurrentTick >> (level * LEVEL_BITS)) & LEVEL_MASK;
+
+          Cascade(mSlots[level][levelIndex]);
+
+          if (0 != levelIndex) {
+            break;
+          }
+        }
+
+        if (LEVEL_COUNT == level) {
+          Cascade(mOverflow);
+        }
+      }
+
+      Slot &slot = mSlots[0][index];
+
+      while (nullptr != slot.head) {
+        TimerEvent *pEvent = slot.head;
+
+        Unlink(pEvent);
+        expired.push_back(pEvent);
+
+        mCount--;
+      }
+
+      mCurrentTick++;
+
+      if (0 == mCount) {
+        mCurrentTick = std::max(mCurrentTick, target + 1);
+        break;
+      }
+    }
+  }
+
+  bool NextWakeTime(
+      std::chrono::steady_clock::time_point &time) const override {
+    if (0 == mCount) {
+      return false;
+    }
+
+    // Look for an event in what is left of this turn of the first level.
+    // If there is none wake up when the level wraps so the levels above
+    // can cascade down. If the next tick is a wrap the cascade for it
+    // has not happened yet so wake up for that tick.
+    uint64_t tick = NextActiveTick();
+
+    while (0 != (tick & LEVEL_MASK) &&
+           nullptr == mSlots[0][tick & LEVEL_MASK].head) {
+      tick++;
+    }
+
+    time = mStart + mResolution * static_cast<int64_t>(tick);
+
+    return true;
+  }
+
+  void Clear(std::list<TimerEvent *> &events) override {
+    for (auto &level : mSlots) {
+      for (auto &slot : level) {
+        ClearSlot(slot, events);
+      }
+    }
+
+    ClearSlot(mOverflow, events);
+
+    for (auto &count : mLevelCounts) {
+      count = 0;
+    }
+
+    mCount = 0;
+  }
+
+  size_t Size() const override { return mCount; }
+
+ private:
+  /// Intrusive list of the events in a slot
+  struct Slot {
+    Slot() : head(nullptr), tail(nullptr) {}
+
+    TimerEvent *head;
+    TimerEvent *tail;
+  };
+
+  /**
+   * Get the first tick from the current tick where an event may fire or
+   * a level may cascade. If the first level is empty every tick up to
+   * the next wrap of the lowest level holding events can be skipped.
+   * @return Next tick that needs to be processed.
+   */
+  uint64_t NextActiveTick() const {
+    uint32_t level = 0;
+
+    while (level < LEVEL_COUNT && 0 == mLevelCounts[level]) {
+      level++;
+    }
+
+    if (0 == level) {
+      return mCurrentTick;
+    }
+
+    uint64_t span = (uint64_t)1 << (level * LEVEL_BITS);
+
+    return (mCurrentTick + span - 1) & ~(span - 1);
+  }
+
+  /**
+   * Get the level a slot belongs to.
+   * @param pSlot Slot to check.
+   * @return Level of the slot or LEVEL_COUNT for the overflow list.
+   */
+  uint32_t LevelOf(const Slot *pSlot) const {
+    if (&mOverflow == pSlot) {
+      return LEVEL_COUNT;
+    }
+
+    return static_cast<uint32_t>((pSlot - &mSlots[0][0]) / LEVEL_SIZE);
+  }
+
+  uint64_t ToTickCeil(const std::chrono::steady_clock::time_point &time) const {
+    if (time <= mStart) {
+      return 0;
+    }
+
+    auto elapsed = (time - mStart).count();
+    auto resolution =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            mResolution)
+            .count();
+
+    return static_cast<uint64_t>((elapsed + resolution - 1) / resolution);
+  }
+
+  uint64_t ToTickFloor(
+      const std::chrono::steady_clock::time_point &time) const {
+    if (time <= mStart) {
+      return 0;
+    }
+
+    return static_cast<uint64_t>((time - mStart) / mResolution);
+  }
+
+  void Place(TimerEvent *pEvent) {
+    // Anything already due goes in the slot processed next.
+    uint64_t expiry = std::max(pEvent->mExpiryTick, mCurrentTick);
+    uint64_t delta = expiry - mCurrentTick;
+
+    Slot *pSlot = &mOverflow;
+
+    for (uint32_t level = 0; level < LEVEL_COUNT; ++level) {
+      if (delta < ((uint64_t)1 << ((level + 1) * LEVEL_BITS))) {
+        pSlot = &mSlots[level][(expiry >> (level * LEVEL_BITS)) & LEVEL_MASK];
+        break;
+      }
+    }
+
+    pEvent->mSlot = pSlot;
+    pEvent->mNext = nullptr;
+    pEvent->mPrev = pSlot->tail;
+
+    mLevelCounts[LevelOf(pSlot)]++;
+
+    if (nullptr != pSlot->tail) {
+      pSlot->tail->mNext = pEvent;
+    } else {
+      pSlot->head = pEvent;
+    }
+
+    pSlot->tail = pEvent;
+  }
+
+  void Unlink(TimerEvent *pEvent) {
+    Slot *pSlot = static_cast<Slot *>(pEvent->mSlot);
+
+    mLevelCounts[LevelOf(pSlot)]--;
+
+    if (nullptr != pEvent->mPrev) {
+      pEvent->mPrev->mNext = pEvent->mNext;
+    } else {
+      pSlot->head = pEvent->mNext;
+    }
+
+    if (nullptr != pEvent->mNext) {
+      pEvent->mNext->mPrev = pEvent->mPrev;
+    } else {
+      pSlot->tail = pEvent->mPrev;
+    }
+
+    pEvent->mSlot = nullptr;
+    pEvent->mPrev = nullptr;
+    pEvent->mNext = nullptr;
+  }
+
+  void Cascade(Slot &slot) {
+    TimerEvent *pEvent = slot.head;
+    uint32_t level = LevelOf(&slot);
+
+    slot.head = nullptr;
+    slot.tail = nullptr;
+
+    while (nullptr != pEvent) {
+      TimerEvent *pNext = pEvent->mNext;
+
+      mLevelCounts[level]--;
+
+      Place(pEvent);
+
+      pEvent = pNext;
+    }
+  }
+
+  void ClearSlot(Slot &slot, std::list<TimerEvent *> &events) {
+    for (TimerEvent *pEvent = slot.head; nullptr != pEvent;
+         pEvent = pEvent->mNext) {
+      events.push_back(pEvent);
+    }
+
+    slot.head = nullptr;
+    slot.tail = nullptr;
+  }
+
+  /// Length of a tick
+  std::chrono::milliseconds mResolution;
+
+  /// Time of tick zero
+  std::chrono::steady_clock::time_point mStart;
+
+  /// Next tick to process
+  uint64_t mCurrentTick;
+
+  /// Number of pending events
+  size_t mCount;
+
+  /// Slots of each level of the wheel
+  Slot mSlots[LEVEL_COUNT][LEVEL_SIZE];
+
+  /// Events too far out to fit in the wheel
+  Slot mOverflow;
+
+  /// Number of events in each level with the overflow list last
+  size_t mLevelCounts[LEVEL_COUNT + 1];
 };
 
 }  // namespace libcomp
 
 using namespace libcomp;
 
-TimerEvent::TimerEvent() : msg(nullptr), mIsPeriodic(false) {}
+/// Number of event nodes to allocate each time the pool runs out
+static const size_t EVENT_BLOCK_SIZE = 256;
+
+TimerEvent::TimerEvent()
+    : period(0),
+      mIsPeriodic(false),
+      mCancelled(false),
+      mState(TimerEventState_t::FREE),
+      mIndex(0),
+      mGeneration(0),
+      mExpiryTick(0),
+      mSlot(nullptr),
+      mPrev(nullptr),
+      mNext(nullptr) {}
 
-TimerEvent::~TimerEvent() { delete msg; }
+TimerEvent::~TimerEvent() {}
+
+void TimerEvent::Reset() {
+  msg.reset();
+  mTarget.reset();
+
+  period = std::chrono::milliseconds(0);
+  mIsPeriodic = false;
+  mCancelled = false;
+  mState = TimerEventState_t::FREE;
+  mExpiryTick = 0;
+  mSlot = nullptr;
+  mPrev = nullptr;
+  mNext = nullptr;
+}
+
+TimerHistogram::TimerHistogram() : count(0), total(0), max(0) {
+  for (auto &bucket : buckets) {
+    bucket = 0;
+  }
+}
+
+uint64_t TimerHistogram::Percentile(double percentile) const {
+  if (0 == count) {
+    return 0;
+  }
+
+  uint64_t target = static_cast<uint64_t>(
+      std::ceil(static_cast<double>(count) * percentile / 100.0));
+  uint64_t seen = 0;
+
+  for (size_t i = 0; i < (BUCKET_COUNT - 1); ++i) {
+    seen += buckets[i];
+
+    if (seen >= target) {
+      return std::min((uint64_t)1 << i, max);
+    }
+  }
+
+  return max;
+}
+
+/// Index of a handle that does not refer to any event
+static const uint32_t INVALID_EVENT_INDEX = UINT32_MAX;
+
+TimerHandle::TimerHandle()
+    : mIndex(INVALID_EVENT_INDEX), mGeneration(0) {}
+
+TimerHandle::TimerHandle(uint32_t index, uint32_t generation)
+    : mIndex(index), mGeneration(generation) {}
+
+bool TimerHandle::IsValid() const { return INVALID_EVENT_INDEX != mIndex; }
 
 bool TimerEventComp::operator()(const TimerEvent *lhs,
                                 const TimerEvent *rhs) const {
   return lhs->time < rhs->time;
 }
 
-TimerManager::TimerManager() : mRunning(true), mProcessingEvents(false) {
+TimerManager::TimerManager(TimerBackend_t backend,
+                           const std::chrono::milliseconds &resolution,
+                           bool manualClock)
+    : mRunning(true),
+      mBackend(backend),
+      mManualClock(manualClock),
+      mStats(std::make_shared<TimerStatsCounters>(manualClock)) {
+  if (TimerBackend_t::TIMING_WHEEL == backend) {
+    mEvents.reset(new TimerEventWheel(resolution, Now()));
+  } else {
+    mEvents.reset(new TimerEventSet);
+  }
+
+  // Events only fire when the manual clock is advanced.
+  if (manualClock) {
+    return;
+  }
+
   mRunThread = std::thread([&]() {
 #if !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
     pthread_setname_np(pthread_self(), "timer");
 #endif  // !defined(EXOTIC_PLATFORM) && !defined(_WIN32) && !defined(__APPLE__)
 
-    while (mRunning) {
-      std::unique_lock<std::mutex> lock(mEventLock);
+    std::unique_lock<std::mutex> lock(mEventLock);
 
+    while (mRunning) {
       ProcessEvents(lock);
       WaitForEvent(lock);
     }
@@ -71,119 +892,376 @@ TimerManager::TimerManager() : mRunning(true), mProcessingEvents(false) {
 }
 
 TimerManager::~TimerManager() {
-  mRunning = false;
+  {
+    std::unique_lock<std::mutex> lock(mEventLock);
 
-  mEventCondition.notify_all();
+    mRunning = false;
 
-  mRunThread.join();
+    mEventCondition.notify_all();
+  }
 
-  for (TimerEvent *pEvent : mEvents) {
-    delete pEvent;
+  if (mRunThread.joinable()) {
+    mRunThread.join();
   }
+
+  std::list<TimerEvent *> events;
+  mEvents->Clear(events);
+
+  for (TimerEvent *pEvent : events) {
+    pEvent->Reset();
+  }
+
+  for (TimerEvent *pBlock : mEventBlocks) {
+    delete[] pBlock;
+  }
+}
+
+TimerBackend_t TimerManager::GetBackend() const { return mBackend; }
+
+std::chrono::steady_clock::time_point TimerManager::Now() const {
+  return mStats->Now();
+}
+
+void TimerManager::AdvanceClock(const std::chrono::milliseconds &elapsed) {
+  if (!mManualClock) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mEventLock);
+
+  mStats->AdvanceClock(elapsed);
+
+  auto now = Now();
+
+  // Keep processing like the timer thread would until nothing else is due.
+  std::chrono::steady_clock::time_point next;
+
+  do {
+    ProcessEvents(lock);
+  } while (mEvents->NextWakeTime(next) && next <= now);
+}
+
+TimerEvent *TimerManager::AllocateEvent() {
+  if (mFreeEvents.empty()) {
+    TimerEvent *pBlock = new TimerEvent[EVENT_BLOCK_SIZE];
+    mEventBlocks.push_back(pBlock);
+
+    for (size_t i = 0; i < EVENT_BLOCK_SIZE; ++i) {
+      pBlock[i].mIndex = static_cast<uint32_t>(mEventNodes.size());
+      mEventNodes.push_back(&pBlock[i]);
+    }
+
+    for (size_t i = EVENT_BLOCK_SIZE; i > 0; --i) {
+      mFreeEvents.push_back(&pBlock[i - 1]);
+    }
+  }
+
+  TimerEvent *pEvent = mFreeEvents.back();
+  mFreeEvents.pop_back();
+
+  return pEvent;
+}
+
+void TimerManager::ReleaseEvent(TimerEvent *pEvent) {
+  pEvent->Reset();
+  pEvent->mGeneration++;
+
+  mFreeEvents.push_back(pEvent);
 }
 
 void TimerManager::ProcessEvents(std::unique_lock<std::mutex> &lock) {
-  auto now = std::chrono::steady_clock::now();
+  auto now = Now();
+
+  std::list<TimerEvent *> expired;
+  mEvents->PopExpired(now, expired);
 
-  std::list<TimerEvent *> periodicals;
+  for (TimerEvent *pEvent : expired) {
+    pEvent->mState = TimerEventState_t::FIRING;
+  }
 
-  mProcessingEvents = true;
+  bool pruneTargets = false;
 
-  while (!mEvents.empty()) {
-    auto it = mEvents.begin();
+  for (TimerEvent *pEvent : expired) {
+    auto target = pEvent->mTarget ? pEvent->mTarget : mDefaultTarget;
 
-    TimerEvent *pEvent = *it;
+    if (target) {
+      // Only queue the message on the worker so the timer thread is free
+      // to keep scheduling. Events for a worker that is gone are dropped.
+      auto worker = target->mWorker.lock();
+      auto queue = worker ? worker->GetMessageQueue() : nullptr;
 
-    if (pEvent->time > now) {
-      break;
-    } else {
-      mEvents.erase(it++);
-
-      if (pEvent->msg) {
-        // Unlock the mutex in the case the callback waits on another
-        // mutex that waits on the timer or the callback tries to
-        // register a new timer event. We don't like deadlocks.
-        lock.unlock();
-        pEvent->msg->Run();
-        lock.lock();
+      if (queue && pEvent->msg && !pEvent->mCancelled) {
+        queue->Enqueue(new TimerDispatch(pEvent->msg, pEvent->time,
+                                         pEvent->period, target, mStats));
+      } else if (!queue) {
+        pEvent->mCancelled = true;
+        pruneTargets = true;
       }
+    } else if (pEvent->msg && !pEvent->mCancelled) {
+      // Unlock the mutex in the case the callback waits on another
+      // mutex that waits on the timer or the callback tries to
+      // register a new timer event. We don't like deadlocks.
+      lock.unlock();
 
-      if (pEvent->mIsPeriodic) {
-        pEvent->time += pEvent->period;
+      auto start = Now();
+      pEvent->msg->Run();
 
-        periodicals.push_back(pEvent);
-      } else {
-        delete pEvent;
-      }
+      mStats->RecordRun(pEvent->period,
+                        ElapsedMicroseconds(pEvent->time, start),
+                        ElapsedMicroseconds(start, Now()));
+
+      lock.lock();
     }
-  }
 
-  for (TimerEvent *pEvent : periodicals) {
-    mEvents.insert(pEvent);
+    if (pEvent->mIsPeriodic && !pEvent->mCancelled) {
+      pEvent->time += pEvent->period;
+      pEvent->mState = TimerEventState_t::PENDING;
+
+      mEvents->Insert(pEvent);
+    } else {
+      ReleaseEvent(pEvent);
+    }
   }
 
-  mProcessingEvents = false;
+  if (pruneTargets) {
+    PruneTargets();
+  }
 }
 
 void TimerManager::WaitForEvent(std::unique_lock<std::mutex> &lock) {
-  if (mEvents.empty()) {
+  std::chrono::steady_clock::time_point next;
+
+  if (!mRunning) {
+    return;
+  } else if (!mEvents->NextWakeTime(next)) {
     // Wait for at least one event.
     mEventCondition.wait(lock);
   } else {
     // We don't care why we wake we'll check everything anyway.
-    (void)mEventCondition.wait_until(lock, (*mEvents.begin())->time);
+    (void)mEventCondition.wait_until(lock, next);
   }
 }
 
-TimerEvent *TimerManager::RegisterEvent(
+TimerHandle TimerManager::RegisterEvent(
     const std::chrono::steady_clock::time_point &time,
     libcomp::Message::Execute *pMessage) {
-  TimerEvent *pEvent = new TimerEvent;
-  pEvent->time = time;
-  pEvent->msg = pMessage;
+  return RegisterEvent(time, pMessage, nullptr);
+}
 
+TimerHandle TimerManager::RegisterPeriodicEvent(
+    const std::chrono::milliseconds &period,
+    libcomp::Message::Execute *pMessage) {
+  return RegisterPeriodicEvent(period, pMessage, nullptr);
+}
+
+TimerHandle TimerManager::RegisterEvent(
+    const std::chrono::steady_clock::time_point &time,
+    libcomp::Message::Execute *pMessage,
+    const std::shared_ptr<Worker> &target) {
   std::unique_lock<std::mutex> lock(mEventLock);
 
-  mEvents.insert(pEvent);
+  TimerEvent *pEvent = AllocateEvent();
+  pEvent->time = time;
+  pEvent->msg.reset(pMessage);
+  pEvent->mTarget = GetTarget(target);
+  pEvent->mState = TimerEventState_t::PENDING;
+
+  mEvents->Insert(pEvent);
   mEventCondition.notify_all();
 
-  return pEvent;
+  return TimerHandle(pEvent->mIndex, pEvent->mGeneration);
 }
 
-TimerEvent *TimerManager::RegisterPeriodicEvent(
+TimerHandle TimerManager::RegisterPeriodicEvent(
     const std::chrono::milliseconds &period,
-    libcomp::Message::Execute *pMessage) {
-  TimerEvent *pEvent = new TimerEvent;
-  pEvent->time = std::chrono::steady_clock::now() + period;
+    libcomp::Message::Execute *pMessage,
+    const std::shared_ptr<Worker> &target) {
+  std::unique_lock<std::mutex> lock(mEventLock);
+
+  TimerEvent *pEvent = AllocateEvent();
+  pEvent->time = Now() + period;
   pEvent->period = period;
   pEvent->mIsPeriodic = true;
-  pEvent->msg = pMessage;
-
-  std::unique_lock<std::mutex> lock(mEventLock);
+  pEvent->msg.reset(pMessage);
+  pEvent->mTarget = GetTarget(target);
+  pEvent->mState = TimerEventState_t::PENDING;
 
-  mEvents.insert(pEvent);
+  mEvents->Insert(pEvent);
   mEventCondition.notify_all();
 
-  return pEvent;
+  return TimerHandle(pEvent->mIndex, pEvent->mGeneration);
 }
 
-void TimerManager::CancelEvent(TimerEvent *pEvent) {
+void TimerManager::CancelEvent(const TimerHandle &handle) {
   std::unique_lock<std::mutex> lock(mEventLock);
 
-  // If the event is being processed we can't cancel but if the event
-  // is periodic we can keep it from happening next time.
-  if (mProcessingEvents) {
-    pEvent->mIsPeriodic = false;
+  if (handle.mIndex >= mEventNodes.size()) {
     return;
   }
 
-  auto it = mEvents.find(pEvent);
+  TimerEvent *pEvent = mEventNodes[handle.mIndex];
 
-  if (mEvents.end() != it) {
-    mEvents.erase(it);
+  // The event already fired or was cancelled (the node may be reused).
+  if (pEvent->mGeneration != handle.mGeneration) {
+    return;
+  }
+
+  switch (pEvent->mState) {
+    case TimerEventState_t::PENDING:
+      mEvents->Remove(pEvent);
+      ReleaseEvent(pEvent);
 
-    delete pEvent;
+      mEventCondition.notify_all();
+      break;
+    case TimerEventState_t::FIRING:
+      // The event has been taken to run. If it has not run yet it will
+      // be skipped and either way it will not be scheduled again.
+      pEvent->mCancelled = true;
+      break;
+    default:
+      break;
   }
+}
 
-  mEventCondition.notify_all();
+void TimerManager::SetDefaultTarget(const std::shared_ptr<Worker> &target) {
+  std::unique_lock<std::mutex> lock(mEventLock);
+
+  mDefaultTarget = GetTarget(target);
+}
+
+std::list<TimerTargetLateness> TimerManager::GetTargetLateness() {
+  std::unique_lock<std::mutex> lock(mEventLock);
+
+  std::list<TimerTargetLateness> result;
+
+  PruneTargets();
+
+  for (auto &target : mTargets) {
+    auto worker = target->mWorker.lock();
+
+    if (worker) {
+      target->mName = worker->GetWorkerName();
+    }
+
+    TimerTargetLateness lateness;
+    lateness.target = target->mName;
+    lateness.count = target->mCount;
+    lateness.totalLateness = target->mTotalLateness;
+    lateness.maxLateness = target->mMaxLateness;
+
+    result.push_back(lateness);
+  }
+
+  return result;
+}
+
+TimerStats TimerManager::GetStats() {
+  TimerStats stats;
+  stats.targets = GetTargetLateness();
+
+  mStats->mOneShotLateness.Snapshot(stats.oneShotLateness);
+  mStats->mPeriodicLateness.Snapshot(stats.periodicLateness);
+  mStats->mRunTime.Snapshot(stats.runTime);
+  stats.periodicOverruns = mStats->mPeriodicOverruns;
+
+  std::unique_lock<std::mutex> lock(mEventLock);
+  stats.pending = mEvents->Size();
+
+  return stats;
+}
+
+void TimerManager::SetStatsLogInterval(const std::chrono::seconds &interval) {
+  TimerHandle event;
+
+  {
+    std::unique_lock<std::mutex> lock(mEventLock);
+    std::swap(event, mStatsLogEvent);
+  }
+
+  if (event.IsValid()) {
+    CancelEvent(event);
+  }
+
+  if (0 < interval.count()) {
+    event = SchedulePeriodicEvent(
+        std::chrono::duration_cast<std::chrono::milliseconds>(interval),
+        [this]() { LogStats(); });
+
+    std::unique_lock<std::mutex> lock(mEventLock);
+    mStatsLogEvent = event;
+  }
+}
+
+void TimerManager::LogStats() {
+  auto stats = GetStats();
+
+  LogGeneralInfo([&]() {
+    auto FormatHistogram = [](const char *name,
+                              const TimerHistogram &histogram) {
+      return String("  %1: %2 samples, p50 %3 us, p99 %4 us, max %5 us\n")
+          .Arg(name)
+          .Arg(histogram.count)
+          .Arg(histogram.Percentile(50.0))
+          .Arg(histogram.Percentile(99.0))
+          .Arg(histogram.max);
+    };
+
+    String msg = String("Timer stats: %1 pending, %2 periodic overruns\n")
+                     .Arg(stats.pending)
+                     .Arg(stats.periodicOverruns);
+
+    msg += FormatHistogram("one-shot lateness", stats.oneShotLateness);
+    msg += FormatHistogram("periodic lateness", stats.periodicLateness);
+    msg += FormatHistogram("run time", stats.runTime);
+
+    for (auto &target : stats.targets) {
+      msg += String("  dispatched to %1: %2 callbacks, avg %3 us late, "
+                    "max %4 us late\n")
+                 .Arg(target.target)
+                 .Arg(target.count)
+                 .Arg(target.count ? (target.totalLateness / target.count)
+                                   : 0)
+                 .Arg(target.maxLateness);
+    }
+
+    return msg;
+  });
+}
+
+std::shared_ptr<TimerTarget> TimerManager::GetTarget(
+    const std::shared_ptr<Worker> &worker) {
+  if (!worker) {
+    return nullptr;
+  }
+
+  PruneTargets();
+
+  for (auto &target : mTargets) {
+    if (target->mWorker.lock() == worker) {
+      return target;
+    }
+  }
+
+  auto target = std::make_shared<TimerTarget>(worker);
+  mTargets.push_back(target);
+
+  return target;
+}
+
+void TimerManager::PruneTargets() {
+  for (auto it = mTargets.begin(); it != mTargets.end();) {
+    auto worker = (*it)->mWorker.lock();
+
+    // Events still pending for the target keep it alive until they fire
+    // and are dropped.
+    if (!worker || !worker->GetMessageQueue()) {
+      it = mTargets.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool TimerManager::SetThreadAffinity(const std::set<uint32_t> &cpus) {
+  return Platform::SetThreadAffinity(mRunThread, cpus);
 }
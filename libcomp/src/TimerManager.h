@@ -30,31 +30,251 @@
 // libcomp Includes
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <list>
+#include <memory>
 #include <set>
 #include <thread>
+#include <vector>
 
+#include "CString.h"
 #include "MessageExecute.h"
 
 namespace libcomp {
 
 class TimerEvent;
+class TimerEventQueue;
+class TimerStatsCounters;
+class TimerTarget;
+class Worker;
+
+/**
+ * Handle to an event registered with a @ref TimerManager. The handle
+ * holds the index of the pooled event node and the generation of the node
+ * when the event was registered. The generation changes each time the
+ * node is returned to the pool so a handle kept after the event fired or
+ * was cancelled no longer matches the node and can not cancel the event
+ * that reused it.
+ */
+class TimerHandle {
+  friend class TimerManager;
+
+ public:
+  /**
+   * Create a handle that does not refer to any event.
+   */
+  TimerHandle();
+
+  /**
+   * Check if the handle was returned for an event. This does not check if
+   * the event is still pending.
+   * @return true if the handle refers to an event, false otherwise.
+   */
+  bool IsValid() const;
+
+ private:
+  /**
+   * Create a handle to an event node.
+   * @param index Index of the event node in the pool.
+   * @param generation Generation of the event node.
+   */
+  TimerHandle(uint32_t index, uint32_t generation);
+
+  /// Index of the event node in the pool
+  uint32_t mIndex;
+
+  /// Generation of the event node when the event was registered
+  uint32_t mGeneration;
+};
 
 class TimerEventComp {
  public:
   bool operator()(const TimerEvent* lhs, const TimerEvent* rhs) const;
 };
 
+/**
+ * Data structure used by a @ref TimerManager to order pending events.
+ */
+enum class TimerBackend_t : uint8_t {
+  /// Events are kept in a multiset sorted by time. Events fire at
+  /// exactly the time requested but insert and cancel are O(log n).
+  SORTED_SET = 0,
+  /// Events are kept in a hierarchical timing wheel. Insert and cancel
+  /// are O(1) but events fire on the first tick at or after the time
+  /// requested so they may be up to one tick late.
+  TIMING_WHEEL,
+};
+
+/**
+ * How late timer callbacks dispatched to a worker ran.
+ */
+struct TimerTargetLateness {
+  /// Name of the worker the callbacks were dispatched to
+  String target;
+
+  /// Number of callbacks that ran on the worker
+  uint64_t count;
+
+  /// Sum of the time each callback ran after it was scheduled (microseconds)
+  uint64_t totalLateness;
+
+  /// Longest time a callback ran after it was scheduled (microseconds)
+  uint64_t maxLateness;
+};
+
+/**
+ * Histogram of timer durations. Bucket N counts durations of less than
+ * 2^N microseconds (and at least 2^(N-1)). The last bucket also counts
+ * everything longer.
+ */
+struct TimerHistogram {
+  /// Number of buckets in the histogram
+  static const size_t BUCKET_COUNT = 24;
+
+  TimerHistogram();
+
+  /**
+   * Get the approximate duration a percentage of the samples were under.
+   * @param percentile Percentage of samples (0 to 100).
+   * @return Upper bound of the bucket the percentile falls in
+   *  (microseconds) or 0 if there are no samples.
+   */
+  uint64_t Percentile(double percentile) const;
+
+  /// Number of samples in each bucket
+  uint64_t buckets[BUCKET_COUNT];
+
+  /// Number of samples
+  uint64_t count;
+
+  /// Sum of every sample (microseconds)
+  uint64_t total;
+
+  /// Longest sample (microseconds)
+  uint64_t max;
+};
+
+/**
+ * Snapshot of the timer statistics returned by @ref TimerManager::GetStats.
+ */
+struct TimerStats {
+  /// How late one-shot event callbacks started
+  TimerHistogram oneShotLateness;
+
+  /// How late periodic event callbacks started
+  TimerHistogram periodicLateness;
+
+  /// How long event callbacks took to run
+  TimerHistogram runTime;
+
+  /// Number of events waiting to fire
+  uint64_t pending;
+
+  /// Number of periodic callbacks that finished after the next run was due
+  uint64_t periodicOverruns;
+
+  /// Lateness of the callbacks dispatched to each worker
+  std::list<TimerTargetLateness> targets;
+};
+
+/**
+ * Runs @ref Message::Execute messages at a given time or periodically in
+ * a dedicated "timer" thread. Events may instead be registered with a
+ * target @ref Worker (or a default target may be set for all events) in
+ * which case the timer thread only queues the message on the worker when
+ * the event fires. Cancelling an event does not remove a message that has
+ * already been queued. The returned @ref TimerHandle may be passed to
+ * @ref CancelEvent at any time. Event nodes are pooled and reused but a
+ * handle to an event that has already fired or been cancelled is ignored.
+ */
 class TimerManager {
  public:
-  TimerManager();
+  /**
+   * Create the timer manager and start the timer thread.
+   * @param backend Data structure used to order pending events.
+   * @param resolution Length of a tick for the timing wheel backend.
+   * @param manualClock If true no timer thread is started and time only
+   *  moves when @ref AdvanceClock is called. Events then fire in the
+   *  thread that advances the clock.
+   */
+  explicit TimerManager(
+      TimerBackend_t backend = TimerBackend_t::SORTED_SET,
+      const std::chrono::milliseconds& resolution =
+          std::chrono::milliseconds(1),
+      bool manualClock = false);
   ~TimerManager();
 
-  TimerEvent* RegisterEvent(const std::chrono::steady_clock::time_point& time,
+  TimerHandle RegisterEvent(const std::chrono::steady_clock::time_point& time,
                             libcomp::Message::Execute* pMessage);
-  TimerEvent* RegisterPeriodicEvent(const std::chrono::milliseconds& period,
+  TimerHandle RegisterPeriodicEvent(const std::chrono::milliseconds& period,
                                     libcomp::Message::Execute* pMessage);
-  void CancelEvent(TimerEvent* pEvent);
+  TimerHandle RegisterEvent(const std::chrono::steady_clock::time_point& time,
+                            libcomp::Message::Execute* pMessage,
+                            const std::shared_ptr<Worker>& target);
+  TimerHandle RegisterPeriodicEvent(const std::chrono::milliseconds& period,
+                                    libcomp::Message::Execute* pMessage,
+                                    const std::shared_ptr<Worker>& target);
+
+  /**
+   * Cancel an event. This does nothing if the event already fired (or was
+   * cancelled) even if the event node has since been reused.
+   * @param handle Handle returned when the event was registered.
+   */
+  void CancelEvent(const TimerHandle& handle);
+
+  /**
+   * Set the worker events registered without a target are dispatched to.
+   * @param target Worker to dispatch to or null to run the events in the
+   *  timer thread.
+   */
+  void SetDefaultTarget(const std::shared_ptr<Worker>& target);
+
+  /**
+   * Get how late the callbacks dispatched to each worker ran.
+   * @return Lateness of each worker events have been dispatched to.
+   */
+  std::list<TimerTargetLateness> GetTargetLateness();
+
+  /**
+   * Get a snapshot of how late events fire, how long the callbacks take
+   * and how many events are pending.
+   * @return Snapshot of the timer statistics.
+   */
+  TimerStats GetStats();
+
+  /**
+   * Log a summary of the timer statistics periodically.
+   * @param interval Time between each summary or zero to stop logging.
+   */
+  void SetStatsLogInterval(const std::chrono::seconds& interval);
+
+  /**
+   * Get the data structure used to order pending events.
+   * @return Backend used by the manager.
+   */
+  TimerBackend_t GetBackend() const;
+
+  /**
+   * Get the current time of the clock events are scheduled against.
+   * @return Current time of the manual clock if there is one or the
+   *  steady clock otherwise.
+   */
+  std::chrono::steady_clock::time_point Now() const;
+
+  /**
+   * Move the manual clock forward and fire every event that is due by
+   * the new time in the calling thread. This does nothing unless the
+   * manager was created with a manual clock.
+   * @param elapsed Time to move the clock forward by.
+   */
+  void AdvanceClock(const std::chrono::milliseconds& elapsed);
+
+  /**
+   * Restrict the timer thread to run on a set of CPUs.
+   * @param cpus Indexes of the CPUs the timer thread may run on.
+   * @return true if the thread was placed, false otherwise.
+   */
+  bool SetThreadAffinity(const std::set<uint32_t>& cpus);
 
   /**
    * Executes code in the worker thread.
@@ -63,7 +283,7 @@ class TimerManager {
    * @return true on success, false on failure
    */
   template <typename Function, typename... Args>
-  TimerEvent* ScheduleEvent(const std::chrono::steady_clock::time_point& time,
+  TimerHandle ScheduleEvent(const std::chrono::steady_clock::time_point& time,
                             Function&& f, Args&&... args) {
     auto msg = new libcomp::Message::ExecuteImpl<Args...>(
         std::forward<Function>(f), std::forward<Args>(args)...);
@@ -78,12 +298,11 @@ class TimerManager {
    * @return true on success, false on failure
    */
   template <typename Function, typename... Args>
-  TimerEvent* ScheduleEventIn(int seconds, Function&& f, Args&&... args) {
+  TimerHandle ScheduleEventIn(int seconds, Function&& f, Args&&... args) {
     auto msg = new libcomp::Message::ExecuteImpl<Args...>(
         std::forward<Function>(f), std::forward<Args>(args)...);
 
-    return RegisterEvent(
-        std::chrono::steady_clock::now() + std::chrono::seconds(seconds), msg);
+    return RegisterEvent(Now() + std::chrono::seconds(seconds), msg);
   }
 
   /**
@@ -93,7 +312,7 @@ class TimerManager {
    * @return true on success, false on failure
    */
   template <typename Function, typename... Args>
-  TimerEvent* SchedulePeriodicEvent(const std::chrono::milliseconds& period,
+  TimerHandle SchedulePeriodicEvent(const std::chrono::milliseconds& period,
                                     Function&& f, Args&&... args) {
     auto msg = new libcomp::Message::ExecuteImpl<Args...>(
         std::forward<Function>(f), std::forward<Args>(args)...);
@@ -101,13 +320,113 @@ class TimerManager {
     return RegisterPeriodicEvent(period, msg);
   }
 
+  /**
+   * Executes code in a worker when the time is reached.
+   * @param target Worker to execute the code in.
+   * @param time Time to execute the code at.
+   * @param f Function (lambda) to execute in the worker thread.
+   * @param args Arguments to pass to the function when it is executed.
+   * @return Handle to the event
+   */
+  template <typename Function, typename... Args>
+  TimerHandle ScheduleWorkerEvent(
+      const std::shared_ptr<Worker>& target,
+      const std::chrono::steady_clock::time_point& time, Function&& f,
+      Args&&... args) {
+    auto msg = new libcomp::Message::ExecuteImpl<Args...>(
+        std::forward<Function>(f), std::forward<Args>(args)...);
+
+    return RegisterEvent(time, msg, target);
+  }
+
+  /**
+   * Executes code in a worker after a number of seconds.
+   * @param target Worker to execute the code in.
+   * @param seconds Number of seconds to wait.
+   * @param f Function (lambda) to execute in the worker thread.
+   * @param args Arguments to pass to the function when it is executed.
+   * @return Handle to the event
+   */
+  template <typename Function, typename... Args>
+  TimerHandle ScheduleWorkerEventIn(const std::shared_ptr<Worker>& target,
+                                    int seconds, Function&& f,
+                                    Args&&... args) {
+    auto msg = new libcomp::Message::ExecuteImpl<Args...>(
+        std::forward<Function>(f), std::forward<Args>(args)...);
+
+    return RegisterEvent(Now() + std::chrono::seconds(seconds), msg, target);
+  }
+
+  /**
+   * Executes code in a worker periodically.
+   * @param target Worker to execute the code in.
+   * @param period Time between each execution.
+   * @param f Function (lambda) to execute in the worker thread.
+   * @param args Arguments to pass to the function when it is executed.
+   * @return Handle to the event
+   */
+  template <typename Function, typename... Args>
+  TimerHandle ScheduleWorkerPeriodicEvent(
+      const std::shared_ptr<Worker>& target,
+      const std::chrono::milliseconds& period, Function&& f, Args&&... args) {
+    auto msg = new libcomp::Message::ExecuteImpl<Args...>(
+        std::forward<Function>(f), std::forward<Args>(args)...);
+
+    return RegisterPeriodicEvent(period, msg, target);
+  }
+
  private:
   void ProcessEvents(std::unique_lock<std::mutex>& lock);
   void WaitForEvent(std::unique_lock<std::mutex>& lock);
 
+  /**
+   * Take an event node from the pool. The event lock must be held.
+   * @return Event node ready to be filled in.
+   */
+  TimerEvent* AllocateEvent();
+
+  /**
+   * Free the message of an event and return the node to the pool. This
+   * changes the generation of the node so old handles no longer match it.
+   * The event lock must be held.
+   * @param pEvent Event to release.
+   */
+  void ReleaseEvent(TimerEvent* pEvent);
+
+  /**
+   * Get the dispatch target for a worker. The event lock must be held.
+   * @param worker Worker to get the target for (may be null).
+   * @return Target for the worker or null if no worker was given.
+   */
+  std::shared_ptr<TimerTarget> GetTarget(const std::shared_ptr<Worker>& worker);
+
+  /**
+   * Remove the targets of workers that are gone or no longer have a
+   * message queue. The event lock must be held.
+   */
+  void PruneTargets();
+
+  /**
+   * Log a summary of the timer statistics.
+   */
+  void LogStats();
+
   volatile bool mRunning;
-  volatile bool mProcessingEvents;
-  std::multiset<TimerEvent*, TimerEventComp> mEvents;
+  TimerBackend_t mBackend;
+
+  /// Set when time only moves when @ref AdvanceClock is called
+  bool mManualClock;
+
+  std::unique_ptr<TimerEventQueue> mEvents;
+  std::vector<TimerEvent*> mFreeEvents;
+  std::list<TimerEvent*> mEventBlocks;
+
+  /// Every pooled event node by the index stored in its handles
+  std::vector<TimerEvent*> mEventNodes;
+  std::list<std::shared_ptr<TimerTarget>> mTargets;
+  std::shared_ptr<TimerTarget> mDefaultTarget;
+  std::shared_ptr<TimerStatsCounters> mStats;
+  TimerHandle mStatsLogEvent;
   std::condition_variable mEventCondition;
   std::mutex mEventLock;
   std::thread mRunThread;
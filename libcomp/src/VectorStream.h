@@ -4,7 +4,7 @@
  *
  * @author COMP Omega <compomega@tutanota.com>
  *
- * @brief Class to use a std::vector<char> as a stream.
+ * @brief Classes to use a std::vector<char> or an array as a stream.
  *
  * This file is part of the COMP_hack Library (libcomp).
  *
@@ -33,27 +33,21 @@
 
 namespace libcomp {
 
+/**
+ * Read only stream buffer over an array of characters that it does not own.
+ * The array must stay valid while the stream is used.
+ */
 template <typename CharT, typename TraitsT = std::char_traits<CharT>>
-class VectorStream : public std::basic_streambuf<CharT, TraitsT> {
- private:
-  std::vector<CharT>& mData;
-
+class ArrayStream : public std::basic_streambuf<CharT, TraitsT> {
  public:
-  VectorStream(std::vector<CharT>& data) : mData(data) {
-    this->setg(data.data(), data.data(), data.data() + data.size());
-  }
+  ArrayStream(const CharT* data, size_t size) {
+    // The get area is never written to.
+    CharT* begin = const_cast<CharT*>(data);
 
- protected:
-  virtual typename std::basic_streambuf<CharT, TraitsT>::int_type overflow(
-      typename std::basic_streambuf<CharT, TraitsT>::int_type c =
-          std::basic_streambuf<CharT, TraitsT>::traits_type::eof()) {
-    if (std::basic_streambuf<CharT, TraitsT>::traits_type::eof() != c) {
-      mData.push_back(static_cast<CharT>(c));
-    }
-
-    return c;
+    this->setg(begin, begin, begin + size);
   }
 
+ protected:
   virtual typename std::basic_streambuf<CharT, TraitsT>::pos_type seekoff(
       typename std::basic_streambuf<CharT, TraitsT>::off_type off,
       std::ios_base::seekdir dir,
@@ -115,6 +109,34 @@ class VectorStream : public std::basic_streambuf<CharT, TraitsT> {
   }
 };
 
+template <typename CharT, typename TraitsT = std::char_traits<CharT>>
+class VectorStream : public ArrayStream<CharT, TraitsT> {
+ private:
+  std::vector<CharT>& mData;
+
+ public:
+  VectorStream(std::vector<CharT>& data)
+      : ArrayStream<CharT, TraitsT>(data.data(), data.size()), mData(data) {}
+
+ protected:
+  virtual typename std::basic_streambuf<CharT, TraitsT>::int_type overflow(
+      typename std::basic_streambuf<CharT, TraitsT>::int_type c =
+          std::basic_streambuf<CharT, TraitsT>::traits_type::eof()) {
+    if (std::basic_streambuf<CharT, TraitsT>::traits_type::eof() != c) {
+      mData.push_back(static_cast<CharT>(c));
+    }
+
+    return c;
+  }
+
+  virtual std::streamsize xsputn(const CharT* s, std::streamsize count) {
+    // Append whole writes at once instead of one character at a time.
+    mData.insert(mData.end(), s, s + count);
+
+    return count;
+  }
+};
+
 }  // namespace libcomp
 
 #endif  // LIBCOMP_SRC_VECTORSTREAM_H
@@ -30,6 +30,7 @@
 #include "BaseLog.h"
 #include "Exception.h"
 #include "MessageShutdown.h"
+#include "Platform.h"
 
 // Standard C++11 Includes
 #include <thread>
@@ -39,7 +40,10 @@ using namespace libcomp;
 Worker::Worker()
     : mRunning(false),
       mMessageQueue(new MessageQueue<Message::Message*>()),
-      mThread(nullptr) {}
+      mThread(nullptr),
+      mLocalMemory(false) {
+  mShutdownMark.fill(0);
+}
 
 Worker::~Worker() { Cleanup(); }
 
@@ -51,10 +55,17 @@ void Worker::AddManager(const std::shared_ptr<Manager>& manager) {
 
 void Worker::RemoveAllManagers() { mManagers.clear(); }
 
+void Worker::SetPlacement(const std::set<uint32_t>& cpus, bool localMemory) {
+  mCPUs = cpus;
+  mLocalMemory = localMemory;
+}
+
 void Worker::Start(const libcomp::String& name, bool blocking) {
   mWorkerName = name;
 
   if (blocking) {
+    ApplyPlacement();
+
     mRunning = true;
     Run(mMessageQueue.get());
     mRunning = false;
@@ -70,6 +81,10 @@ void Worker::Start(const libcomp::String& name, bool blocking) {
 
           libcomp::Exception::RegisterSignalHandler();
 
+          // Place the thread before anything is allocated by it so worker
+          // owned memory comes from the local node.
+          ApplyPlacement();
+
           mRunning = true;
           Run(messageQueue.get());
           mRunning = false;
@@ -78,15 +93,54 @@ void Worker::Start(const libcomp::String& name, bool blocking) {
   }
 }
 
+void Worker::ApplyPlacement() {
+  if (!mCPUs.empty() && !Platform::SetCurrentThreadAffinity(mCPUs)) {
+    LogGeneralWarning([&]() {
+      return String("Failed to set the CPU affinity of worker '%1'.\n")
+          .Arg(mWorkerName);
+    });
+  }
+
+  if (mLocalMemory && !Platform::SetCurrentThreadLocalMemory()) {
+    LogGeneralWarning([&]() {
+      return String("Failed to set the NUMA memory policy of worker '%1'.\n")
+          .Arg(mWorkerName);
+    });
+  }
+}
+
 void Worker::Run(MessageQueue<Message::Message*>* pMessageQueue) {
   while (mRunning) {
+    // End the batch at a shutdown so the messages after it are not handled
+    // with the messages before it.
     std::list<libcomp::Message::Message*> msgs;
-    pMessageQueue->DequeueAll(msgs);
+    pMessageQueue->DequeueWeighted(
+        msgs, [](libcomp::Message::Message* pMessage) {
+          return nullptr !=
+                 dynamic_cast<libcomp::Message::Shutdown*>(pMessage);
+        });
 
     for (auto pMessage : msgs) {
       HandleMessage(pMessage);
     }
   }
+
+  std::array<uint64_t, MessageQueue<Message::Message*>::LANE_COUNT> mark;
+
+  {
+    std::lock_guard<std::mutex> lock(mShutdownLock);
+    mark = mShutdownMark;
+  }
+
+  // Handle everything queued before the shutdown so work such as pending
+  // saves is not lost when the lower lanes were still waiting. Messages
+  // queued after the shutdown are left in the queue and dropped.
+  std::list<libcomp::Message::Message*> msgs;
+  pMessageQueue->DequeueBefore(mark, msgs);
+
+  for (auto pMessage : msgs) {
+    HandleMessage(pMessage);
+  }
 }
 
 void Worker::HandleMessage(libcomp::Message::Message* pMessage) {
@@ -98,8 +152,8 @@ void Worker::HandleMessage(libcomp::Message::Message* pMessage) {
   libcomp::Message::Execute* pExecute =
       dynamic_cast<libcomp::Message::Execute*>(pMessage);
 
-  // Do not handle any more messages if a shutdown was sent.
-  if (nullptr != pShutdown || !mRunning) {
+  // Stop waiting for more messages once a shutdown was sent.
+  if (nullptr != pShutdown) {
     mRunning = false;
   } else if (nullptr != pExecute) {
     // Run the code now.
@@ -143,15 +197,25 @@ void Worker::HandleMessage(libcomp::Message::Message* pMessage) {
   // Grab the next worker.
   auto nextWorker = mNextWorker.lock();
 
-  // Either forward the message to the next worker or free it.
+  // Either forward the message to the next worker (in the same lane it
+  // was queued in) or free it.
   if (nextWorker) {
-    nextWorker->GetMessageQueue()->Enqueue(pMessage);
+    nextWorker->GetMessageQueue()->Enqueue(pMessage,
+                                           pMessage->GetPriority());
   } else {
     delete pMessage;
   }
 }
 
 void Worker::Shutdown() {
+  std::lock_guard<std::mutex> lock(mShutdownLock);
+
+  // Remember what was queued before the shutdown so only that is handled
+  // once the worker stops.
+  mShutdownMark = mMessageQueue->GetEnqueueCounts();
+
+  // Queue in the normal lane so it is handled after the work already
+  // queued there instead of jumping ahead of it.
   mMessageQueue->Enqueue(new libcomp::Message::Shutdown());
 }
 
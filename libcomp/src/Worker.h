@@ -35,8 +35,11 @@
 #include "MessageQueue.h"
 
 // Standard C++11 Includes
+#include <array>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
 #include <unordered_map>
 
@@ -78,10 +81,21 @@ class Worker {
    */
   void Start(const libcomp::String& name, bool blocking = false);
 
+  /**
+   * Set the CPUs the worker thread should be placed on. This must be called
+   * before @ref Start to have any effect.
+   * @param cpus Indexes of the CPUs the worker may run on (empty for any)
+   * @param localMemory If the worker should prefer memory from the NUMA
+   *  node it is running on for everything it allocates
+   */
+  void SetPlacement(const std::set<uint32_t>& cpus, bool localMemory);
+
   /**
    * Wait for a message to enter the queue then handle it
    * with the appropriate @ref Manager configured for the
-   * worker.
+   * worker. Messages are taken in weighted batches so high
+   * priority messages are handled first without starving
+   * the lower priority lanes.
    * @param pMessageQueue Queue to check for messages
    */
   virtual void Run(
@@ -89,7 +103,9 @@ class Worker {
 
   /**
    * Signal that the worker should shutdown by sending a
-   * @ref Message::Shutdown.
+   * @ref Message::Shutdown. Messages queued before the shutdown are
+   * still handled before the worker stops. Messages queued after it are
+   * dropped.
    */
   virtual void Shutdown();
 
@@ -138,12 +154,28 @@ class Worker {
    */
   template <typename Function, typename... Args>
   bool ExecuteInWorker(Function&& f, Args&&... args) const {
+    return ExecuteInWorkerWithPriority(MessagePriority_t::PRIORITY_NORMAL,
+                                       std::forward<Function>(f),
+                                       std::forward<Args>(args)...);
+  }
+
+  /**
+   * Executes code in the worker thread from the specified priority lane.
+   * @param priority Lane of the message queue to add the code to.
+   * @param f Function (lambda) to execute in the worker thread.
+   * @param args Arguments to pass to the function when it is executed.
+   * @return true on success, false on failure
+   */
+  template <typename Function, typename... Args>
+  bool ExecuteInWorkerWithPriority(MessagePriority_t priority, Function&& f,
+                                   Args&&... args) const {
     auto queue = GetMessageQueue();
 
     if (nullptr != queue) {
       auto msg = new libcomp::Message::ExecuteImpl<Args...>(
           std::forward<Function>(f), std::forward<Args>(args)...);
-      queue->Enqueue(msg);
+      msg->SetPriority(priority);
+      queue->Enqueue(msg, priority);
 
       return true;
     }
@@ -158,6 +190,12 @@ class Worker {
    */
   virtual void Cleanup();
 
+  /**
+   * Apply the CPU and memory placement set by @ref SetPlacement to the
+   * calling thread.
+   */
+  void ApplyPlacement();
+
   /**
    * Handle an incoming message from the queue.
    * @param pMessage Message to handle from the queue.
@@ -183,6 +221,19 @@ class Worker {
 
   /// Thread used to handle asynchronous execution
   std::thread* mThread;
+
+  /// CPUs the worker thread should be placed on (empty for any)
+  std::set<uint32_t> mCPUs;
+
+  /// Indicates the worker should prefer memory from its local NUMA node
+  bool mLocalMemory;
+
+  /// Enqueue counts of each lane when @ref Shutdown was last called
+  std::array<uint64_t, MessageQueue<Message::Message*>::LANE_COUNT>
+      mShutdownMark;
+
+  /// Mutex lock to use when accessing the shutdown mark
+  std::mutex mShutdownLock;
 };
 
 }  // namespace libcomp
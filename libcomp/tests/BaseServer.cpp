@@ -0,0 +1,82 @@
+/**
+ * @file libcomp/tests/BaseServer.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Test the base server utility functions.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <BaseServer.h>
+
+using namespace libcomp;
+
+TEST(BaseServer, ParseCPUList) {
+  std::set<uint32_t> cpus;
+
+  EXPECT_TRUE(BaseServer::ParseCPUList("", cpus));
+  EXPECT_TRUE(cpus.empty());
+
+  EXPECT_TRUE(BaseServer::ParseCPUList("0-3, 8 ,10-11,", cpus));
+  EXPECT_EQ(std::set<uint32_t>({0, 1, 2, 3, 8, 10, 11}), cpus);
+
+  cpus.clear();
+
+  EXPECT_TRUE(BaseServer::ParseCPUList("5-5,1023", cpus));
+  EXPECT_EQ(std::set<uint32_t>({5, 1023}), cpus);
+
+  EXPECT_FALSE(BaseServer::ParseCPUList("3-1", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("1-2-3", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("a", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("0-b", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("-1", cpus));
+}
+
+TEST(BaseServer, ParseCPUListLimit) {
+  std::set<uint32_t> cpus;
+
+  EXPECT_FALSE(BaseServer::ParseCPUList("1024", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("0-1024", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("0-4000000000", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("0-4294967295", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("4294967295", cpus));
+  EXPECT_FALSE(BaseServer::ParseCPUList("0-4294967296", cpus));
+  EXPECT_TRUE(cpus.empty());
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
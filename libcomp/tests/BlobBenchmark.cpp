@@ -0,0 +1,257 @@
+/**
+ * @file libcomp/tests/BlobBenchmark.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Benchmark saving and loading container columns as blobs.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <DatabaseBind.h>
+#include <DatabaseQuerySQLite3.h>
+#include <TestPersistentHistory.h>
+#include <VectorStream.h>
+
+// SQLite3 Includes
+#include <sqlite3.h>
+
+// Standard C++11 Includes
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <vector>
+
+using namespace libcomp;
+
+/// Number of elements in the list of the benchmark object.
+static const uint32_t LIST_SIZE = 100000;
+
+/// Number of entries in the map of the benchmark object.
+static const uint32_t MAP_SIZE = 10000;
+
+/// Number of times each benchmark saves or loads the object.
+static const int REPEAT_COUNT = 200;
+
+/**
+ * Print the time taken by a benchmark step.
+ * @param step Name of the step.
+ * @param start Time the step started.
+ * @param count Number of operations in the step.
+ * @param bytes Number of bytes handled by each operation.
+ */
+static void Report(const char *step,
+                   const std::chrono::steady_clock::time_point &start,
+                   int count, size_t bytes) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  std::cout << "[ BENCH    ] Blob " << step << ": " << count << " ops in "
+            << elapsed << " us (" << ((double)elapsed / count) << " us/op, "
+            << (elapsed ? ((double)bytes * count / elapsed) : 0.0)
+            << " MB/s)" << std::endl;
+}
+
+/**
+ * Create the object with a large list and map to benchmark.
+ * @return Pointer to the object.
+ */
+static std::shared_ptr<objects::TestPersistentHistory> CreateHistory() {
+  auto history = std::make_shared<objects::TestPersistentHistory>();
+
+  for (uint32_t i = 0; i < LIST_SIZE; ++i) {
+    history->AppendEntries(i * 7);
+  }
+
+  for (uint32_t i = 0; i < MAP_SIZE; ++i) {
+    history->SetCounters(i, (int64_t)i * 1000);
+  }
+
+  return history;
+}
+
+/**
+ * Bind the list of the object the way the generated code used to, by
+ * saving to a string stream and copying the string into a vector.
+ * @param history Object to bind the list of.
+ * @return Binding of the list.
+ */
+static DatabaseBind *CopyBindEntries(
+    const std::shared_ptr<objects::TestPersistentHistory> &history) {
+  std::stringstream stream(std::stringstream::out | std::stringstream::binary);
+
+  uint32_t elementCount = (uint32_t)history->EntriesCount();
+  stream.write(reinterpret_cast<char *>(&elementCount), sizeof(elementCount));
+
+  for (auto it = history->EntriesBegin(); it != history->EntriesEnd(); ++it) {
+    uint32_t element = *it;
+    stream.write(reinterpret_cast<char *>(&element), sizeof(element));
+  }
+
+  auto stringData = stream.str();
+  auto data = std::vector<char>(stringData.c_str(),
+                                stringData.c_str() + stringData.size());
+
+  return new DatabaseBindBlob("Entries", data);
+}
+
+TEST(BlobBenchmark, Bind) {
+  auto history = CreateHistory();
+
+  size_t bytes = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < REPEAT_COUNT; ++i) {
+    auto bind = CopyBindEntries(history);
+    bytes = ((DatabaseBindBlob *)bind)->GetValue().size();
+    delete bind;
+  }
+
+  Report("Bind list (string copy)", start, REPEAT_COUNT, bytes);
+
+  start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < REPEAT_COUNT; ++i) {
+    auto values = history->GetMemberBindValues(true, false);
+
+    if (i == 0) {
+      bytes = 0;
+
+      for (auto value : values) {
+        bytes += ((DatabaseBindBlob *)value)->GetValue().size();
+      }
+    }
+
+    for (auto value : values) {
+      delete value;
+    }
+  }
+
+  Report("Bind list and map (direct)", start, REPEAT_COUNT, bytes);
+
+  EXPECT_LT((size_t)(LIST_SIZE * sizeof(uint32_t)), bytes);
+}
+
+TEST(BlobBenchmark, Load) {
+  auto history = CreateHistory();
+  ASSERT_TRUE(PersistentObject::Register(history));
+
+  sqlite3 *pDatabase = nullptr;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(":memory:", &pDatabase));
+
+  {
+    DatabaseQuery create(new DatabaseQuerySQLite3(pDatabase),
+                         "CREATE TABLE TestPersistentHistory (UID string, "
+                         "Entries blob, Counters blob);");
+    ASSERT_TRUE(create.Execute());
+
+    DatabaseQuery insert(new DatabaseQuerySQLite3(pDatabase),
+                         "INSERT INTO TestPersistentHistory (UID, Entries, "
+                         "Counters) VALUES (?, ?, ?);");
+    ASSERT_TRUE(insert.Bind(1, history->GetUUID()));
+
+    size_t idx = 2;
+    size_t bytes = 0;
+
+    for (auto value : history->GetMemberBindValues(true, false)) {
+      bytes += ((DatabaseBindBlob *)value)->GetValue().size();
+
+      EXPECT_TRUE(value->Bind(insert, idx++));
+      delete value;
+    }
+
+    ASSERT_TRUE(insert.Execute());
+
+    DatabaseQuery select(new DatabaseQuerySQLite3(pDatabase),
+                         "SELECT * FROM TestPersistentHistory;");
+    ASSERT_TRUE(select.Execute());
+    ASSERT_TRUE(select.Next());
+
+    std::vector<char> copy;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < REPEAT_COUNT; ++i) {
+      // Copy the column and read it the way the generated code used to.
+      EXPECT_TRUE(select.GetValue("Entries", copy));
+
+      VectorStream<char> vstream(copy);
+      std::istream stream(&vstream);
+
+      uint32_t elementCount = 0;
+      stream.read(reinterpret_cast<char *>(&elementCount),
+                  sizeof(elementCount));
+
+      std::list<uint32_t> entries;
+
+      for (uint32_t j = 0; j < elementCount; ++j) {
+        uint32_t element;
+        stream.read(reinterpret_cast<char *>(&element), sizeof(element));
+        entries.push_back(element);
+      }
+
+      EXPECT_EQ(LIST_SIZE, (uint32_t)entries.size());
+    }
+
+    Report("Load list (column copy)", start, REPEAT_COUNT, copy.size());
+
+    auto loaded = std::make_shared<objects::TestPersistentHistory>();
+
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < REPEAT_COUNT; ++i) {
+      EXPECT_TRUE(loaded->LoadDatabaseValues(select));
+    }
+
+    Report("Load list and map (direct)", start, REPEAT_COUNT, bytes);
+
+    EXPECT_EQ(history->GetUUID(), loaded->GetUUID());
+    EXPECT_EQ(LIST_SIZE, (uint32_t)loaded->EntriesCount());
+    EXPECT_EQ(MAP_SIZE, (uint32_t)loaded->CountersCount());
+    EXPECT_EQ(history->GetEntries(LIST_SIZE - 1),
+              loaded->GetEntries(LIST_SIZE - 1));
+    EXPECT_EQ(history->GetCounters(MAP_SIZE - 1),
+              loaded->GetCounters(MAP_SIZE - 1));
+  }
+
+  sqlite3_close(pDatabase);
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
@@ -31,22 +31,1813 @@
 #include <gtest/gtest.h>
 
 // Stop ignoring warnings
-#include <DatabaseSQLite3.h>
 #include <PushIgnore.h>
 
+// libcomp Includes
+#include <BaseLog.h>
+#include <DatabaseBind.h>
+#include <DatabaseExecutor.h>
+#include <DatabaseQueryStats.h>
+#include <DatabaseSQLite3.h>
+#include <ObjectReference.h>
+#include <ObjectResidency.h>
+#include <TestPersistentEnchant.h>
+#include <TestPersistentInventory.h>
+#include <TestPersistentItem.h>
+
+// Standard C++11 Includes
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <set>
+#include <thread>
+
 using namespace libcomp;
 
+namespace {
+
+/**
+ * Log for the messages of the database while testing.
+ */
+class TestLog : public BaseLog {
+ public:
+  TestLog() {}
+};
+
+/**
+ * SQLite3 database that can refuse to create savepoints.
+ */
+class SavepointDatabase : public DatabaseSQLite3 {
+ public:
+  SavepointDatabase(
+      const std::shared_ptr<objects::DatabaseConfigSQLite3> &config)
+      : DatabaseSQLite3(config), allowSavepoints(true), allowRelease(true) {}
+
+  bool allowSavepoints;
+
+  /// Refuse to release savepoints so the group commit is rolled back
+  bool allowRelease;
+
+ protected:
+  bool ExecuteTransactionControl(const String &statement) override {
+    if (!allowRelease && "RELEASE SAVEPOINT" == statement.Left(17)) {
+      return false;
+    }
+
+    return allowSavepoints && DatabaseSQLite3::ExecuteTransactionControl(
+                                  statement);
+  }
+};
+
+/**
+ * SQLite3 database that binds fewer values to each statement.
+ */
+class BatchDatabase : public DatabaseSQLite3 {
+ public:
+  BatchDatabase(const std::shared_ptr<objects::DatabaseConfigSQLite3> &config)
+      : DatabaseSQLite3(config), maxBindCount(0) {}
+
+  /// Most values bound to one statement (0 for the SQLite3 limit)
+  size_t maxBindCount;
+
+ protected:
+  size_t GetMaxBindCount() const override {
+    return maxBindCount ? maxBindCount : DatabaseSQLite3::GetMaxBindCount();
+  }
+};
+
+/**
+ * SQLite3 database that exposes how values are written into statements.
+ */
+class LiteralDatabase : public DatabaseSQLite3 {
+ public:
+  LiteralDatabase(
+      const std::shared_ptr<objects::DatabaseConfigSQLite3> &config)
+      : DatabaseSQLite3(config) {}
+
+  using DatabaseSQLite3::FormatChangeSet;
+  using DatabaseSQLite3::FormatLiteral;
+};
+
+}  // namespace
+
+template <class T>
+static void RegisterTestType() {
+  PersistentObject::RegisterType(typeid(T), T::GetMetadata(),
+                                 []() { return (PersistentObject *)new T(); });
+}
+
+/**
+ * Get the config of an in-memory database.
+ * @return Config of an in-memory database.
+ */
+static std::shared_ptr<objects::DatabaseConfigSQLite3> GetConfig() {
+  auto config = std::make_shared<objects::DatabaseConfigSQLite3>();
+  config->SetDatabaseName(":memory:");
+
+  return config;
+}
+
+/**
+ * Read the value of an item from the database instead of the object.
+ * @param db Database to read from.
+ * @param uuid UUID of the item.
+ * @return Value of the item or -1 if it could not be read.
+ */
+static int32_t GetItemValue(Database &db, const libobjgen::UUID &uuid) {
+  auto query =
+      db.Prepare("SELECT Value FROM TestPersistentItem WHERE UID = :uid;");
+
+  int32_t value = -1;
+
+  if (!query.Bind("uid", uuid) || !query.Execute() || !query.Next() ||
+      !query.GetValue(0, value)) {
+    return -1;
+  }
+
+  return value;
+}
+
+/**
+ * Run a query that returns a single integer.
+ * @param query Query to run.
+ * @return Integer returned or -1 if the query failed.
+ */
+static int64_t GetInteger(DatabaseQuery &query) {
+  int64_t value = -1;
+
+  if (!query.Execute() || !query.Next() || !query.GetValue(0, value)) {
+    return -1;
+  }
+
+  return value;
+}
+
+/**
+ * Remove a database file and the files SQLite3 keeps next to it.
+ * @param filepath Path to the database file.
+ */
+static void RemoveDatabaseFile(const std::string &filepath) {
+  std::remove(filepath.c_str());
+  std::remove((filepath + "-journal").c_str());
+  std::remove((filepath + "-wal").c_str());
+  std::remove((filepath + "-shm").c_str());
+}
+
 TEST(SQLite3, OpenCloseDatabase) {
-  DatabaseSQLite3 db;
+  DatabaseSQLite3 db(GetConfig());
 
-  ASSERT_TRUE(db.Open(":memory:"));
+  ASSERT_TRUE(db.Open());
   ASSERT_TRUE(db.IsOpen());
   ASSERT_TRUE(db.Close());
+  ASSERT_FALSE(db.IsOpen());
 }
 
-int main(int argc, char *argv[]) {
-  try {
-    ::testing::InitGoogleTest(&argc, argv);
+TEST(SQLite3, StatementCache) {
+  auto config = GetConfig();
+  config->SetStatementCacheSize(2);
+
+  DatabaseSQLite3 db(config);
+
+  ASSERT_TRUE(db.Open());
+
+  for (int32_t i = 0; i < 10; ++i) {
+    auto query = db.Prepare("SELECT :value");
+
+    EXPECT_TRUE(query.Bind("value", i));
+    EXPECT_TRUE(query.Execute());
+    EXPECT_TRUE(query.Next());
+
+    int32_t value = -1;
+
+    EXPECT_TRUE(query.GetValue(0, value));
+    EXPECT_EQ(i, value);
+  }
+
+  auto stats = db.GetStatementCacheStats();
+
+  EXPECT_EQ((uint64_t)9, stats.hits);
+  EXPECT_EQ((uint64_t)1, stats.misses);
+  EXPECT_EQ((uint64_t)1, stats.size);
+
+  // The bindings of a cached statement are cleared when it is returned.
+  {
+    auto query = db.Prepare("SELECT :value");
+
+    EXPECT_TRUE(query.Execute());
+    EXPECT_TRUE(query.Next());
+
+    int32_t value = -1;
+
+    EXPECT_FALSE(query.GetValue(0, value));
+  }
+
+  // Schema and transaction statements bypass the cache.
+  EXPECT_TRUE(db.Execute("CREATE TABLE Cached (Value int);"));
+  EXPECT_TRUE(db.Execute("BEGIN TRANSACTION;"));
+  EXPECT_TRUE(db.Execute("INSERT INTO Cached (Value) VALUES (1), (2), (3);"));
+  EXPECT_TRUE(db.Execute("COMMIT;"));
+  EXPECT_TRUE(db.Execute("PRAGMA user_version = 1;"));
+
+  stats = db.GetStatementCacheStats();
+
+  EXPECT_EQ((uint64_t)10, stats.hits);
+  EXPECT_EQ((uint64_t)2, stats.misses);
+  EXPECT_EQ((uint64_t)2, stats.size);
+
+  // A statement returned part way through its rows starts over when it is
+  // used again.
+  for (int32_t i = 0; i < 2; ++i) {
+    auto query = db.Prepare("SELECT Value FROM Cached ORDER BY Value;");
+
+    EXPECT_TRUE(query.Execute());
+    EXPECT_TRUE(query.Next());
+
+    int32_t value = -1;
+
+    EXPECT_TRUE(query.GetValue(0, value));
+    EXPECT_EQ(1, value);
+  }
+
+  // The least recently used statements made room for the new ones.
+  EXPECT_TRUE(db.Execute("DELETE FROM Cached WHERE Value = 3;"));
+
+  stats = db.GetStatementCacheStats();
+
+  EXPECT_EQ((uint64_t)11, stats.hits);
+  EXPECT_EQ((uint64_t)4, stats.misses);
+  EXPECT_EQ((uint64_t)2, stats.evictions);
+  EXPECT_EQ((uint64_t)2, stats.size);
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, StatementCacheDisabled) {
+  auto config = GetConfig();
+  config->SetStatementCacheSize(0);
+
+  DatabaseSQLite3 db(config);
+
+  ASSERT_TRUE(db.Open());
+
+  for (int32_t i = 0; i < 3; ++i) {
+    auto query = db.Prepare("SELECT :value");
+
+    EXPECT_TRUE(query.Bind("value", i));
+    EXPECT_TRUE(query.Execute());
+  }
+
+  auto stats = db.GetStatementCacheStats();
+
+  EXPECT_EQ((uint64_t)0, stats.hits);
+  EXPECT_EQ((uint64_t)0, stats.misses);
+  EXPECT_EQ((uint64_t)0, stats.size);
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, WriteBehind) {
+  auto config = GetConfig();
+  config->SetWriteBehind(true);
+  config->SetWriteBehindInterval(60000);
+  config->SetWriteBehindMaxObjects(2);
+  RegisterTestType<objects::TestPersistentItem>();
+
+  DatabaseSQLite3 db(config);
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  auto first = std::make_shared<objects::TestPersistentItem>();
+  first->Register(first);
+
+  auto second = std::make_shared<objects::TestPersistentItem>();
+  second->Register(second);
+
+  db.QueueInsert(first);
+  db.QueueInsert(second);
+
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+
+  for (int32_t i = 1; i <= 5; ++i) {
+    first->SetValue(i);
+    db.QueueUpdate(first);
+  }
+
+  auto stats = db.GetWriteBehindStats();
+
+  EXPECT_EQ((uint64_t)5, stats.deferred);
+  EXPECT_EQ((uint64_t)4, stats.absorbed);
+  EXPECT_EQ((uint64_t)1, stats.pending);
+
+  // Nothing is written before the interval passes or enough objects are
+  // pending.
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+  EXPECT_EQ(0, GetItemValue(db, first->GetUUID()));
+  EXPECT_EQ((uint64_t)0, db.GetWriteBehindStats().flushes);
+
+  // Reaching the limit leaves the write to the transaction queue.
+  second->SetValue(10);
+  db.QueueUpdate(second);
+
+  stats = db.GetWriteBehindStats();
+
+  EXPECT_EQ((uint64_t)0, stats.flushes);
+  EXPECT_EQ((uint64_t)2, stats.pending);
+  EXPECT_EQ(0, GetItemValue(db, second->GetUUID()));
+
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+
+  stats = db.GetWriteBehindStats();
+
+  EXPECT_EQ((uint64_t)2, stats.written);
+  EXPECT_EQ((uint64_t)1, stats.flushes);
+  EXPECT_EQ((uint64_t)0, stats.pending);
+  EXPECT_EQ(5, GetItemValue(db, first->GetUUID()));
+  EXPECT_EQ(10, GetItemValue(db, second->GetUUID()));
+
+  // A flush that fails is reported with the ungrouped changes.
+  EXPECT_TRUE(db.Execute("DROP TABLE TestPersistentItem;"));
+
+  first->SetValue(6);
+  db.QueueUpdate(first);
+  second->SetValue(11);
+  db.QueueUpdate(second);
+
+  auto failures = db.ProcessTransactionQueue();
+
+  ASSERT_EQ((size_t)1, failures.size());
+  EXPECT_EQ(NULLUUID, failures.front());
+
+  // Only the flush that succeeded counts as written.
+  stats = db.GetWriteBehindStats();
+
+  EXPECT_EQ((uint64_t)2, stats.written);
+  EXPECT_EQ((uint64_t)2, stats.flushes);
+  EXPECT_EQ((uint64_t)1, stats.failures);
+  EXPECT_EQ((uint64_t)2, stats.failed);
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, ForEachObject) {
+  RegisterTestType<objects::TestPersistentItem>();
+
+  DatabaseSQLite3 db(GetConfig());
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  for (int32_t i = 0; i < 5; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(i < 3 ? 1 : 2);
+
+    changeset->Insert(item);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+  changeset.reset();
+
+  size_t typeHash = typeid(objects::TestPersistentItem).hash_code();
+
+  // Objects not kept by the callback are freed before the next row.
+  size_t count = 0;
+  std::weak_ptr<PersistentObject> previous;
+
+  EXPECT_TRUE(db.ForEachObject(
+      typeHash, nullptr, [&](const std::shared_ptr<PersistentObject> &obj) {
+        EXPECT_TRUE(previous.expired());
+        previous = obj;
+        count++;
+
+        return true;
+      }));
+  EXPECT_EQ((size_t)5, count);
+
+  // Returning false stops the load.
+  count = 0;
+
+  EXPECT_TRUE(db.ForEachObject(
+      typeHash, nullptr, [&](const std::shared_ptr<PersistentObject> &) {
+        return ++count < 2;
+      }));
+  EXPECT_EQ((size_t)2, count);
+
+  DatabaseBindInt bind("Value", 1);
+  count = 0;
+
+  EXPECT_TRUE(db.ForEachObject(
+      typeHash, &bind, [&](const std::shared_ptr<PersistentObject> &obj) {
+        auto item = std::dynamic_pointer_cast<objects::TestPersistentItem>(obj);
+
+        EXPECT_NE(nullptr, item);
+        EXPECT_EQ(1, item->GetValue());
+        count++;
+
+        return true;
+      }));
+  EXPECT_EQ((size_t)3, count);
+
+  // The statement stopped part way through its rows starts over.
+  EXPECT_EQ((size_t)5, db.LoadObjects(typeHash, nullptr).size());
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, LoadObjectsParallel) {
+  RegisterTestType<objects::TestPersistentItem>();
+
+  DatabaseSQLite3 db(GetConfig());
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  for (int32_t i = 0; i < 200; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(i);
+
+    changeset->Insert(item);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+  changeset.reset();
+
+  size_t typeHash = typeid(objects::TestPersistentItem).hash_code();
+
+  // Rows past the first few are built by the load threads but the
+  // objects still come back in the order of the rows.
+  auto ordered = db.LoadObjectsParallel(typeHash, nullptr, true, 4);
+
+  ASSERT_EQ((size_t)200, ordered.size());
+
+  int32_t value = 0;
+
+  for (auto obj : ordered) {
+    auto item = std::dynamic_pointer_cast<objects::TestPersistentItem>(obj);
+
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(value++, item->GetValue());
+  }
+
+  // The objects are cached so every load returns the same pointers.
+  EXPECT_TRUE(ordered == db.LoadObjectsParallel(typeHash, nullptr, true, 1));
+
+  ordered.clear();
+
+  auto unordered = db.LoadObjectsParallel(typeHash, nullptr, false, 4);
+
+  ASSERT_EQ((size_t)200, unordered.size());
+
+  std::set<int32_t> values;
+
+  for (auto obj : unordered) {
+    auto item = std::dynamic_pointer_cast<objects::TestPersistentItem>(obj);
+
+    ASSERT_NE(nullptr, item);
+    values.insert(item->GetValue());
+  }
+
+  EXPECT_EQ((size_t)200, values.size());
+  EXPECT_EQ(0, *values.begin());
+  EXPECT_EQ(199, *values.rbegin());
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, ReadConnections) {
+  auto config = GetConfig();
+  config->SetDatabaseName("comp_hack_test");
+  config->SetFileDirectory(".");
+  config->SetWAL(true);
+  config->SetReadConnections(1);
+  config->SetCacheSize(4096);
+  config->SetMmapSize(16);
+
+  std::string filepath = "./comp_hack_test.sqlite3";
+  RemoveDatabaseFile(filepath);
+
+  {
+    DatabaseSQLite3 db(config);
+
+    ASSERT_TRUE(db.Open());
+
+    {
+      auto query = db.Prepare("PRAGMA journal_mode;");
+
+      String mode;
+
+      EXPECT_TRUE(query.Execute());
+      EXPECT_TRUE(query.Next());
+      EXPECT_TRUE(query.GetValue(0, mode));
+      EXPECT_EQ(String("wal"), mode.ToLower());
+    }
+
+    EXPECT_TRUE(db.Execute("CREATE TABLE Pool (Value int);"));
+    EXPECT_TRUE(db.Execute("INSERT INTO Pool (Value) VALUES (1), (2);"));
+
+    {
+      // The read-only connection refuses to write.
+      auto read = db.PrepareRead("INSERT INTO Pool (Value) VALUES (3);");
+      EXPECT_FALSE(read.Execute());
+
+      // With the only read-only connection in use the write connection
+      // takes the next query.
+      auto fallback = db.PrepareRead("INSERT INTO Pool (Value) VALUES (3);");
+      EXPECT_TRUE(fallback.Execute());
+    }
+
+    // The read-only connection sees what the write connection committed.
+    {
+      auto read = db.PrepareRead("SELECT COUNT(*) FROM Pool;");
+      EXPECT_EQ(3, GetInteger(read));
+    }
+
+    // Both connections use the page cache and memory map settings.
+    {
+      auto write = db.Prepare("PRAGMA cache_size;");
+      EXPECT_EQ(-4096, GetInteger(write));
+
+      auto read = db.PrepareRead("PRAGMA cache_size;");
+      EXPECT_EQ(-4096, GetInteger(read));
+    }
+
+    {
+      auto write = db.Prepare("PRAGMA mmap_size;");
+      EXPECT_EQ(16 * 1024 * 1024, GetInteger(write));
+
+      auto read = db.PrepareRead("PRAGMA mmap_size;");
+      EXPECT_EQ(16 * 1024 * 1024, GetInteger(read));
+    }
+
+    // Closing the database leaves a leased read-only connection open until
+    // the query using it is done.
+    {
+      auto read = db.PrepareRead("SELECT Value FROM Pool ORDER BY Value;");
+
+      int32_t value = -1;
+
+      EXPECT_TRUE(read.Execute());
+      EXPECT_TRUE(read.Next());
+      EXPECT_TRUE(read.GetValue(0, value));
+      EXPECT_EQ(1, value);
+
+      EXPECT_TRUE(db.Close());
+      EXPECT_FALSE(db.IsOpen());
+
+      EXPECT_TRUE(read.Next());
+      EXPECT_TRUE(read.GetValue(0, value));
+      EXPECT_EQ(2, value);
+    }
+
+    // The pool is filled again once the database is opened again.
+    ASSERT_TRUE(db.Open());
+
+    {
+      auto read = db.PrepareRead("INSERT INTO Pool (Value) VALUES (4);");
+      EXPECT_FALSE(read.Execute());
+    }
+
+    {
+      auto read = db.PrepareRead("SELECT COUNT(*) FROM Pool;");
+      EXPECT_EQ(3, GetInteger(read));
+    }
+
+    EXPECT_TRUE(db.Close());
+  }
+
+  RemoveDatabaseFile(filepath);
+}
+
+/**
+ * Get the storage class of the UIDs of a table.
+ * @param db Database to check.
+ * @param table Table to check.
+ * @return Storage class of every UID or an empty string if they differ.
+ */
+static String GetUIDType(Database &db, const String &table) {
+  auto query = db.Prepare(
+      String("SELECT DISTINCT typeof(UID) FROM %1;").Arg(table));
+
+  String type;
+
+  if (!query.Execute() || !query.Next() || !query.GetValue(0, type) ||
+      query.Next()) {
+    return String();
+  }
+
+  return type;
+}
+
+TEST(SQLite3, BinaryUUIDs) {
+  auto config = GetConfig();
+  config->SetDatabaseName("comp_hack_test");
+  config->SetFileDirectory(".");
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentInventory>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  std::string filepath = "./comp_hack_test.sqlite3";
+  RemoveDatabaseFile(filepath);
+
+  libobjgen::UUID itemUUID;
+  libobjgen::UUID inventoryUUID;
+
+  {
+    DatabaseSQLite3 db(config);
+
+    ASSERT_TRUE(db.Open());
+    ASSERT_TRUE(db.Setup());
+
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(42);
+
+    auto inventory = std::make_shared<objects::TestPersistentInventory>();
+    inventory->Register(inventory);
+    inventory->SetMainItem(item);
+
+    auto changeset = libcomp::DatabaseChangeSet::Create();
+    changeset->Insert(item);
+    changeset->Insert(inventory);
+
+    EXPECT_TRUE(db.ProcessChangeSet(changeset));
+    EXPECT_EQ(String("text"), GetUIDType(db, "TestPersistentItem"));
+
+    itemUUID = item->GetUUID();
+    inventoryUUID = inventory->GetUUID();
+
+    EXPECT_TRUE(db.Close());
+  }
+
+  // Switching to binary UUIDs converts the existing text UIDs and
+  // references and switching back converts them again.
+  for (bool binary : {true, false}) {
+    config->SetBinaryUUIDs(binary);
+
+    DatabaseSQLite3 db(config);
+
+    ASSERT_TRUE(db.Open());
+    ASSERT_TRUE(db.Setup());
+
+    EXPECT_EQ(String(binary ? "blob" : "text"),
+              GetUIDType(db, "TestPersistentItem"));
+    EXPECT_EQ(String(binary ? "blob" : "text"),
+              GetUIDType(db, "TestPersistentInventory"));
+
+    auto inventory =
+        std::dynamic_pointer_cast<objects::TestPersistentInventory>(
+            db.LoadSingleObject(
+                typeid(objects::TestPersistentInventory).hash_code(),
+                nullptr));
+
+    ASSERT_NE(nullptr, inventory);
+    EXPECT_EQ(inventoryUUID, inventory->GetUUID());
+    EXPECT_EQ(itemUUID, inventory->GetMainItem().GetUUID());
+
+    auto objects = db.LoadObjectsByUUIDs(
+        typeid(objects::TestPersistentItem).hash_code(), {itemUUID}, true);
+
+    ASSERT_EQ((size_t)1, objects.size());
+    EXPECT_EQ(itemUUID, objects.front()->GetUUID());
+    EXPECT_EQ(42, std::dynamic_pointer_cast<objects::TestPersistentItem>(
+                      objects.front())
+                      ->GetValue());
+
+    EXPECT_TRUE(db.Close());
+  }
+
+  // Deletes find the UIDs they bind too.
+  config->SetBinaryUUIDs(true);
+
+  {
+    DatabaseSQLite3 db(config);
+
+    ASSERT_TRUE(db.Open());
+    ASSERT_TRUE(db.Setup());
+
+    auto objects = db.LoadObjectsByUUIDs(
+        typeid(objects::TestPersistentItem).hash_code(), {itemUUID}, true);
+    ASSERT_EQ((size_t)1, objects.size());
+
+    auto obj = objects.front();
+    EXPECT_TRUE(db.DeleteSingleObject(obj));
+    EXPECT_TRUE(db.LoadObjectsByUUIDs(
+                      typeid(objects::TestPersistentItem).hash_code(),
+                      {itemUUID}, true)
+                    .empty());
+
+    EXPECT_TRUE(db.Close());
+  }
+
+  RemoveDatabaseFile(filepath);
+}
+
+TEST(SQLite3, ObjectResidency) {
+  RegisterTestType<objects::TestPersistentItem>();
+
+  auto db = std::make_shared<DatabaseSQLite3>(GetConfig());
+
+  ASSERT_TRUE(db->Open());
+  ASSERT_TRUE(db->Setup());
+
+  std::vector<libobjgen::UUID> uuids;
+
+  {
+    auto changeset = libcomp::DatabaseChangeSet::Create();
+
+    for (int32_t i = 0; i < 5; ++i) {
+      auto item = std::make_shared<objects::TestPersistentItem>();
+      item->Register(item);
+      item->SetValue(i);
+
+      changeset->Insert(item);
+      uuids.push_back(item->GetUUID());
+    }
+
+    EXPECT_TRUE(db->ProcessChangeSet(changeset));
+  }
+
+  // Keep only the most recently used object loaded.
+  ObjectResidency::Reset();
+  ObjectResidency::Configure(1);
+
+  std::vector<ObjectReference<objects::TestPersistentItem>> refs;
+
+  for (auto &uuid : uuids) {
+    refs.push_back(ObjectReference<objects::TestPersistentItem>(uuid));
+    EXPECT_NE(nullptr, refs.back().Get(db));
+  }
+
+  auto stats = ObjectResidency::GetStats();
+  EXPECT_EQ((uint64_t)5, stats.misses);
+  EXPECT_EQ((uint64_t)4, stats.evictions);
+  EXPECT_EQ((uint64_t)1, stats.resident);
+
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(nullptr, refs[i].GetCurrentReference());
+    EXPECT_EQ(nullptr, PersistentObject::GetObjectByUUID(uuids[i]));
+  }
+
+  EXPECT_NE(nullptr, refs.back().GetCurrentReference());
+
+  // Pinned objects and objects held elsewhere are kept.
+  ObjectResidency::Pin(uuids[0]);
+
+  auto held = refs[1].Get(db);
+  EXPECT_NE(nullptr, refs[0].Get(db));
+  EXPECT_NE(nullptr, refs[2].Get(db));
+
+  EXPECT_NE(nullptr, refs[0].GetCurrentReference());
+  EXPECT_NE(nullptr, refs[1].GetCurrentReference());
+  EXPECT_NE(nullptr, refs[2].GetCurrentReference());
+  EXPECT_EQ(nullptr, refs[4].GetCurrentReference());
+
+  // Unpinned objects are unloaded by the next eviction.
+  ObjectResidency::Unpin(uuids[0]);
+  held.reset();
+
+  EXPECT_EQ((size_t)3, ObjectResidency::Evict());
+  EXPECT_EQ(nullptr, refs[0].GetCurrentReference());
+  EXPECT_EQ(nullptr, refs[1].GetCurrentReference());
+  EXPECT_EQ(nullptr, refs[2].GetCurrentReference());
+  EXPECT_EQ((uint64_t)0, ObjectResidency::GetStats().resident);
+
+  // Evicted objects are loaded again from the database.
+  auto item = refs[3].Get(db);
+  ASSERT_NE(nullptr, item);
+  EXPECT_EQ(3, item->GetValue());
+  EXPECT_EQ((uint64_t)9, ObjectResidency::GetStats().misses);
+  EXPECT_EQ((uint64_t)1, ObjectResidency::GetStats().resident);
+
+  // Pinning an object that is never loaded leaves nothing behind.
+  auto unloaded = libobjgen::UUID::Random();
+
+  ObjectResidency::Pin(unloaded);
+  EXPECT_EQ((uint64_t)2, ObjectResidency::GetStats().resident);
+
+  ObjectResidency::Unpin(unloaded);
+  EXPECT_EQ((uint64_t)1, ObjectResidency::GetStats().resident);
+
+  item.reset();
+  refs.clear();
+
+  ObjectResidency::Configure(0);
+
+  EXPECT_TRUE(db->Close());
+}
+
+/**
+ * Load the test inventories again without any of their references.
+ * @param db Database to load from.
+ * @param uuids UUIDs of the inventories.
+ * @return Loaded inventories.
+ */
+static std::list<std::shared_ptr<PersistentObject>> LoadInventories(
+    const std::shared_ptr<Database> &db,
+    const std::list<libobjgen::UUID> &uuids) {
+  auto inventories = db->LoadObjectsByUUIDs(
+      typeid(objects::TestPersistentInventory).hash_code(), uuids, true);
+
+  EXPECT_EQ(uuids.size(), inventories.size());
+
+  for (auto &obj : inventories) {
+    auto inventory =
+        std::dynamic_pointer_cast<objects::TestPersistentInventory>(obj);
+
+    EXPECT_EQ(nullptr, inventory->GetMainItem().GetCurrentReference());
+    EXPECT_EQ(nullptr, inventory->GetItems(0).GetCurrentReference());
+  }
+
+  return inventories;
+}
+
+TEST(SQLite3, PrefetchReferences) {
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentInventory>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  auto db = std::make_shared<DatabaseSQLite3>(GetConfig());
+
+  ASSERT_TRUE(db->Open());
+  ASSERT_TRUE(db->Setup());
+
+  std::list<libobjgen::UUID> uuids;
+
+  {
+    auto changeset = libcomp::DatabaseChangeSet::Create();
+
+    // Every item has two enchantments.
+    auto makeItem = [&changeset](int32_t value) {
+      auto item = std::make_shared<objects::TestPersistentItem>();
+      item->Register(item);
+      item->SetValue(value);
+
+      for (int32_t i = 0; i < 2; ++i) {
+        auto enchant = std::make_shared<objects::TestPersistentEnchant>();
+        enchant->Register(enchant);
+        enchant->SetValue(value * 10 + i);
+        item->AppendEnchants(enchant);
+
+        changeset->Insert(enchant);
+      }
+
+      changeset->Insert(item);
+
+      return item;
+    };
+
+    // Both inventories share their main item.
+    auto mainItem = makeItem(100);
+
+    for (int32_t i = 0; i < 2; ++i) {
+      auto inventory = std::make_shared<objects::TestPersistentInventory>();
+      inventory->Register(inventory);
+      inventory->SetMainItem(mainItem);
+
+      for (int32_t j = 0; j < 3; ++j) {
+        inventory->SetItems((size_t)j, makeItem(i * 10 + j));
+      }
+
+      changeset->Insert(inventory);
+      uuids.push_back(inventory->GetUUID());
+    }
+
+    EXPECT_TRUE(db->ProcessChangeSet(changeset));
+  }
+
+  // One level loads the 7 distinct items in one query.
+  auto inventories = LoadInventories(db, uuids);
+  auto stats = PersistentObject::PrefetchReferences(db, inventories, 1);
+
+  EXPECT_EQ((uint64_t)1, stats.levels);
+  EXPECT_EQ((uint64_t)7, stats.references);
+  EXPECT_EQ((uint64_t)7, stats.loaded);
+  EXPECT_EQ((uint64_t)1, stats.queries);
+  EXPECT_EQ((uint64_t)6, stats.queriesSaved);
+
+  for (auto &obj : inventories) {
+    auto inventory =
+        std::dynamic_pointer_cast<objects::TestPersistentInventory>(obj);
+    auto mainItem = inventory->GetMainItem().GetCurrentReference();
+
+    ASSERT_NE(nullptr, mainItem);
+    EXPECT_EQ(100, mainItem->GetValue());
+    EXPECT_EQ(nullptr, mainItem->GetEnchants(0).GetCurrentReference());
+
+    for (size_t i = 0; i < 3; ++i) {
+      EXPECT_NE(nullptr, inventory->GetItems(i).GetCurrentReference());
+    }
+  }
+
+  // Loaded references are not loaded again.
+  stats = PersistentObject::PrefetchReferences(db, inventories, 1);
+  EXPECT_EQ((uint64_t)0, stats.references);
+  EXPECT_EQ((uint64_t)0, stats.queries);
+
+  // Paths only load the members named.
+  inventories.clear();
+  inventories = LoadInventories(db, uuids);
+  stats = PersistentObject::PrefetchReferences(db, inventories,
+                                               {"Items.Enchants"});
+
+  EXPECT_EQ((uint64_t)2, stats.levels);
+  EXPECT_EQ((uint64_t)18, stats.references);
+  EXPECT_EQ((uint64_t)18, stats.loaded);
+  EXPECT_EQ((uint64_t)2, stats.queries);
+
+  for (auto &obj : inventories) {
+    auto inventory =
+        std::dynamic_pointer_cast<objects::TestPersistentInventory>(obj);
+
+    EXPECT_EQ(nullptr, inventory->GetMainItem().GetCurrentReference());
+
+    for (size_t i = 0; i < 3; ++i) {
+      auto item = inventory->GetItems(i).GetCurrentReference();
+      ASSERT_NE(nullptr, item);
+
+      auto enchant = item->GetEnchants(1).GetCurrentReference();
+      ASSERT_NE(nullptr, enchant);
+      EXPECT_EQ(item->GetValue() * 10 + 1, enchant->GetValue());
+    }
+  }
+
+  // Two levels load every item and enchantment.
+  inventories.clear();
+  inventories = LoadInventories(db, uuids);
+  stats = PersistentObject::PrefetchReferences(db, inventories, 2);
+
+  EXPECT_EQ((uint64_t)2, stats.levels);
+  EXPECT_EQ((uint64_t)21, stats.references);
+  EXPECT_EQ((uint64_t)21, stats.loaded);
+  EXPECT_EQ((uint64_t)2, stats.queries);
+
+  auto inventory = std::dynamic_pointer_cast<objects::TestPersistentInventory>(
+      inventories.front());
+  auto mainItem = inventory->GetMainItem().GetCurrentReference();
+
+  ASSERT_NE(nullptr, mainItem);
+  EXPECT_NE(nullptr, mainItem->GetEnchants(0).GetCurrentReference());
+
+  inventory.reset();
+  mainItem.reset();
+  inventories.clear();
+
+  EXPECT_TRUE(db->Close());
+}
+
+TEST(SQLite3, GroupCommitSavepoints) {
+  auto config = GetConfig();
+  config->SetGroupCommit(true);
+  RegisterTestType<objects::TestPersistentItem>();
+
+  DatabaseSQLite3 db(config);
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  // Reject negative values after the inserts of a change set are written.
+  ASSERT_TRUE(
+      db.Execute("CREATE TRIGGER RejectNegativeValue BEFORE UPDATE ON "
+                 "TestPersistentItem WHEN NEW.Value < 0 BEGIN "
+                 "SELECT RAISE(ABORT, 'negative value'); END;"));
+
+  auto existing = std::make_shared<objects::TestPersistentItem>();
+  existing->Register(existing);
+  existing->SetValue(1);
+
+  db.QueueInsert(existing);
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+
+  std::vector<std::shared_ptr<objects::TestPersistentItem>> items;
+
+  for (int32_t i = 0; i < 3; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue((i + 1) * 10);
+
+    items.push_back(item);
+  }
+
+  auto failedUUID = libobjgen::UUID::Random();
+
+  db.QueueInsert(items[0], libobjgen::UUID::Random());
+
+  auto changes = DatabaseChangeSet::Create(failedUUID);
+  changes->Insert(items[1]);
+  existing->SetValue(-2);
+  changes->Update(existing);
+  EXPECT_TRUE(db.QueueChangeSet(changes));
+
+  db.QueueInsert(items[2], libobjgen::UUID::Random());
+
+  // Only the change set that failed is rolled back to its savepoint.
+  auto failures = db.ProcessTransactionQueue();
+
+  ASSERT_EQ((size_t)1, failures.size());
+  EXPECT_EQ(failedUUID, failures.front());
+
+  auto stats = db.GetGroupCommitStats();
+  EXPECT_EQ((uint64_t)1, stats.transactions);
+  EXPECT_EQ((uint64_t)2, stats.changeSets);
+  EXPECT_EQ((uint64_t)1, stats.rolledBack);
+  EXPECT_EQ((uint64_t)0, stats.fallbacks);
+
+  EXPECT_EQ(10, GetItemValue(db, items[0]->GetUUID()));
+  EXPECT_EQ(-1, GetItemValue(db, items[1]->GetUUID()));
+  EXPECT_EQ(30, GetItemValue(db, items[2]->GetUUID()));
+  EXPECT_EQ(1, GetItemValue(db, existing->GetUUID()));
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, GroupCommitFallback) {
+  auto config = GetConfig();
+  config->SetGroupCommit(true);
+  RegisterTestType<objects::TestPersistentItem>();
+
+  SavepointDatabase db(config);
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  std::vector<std::shared_ptr<objects::TestPersistentItem>> items;
+
+  for (int32_t i = 0; i < 3; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(i + 1);
+
+    db.QueueInsert(item);
+    items.push_back(item);
+  }
+
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+
+  // Each update is its own change set so they are written as a group.
+  for (int32_t i = 0; i < 3; ++i) {
+    items[(size_t)i]->SetValue((i + 1) * 100);
+
+    auto changes = DatabaseChangeSet::Create(libobjgen::UUID::Random());
+    changes->Update(items[(size_t)i]);
+    EXPECT_TRUE(db.QueueChangeSet(changes));
+  }
+
+  // The group commit is rolled back and each change set is written again.
+  db.allowRelease = false;
+
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+
+  auto stats = db.GetGroupCommitStats();
+  EXPECT_EQ((uint64_t)1, stats.fallbacks);
+
+  for (int32_t i = 0; i < 3; ++i) {
+    EXPECT_EQ((i + 1) * 100, GetItemValue(db, items[(size_t)i]->GetUUID()));
+    EXPECT_FALSE(items[(size_t)i]->IsDirty());
+  }
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, ExplicitUpdateFallback) {
+  RegisterTestType<objects::TestPersistentItem>();
+
+  SavepointDatabase db(GetConfig());
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  std::vector<std::shared_ptr<objects::TestPersistentItem>> items;
+
+  auto changeset = DatabaseChangeSet::Create();
+
+  for (int i = 0; i < 10; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(100);
+
+    changeset->Insert(item);
+    items.push_back(item);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+
+  // Updates to the same column of the same table run as one statement.
+  auto opChangeset = std::make_shared<DBOperationalChangeSet>();
+
+  for (auto item : items) {
+    auto expl = std::make_shared<DBExplicitUpdate>(item);
+    EXPECT_TRUE(expl->Subtract<int32_t>("Value", 10));
+    opChangeset->AddOperation(expl);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(opChangeset));
+  EXPECT_TRUE(opChangeset->GetFailedUpdates().empty());
+
+  auto stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)1, stats.explicitStatements);
+  EXPECT_EQ((uint64_t)10, stats.explicitRows);
+  EXPECT_EQ((uint64_t)0, stats.explicitFallbacks);
+
+  for (auto item : items) {
+    EXPECT_EQ(90, item->GetValue());
+  }
+
+  // A record that does not have the expected value is rolled back to the
+  // savepoint and found by running each update on its own.
+  opChangeset = std::make_shared<DBOperationalChangeSet>();
+
+  std::shared_ptr<DBExplicitUpdate> stale;
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    auto expl = std::make_shared<DBExplicitUpdate>(items[i]);
+    EXPECT_TRUE(expl->SubtractFrom<int32_t>("Value", 10, 3 == i ? 100 : 90));
+    opChangeset->AddOperation(expl);
+
+    if (3 == i) {
+      stale = expl;
+    }
+  }
+
+  EXPECT_FALSE(db.ProcessChangeSet(opChangeset));
+
+  auto failed = opChangeset->GetFailedUpdates();
+  ASSERT_EQ((size_t)1, failed.size());
+  EXPECT_EQ(stale, failed.front());
+
+  stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)12, stats.explicitStatements);
+  EXPECT_EQ((uint64_t)1, stats.explicitFallbacks);
+  EXPECT_EQ(90, GetItemValue(db, items.front()->GetUUID()));
+
+  // Without a savepoint the batch is run one record at a time.
+  db.allowSavepoints = false;
+
+  opChangeset = std::make_shared<DBOperationalChangeSet>();
+
+  for (auto item : items) {
+    auto expl = std::make_shared<DBExplicitUpdate>(item);
+    EXPECT_TRUE(expl->SubtractFrom<int32_t>("Value", 10, 90));
+    opChangeset->AddOperation(expl);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(opChangeset));
+  EXPECT_TRUE(opChangeset->GetFailedUpdates().empty());
+
+  stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)22, stats.explicitStatements);
+  EXPECT_EQ((uint64_t)2, stats.explicitFallbacks);
+
+  for (auto item : items) {
+    EXPECT_EQ(80, GetItemValue(db, item->GetUUID()));
+  }
+
+  // Records that fail are still reported without a savepoint.
+  opChangeset = std::make_shared<DBOperationalChangeSet>();
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    auto expl = std::make_shared<DBExplicitUpdate>(items[i]);
+    EXPECT_TRUE(expl->SubtractFrom<int32_t>("Value", 10, 5 == i ? 90 : 80));
+    opChangeset->AddOperation(expl);
+
+    if (5 == i) {
+      stale = expl;
+    }
+  }
+
+  EXPECT_FALSE(db.ProcessChangeSet(opChangeset));
+
+  failed = opChangeset->GetFailedUpdates();
+  ASSERT_EQ((size_t)1, failed.size());
+  EXPECT_EQ(stale, failed.front());
+
+  for (auto item : items) {
+    EXPECT_EQ(80, GetItemValue(db, item->GetUUID()));
+  }
+
+  ASSERT_TRUE(db.Close());
+}
+
+TEST(SQLite3, BatchedChangeSets) {
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  BatchDatabase db(GetConfig());
+
+  ASSERT_TRUE(db.Open());
+  ASSERT_TRUE(db.Setup());
+
+  // An item insert binds the UID, Value and Enchants so 10 rows fit in
+  // each statement.
+  db.maxBindCount = 30;
+
+  auto before = db.GetBatchStats();
+
+  std::vector<std::shared_ptr<objects::TestPersistentItem>> items;
+
+  auto changeset = std::make_shared<DBStandardChangeSet>();
+
+  for (int32_t i = 0; i < 25; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(i);
+
+    changeset->Insert(item);
+    items.push_back(item);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+
+  auto stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)3, stats.insertStatements - before.insertStatements);
+  EXPECT_EQ((uint64_t)25, stats.insertRows - before.insertRows);
+
+  for (int32_t i = 0; i < 25; ++i) {
+    EXPECT_EQ(i, GetItemValue(db, items[(size_t)i]->GetUUID()));
+  }
+
+  // Updating only the Value binds 3 values for each row so 10 rows fit in
+  // each statement. Updating the Enchants as well binds 5 so the items
+  // that change both columns are written by a separate statement.
+  auto enchant = std::make_shared<objects::TestPersistentEnchant>();
+  enchant->Register(enchant);
+
+  changeset = std::make_shared<DBStandardChangeSet>();
+
+  for (int32_t i = 0; i < 25; ++i) {
+    auto item = items[(size_t)i];
+    item->SetValue(i + 100);
+
+    if (20 <= i) {
+      item->AppendEnchants(enchant);
+    }
+
+    changeset->Update(item);
+  }
+
+  before = db.GetBatchStats();
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+
+  stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)3, stats.updateStatements - before.updateStatements);
+  EXPECT_EQ((uint64_t)25, stats.updateRows - before.updateRows);
+
+  for (int32_t i = 0; i < 25; ++i) {
+    EXPECT_EQ(i + 100, GetItemValue(db, items[(size_t)i]->GetUUID()));
+  }
+
+  // Without the lower limit every insert fits in one statement.
+  db.maxBindCount = 0;
+
+  changeset = std::make_shared<DBStandardChangeSet>();
+
+  for (int32_t i = 0; i < 25; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(i);
+
+    changeset->Insert(item);
+  }
+
+  before = db.GetBatchStats();
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+
+  stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)1, stats.insertStatements - before.insertStatements);
+  EXPECT_EQ((uint64_t)25, stats.insertRows - before.insertRows);
+
+  // Reload the items to check the Enchants were written.
+  std::list<libobjgen::UUID> uuids;
+
+  for (auto item : items) {
+    uuids.push_back(item->GetUUID());
+  }
+
+  auto enchantUUID = enchant->GetUUID();
+
+  changeset.reset();
+  items.clear();
+  enchant.reset();
+
+  auto objects = db.LoadObjectsByUUIDs(
+      typeid(objects::TestPersistentItem).hash_code(), uuids, true);
+  ASSERT_EQ((size_t)25, objects.size());
+
+  int32_t i = 0;
+
+  for (auto obj : objects) {
+    auto item = std::dynamic_pointer_cast<objects::TestPersistentItem>(obj);
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(i + 100, item->GetValue());
+
+    if (20 <= i) {
+      ASSERT_EQ((size_t)1, item->EnchantsCount());
+      EXPECT_EQ(enchantUUID, item->GetEnchants(0).GetUUID());
+    } else {
+      EXPECT_EQ((size_t)0, item->EnchantsCount());
+    }
+
+    i++;
+  }
+
+  objects.clear();
+
+  EXPECT_TRUE(db.Close());
+}
+
+TEST(SQLite3, Executor) {
+  RegisterTestType<objects::TestPersistentItem>();
+
+  auto db = std::make_shared<DatabaseSQLite3>(GetConfig());
+
+  ASSERT_TRUE(db->Open());
+  ASSERT_TRUE(db->Setup());
+
+  // The in-memory database has a single connection so the operations run
+  // one at a time on one thread.
+  DatabaseExecutor executor(db, 1);
+
+  // Nothing is queued until the executor starts.
+  EXPECT_FALSE(executor.ExecuteAsync("SELECT 1", nullptr));
+
+  executor.Start();
+
+  // The completions are queued on the worker and only run once it starts.
+  auto worker = std::make_shared<Worker>();
+
+  std::vector<bool> results;
+  std::vector<size_t> loaded;
+  std::set<std::thread::id> completionThreads;
+
+  std::vector<std::shared_ptr<objects::TestPersistentItem>> items;
+
+  for (int32_t i = 0; i < 10; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(i);
+
+    auto changeset = DatabaseChangeSet::Create();
+    changeset->Insert(item);
+
+    EXPECT_TRUE(executor.QueueChangeSetAsync(
+        changeset, worker, [&results, &completionThreads](bool result) {
+          results.push_back(result);
+          completionThreads.insert(std::this_thread::get_id());
+        }));
+
+    items.push_back(item);
+  }
+
+  // Inserting the same item again fails.
+  auto duplicate = DatabaseChangeSet::Create();
+  duplicate->Insert(items.front());
+
+  EXPECT_TRUE(executor.QueueChangeSetAsync(
+      duplicate, worker, [&results, &completionThreads](bool result) {
+        results.push_back(result);
+        completionThreads.insert(std::this_thread::get_id());
+      }));
+
+  // The loads are queued after the change sets so they see every insert.
+  EXPECT_TRUE(executor.LoadObjectsAsync<objects::TestPersistentItem>(
+      nullptr, worker,
+      [&loaded, &completionThreads](
+          const std::list<std::shared_ptr<objects::TestPersistentItem>>
+              &objs) {
+        loaded.push_back(objs.size());
+        completionThreads.insert(std::this_thread::get_id());
+      }));
+
+  EXPECT_TRUE(executor.LoadObjectsAsync<objects::TestPersistentItem>(
+      new DatabaseBindInt("Value", 3), worker,
+      [&loaded, &completionThreads](
+          const std::list<std::shared_ptr<objects::TestPersistentItem>>
+              &objs) {
+        loaded.push_back(objs.size());
+        completionThreads.insert(std::this_thread::get_id());
+
+        if (1 == objs.size()) {
+          EXPECT_EQ(3, objs.front()->GetValue());
+        }
+      }));
+
+  // Loads of an unknown type or of objects that do not exist fail.
+  std::atomic<size_t> partialLoad(0);
+
+  EXPECT_TRUE(executor.LoadObjectsAsync(
+      0, nullptr, nullptr,
+      [](const std::list<std::shared_ptr<PersistentObject>> &objs) {
+        EXPECT_TRUE(objs.empty());
+      }));
+
+  EXPECT_TRUE(executor.LoadObjectsByUUIDsAsync(
+      typeid(objects::TestPersistentItem).hash_code(),
+      {items.front()->GetUUID(), libobjgen::UUID::Random()}, nullptr,
+      [&partialLoad](const std::list<std::shared_ptr<PersistentObject>> &objs) {
+        partialLoad = objs.size();
+      }));
+
+  // Without a worker the completion runs on the database thread.
+  std::atomic<int32_t> executeFailures(0);
+
+  EXPECT_TRUE(executor.ExecuteAsync("SELECT", nullptr,
+                                    [&executeFailures](bool result) {
+                                      if (!result) {
+                                        executeFailures++;
+                                      }
+                                    }));
+
+  // Shutting down finishes everything that was queued.
+  executor.Shutdown();
+
+  EXPECT_EQ(1, executeFailures);
+  EXPECT_EQ((size_t)1, partialLoad);
+  EXPECT_FALSE(executor.ExecuteAsync("SELECT 1", nullptr));
+
+  auto stats = executor.GetStats();
+  auto &load = stats.operations[static_cast<size_t>(DatabaseOperation_t::LOAD)];
+  auto &changeSet =
+      stats.operations[static_cast<size_t>(DatabaseOperation_t::CHANGE_SET)];
+  auto &execute =
+      stats.operations[static_cast<size_t>(DatabaseOperation_t::EXECUTE)];
+
+  EXPECT_EQ((uint64_t)0, stats.queueDepth);
+  EXPECT_EQ((uint64_t)4, load.count);
+  EXPECT_EQ((uint64_t)2, load.failures);
+  EXPECT_EQ((uint64_t)11, changeSet.count);
+  EXPECT_EQ((uint64_t)1, changeSet.failures);
+  EXPECT_EQ((uint64_t)1, execute.count);
+  EXPECT_EQ((uint64_t)1, execute.failures);
+
+  for (int32_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, GetItemValue(*db, items[(size_t)i]->GetUUID()));
+  }
+
+  EXPECT_TRUE(results.empty());
+  EXPECT_TRUE(loaded.empty());
+
+  // Run the worker in this thread until every completion is handled.
+  worker->Shutdown();
+  worker->Start("test", true);
+
+  ASSERT_EQ((size_t)11, results.size());
+
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_TRUE(results[i]);
+  }
+
+  EXPECT_FALSE(results.back());
+  EXPECT_EQ(std::vector<size_t>({10, 1}), loaded);
+  EXPECT_EQ(std::set<std::thread::id>({std::this_thread::get_id()}),
+            completionThreads);
+
+  EXPECT_TRUE(db->Close());
+}
+
+TEST(DatabaseQueryStats, NormalizeSQL) {
+  // Repeated parameter lists of batched statements collapse to one.
+  EXPECT_EQ(String("INSERT INTO `Account` (`UID`, `CP`) VALUES (?);"),
+            DatabaseQueryStats::NormalizeSQL(
+                "INSERT INTO `Account` (`UID`, `CP`) VALUES (?, ?), (?, ?);"));
+  EXPECT_EQ(String("UPDATE `Account` SET `CP` = CASE `UID` WHEN ? THEN ? END "
+                   "WHERE `UID` IN (?);"),
+            DatabaseQueryStats::NormalizeSQL(
+                "UPDATE `Account` SET `CP` = CASE `UID` WHEN ? THEN ? "
+                "WHEN ? THEN ? END WHERE `UID` IN (?, ?);"));
+  EXPECT_EQ(String("INSERT INTO Stats (Value) VALUES (?);"),
+            DatabaseQueryStats::NormalizeSQL(
+                "INSERT INTO Stats (Value) VALUES (1), (11);"));
+
+  // Literals and named parameters are replaced but digits that are part
+  // of an identifier are kept.
+  EXPECT_EQ(String("SELECT * FROM `Account2` WHERE `Name` = ? AND `CP` > ?"),
+            DatabaseQueryStats::NormalizeSQL(
+                "SELECT *  FROM `Account2` WHERE `Name` = 'it''s' AND "
+                "`CP` > 10"));
+  EXPECT_EQ(String("SELECT Value FROM TestPersistentItem WHERE UID = ?;"),
+            DatabaseQueryStats::NormalizeSQL(
+                "SELECT Value FROM TestPersistentItem WHERE UID = :uid;"));
+  EXPECT_EQ(String("SELECT x1 FROM T2 WHERE y = ? AND z IN (?);"),
+            DatabaseQueryStats::NormalizeSQL(
+                "SELECT x1\n\tFROM T2 WHERE y = \"a\"\"b\" AND z IN "
+                "(1.5,2,3);"));
+}
+
+TEST(SQLite3, QueryStats) {
+  auto config = GetConfig();
+  config->SetQueryStats(true);
+  config->SetSlowQueryThreshold(1);
+
+  DatabaseSQLite3 db(config);
+
+  ASSERT_TRUE(db.Open());
+
+  DatabaseQueryStats::Reset();
+
+  // Executions are slow once they take the threshold of 1 ms.
+  EXPECT_FALSE(DatabaseQueryStats::CheckSlowQuery("SELECT 1;", 999, {}));
+  EXPECT_TRUE(DatabaseQueryStats::CheckSlowQuery("SELECT 1;", 1000, {"int"}));
+
+  EXPECT_TRUE(db.Execute("CREATE TABLE Stats (Value int);"));
+
+  for (int32_t i = 0; i < 3; ++i) {
+    EXPECT_TRUE(db.Execute(String("INSERT INTO Stats (Value) VALUES (%1), "
+                                  "(%2);")
+                               .Arg(i)
+                               .Arg(i + 10)));
+  }
+
+  // Counting this many rows takes well over the threshold.
+  EXPECT_TRUE(
+      db.Execute("WITH RECURSIVE Counter(Value) AS (SELECT 1 UNION ALL "
+                 "SELECT Value + 1 FROM Counter WHERE Value < 1000000) "
+                 "SELECT COUNT(*) FROM Counter;"));
+
+  auto shapes = DatabaseQueryStats::GetTopShapes(0);
+  ASSERT_EQ((size_t)3, shapes.size());
+
+  // The shapes are sorted by the total execution time.
+  EXPECT_EQ(String("WITH RECURSIVE Counter(Value) AS (SELECT ? UNION ALL "
+                   "SELECT Value + ? FROM Counter WHERE Value < ?) "
+                   "SELECT COUNT(*) FROM Counter;"),
+            shapes[0].shape);
+  EXPECT_EQ((uint64_t)1, shapes[0].count);
+  EXPECT_EQ((uint64_t)1, shapes[0].slowCount);
+  EXPECT_LE((uint64_t)1000, shapes[0].maxTime);
+
+  for (size_t i = 1; i < shapes.size(); ++i) {
+    EXPECT_GE(shapes[i - 1].totalTime, shapes[i].totalTime);
+  }
+
+  for (auto &shape : shapes) {
+    if (String("INSERT INTO Stats (Value) VALUES (?);") == shape.shape) {
+      EXPECT_EQ((uint64_t)3, shape.count);
+      EXPECT_EQ((uint64_t)6, shape.rowsAffected);
+      EXPECT_GE(shape.totalTime, shape.maxTime);
+    }
+  }
+
+  // The top shapes are limited to the count requested.
+  DatabaseQueryStats::Reset();
+
+  DatabaseQueryShapeStats stats;
+  stats.count = 1;
+
+  stats.totalTime = 5;
+  DatabaseQueryStats::Record("SELECT * FROM A;", stats);
+
+  stats.totalTime = 50;
+  DatabaseQueryStats::Record("SELECT * FROM B;", stats);
+
+  stats.totalTime = 20;
+  DatabaseQueryStats::Record("SELECT * FROM C;", stats);
+
+  shapes = DatabaseQueryStats::GetTopShapes(2);
+  ASSERT_EQ((size_t)2, shapes.size());
+  EXPECT_EQ(String("SELECT * FROM B;"), shapes[0].shape);
+  EXPECT_EQ(String("SELECT * FROM C;"), shapes[1].shape);
+
+  // Shapes past the limit of the table are added to one overflow entry
+  // while the shapes already tracked are still updated.
+  DatabaseQueryStats::Reset();
+
+  stats.totalTime = 1;
+
+  for (int32_t i = 0; i < 1000; ++i) {
+    DatabaseQueryStats::Record(String("SELECT * FROM T%1;").Arg(i), stats);
+  }
+
+  for (int32_t i = 1000; i < 1005; ++i) {
+    DatabaseQueryStats::Record(String("SELECT * FROM T%1;").Arg(i), stats);
+  }
+
+  DatabaseQueryStats::Record("SELECT * FROM T0;", stats);
+
+  shapes = DatabaseQueryStats::GetTopShapes(0);
+  ASSERT_EQ((size_t)1001, shapes.size());
+
+  for (auto &shape : shapes) {
+    if (String("(other)") == shape.shape) {
+      EXPECT_EQ((uint64_t)5, shape.count);
+    } else if (String("SELECT * FROM T0;") == shape.shape) {
+      EXPECT_EQ((uint64_t)2, shape.count);
+    } else {
+      EXPECT_EQ((uint64_t)1, shape.count);
+    }
+  }
+
+  EXPECT_EQ((size_t)1, std::count_if(shapes.begin(), shapes.end(),
+                                     [](const DatabaseQueryShapeStats &shape) {
+                                       return String("(other)") == shape.shape;
+                                     }));
+
+  ASSERT_TRUE(db.Close());
+
+  DatabaseQueryStats::Reset();
+  DatabaseQueryStats::Configure(false, 0);
+}
+
+/**
+ * Select a value written as a literal.
+ * @param db Database to write the literal with and select it from.
+ * @param value Value to write.
+ * @param result Output value read back from the database.
+ * @return true if the literal was written and selected.
+ */
+template <typename T>
+static bool SelectLiteral(LiteralDatabase &db, const DatabaseBind &value,
+                          T &result) {
+  auto literal = db.FormatLiteral(&value);
+
+  if (literal.IsEmpty()) {
+    return false;
+  }
+
+  auto query = db.Prepare(String("SELECT %1;").Arg(literal));
+
+  return query.Execute() && query.Next() && query.GetValue(0, result);
+}
+
+TEST(SQLite3, FormatLiteral) {
+  LiteralDatabase db(GetConfig());
+
+  ASSERT_TRUE(db.Open());
+
+  String text;
+  EXPECT_TRUE(SelectLiteral(
+      db, DatabaseBindText("Text", "it's \"quoted\" \\ caf\xC3\xA9"), text));
+  EXPECT_EQ(String("it's \"quoted\" \\ caf\xC3\xA9"), text);
+
+  std::vector<char> blob;
+  std::vector<char> bytes = {0, (char)0xFF, '\'', 'a'};
+  EXPECT_TRUE(SelectLiteral(db, DatabaseBindBlob("Blob", bytes), blob));
+  EXPECT_EQ(bytes, blob);
+
+  int32_t i32 = 0;
+  EXPECT_TRUE(SelectLiteral(db, DatabaseBindInt("Int", -2147483647 - 1), i32));
+  EXPECT_EQ(-2147483647 - 1, i32);
+
+  int64_t i64 = 0;
+  EXPECT_TRUE(
+      SelectLiteral(db, DatabaseBindBigInt("BigInt", 9007199254740993), i64));
+  EXPECT_EQ(9007199254740993, i64);
+
+  // Real values read back exactly.
+  float f = 0.0f;
+  EXPECT_TRUE(SelectLiteral(db, DatabaseBindFloat("Float", 0.1f), f));
+  EXPECT_EQ(0.1f, f);
+
+  double d = 0.0;
+  EXPECT_TRUE(SelectLiteral(db, DatabaseBindDouble("Double", 1.0 / 3.0), d));
+  EXPECT_EQ(1.0 / 3.0, d);
+
+  bool b = false;
+  EXPECT_TRUE(SelectLiteral(db, DatabaseBindBool("Bool", true), b));
+  EXPECT_TRUE(b);
+
+  // Values without a literal are not written.
+  DatabaseBindDouble notANumber("Double",
+                                std::numeric_limits<double>::quiet_NaN());
+  EXPECT_TRUE(db.FormatLiteral(&notANumber).IsEmpty());
+
+  DatabaseBindFloat infinity("Float", std::numeric_limits<float>::infinity());
+  EXPECT_TRUE(db.FormatLiteral(&infinity).IsEmpty());
+
+  EXPECT_TRUE(db.Close());
+}
+
+TEST(SQLite3, FormatChangeSet) {
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentInventory>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  // UUIDs are written as text or as blobs to match the columns.
+  for (bool binary : {false, true}) {
+    auto config = GetConfig();
+    config->SetBinaryUUIDs(binary);
+
+    LiteralDatabase db(config);
+
+    ASSERT_TRUE(db.Open());
+    ASSERT_TRUE(db.Setup());
+
+    auto enchant = std::make_shared<objects::TestPersistentEnchant>();
+    enchant->Register(enchant);
+    enchant->SetValue(-3);
+
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue(7);
+    item->AppendEnchants(enchant);
+
+    auto deleted = std::make_shared<objects::TestPersistentItem>();
+    deleted->Register(deleted);
+
+    auto inventory = std::make_shared<objects::TestPersistentInventory>();
+    inventory->Register(inventory);
+    inventory->SetName("it's caf\xC3\xA9");
+    inventory->SetMainItem(item);
+    inventory->SetItems(2, item);
+
+    auto changeset = std::make_shared<DBStandardChangeSet>();
+    changeset->Insert(enchant);
+    changeset->Insert(item);
+    changeset->Insert(deleted);
+    changeset->Insert(inventory);
+
+    std::list<String> statements;
+    ASSERT_TRUE(db.FormatChangeSet(changeset, statements));
+
+    // The batches are written in the order their first object was added.
+    std::list<String> tables = {"TestPersistentEnchant", "TestPersistentItem",
+                                "TestPersistentInventory"};
+    ASSERT_EQ(tables.size(), statements.size());
+
+    auto tableIter = tables.begin();
+
+    for (auto &statement : statements) {
+      auto prefix = String("INSERT INTO %1 ").Arg(*tableIter++);
+      EXPECT_EQ(prefix, statement.Left(prefix.Length()));
+      EXPECT_TRUE(db.Execute(statement));
+    }
+
+    EXPECT_EQ(7, GetItemValue(db, item->GetUUID()));
+    EXPECT_EQ(0, GetItemValue(db, deleted->GetUUID()));
+
+    changeset = std::make_shared<DBStandardChangeSet>();
+    item->SetValue(8);
+    changeset->Update(item);
+    changeset->Delete(deleted);
+
+    statements.clear();
+    ASSERT_TRUE(db.FormatChangeSet(changeset, statements));
+    EXPECT_EQ((size_t)2, statements.size());
+
+    for (auto &statement : statements) {
+      EXPECT_TRUE(db.Execute(statement));
+    }
+
+    EXPECT_EQ(8, GetItemValue(db, item->GetUUID()));
+    EXPECT_EQ(-1, GetItemValue(db, deleted->GetUUID()));
+
+    // Reload the objects to check every value was written.
+    auto itemUUID = item->GetUUID();
+    auto enchantUUID = enchant->GetUUID();
+    auto inventoryUUID = inventory->GetUUID();
+
+    changeset.reset();
+    inventory.reset();
+    item.reset();
+    enchant.reset();
+    deleted.reset();
+
+    auto objects = db.LoadObjectsByUUIDs(
+        typeid(objects::TestPersistentItem).hash_code(), {itemUUID}, true);
+    ASSERT_EQ((size_t)1, objects.size());
+
+    item = std::dynamic_pointer_cast<objects::TestPersistentItem>(
+        objects.front());
+    EXPECT_EQ(8, item->GetValue());
+    ASSERT_EQ((size_t)1, item->EnchantsCount());
+    EXPECT_EQ(enchantUUID, item->GetEnchants(0).GetUUID());
+
+    objects = db.LoadObjectsByUUIDs(
+        typeid(objects::TestPersistentInventory).hash_code(), {inventoryUUID},
+        true);
+    ASSERT_EQ((size_t)1, objects.size());
+
+    inventory = std::dynamic_pointer_cast<objects::TestPersistentInventory>(
+        objects.front());
+    EXPECT_EQ(String("it's caf\xC3\xA9"), inventory->GetName());
+    EXPECT_EQ(itemUUID, inventory->GetMainItem().GetUUID());
+    EXPECT_EQ(itemUUID, inventory->GetItems(2).GetUUID());
+    EXPECT_TRUE(inventory->GetItems(0).GetUUID().IsNull());
+
+    objects = db.LoadObjectsByUUIDs(
+        typeid(objects::TestPersistentEnchant).hash_code(), {enchantUUID},
+        true);
+    ASSERT_EQ((size_t)1, objects.size());
+    EXPECT_EQ(-3, std::dynamic_pointer_cast<objects::TestPersistentEnchant>(
+                      objects.front())
+                      ->GetValue());
+
+    EXPECT_TRUE(db.Close());
+  }
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    TestLog log;
 
     return RUN_ALL_TESTS();
   } catch (...) {
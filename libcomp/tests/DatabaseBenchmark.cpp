@@ -0,0 +1,601 @@
+/**
+ * @file libcomp/tests/DatabaseBenchmark.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Benchmark the throughput and latency of the database backends.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <DatabaseChangeSet.h>
+#include <DatabaseMariaDB.h>
+#include <DatabaseSQLite3.h>
+#include <TestPersistentEnchant.h>
+#include <TestPersistentItem.h>
+
+// Standard C++11 Includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace libcomp;
+
+/// Number of objects written by each insert, update and delete benchmark.
+static const size_t WRITE_COUNT = 1000;
+
+/// Number of objects written by each change set of the write benchmarks.
+static const size_t BATCH_SIZES[] = {1, 10, 100, 1000};
+
+/// Number of rows in the table for each load benchmark.
+static const size_t TABLE_SIZES[] = {100, 1000, 10000};
+
+/// Number of times each table is loaded.
+static const int LOAD_REPEAT_COUNT = 5;
+
+/// Number of objects loaded by UUID for each lookup benchmark.
+static const size_t LOOKUP_COUNT = 1000;
+
+/// Number of change sets committed for each latency benchmark.
+static const size_t COMMIT_COUNT = 200;
+
+/// Number of objects updated by each change set of the latency benchmarks.
+static const size_t COMMIT_SIZES[] = {1, 10, 100};
+
+/// Name of the on-disk SQLite3 database and the MariaDB database.
+static const char *DATABASE_NAME = "comp_hack_benchmark";
+
+/// Environment variable with the address of a MariaDB server to benchmark.
+static const char *MARIADB_ENV = "LIBCOMP_BENCHMARK_MARIADB";
+
+/// Environment variable with the path of the results file.
+static const char *RESULTS_ENV = "LIBCOMP_BENCHMARK_RESULTS";
+
+/// Path of the results file when the environment variable is not set.
+static const char *DEFAULT_RESULTS_PATH = "DatabaseBenchmark.csv";
+
+/**
+ * Result of a benchmark step.
+ */
+struct BenchmarkResult {
+  /// Name of the database backend
+  std::string backend;
+
+  /// Name of the benchmark
+  std::string benchmark;
+
+  /// Batch, change set or table size the benchmark was run with
+  size_t size;
+
+  /// Number of operations timed
+  size_t count;
+
+  /// Time taken by every operation (microseconds)
+  int64_t elapsed;
+
+  /// Median latency of an operation (microseconds or -1 if not measured)
+  int64_t p50;
+
+  /// 99th percentile latency of an operation (microseconds or -1 if not
+  /// measured)
+  int64_t p99;
+};
+
+/// Every benchmark result in the order they were measured.
+static std::list<BenchmarkResult> sResults;
+
+/// List of benchmark items.
+typedef std::vector<std::shared_ptr<objects::TestPersistentItem>> ItemList;
+
+/// Function that adds an object to a change set.
+typedef std::function<void(const std::shared_ptr<DatabaseChangeSet> &,
+                           const std::shared_ptr<PersistentObject> &)>
+    ChangeFunction;
+
+template <class T>
+static void RegisterTestType() {
+  PersistentObject::RegisterType(typeid(T), T::GetMetadata(),
+                                 []() { return (PersistentObject *)new T(); });
+}
+
+/**
+ * Get the time since a point in microseconds.
+ * @param start Time to measure from.
+ * @return Number of microseconds since the start.
+ */
+static int64_t Elapsed(const std::chrono::steady_clock::time_point &start) {
+  return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/**
+ * Print and save the result of a benchmark step.
+ * @param result Result of the step.
+ */
+static void Report(const BenchmarkResult &result) {
+  std::cout << "[ BENCH    ] " << result.backend << " " << result.benchmark
+            << " (" << result.size << "): " << result.count << " ops in "
+            << result.elapsed << " us ("
+            << ((double)result.elapsed / (double)result.count) << " us/op";
+
+  if (0 <= result.p50) {
+    std::cout << ", p50 " << result.p50 << " us, p99 " << result.p99 << " us";
+  }
+
+  std::cout << ")" << std::endl;
+
+  sResults.push_back(result);
+}
+
+/**
+ * Report the throughput of a benchmark step.
+ * @param backend Name of the database backend.
+ * @param benchmark Name of the benchmark.
+ * @param size Batch or table size the step was run with.
+ * @param count Number of operations in the step.
+ * @param start Time the step started.
+ */
+static void Report(const std::string &backend, const std::string &benchmark,
+                   size_t size, size_t count,
+                   const std::chrono::steady_clock::time_point &start) {
+  BenchmarkResult result;
+  result.backend = backend;
+  result.benchmark = benchmark;
+  result.size = size;
+  result.count = count;
+  result.elapsed = Elapsed(start);
+  result.p50 = -1;
+  result.p99 = -1;
+
+  Report(result);
+}
+
+/**
+ * Report the latency of each operation of a benchmark step.
+ * @param backend Name of the database backend.
+ * @param benchmark Name of the benchmark.
+ * @param size Change set size the step was run with.
+ * @param samples Time taken by each operation (microseconds).
+ */
+static void ReportLatency(const std::string &backend,
+                          const std::string &benchmark, size_t size,
+                          std::vector<int64_t> samples) {
+  if (samples.empty()) {
+    return;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  BenchmarkResult result;
+  result.backend = backend;
+  result.benchmark = benchmark;
+  result.size = size;
+  result.count = samples.size();
+  result.elapsed = 0;
+  result.p50 = samples[samples.size() / 2];
+  result.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+
+  for (auto sample : samples) {
+    result.elapsed += sample;
+  }
+
+  Report(result);
+}
+
+/**
+ * Write every benchmark result as CSV so runs can be compared.
+ * @param path Path of the file to write.
+ * @return true if the file was written, false if it was not
+ */
+static bool WriteResults(const std::string &path) {
+  std::ofstream out(path.c_str(), std::ofstream::out | std::ofstream::trunc);
+
+  if (!out.good()) {
+    return false;
+  }
+
+  out << "backend,benchmark,size,count,total_us,us_per_op,ops_per_sec,"
+         "p50_us,p99_us"
+      << std::endl;
+
+  for (auto &result : sResults) {
+    out << result.backend << "," << result.benchmark << "," << result.size
+        << "," << result.count << "," << result.elapsed << ","
+        << ((double)result.elapsed / (double)result.count) << ","
+        << (result.elapsed
+                ? ((double)result.count * 1000000.0 / (double)result.elapsed)
+                : 0.0)
+        << ",";
+
+    if (0 <= result.p50) {
+      out << result.p50 << "," << result.p99;
+    } else {
+      out << ",";
+    }
+
+    out << std::endl;
+  }
+
+  return out.good();
+}
+
+/**
+ * Create registered items that are not saved yet.
+ * @param count Number of items to create.
+ * @return List of the items.
+ */
+static ItemList CreateItems(size_t count) {
+  ItemList items;
+  items.reserve(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    auto item = std::make_shared<objects::TestPersistentItem>();
+    item->Register(item);
+    item->SetValue((int32_t)i);
+
+    items.push_back(item);
+  }
+
+  return items;
+}
+
+/**
+ * Save changes to items with one change set per batch.
+ * @param db Database to save to.
+ * @param items Items to save.
+ * @param batchSize Number of items in each change set.
+ * @param change Function that adds an item to a change set.
+ * @return true if every change set was saved, false if one was not
+ */
+static bool ProcessBatches(const std::shared_ptr<Database> &db,
+                           const ItemList &items, size_t batchSize,
+                           const ChangeFunction &change) {
+  bool result = true;
+
+  for (size_t i = 0; i < items.size(); i += batchSize) {
+    auto changeset = DatabaseChangeSet::Create();
+
+    for (size_t j = i; j < std::min(items.size(), i + batchSize); ++j) {
+      change(changeset, items[j]);
+    }
+
+    if (!db->ProcessChangeSet(changeset)) {
+      result = false;
+    }
+  }
+
+  return result;
+}
+
+/**
+ * Benchmark inserting, updating and deleting objects with each batch size.
+ * @param backend Name of the database backend.
+ * @param db Database to benchmark.
+ */
+static void BenchmarkWrites(const std::string &backend,
+                            const std::shared_ptr<Database> &db) {
+  for (auto batchSize : BATCH_SIZES) {
+    auto items = CreateItems(WRITE_COUNT);
+
+    auto start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(ProcessBatches(db, items, batchSize,
+                               [](const std::shared_ptr<DatabaseChangeSet> &cs,
+                                  const std::shared_ptr<PersistentObject> &obj) {
+                                 cs->Insert(obj);
+                               }));
+
+    Report(backend, "insert", batchSize, items.size(), start);
+
+    for (auto &item : items) {
+      item->SetValue(item->GetValue() + 1);
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(ProcessBatches(db, items, batchSize,
+                               [](const std::shared_ptr<DatabaseChangeSet> &cs,
+                                  const std::shared_ptr<PersistentObject> &obj) {
+                                 cs->Update(obj);
+                               }));
+
+    Report(backend, "update", batchSize, items.size(), start);
+
+    start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(ProcessBatches(db, items, batchSize,
+                               [](const std::shared_ptr<DatabaseChangeSet> &cs,
+                                  const std::shared_ptr<PersistentObject> &obj) {
+                                 cs->Delete(obj);
+                               }));
+
+    Report(backend, "delete", batchSize, items.size(), start);
+  }
+
+  EXPECT_FALSE(db->TableHasRows("TestPersistentItem"));
+}
+
+/**
+ * Benchmark loading every object of a table with each table size and
+ * loading objects by UUID from the largest table.
+ * @param backend Name of the database backend.
+ * @param db Database to benchmark.
+ */
+static void BenchmarkLoads(const std::string &backend,
+                           const std::shared_ptr<Database> &db) {
+  auto typeHash = typeid(objects::TestPersistentItem).hash_code();
+
+  std::vector<libobjgen::UUID> uuids;
+  size_t tableSize = 0;
+
+  for (auto size : TABLE_SIZES) {
+    {
+      // Only keep the UUIDs so the loads read from the database instead of
+      // the object cache.
+      auto items = CreateItems(size - uuids.size());
+
+      EXPECT_TRUE(ProcessBatches(
+          db, items, 1000,
+          [](const std::shared_ptr<DatabaseChangeSet> &cs,
+             const std::shared_ptr<PersistentObject> &obj) {
+            cs->Insert(obj);
+          }));
+
+      for (auto &item : items) {
+        uuids.push_back(item->GetUUID());
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < LOAD_REPEAT_COUNT; ++i) {
+      EXPECT_EQ(size, db->LoadObjects(typeHash, nullptr).size());
+    }
+
+    Report(backend, "load_objects", size, LOAD_REPEAT_COUNT, start);
+
+    tableSize = size;
+  }
+
+  // Objects that are loaded by UUID again are found in the object cache.
+  auto loaded = db->LoadObjects(typeHash, nullptr);
+  EXPECT_EQ(tableSize, loaded.size());
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+    EXPECT_NE(nullptr,
+              PersistentObject::LoadObjectByUUID<objects::TestPersistentItem>(
+                  db, uuids[(i * 7919) % uuids.size()]));
+  }
+
+  Report(backend, "load_uuid_cached", tableSize, LOOKUP_COUNT, start);
+
+  start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+    EXPECT_NE(nullptr,
+              PersistentObject::LoadObjectByUUID<objects::TestPersistentItem>(
+                  db, uuids[(i * 7919) % uuids.size()], true));
+  }
+
+  Report(backend, "load_uuid_hit", tableSize, LOOKUP_COUNT, start);
+
+  std::vector<libobjgen::UUID> missing;
+  missing.reserve(LOOKUP_COUNT);
+
+  for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+    missing.push_back(libobjgen::UUID::Random());
+  }
+
+  start = std::chrono::steady_clock::now();
+
+  for (auto &uuid : missing) {
+    EXPECT_EQ(nullptr,
+              PersistentObject::LoadObjectByUUID<objects::TestPersistentItem>(
+                  db, uuid, false, false));
+  }
+
+  Report(backend, "load_uuid_miss", tableSize, LOOKUP_COUNT, start);
+
+  // Leave the table empty for the next benchmark.
+  EXPECT_TRUE(db->DeleteObjects(loaded));
+}
+
+/**
+ * Benchmark the latency of committing change sets that insert one object,
+ * update a number of objects and delete the object inserted before.
+ * @param backend Name of the database backend.
+ * @param db Database to benchmark.
+ */
+static void BenchmarkCommits(const std::string &backend,
+                             const std::shared_ptr<Database> &db) {
+  for (auto commitSize : COMMIT_SIZES) {
+    auto items = CreateItems(commitSize);
+
+    EXPECT_TRUE(ProcessBatches(db, items, items.size(),
+                               [](const std::shared_ptr<DatabaseChangeSet> &cs,
+                                  const std::shared_ptr<PersistentObject> &obj) {
+                                 cs->Insert(obj);
+                               }));
+
+    auto inserted = CreateItems(COMMIT_COUNT);
+
+    std::vector<int64_t> samples;
+    samples.reserve(COMMIT_COUNT);
+
+    for (size_t i = 0; i < COMMIT_COUNT; ++i) {
+      auto changeset = DatabaseChangeSet::Create();
+      changeset->Insert(inserted[i]);
+
+      for (auto &item : items) {
+        item->SetValue(item->GetValue() + 1);
+        changeset->Update(item);
+      }
+
+      if (0 < i) {
+        changeset->Delete(inserted[i - 1]);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+
+      EXPECT_TRUE(db->ProcessChangeSet(changeset));
+
+      samples.push_back(Elapsed(start));
+    }
+
+    ReportLatency(backend, "commit", commitSize, samples);
+
+    auto changeset = DatabaseChangeSet::Create();
+    changeset->Delete(inserted.back());
+
+    for (auto &item : items) {
+      changeset->Delete(item);
+    }
+
+    EXPECT_TRUE(db->ProcessChangeSet(changeset));
+  }
+}
+
+/**
+ * Run every benchmark against a database.
+ * @param backend Name of the database backend.
+ * @param db Database to benchmark.
+ */
+static void RunBenchmarks(const std::string &backend,
+                          const std::shared_ptr<Database> &db) {
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  ASSERT_TRUE(db->Open());
+  ASSERT_TRUE(db->Setup(true));
+
+  BenchmarkWrites(backend, db);
+  BenchmarkLoads(backend, db);
+  BenchmarkCommits(backend, db);
+}
+
+/**
+ * Remove the on-disk SQLite3 database and its journal files.
+ * @param filepath Path to the database file.
+ */
+static void RemoveDatabaseFile(const std::string &filepath) {
+  std::remove(filepath.c_str());
+  std::remove((filepath + "-journal").c_str());
+  std::remove((filepath + "-wal").c_str());
+  std::remove((filepath + "-shm").c_str());
+}
+
+TEST(DatabaseBenchmark, SQLite3Memory) {
+  auto config = std::make_shared<objects::DatabaseConfigSQLite3>();
+  config->SetDatabaseName(":memory:");
+
+  auto db = std::make_shared<DatabaseSQLite3>(config);
+
+  RunBenchmarks("sqlite3_memory", db);
+
+  EXPECT_TRUE(db->Close());
+}
+
+TEST(DatabaseBenchmark, SQLite3File) {
+  auto config = std::make_shared<objects::DatabaseConfigSQLite3>();
+  config->SetDatabaseName(DATABASE_NAME);
+  config->SetFileDirectory(".");
+
+  std::string filepath = std::string("./") + DATABASE_NAME + ".sqlite3";
+  RemoveDatabaseFile(filepath);
+
+  auto db = std::make_shared<DatabaseSQLite3>(config);
+
+  RunBenchmarks("sqlite3_file", db);
+
+  EXPECT_TRUE(db->Close());
+
+  RemoveDatabaseFile(filepath);
+}
+
+TEST(DatabaseBenchmark, MariaDB) {
+  const char *address = std::getenv(MARIADB_ENV);
+
+  if (nullptr == address || 0 == *address) {
+    std::cout << "[ BENCH    ] Set " << MARIADB_ENV
+              << " to the address of a MariaDB server to benchmark it."
+              << std::endl;
+
+    return;
+  }
+
+  auto config = std::make_shared<objects::DatabaseConfigMariaDB>();
+  config->SetIP(address);
+  config->SetDatabaseName(DATABASE_NAME);
+  config->SetUsername("testuser");
+  config->SetPassword("un1tt3st");
+
+  auto db = std::make_shared<DatabaseMariaDB>(config);
+
+  RunBenchmarks("mariadb", db);
+
+  EXPECT_TRUE(db->Execute("DROP DATABASE IF EXISTS comp_hack_benchmark;"));
+  EXPECT_TRUE(db->Close());
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    int result = RUN_ALL_TESTS();
+
+    const char *path = std::getenv(RESULTS_ENV);
+
+    if (nullptr == path || 0 == *path) {
+      path = DEFAULT_RESULTS_PATH;
+    }
+
+    if (!WriteResults(path)) {
+      std::cerr << "Failed to write the benchmark results to " << path
+                << std::endl;
+
+      return EXIT_FAILURE;
+    }
+
+    std::cout << "[ BENCH    ] Results written to " << path << std::endl;
+
+    return result;
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
@@ -34,9 +34,30 @@
 #include <PushIgnore.h>
 #include <TestObject.h>
 
+// libcomp Includes
+#include <BaseLog.h>
+#include <TestPersistentItem.h>
+
+// Standard C++11 Includes
+#include <atomic>
+#include <thread>
+#include <vector>
+
 using namespace libcomp;
 using namespace objects;
 
+namespace {
+
+/**
+ * Log for the errors of the object cache while testing.
+ */
+class TestLog : public BaseLog {
+ public:
+  TestLog() {}
+};
+
+}  // namespace
+
 void WriteMapU16Char(char* map, uint16_t idx, char val) {
   uint32_t stringLength = 1;
 
@@ -376,10 +397,175 @@ TEST(Object, TestObject) {
   EXPECT_EQ(TestObject::EnumYN_t::YES, data.GetEnumYN());
 }
 
+/**
+ * Create a persistent object that is not destroyed when the last reference
+ * to it is released. This holds the object between the expiry of its entry
+ * in the object cache and its destructor.
+ * @param held Objects to delete once the test is ready for their destructor.
+ * @return Pointer to the new object.
+ */
+static std::shared_ptr<TestPersistentItem> MakeHeldItem(
+    std::vector<TestPersistentItem*>& held) {
+  return std::shared_ptr<TestPersistentItem>(
+      new TestPersistentItem,
+      [&held](TestPersistentItem* pItem) { held.push_back(pItem); });
+}
+
+TEST(PersistentObject, ObjectCache) {
+  PersistentObject::PurgeExpiredObjects();
+  auto before = PersistentObject::GetCacheStats();
+
+  std::vector<std::shared_ptr<TestPersistentItem>> items;
+
+  for (int i = 0; i < 100; ++i) {
+    auto item = std::make_shared<TestPersistentItem>();
+    EXPECT_TRUE(item->Register(item));
+
+    items.push_back(item);
+  }
+
+  // Registering the same UUID twice is still rejected.
+  auto copy = std::make_shared<TestPersistentItem>();
+  EXPECT_FALSE(copy->Register(copy, items.front()->GetUUID()));
+
+  std::atomic<int> misses(0);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&items, &misses]() {
+      for (int j = 0; j < 1000; ++j) {
+        auto& item = items[(size_t)j % items.size()];
+
+        if (PersistentObject::GetObjectByUUID(item->GetUUID()) != item) {
+          misses++;
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(0, misses);
+
+  auto stats = PersistentObject::GetCacheStats();
+  EXPECT_EQ(before.lookups + 4000, stats.lookups);
+  EXPECT_EQ(before.registrations + 100, stats.registrations);
+  EXPECT_EQ(before.cached + 100, stats.cached);
+
+  // The failed copy must not remove the entry of the original.
+  auto uuid = items.front()->GetUUID();
+  copy.reset();
+  EXPECT_EQ(items.front(), PersistentObject::GetObjectByUUID(uuid));
+
+  uuid = items.back()->GetUUID();
+  items.clear();
+
+  EXPECT_EQ(nullptr, PersistentObject::GetObjectByUUID(uuid));
+  EXPECT_EQ(before.cached, PersistentObject::GetCacheStats().cached);
+}
+
+TEST(PersistentObject, ObjectCacheReplaceExpired) {
+  std::vector<TestPersistentItem*> held;
+
+  auto item = MakeHeldItem(held);
+  ASSERT_TRUE(item->Register(item));
+
+  auto uuid = item->GetUUID();
+
+  // Release the object without destroying it so the entry has expired
+  // when another object is registered with the UUID.
+  item.reset();
+  ASSERT_EQ((size_t)1, held.size());
+  EXPECT_EQ(nullptr, PersistentObject::GetObjectByUUID(uuid));
+
+  auto replacement = std::make_shared<TestPersistentItem>();
+  EXPECT_TRUE(replacement->Register(replacement, uuid));
+
+  // The destructor of the old object must keep the new entry.
+  delete held.front();
+  held.clear();
+
+  EXPECT_EQ(replacement, PersistentObject::GetObjectByUUID(uuid));
+
+  replacement.reset();
+  EXPECT_EQ(nullptr, PersistentObject::GetObjectByUUID(uuid));
+}
+
+TEST(PersistentObject, ObjectCacheRegisterRace) {
+  PersistentObject::PurgeExpiredObjects();
+  auto before = PersistentObject::GetCacheStats();
+
+  for (int i = 0; i < 500; ++i) {
+    auto item = std::make_shared<TestPersistentItem>();
+    ASSERT_TRUE(item->Register(item));
+
+    auto uuid = item->GetUUID();
+    auto replacement = std::make_shared<TestPersistentItem>();
+
+    std::thread release([&item]() { item.reset(); });
+
+    // The UUID is free once the old object has expired even if its
+    // destructor has not removed the entry yet.
+    while (!replacement->Register(replacement, uuid)) {
+      std::this_thread::yield();
+    }
+
+    release.join();
+
+    ASSERT_EQ(replacement, PersistentObject::GetObjectByUUID(uuid));
+  }
+
+  EXPECT_EQ(before.cached, PersistentObject::GetCacheStats().cached);
+}
+
+TEST(PersistentObject, PurgeExpiredObjects) {
+  PersistentObject::PurgeExpiredObjects();
+  auto before = PersistentObject::GetCacheStats();
+
+  std::vector<TestPersistentItem*> held;
+  std::vector<std::shared_ptr<TestPersistentItem>> items;
+  std::vector<libobjgen::UUID> uuids;
+
+  for (int i = 0; i < 10; ++i) {
+    auto item = MakeHeldItem(held);
+    EXPECT_TRUE(item->Register(item));
+
+    items.push_back(item);
+    uuids.push_back(item->GetUUID());
+  }
+
+  // The entries stay in the cache until they are purged or the objects
+  // are destroyed.
+  items.clear();
+  ASSERT_EQ((size_t)10, held.size());
+  EXPECT_EQ(before.cached + 10, PersistentObject::GetCacheStats().cached);
+
+  for (auto& uuid : uuids) {
+    EXPECT_EQ(nullptr, PersistentObject::GetObjectByUUID(uuid));
+  }
+
+  EXPECT_EQ((size_t)10, PersistentObject::PurgeExpiredObjects());
+  EXPECT_EQ((size_t)0, PersistentObject::PurgeExpiredObjects());
+
+  auto stats = PersistentObject::GetCacheStats();
+  EXPECT_EQ(before.cached, stats.cached);
+  EXPECT_EQ(before.purged + 10, stats.purged);
+
+  for (auto pItem : held) {
+    delete pItem;
+  }
+
+  EXPECT_EQ(before.cached, PersistentObject::GetCacheStats().cached);
+}
+
 int main(int argc, char* argv[]) {
   try {
     ::testing::InitGoogleTest(&argc, argv);
 
+    TestLog log;
+
     return RUN_ALL_TESTS();
   } catch (...) {
     return EXIT_FAILURE;
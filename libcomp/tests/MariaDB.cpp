@@ -35,7 +35,20 @@
 
 // libcomp Includes
 #include <Account.h>
+#include <DatabaseBind.h>
+#include <DatabaseExecutor.h>
 #include <DatabaseMariaDB.h>
+#include <ObjectReference.h>
+#include <ObjectResidency.h>
+#include <TestPersistentEnchant.h>
+#include <TestPersistentInventory.h>
+#include <TestPersistentItem.h>
+
+// Standard C++11 Includes
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
 
 using namespace libcomp;
 
@@ -51,6 +64,12 @@ class MariaDBAccount : public objects::Account {
   libcomp::String text;
 };
 
+template <class T>
+static void RegisterTestType() {
+  PersistentObject::RegisterType(typeid(T), T::GetMetadata(),
+                                 []() { return (PersistentObject *)new T(); });
+}
+
 std::shared_ptr<objects::DatabaseConfigMariaDB> GetConfig() {
   auto config = std::shared_ptr<objects::DatabaseConfigMariaDB>(
       new objects::DatabaseConfigMariaDB);
@@ -87,6 +106,135 @@ TEST(MariaDB, BadPrepare) {
   EXPECT_FALSE(db.IsOpen());
 }
 
+TEST(MariaDB, StatementCache) {
+  auto config = GetConfig();
+  config->SetStatementCacheSize(2);
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.IsOpen());
+
+  for (int32_t i = 0; i < 10; ++i) {
+    auto query = db.Prepare("SELECT :value");
+
+    EXPECT_TRUE(query.Bind("value", i));
+    EXPECT_TRUE(query.Execute());
+    EXPECT_TRUE(query.Next());
+
+    int32_t value = -1;
+
+    EXPECT_TRUE(query.GetValue(0, value));
+    EXPECT_EQ(i, value);
+  }
+
+  auto stats = db.GetStatementCacheStats();
+
+  EXPECT_EQ((uint64_t)9, stats.hits);
+  EXPECT_EQ((uint64_t)1, stats.misses);
+  EXPECT_EQ((uint64_t)1, stats.size);
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, ConnectionPool) {
+  auto config = GetConfig();
+  config->SetPoolSize(2);
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.IsOpen());
+
+  std::atomic<int32_t> successes(0);
+  std::list<std::thread> threads;
+
+  for (int32_t i = 0; i < 8; ++i) {
+    threads.push_back(std::thread([&db, &successes, i]() {
+      auto query = db.Prepare("SELECT :value");
+
+      int32_t value = -1;
+
+      if (query.Bind("value", i) && query.Execute() && query.Next() &&
+          query.GetValue(0, value) && i == value) {
+        successes++;
+      }
+    }));
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(8, successes);
+
+  auto stats = db.GetConnectionPoolStats();
+
+  // Threads share the two connections instead of opening their own.
+  EXPECT_GE((uint64_t)2, stats.open);
+  EXPECT_GE((uint64_t)2, stats.opened);
+  EXPECT_EQ((uint64_t)0, stats.inUse);
+  EXPECT_EQ((uint64_t)0, stats.timeouts);
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+
+  EXPECT_EQ((uint64_t)0, db.GetConnectionPoolStats().open);
+}
+
+TEST(MariaDB, Executor) {
+  auto config = GetConfig();
+
+  auto db = std::make_shared<DatabaseMariaDB>(config);
+
+  EXPECT_TRUE(db->Open());
+
+  DatabaseExecutor executor(db, 2);
+
+  // Nothing is queued until the executor starts.
+  EXPECT_FALSE(executor.ExecuteAsync("SELECT 1", nullptr));
+
+  executor.Start();
+
+  std::atomic<int32_t> successes(0);
+  std::atomic<int32_t> failures(0);
+
+  for (int32_t i = 0; i < 10; ++i) {
+    EXPECT_TRUE(executor.ExecuteAsync("SELECT 1", nullptr, [&](bool result) {
+      if (result) {
+        successes++;
+      } else {
+        failures++;
+      }
+    }));
+  }
+
+  EXPECT_TRUE(executor.ExecuteAsync("SELECT", nullptr, [&](bool result) {
+    if (result) {
+      successes++;
+    } else {
+      failures++;
+    }
+  }));
+
+  // Shutting down finishes everything that was queued.
+  executor.Shutdown();
+
+  EXPECT_EQ(10, successes);
+  EXPECT_EQ(1, failures);
+
+  auto stats = executor.GetStats();
+  auto& execute =
+      stats.operations[static_cast<size_t>(DatabaseOperation_t::EXECUTE)];
+
+  EXPECT_EQ((uint64_t)0, stats.queueDepth);
+  EXPECT_EQ((uint64_t)11, execute.count);
+  EXPECT_EQ((uint64_t)1, execute.failures);
+
+  EXPECT_TRUE(db->Close());
+}
+
 TEST(MariaDB, ObjectBindIndex) {
   libobjgen::UUID uuid1 = libobjgen::UUID::Random();
 
@@ -356,6 +504,715 @@ TEST(MariaDB, ChangeSet) {
   EXPECT_FALSE(db.IsOpen());
 }
 
+TEST(MariaDB, ExplicitUpdateBatch) {
+  auto config = GetConfig();
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  std::vector<std::shared_ptr<MariaDBAccount>> accounts;
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  for (int i = 0; i < 10; ++i) {
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(100);
+
+    changeset->Insert(account);
+    accounts.push_back(account);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+
+  // Updates to the same column of the same table run as one statement.
+  auto opChangeset = std::make_shared<libcomp::DBOperationalChangeSet>();
+
+  for (auto account : accounts) {
+    auto expl = std::make_shared<libcomp::DBExplicitUpdate>(account);
+    EXPECT_TRUE(expl->Subtract<int64_t>("CP", 10));
+    opChangeset->AddOperation(expl);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(opChangeset));
+  EXPECT_TRUE(opChangeset->GetFailedUpdates().empty());
+
+  auto stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)1, stats.explicitStatements);
+  EXPECT_EQ((uint64_t)10, stats.explicitRows);
+  EXPECT_EQ((uint64_t)0, stats.explicitFallbacks);
+
+  for (auto account : accounts) {
+    EXPECT_EQ(90, account->GetCP());
+  }
+
+  // A record that does not have the expected value is reported on its own
+  // and nothing in the change set is applied.
+  opChangeset = std::make_shared<libcomp::DBOperationalChangeSet>();
+
+  std::shared_ptr<libcomp::DBExplicitUpdate> stale;
+
+  for (size_t i = 0; i < accounts.size(); ++i) {
+    auto expl = std::make_shared<libcomp::DBExplicitUpdate>(accounts[i]);
+    EXPECT_TRUE(expl->SubtractFrom<int64_t>("CP", 10, 3 == i ? 100 : 90));
+    opChangeset->AddOperation(expl);
+
+    if (3 == i) {
+      stale = expl;
+    }
+  }
+
+  EXPECT_FALSE(db.ProcessChangeSet(opChangeset));
+
+  auto failed = opChangeset->GetFailedUpdates();
+  ASSERT_EQ((size_t)1, failed.size());
+  EXPECT_EQ(stale, failed.front());
+
+  stats = db.GetBatchStats();
+  EXPECT_EQ((uint64_t)12, stats.explicitStatements);
+  EXPECT_EQ((uint64_t)1, stats.explicitFallbacks);
+
+  auto loaded = db.LoadObjectsByUUIDs(typeid(MariaDBAccount).hash_code(),
+                                     {accounts.front()->GetUUID()}, true);
+  ASSERT_EQ((size_t)1, loaded.size());
+  EXPECT_EQ(90, std::dynamic_pointer_cast<MariaDBAccount>(loaded.front())
+                    ->GetCP());
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, WriteBehind) {
+  auto config = GetConfig();
+  config->SetWriteBehind(true);
+  config->SetWriteBehindInterval(0);
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  auto account = std::make_shared<MariaDBAccount>();
+  account->Register(account);
+  account->SetCP(0);
+
+  db.QueueInsert(account);
+
+  for (int64_t i = 1; i <= 5; ++i) {
+    account->SetCP(i);
+    db.QueueUpdate(account);
+  }
+
+  auto stats = db.GetWriteBehindStats();
+
+  EXPECT_EQ((uint64_t)5, stats.deferred);
+  EXPECT_EQ((uint64_t)4, stats.absorbed);
+  EXPECT_EQ((uint64_t)1, stats.pending);
+
+  // The insert and the merged update are written in one transaction.
+  EXPECT_TRUE(db.ProcessTransactionQueue().empty());
+
+  stats = db.GetWriteBehindStats();
+
+  EXPECT_EQ((uint64_t)1, stats.written);
+  EXPECT_EQ((uint64_t)1, stats.flushes);
+  EXPECT_EQ((uint64_t)0, stats.pending);
+
+  auto uuid = account->GetUUID();
+  account.reset();
+
+  DatabaseBindUUID bind("UID", uuid);
+
+  auto loaded = std::dynamic_pointer_cast<MariaDBAccount>(
+      db.LoadSingleObject(typeid(MariaDBAccount).hash_code(), &bind));
+
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_EQ(5, loaded->GetCP());
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, LoadObjectsByUUIDs) {
+  auto config = GetConfig();
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  std::list<libobjgen::UUID> uuids;
+  std::shared_ptr<MariaDBAccount> cached;
+
+  for (int64_t i = 0; i < 3; ++i) {
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(i * 10);
+
+    changeset->Insert(account);
+    uuids.push_back(account->GetUUID());
+
+    if (!cached) {
+      cached = account;
+    }
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+
+  // Only the first account is still cached now.
+  changeset.reset();
+
+  // Unknown and duplicate UUIDs are skipped.
+  uuids.push_back(libobjgen::UUID::Random());
+  uuids.push_back(uuids.front());
+
+  auto objects =
+      db.LoadObjectsByUUIDs(typeid(MariaDBAccount).hash_code(), uuids);
+
+  ASSERT_EQ((size_t)3, objects.size());
+  EXPECT_EQ(cached, objects.front());
+
+  int64_t cp = 0;
+
+  for (auto obj : objects) {
+    auto account = std::dynamic_pointer_cast<MariaDBAccount>(obj);
+
+    ASSERT_NE(nullptr, account);
+    EXPECT_EQ(cp, account->GetCP());
+
+    cp += 10;
+  }
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, ForEachObject) {
+  auto config = GetConfig();
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  for (int64_t i = 0; i < 5; ++i) {
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(i < 3 ? 1 : 2);
+
+    changeset->Insert(account);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+  changeset.reset();
+
+  size_t typeHash = typeid(MariaDBAccount).hash_code();
+
+  // Objects not kept by the callback are freed before the next row.
+  size_t count = 0;
+  std::weak_ptr<PersistentObject> previous;
+
+  EXPECT_TRUE(db.ForEachObject(
+      typeHash, nullptr,
+      [&](const std::shared_ptr<PersistentObject>& obj) {
+        EXPECT_TRUE(previous.expired());
+        previous = obj;
+        count++;
+
+        return true;
+      }));
+  EXPECT_EQ((size_t)5, count);
+
+  // Returning false stops the load.
+  count = 0;
+
+  EXPECT_TRUE(db.ForEachObject(
+      typeHash, nullptr, [&](const std::shared_ptr<PersistentObject>&) {
+        return ++count < 2;
+      }));
+  EXPECT_EQ((size_t)2, count);
+
+  DatabaseBindBigInt bind("CP", 1);
+  count = 0;
+
+  EXPECT_TRUE(db.ForEachObject(
+      typeHash, &bind, [&](const std::shared_ptr<PersistentObject>& obj) {
+        auto account = std::dynamic_pointer_cast<MariaDBAccount>(obj);
+
+        EXPECT_NE(nullptr, account);
+        EXPECT_EQ(1, account->GetCP());
+        count++;
+
+        return true;
+      }));
+  EXPECT_EQ((size_t)3, count);
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, LoadObjectsParallel) {
+  auto config = GetConfig();
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  for (int64_t i = 0; i < 200; ++i) {
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(i);
+
+    changeset->Insert(account);
+  }
+
+  EXPECT_TRUE(db.ProcessChangeSet(changeset));
+  changeset.reset();
+
+  size_t typeHash = typeid(MariaDBAccount).hash_code();
+
+  auto single = db.LoadObjectsParallel(typeHash, nullptr, true, 1);
+  auto ordered = db.LoadObjectsParallel(typeHash, nullptr, true, 4);
+  auto unordered = db.LoadObjectsParallel(typeHash, nullptr, false, 4);
+
+  ASSERT_EQ((size_t)200, single.size());
+  ASSERT_EQ((size_t)200, unordered.size());
+
+  // The objects are cached so every load returns the same pointers.
+  EXPECT_TRUE(single == ordered);
+
+  std::set<int64_t> cp;
+
+  for (auto obj : unordered) {
+    auto account = std::dynamic_pointer_cast<MariaDBAccount>(obj);
+
+    ASSERT_NE(nullptr, account);
+    cp.insert(account->GetCP());
+  }
+
+  EXPECT_EQ((size_t)200, cp.size());
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, QueryStats) {
+  EXPECT_EQ(String("INSERT INTO `Account` (`UID`, `CP`) VALUES (?);"),
+            DatabaseQueryStats::NormalizeSQL(
+                "INSERT INTO `Account` (`UID`, `CP`) VALUES (?, ?), (?, ?);"));
+  EXPECT_EQ(String("UPDATE `Account` SET `CP` = CASE `UID` WHEN ? THEN ? END "
+                   "WHERE `UID` IN (?);"),
+            DatabaseQueryStats::NormalizeSQL(
+                "UPDATE `Account` SET `CP` = CASE `UID` WHEN ? THEN ? "
+                "WHEN ? THEN ? END WHERE `UID` IN (?, ?);"));
+  EXPECT_EQ(String("SELECT * FROM `Account2` WHERE `Name` = ? AND `CP` > ?"),
+            DatabaseQueryStats::NormalizeSQL(
+                "SELECT *  FROM `Account2` WHERE `Name` = 'it''s' AND "
+                "`CP` > 10"));
+
+  auto config = GetConfig();
+  config->SetQueryStats(true);
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  DatabaseQueryStats::Reset();
+
+  for (int64_t i = 0; i < 3; ++i) {
+    EXPECT_TRUE(db.Execute(
+        String("SELECT * FROM `Account` WHERE `CP` = %1;").Arg(i)));
+  }
+
+  auto shapes = DatabaseQueryStats::GetTopShapes(0);
+
+  ASSERT_EQ((size_t)1, shapes.size());
+  EXPECT_EQ(String("SELECT * FROM `Account` WHERE `CP` = ?;"),
+            shapes.front().shape);
+  EXPECT_EQ((uint64_t)3, shapes.front().count);
+  EXPECT_GE(shapes.front().totalTime, shapes.front().maxTime);
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+
+  DatabaseQueryStats::Configure(false, 0);
+}
+
+TEST(MariaDB, BinaryUUIDs) {
+  auto config = GetConfig();
+  MariaDBAccount::RegisterPersistentType();
+
+  libobjgen::UUID uuid;
+
+  {
+    DatabaseMariaDB db(config);
+
+    EXPECT_TRUE(db.Open());
+    EXPECT_TRUE(db.Setup());
+
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(42);
+
+    uuid = account->GetUUID();
+
+    std::shared_ptr<PersistentObject> obj = account;
+    EXPECT_TRUE(db.InsertSingleObject(obj));
+    EXPECT_TRUE(db.Close());
+  }
+
+  // Switching to binary UUIDs converts the existing text UIDs.
+  config->SetBinaryUUIDs(true);
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  auto objects = db.LoadObjectsByUUIDs(typeid(MariaDBAccount).hash_code(),
+                                       {uuid}, true);
+
+  ASSERT_EQ((size_t)1, objects.size());
+  EXPECT_EQ(uuid, objects.front()->GetUUID());
+  EXPECT_EQ(42, std::dynamic_pointer_cast<MariaDBAccount>(objects.front())
+                    ->GetCP());
+
+  auto obj = objects.front();
+  EXPECT_TRUE(db.DeleteSingleObject(obj));
+  EXPECT_TRUE(db.LoadObjectsByUUIDs(typeid(MariaDBAccount).hash_code(),
+                                    {uuid}, true)
+                  .empty());
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, ObjectResidency) {
+  auto config = GetConfig();
+  MariaDBAccount::RegisterPersistentType();
+
+  auto db = std::make_shared<DatabaseMariaDB>(config);
+
+  EXPECT_TRUE(db->Open());
+  EXPECT_TRUE(db->Setup());
+
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  std::vector<libobjgen::UUID> uuids;
+
+  for (int64_t i = 0; i < 5; ++i) {
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(i);
+
+    changeset->Insert(account);
+    uuids.push_back(account->GetUUID());
+  }
+
+  EXPECT_TRUE(db->ProcessChangeSet(changeset));
+  changeset.reset();
+
+  // Keep only the most recently used object loaded.
+  ObjectResidency::Configure(1);
+
+  std::vector<ObjectReference<MariaDBAccount>> refs;
+
+  for (auto &uuid : uuids) {
+    refs.push_back(ObjectReference<MariaDBAccount>(uuid));
+    EXPECT_NE(nullptr, refs.back().Get(db));
+  }
+
+  auto stats = ObjectResidency::GetStats();
+  EXPECT_EQ((uint64_t)5, stats.misses);
+  EXPECT_EQ((uint64_t)4, stats.evictions);
+  EXPECT_EQ((uint64_t)1, stats.resident);
+
+  EXPECT_EQ(nullptr, refs.front().GetCurrentReference());
+  EXPECT_NE(nullptr, refs.back().GetCurrentReference());
+
+  // Pinned objects and objects held elsewhere are kept.
+  ObjectResidency::Pin(uuids[0]);
+
+  auto held = refs[1].Get(db);
+  EXPECT_NE(nullptr, refs[0].Get(db));
+  EXPECT_NE(nullptr, refs[2].Get(db));
+
+  EXPECT_NE(nullptr, refs[0].GetCurrentReference());
+  EXPECT_NE(nullptr, refs[1].GetCurrentReference());
+  EXPECT_EQ(nullptr, refs[4].GetCurrentReference());
+
+  // Unpinned objects are unloaded by the next eviction.
+  ObjectResidency::Unpin(uuids[0]);
+  held.reset();
+
+  EXPECT_EQ((size_t)3, ObjectResidency::Evict());
+  EXPECT_EQ(nullptr, refs[0].GetCurrentReference());
+  EXPECT_EQ(nullptr, refs[1].GetCurrentReference());
+  EXPECT_EQ(nullptr, refs[2].GetCurrentReference());
+  EXPECT_EQ((uint64_t)0, ObjectResidency::GetStats().resident);
+
+  ObjectResidency::Configure(0);
+
+  EXPECT_TRUE(db->Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db->Close());
+  EXPECT_FALSE(db->IsOpen());
+}
+
+TEST(MariaDB, PrefetchReferences) {
+  auto config = GetConfig();
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentInventory>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  auto db = std::make_shared<DatabaseMariaDB>(config);
+
+  EXPECT_TRUE(db->Open());
+  EXPECT_TRUE(db->Setup());
+
+  libobjgen::UUID uuid;
+
+  {
+    auto changeset = libcomp::DatabaseChangeSet::Create();
+    auto inventory = std::make_shared<objects::TestPersistentInventory>();
+    inventory->Register(inventory);
+
+    for (size_t i = 0; i < 5; ++i) {
+      auto item = std::make_shared<objects::TestPersistentItem>();
+      item->Register(item);
+      item->SetValue((int32_t)i);
+
+      for (int32_t j = 0; j < 2; ++j) {
+        auto enchant = std::make_shared<objects::TestPersistentEnchant>();
+        enchant->Register(enchant);
+        enchant->SetValue(j);
+
+        item->AppendEnchants(enchant);
+        changeset->Insert(enchant);
+      }
+
+      inventory->SetItems(i, item);
+      changeset->Insert(item);
+    }
+
+    inventory->SetMainItem(inventory->GetItems(0));
+    changeset->Insert(inventory);
+    uuid = inventory->GetUUID();
+
+    EXPECT_TRUE(db->ProcessChangeSet(changeset));
+  }
+
+  // Load every item and enchantment with one query per level.
+  auto inventory =
+      PersistentObject::LoadObjectByUUID<objects::TestPersistentInventory>(
+          db, uuid);
+  ASSERT_NE(nullptr, inventory);
+  EXPECT_EQ(nullptr, inventory->GetItems(0).GetCurrentReference());
+
+  auto stats = PersistentObject::PrefetchReferences(db, {inventory}, 2);
+  EXPECT_EQ((uint64_t)2, stats.levels);
+  EXPECT_EQ((uint64_t)15, stats.references);
+  EXPECT_EQ((uint64_t)15, stats.loaded);
+  EXPECT_EQ((uint64_t)2, stats.queries);
+  EXPECT_EQ((uint64_t)13, stats.queriesSaved);
+
+  for (size_t i = 0; i < 5; ++i) {
+    auto item = inventory->GetItems(i).GetCurrentReference();
+
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ((int32_t)i, item->GetValue());
+    EXPECT_NE(nullptr, item->GetEnchants(1).GetCurrentReference());
+  }
+
+  // Member paths only load the references they name.
+  inventory.reset();
+  inventory =
+      PersistentObject::LoadObjectByUUID<objects::TestPersistentInventory>(
+          db, uuid);
+  ASSERT_NE(nullptr, inventory);
+
+  stats = PersistentObject::PrefetchReferences(db, {inventory},
+                                               {"MainItem.Enchants"});
+  EXPECT_EQ((uint64_t)3, stats.references);
+  EXPECT_EQ((uint64_t)2, stats.queries);
+
+  auto item = inventory->GetMainItem().GetCurrentReference();
+  ASSERT_NE(nullptr, item);
+  EXPECT_NE(nullptr, item->GetEnchants(0).GetCurrentReference());
+  EXPECT_EQ(nullptr, inventory->GetItems(1).GetCurrentReference());
+
+  EXPECT_TRUE(db->Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db->Close());
+  EXPECT_FALSE(db->IsOpen());
+}
+
+TEST(MariaDB, GroupCommit) {
+  auto config = GetConfig();
+  config->SetGroupCommit(true);
+  MariaDBAccount::RegisterPersistentType();
+
+  DatabaseMariaDB db(config);
+
+  EXPECT_TRUE(db.Open());
+  EXPECT_TRUE(db.Setup());
+
+  std::shared_ptr<PersistentObject> existing =
+      std::make_shared<MariaDBAccount>();
+  existing->Register(existing);
+  EXPECT_TRUE(db.InsertSingleObject(existing));
+
+  std::list<libobjgen::UUID> uuids;
+
+  for (int64_t i = 0; i < 5; ++i) {
+    auto account = std::make_shared<MariaDBAccount>();
+    account->Register(account);
+    account->SetCP(i);
+
+    db.QueueInsert(account, libobjgen::UUID::Random());
+    uuids.push_back(account->GetUUID());
+  }
+
+  // Inserting the same record again fails without affecting the others.
+  auto transactionUUID = libobjgen::UUID::Random();
+  db.QueueInsert(existing, transactionUUID);
+
+  auto failures = db.ProcessTransactionQueue();
+  ASSERT_EQ((size_t)1, failures.size());
+  EXPECT_EQ(transactionUUID, failures.front());
+
+  auto stats = db.GetGroupCommitStats();
+  EXPECT_EQ((uint64_t)1, stats.transactions);
+  EXPECT_EQ((uint64_t)5, stats.changeSets);
+  EXPECT_EQ((uint64_t)1, stats.rolledBack);
+  EXPECT_EQ((uint64_t)0, stats.fallbacks);
+
+  EXPECT_EQ((size_t)5,
+            db.LoadObjectsByUUIDs(typeid(MariaDBAccount).hash_code(), uuids,
+                                  true)
+                .size());
+
+  EXPECT_TRUE(db.Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(db.IsOpen());
+}
+
+TEST(MariaDB, PipelinedChangeSet) {
+  auto config = GetConfig();
+  config->SetPipelineChangeSets(true);
+  config->SetPrefetchRows(2);
+  RegisterTestType<objects::TestPersistentEnchant>();
+  RegisterTestType<objects::TestPersistentInventory>();
+  RegisterTestType<objects::TestPersistentItem>();
+
+  auto db = std::make_shared<DatabaseMariaDB>(config);
+
+  EXPECT_TRUE(db->Open());
+  EXPECT_TRUE(db->Setup());
+
+  std::vector<std::shared_ptr<objects::TestPersistentInventory>> inventories;
+  std::vector<libobjgen::UUID> uuids;
+
+  // Values that need escaping are written into the statement text.
+  auto changeset = libcomp::DatabaseChangeSet::Create();
+
+  for (int32_t i = 0; i < 5; ++i) {
+    auto inventory = std::make_shared<objects::TestPersistentInventory>();
+    inventory->Register(inventory);
+    inventory->SetName(String("It's \\%1").Arg(i));
+
+    changeset->Insert(inventory);
+    inventories.push_back(inventory);
+    uuids.push_back(inventory->GetUUID());
+  }
+
+  EXPECT_TRUE(db->ProcessChangeSet(changeset));
+
+  auto stats = db->GetPipelineStats();
+  EXPECT_EQ((uint64_t)1, stats.changeSets);
+  EXPECT_EQ((uint64_t)3, stats.statements);
+  EXPECT_EQ((uint64_t)1, stats.roundTrips);
+
+  // Updates and deletes are sent together as well.
+  changeset = libcomp::DatabaseChangeSet::Create();
+  inventories[0]->SetName("Updated");
+  changeset->Update(inventories[0]);
+  changeset->Delete(inventories[4]);
+
+  EXPECT_TRUE(db->ProcessChangeSet(changeset));
+
+  stats = db->GetPipelineStats();
+  EXPECT_EQ((uint64_t)2, stats.changeSets);
+  EXPECT_EQ((uint64_t)7, stats.statements);
+  EXPECT_EQ((uint64_t)2, stats.roundTrips);
+  EXPECT_EQ((uint64_t)0, stats.failures);
+
+  // A statement that fails rolls back the whole change set.
+  changeset = libcomp::DatabaseChangeSet::Create();
+  inventories[1]->SetName("Rolled back");
+  changeset->Update(inventories[1]);
+  changeset->Insert(inventories[2]);
+
+  EXPECT_FALSE(db->ProcessChangeSet(changeset));
+  EXPECT_EQ((uint64_t)1, db->GetPipelineStats().failures);
+
+  // Every row is read through a cursor two rows at a time.
+  inventories.clear();
+
+  auto loaded = db->LoadObjects(
+      typeid(objects::TestPersistentInventory).hash_code(), nullptr);
+  ASSERT_EQ((size_t)4, loaded.size());
+
+  for (auto obj : loaded) {
+    auto inventory =
+        std::dynamic_pointer_cast<objects::TestPersistentInventory>(obj);
+
+    if (uuids[0] == inventory->GetUUID()) {
+      EXPECT_EQ(String("Updated"), inventory->GetName());
+    } else if (uuids[1] == inventory->GetUUID()) {
+      EXPECT_EQ(String("It's \\1"), inventory->GetName());
+    } else {
+      EXPECT_EQ(String("It's \\"), inventory->GetName().Left(6));
+    }
+  }
+
+  EXPECT_TRUE(db->Execute("DROP DATABASE IF EXISTS comp_hack_test;"));
+
+  EXPECT_TRUE(db->Close());
+  EXPECT_FALSE(db->IsOpen());
+}
+
 int main(int argc, char *argv[]) {
   try {
     ::testing::InitGoogleTest(&argc, argv);
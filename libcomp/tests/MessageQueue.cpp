@@ -0,0 +1,222 @@
+/**
+ * @file libcomp/tests/MessageQueue.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Test the priority lanes of the message queue.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <MessageQueue.h>
+#include <MessageShutdown.h>
+#include <MessageTick.h>
+#include <MessageTimeout.h>
+
+// Standard C++11 Includes
+#include <list>
+#include <thread>
+
+using namespace libcomp;
+
+/**
+ * Add a number of items to a lane of the queue.
+ * @param queue Queue to add the items to
+ * @param priority Lane to add the items to
+ * @param first Value of the first item (each item adds one)
+ * @param count Number of items to add
+ */
+static void Fill(MessageQueue<int>& queue, MessagePriority_t priority,
+                 int first, int count) {
+  for (int i = 0; i < count; ++i) {
+    queue.Enqueue(first + i, priority);
+  }
+}
+
+TEST(MessageQueue, DequeueWeighted) {
+  MessageQueue<int> queue;
+
+  Fill(queue, MessagePriority_t::PRIORITY_HIGH, 0, 100);
+  Fill(queue, MessagePriority_t::PRIORITY_NORMAL, 1000, 100);
+  Fill(queue, MessagePriority_t::PRIORITY_LOW, 2000, 100);
+
+  std::list<int> items;
+  queue.DequeueWeighted(items);
+
+  // Each lane gives up to its weight (64/16/4) in order of priority.
+  ASSERT_EQ((size_t)(64 + 16 + 4), items.size());
+
+  int expected = 0;
+
+  for (int i = 0; i < 64; ++i) {
+    EXPECT_EQ(expected++, items.front());
+    items.pop_front();
+  }
+
+  expected = 1000;
+
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_EQ(expected++, items.front());
+    items.pop_front();
+  }
+
+  expected = 2000;
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(expected++, items.front());
+    items.pop_front();
+  }
+
+  EXPECT_EQ((uint64_t)36,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_HIGH).depth);
+  EXPECT_EQ((uint64_t)84,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_NORMAL).depth);
+  EXPECT_EQ((uint64_t)96,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_LOW).depth);
+
+  // A changed weight applies to the next batch.
+  queue.SetLaneWeight(MessagePriority_t::PRIORITY_HIGH, 8);
+  queue.DequeueWeighted(items);
+
+  ASSERT_EQ((size_t)(8 + 16 + 4), items.size());
+  EXPECT_EQ(64, items.front());
+  EXPECT_EQ(2007, items.back());
+}
+
+TEST(MessageQueue, LowLaneNotStarved) {
+  MessageQueue<int> queue;
+
+  Fill(queue, MessagePriority_t::PRIORITY_LOW, 2000, 10);
+
+  std::list<int> items;
+  int lowSeen = 0;
+  int batches = 0;
+
+  // Keep the high and normal lanes busy while the low lane drains.
+  while (lowSeen < 10) {
+    Fill(queue, MessagePriority_t::PRIORITY_HIGH, 0, 100);
+    Fill(queue, MessagePriority_t::PRIORITY_NORMAL, 1000, 100);
+
+    queue.DequeueWeighted(items);
+    batches++;
+
+    for (int item : items) {
+      if (2000 <= item) {
+        EXPECT_EQ(2000 + lowSeen, item);
+        lowSeen++;
+      }
+    }
+
+    items.clear();
+
+    ASSERT_GE(3, batches);
+  }
+
+  EXPECT_EQ(3, batches);
+  EXPECT_EQ((uint64_t)0,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_LOW).depth);
+}
+
+TEST(MessageQueue, LaneWaitStats) {
+  MessageQueue<int> queue;
+
+  Fill(queue, MessagePriority_t::PRIORITY_LOW, 0, 5);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  Fill(queue, MessagePriority_t::PRIORITY_HIGH, 100, 2);
+
+  auto low = queue.GetLaneStats(MessagePriority_t::PRIORITY_LOW);
+  EXPECT_EQ((uint64_t)5, low.depth);
+  EXPECT_EQ((uint64_t)5, low.enqueueCount);
+  EXPECT_EQ((uint64_t)0, low.dequeueCount);
+  EXPECT_EQ((uint64_t)0, low.totalWait);
+
+  std::list<int> items;
+  queue.DequeueWeighted(items);
+  ASSERT_EQ((size_t)6, items.size());
+
+  low = queue.GetLaneStats(MessagePriority_t::PRIORITY_LOW);
+  EXPECT_EQ((uint64_t)1, low.depth);
+  EXPECT_EQ((uint64_t)4, low.dequeueCount);
+  EXPECT_LE((uint64_t)(4 * 20000), low.totalWait);
+  EXPECT_LE((uint64_t)20000, low.maxWait);
+
+  // The high lane items were only queued just before the dequeue.
+  auto high = queue.GetLaneStats(MessagePriority_t::PRIORITY_HIGH);
+  EXPECT_EQ((uint64_t)0, high.depth);
+  EXPECT_EQ((uint64_t)2, high.enqueueCount);
+  EXPECT_EQ((uint64_t)2, high.dequeueCount);
+  EXPECT_GT(low.maxWait, high.maxWait);
+
+  auto normal = queue.GetLaneStats(MessagePriority_t::PRIORITY_NORMAL);
+  EXPECT_EQ((uint64_t)0, normal.enqueueCount);
+  EXPECT_EQ((uint64_t)0, normal.dequeueCount);
+}
+
+TEST(MessageQueue, DefaultMessagePriority) {
+  MessageQueue<Message::Message*> queue;
+
+  queue.Enqueue(new Message::Shutdown);
+  queue.Enqueue(new Message::Timeout);
+  queue.Enqueue(new Message::Tick);
+
+  EXPECT_EQ((uint64_t)2,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_HIGH).depth);
+  EXPECT_EQ((uint64_t)1,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_NORMAL).depth);
+
+  // An explicit priority still overrides the message.
+  queue.Enqueue(new Message::Timeout, MessagePriority_t::PRIORITY_LOW);
+
+  EXPECT_EQ((uint64_t)1,
+            queue.GetLaneStats(MessagePriority_t::PRIORITY_LOW).depth);
+
+  std::list<Message::Message*> messages;
+  queue.DequeueAny(messages);
+  ASSERT_EQ((size_t)4, messages.size());
+
+  EXPECT_EQ(String("Message: Timeout"), messages.front()->Dump());
+  EXPECT_EQ(String("Message: Shutdown"),
+            (*std::next(messages.begin(), 2))->Dump());
+
+  for (auto pMessage : messages) {
+    delete pMessage;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,270 @@
+/**
+ * @file libcomp/tests/TimerBenchmark.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Benchmark the timer manager backends.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <TimerManager.h>
+#include <Worker.h>
+
+// Standard C++11 Includes
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace libcomp;
+
+/// Number of events registered by each benchmark.
+static const int EVENT_COUNT = 200000;
+
+/**
+ * Lightweight message that counts how many times it ran. This avoids the
+ * backtrace captured by @ref Message::ExecuteImpl so only the timer
+ * manager itself is measured.
+ */
+class BenchmarkExecute : public Message::Execute {
+ public:
+  BenchmarkExecute(const std::chrono::steady_clock::time_point &time,
+                   std::atomic<int> &fired, std::atomic<int> &early)
+      : mTime(time), mFired(fired), mEarly(early) {}
+
+  libcomp::Message::MessageType GetType() const override {
+    return libcomp::Message::MessageType::MESSAGE_TYPE_SYSTEM;
+  }
+
+  String Dump() const override { return "Message: Benchmark Execute"; }
+
+  void Run() override {
+    if (std::chrono::steady_clock::now() < mTime) {
+      mEarly++;
+    }
+
+    mFired++;
+  }
+
+ private:
+  std::chrono::steady_clock::time_point mTime;
+  std::atomic<int> &mFired;
+  std::atomic<int> &mEarly;
+};
+
+/**
+ * Print the time taken by a benchmark step.
+ * @param backend Name of the backend.
+ * @param step Name of the step.
+ * @param start Time the step started.
+ * @param count Number of operations in the step.
+ */
+static void Report(const char *backend, const char *step,
+                   const std::chrono::steady_clock::time_point &start,
+                   int count) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  std::cout << "[ BENCH    ] " << backend << " " << step << ": " << count
+            << " ops in " << elapsed << " us ("
+            << (elapsed * 1000.0 / count) << " ns/op)" << std::endl;
+}
+
+/**
+ * Print a note if the setup ran into the window the events fire in. The
+ * lateness measured is then not representative.
+ * @param backend Name of the backend.
+ * @param base Time the first events fire.
+ */
+static void ReportSetup(const char *backend,
+                        const std::chrono::steady_clock::time_point &base) {
+  if (std::chrono::steady_clock::now() >= base) {
+    std::cout << "[ BENCH    ] " << backend
+              << " setup ran into the firing window." << std::endl;
+  }
+}
+
+/**
+ * Wait for the events to fire. The wait is bounded generously so a slow
+ * machine only skews the measurements instead of failing the benchmark.
+ * @param done Function that returns true once every event has fired.
+ * @param base Time the first events fire.
+ */
+static void WaitForEvents(const std::function<bool()> &done,
+                          const std::chrono::steady_clock::time_point &base) {
+  auto deadline = base + std::chrono::seconds(60);
+
+  while (!done() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+/**
+ * Register, cancel and fire a large number of short timers.
+ * @param backend Backend to benchmark.
+ * @param name Name of the backend.
+ */
+static void BenchmarkBackend(TimerBackend_t backend, const char *name) {
+  TimerManager timers(backend);
+
+  std::atomic<int> fired(0);
+  std::atomic<int> early(0);
+  std::vector<TimerHandle> events;
+  std::vector<std::pair<std::chrono::steady_clock::time_point,
+                        Message::Execute *>>
+      messages;
+  std::mt19937 rng(1);
+
+  events.reserve(EVENT_COUNT);
+  messages.reserve(EVENT_COUNT);
+
+  // Fire everything in a window that starts after the setup is done.
+  auto base = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+
+  for (int i = 0; i < EVENT_COUNT; ++i) {
+    auto time = base + std::chrono::milliseconds(rng() % 1000);
+
+    messages.push_back(
+        std::make_pair(time, new BenchmarkExecute(time, fired, early)));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (auto &msg : messages) {
+    events.push_back(timers.RegisterEvent(msg.first, msg.second));
+  }
+
+  Report(name, "register", start, EVENT_COUNT);
+
+  start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < EVENT_COUNT; i += 2) {
+    timers.CancelEvent(events[(size_t)i]);
+  }
+
+  Report(name, "cancel", start, EVENT_COUNT / 2);
+
+  ReportSetup(name, base);
+  WaitForEvents(
+      [&timers]() {
+        return (uint64_t)(EVENT_COUNT / 2) <=
+               timers.GetStats().oneShotLateness.count;
+      },
+      base);
+
+  EXPECT_EQ(EVENT_COUNT / 2, fired.load());
+
+  std::cout << "[ BENCH    ] " << name << " early: " << early.load()
+            << std::endl;
+
+  auto stats = timers.GetStats();
+
+  EXPECT_EQ((uint64_t)(EVENT_COUNT / 2), stats.oneShotLateness.count);
+  EXPECT_EQ((uint64_t)0, stats.pending);
+
+  std::cout << "[ BENCH    ] " << name << " lateness: p50 "
+            << stats.oneShotLateness.Percentile(50.0) << " us, p99 "
+            << stats.oneShotLateness.Percentile(99.0) << " us, max "
+            << stats.oneShotLateness.max << " us" << std::endl;
+}
+
+TEST(TimerBenchmark, SortedSet) {
+  BenchmarkBackend(TimerBackend_t::SORTED_SET, "SORTED_SET");
+}
+
+TEST(TimerBenchmark, TimingWheel) {
+  BenchmarkBackend(TimerBackend_t::TIMING_WHEEL, "TIMING_WHEEL");
+}
+
+TEST(TimerBenchmark, WorkerDispatch) {
+  TimerManager timers(TimerBackend_t::TIMING_WHEEL);
+
+  auto worker = std::make_shared<Worker>();
+  worker->Start("timer_bench");
+
+  std::atomic<int> fired(0);
+  std::atomic<int> early(0);
+  std::vector<std::pair<std::chrono::steady_clock::time_point,
+                        Message::Execute *>>
+      messages;
+  std::mt19937 rng(1);
+
+  messages.reserve(EVENT_COUNT);
+
+  auto base = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+
+  for (int i = 0; i < EVENT_COUNT; ++i) {
+    auto time = base + std::chrono::milliseconds(rng() % 1000);
+
+    messages.push_back(
+        std::make_pair(time, new BenchmarkExecute(time, fired, early)));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (auto &msg : messages) {
+    timers.RegisterEvent(msg.first, msg.second, worker);
+  }
+
+  Report("TIMING_WHEEL", "register (worker)", start, EVENT_COUNT);
+
+  ReportSetup("TIMING_WHEEL", base);
+  WaitForEvents([&fired]() { return EVENT_COUNT <= fired.load(); }, base);
+
+  EXPECT_EQ(EVENT_COUNT, fired.load());
+
+  std::cout << "[ BENCH    ] TIMING_WHEEL dispatch early: " << early.load()
+            << std::endl;
+
+  auto lateness = timers.GetTargetLateness();
+
+  ASSERT_EQ(1, (int)lateness.size());
+  EXPECT_EQ((uint64_t)EVENT_COUNT, lateness.front().count);
+
+  std::cout << "[ BENCH    ] TIMING_WHEEL dispatch lateness: avg "
+            << (lateness.front().totalLateness / lateness.front().count)
+            << " us, max " << lateness.front().maxLateness << " us"
+            << std::endl;
+
+  worker->Shutdown();
+  worker->Join();
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
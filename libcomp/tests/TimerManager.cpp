@@ -0,0 +1,519 @@
+/**
+ * @file libcomp/tests/TimerManager.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Test the timer manager backends with a manual clock.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <TimerManager.h>
+#include <Worker.h>
+
+// Standard C++11 Includes
+#include <vector>
+
+using namespace libcomp;
+
+/**
+ * Get the time elapsed on the clock of a timer manager.
+ * @param timers Timer manager to check the clock of.
+ * @param start Time the clock started at.
+ * @return Milliseconds since the start.
+ */
+static int64_t Elapsed(TimerManager &timers,
+                       const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(timers.Now() -
+                                                               start)
+      .count();
+}
+
+/**
+ * Run the timer callbacks queued on a worker that has not been started.
+ * @param worker Worker to run the queued messages of.
+ * @return Number of messages that were run.
+ */
+static size_t RunQueued(Worker &worker) {
+  std::list<libcomp::Message::Message *> msgs;
+  worker.GetMessageQueue()->DequeueAny(msgs);
+
+  for (auto pMessage : msgs) {
+    auto pExecute = dynamic_cast<libcomp::Message::Execute *>(pMessage);
+
+    if (pExecute) {
+      pExecute->Run();
+    }
+
+    delete pMessage;
+  }
+
+  return msgs.size();
+}
+
+/**
+ * Check events fire in order on the exact tick they are due, one tick at
+ * a time.
+ * @param backend Backend to test.
+ */
+static void TestOrder(TimerBackend_t backend) {
+  TimerManager timers(backend, std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+
+  std::vector<int64_t> fired;
+
+  for (int64_t offset : {7, 3, 3, 250, 1}) {
+    timers.ScheduleEvent(start + std::chrono::milliseconds(offset),
+                         [&fired, &timers, start, offset]() {
+                           EXPECT_EQ(offset, Elapsed(timers, start));
+                           fired.push_back(offset);
+                         });
+  }
+
+  for (int i = 0; i < 300; ++i) {
+    timers.AdvanceClock(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(std::vector<int64_t>({1, 3, 3, 7, 250}), fired);
+  EXPECT_EQ((uint64_t)0, timers.GetStats().pending);
+}
+
+/**
+ * Check a periodic event fires once each period until it is cancelled.
+ * @param backend Backend to test.
+ */
+static void TestPeriodic(TimerBackend_t backend) {
+  TimerManager timers(backend, std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+
+  std::vector<int64_t> fired;
+
+  auto event = timers.SchedulePeriodicEvent(
+      std::chrono::milliseconds(10), [&fired, &timers, start]() {
+        fired.push_back(Elapsed(timers, start));
+      });
+
+  for (int i = 0; i < 55; ++i) {
+    timers.AdvanceClock(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(std::vector<int64_t>({10, 20, 30, 40, 50}), fired);
+  EXPECT_EQ((uint64_t)1, timers.GetStats().pending);
+
+  timers.CancelEvent(event);
+  timers.AdvanceClock(std::chrono::milliseconds(100));
+
+  EXPECT_EQ((size_t)5, fired.size());
+  EXPECT_EQ((uint64_t)0, timers.GetStats().pending);
+}
+
+/**
+ * Check events can be cancelled from inside a callback.
+ * @param backend Backend to test.
+ */
+static void TestCancelInCallback(TimerBackend_t backend) {
+  TimerManager timers(backend, std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+
+  int periodicCount = 0;
+  bool sameTickFired = false;
+  bool laterFired = false;
+
+  TimerHandle periodic;
+  TimerHandle sameTick;
+  TimerHandle later;
+
+  // A periodic event that cancels itself on the third run.
+  periodic = timers.SchedulePeriodicEvent(
+      std::chrono::milliseconds(5), [&timers, &periodicCount, &periodic]() {
+        if (3 == ++periodicCount) {
+          timers.CancelEvent(periodic);
+        }
+      });
+
+  // An event that cancels one already taken to fire on the same tick and
+  // one that is still pending.
+  timers.ScheduleEvent(start + std::chrono::milliseconds(8),
+                       [&timers, &sameTick, &later]() {
+                         timers.CancelEvent(sameTick);
+                         timers.CancelEvent(later);
+                       });
+
+  sameTick = timers.ScheduleEvent(start + std::chrono::milliseconds(8),
+                                  [&sameTickFired]() { sameTickFired = true; });
+  later = timers.ScheduleEvent(start + std::chrono::milliseconds(600),
+                               [&laterFired]() { laterFired = true; });
+
+  for (int i = 0; i < 1000; ++i) {
+    timers.AdvanceClock(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(3, periodicCount);
+  EXPECT_FALSE(sameTickFired);
+  EXPECT_FALSE(laterFired);
+  EXPECT_EQ((uint64_t)0, timers.GetStats().pending);
+}
+
+/**
+ * Check a handle kept after its event fired or was cancelled can not
+ * cancel the event that reuses the node.
+ * @param backend Backend to test.
+ */
+static void TestStaleHandle(TimerBackend_t backend) {
+  TimerManager timers(backend, std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+
+  int fired = 0;
+
+  // The node of the first event is returned to the pool once it fires.
+  auto first = timers.ScheduleEvent(start + std::chrono::milliseconds(5),
+                                    [&fired]() { fired++; });
+  timers.AdvanceClock(std::chrono::milliseconds(10));
+  ASSERT_EQ(1, fired);
+
+  auto second = timers.ScheduleEvent(start + std::chrono::milliseconds(20),
+                                     [&fired]() { fired++; });
+
+  timers.CancelEvent(first);
+  timers.CancelEvent(TimerHandle());
+  EXPECT_EQ((uint64_t)1, timers.GetStats().pending);
+
+  timers.AdvanceClock(std::chrono::milliseconds(15));
+  EXPECT_EQ(2, fired);
+
+  // Cancelling twice must not remove the event that reuses the node.
+  auto third = timers.ScheduleEvent(start + std::chrono::milliseconds(40),
+                                    [&fired]() { fired++; });
+  timers.CancelEvent(third);
+
+  timers.ScheduleEvent(start + std::chrono::milliseconds(40),
+                       [&fired]() { fired++; });
+
+  timers.CancelEvent(third);
+  timers.CancelEvent(second);
+  EXPECT_EQ((uint64_t)1, timers.GetStats().pending);
+
+  timers.AdvanceClock(std::chrono::milliseconds(20));
+  EXPECT_EQ(3, fired);
+  EXPECT_TRUE(first.IsValid());
+  EXPECT_FALSE(TimerHandle().IsValid());
+}
+
+TEST(TimerManager, SortedSetOrder) { TestOrder(TimerBackend_t::SORTED_SET); }
+
+TEST(TimerManager, TimingWheelOrder) {
+  TestOrder(TimerBackend_t::TIMING_WHEEL);
+}
+
+TEST(TimerManager, SortedSetPeriodic) {
+  TestPeriodic(TimerBackend_t::SORTED_SET);
+}
+
+TEST(TimerManager, TimingWheelPeriodic) {
+  TestPeriodic(TimerBackend_t::TIMING_WHEEL);
+}
+
+TEST(TimerManager, SortedSetCancelInCallback) {
+  TestCancelInCallback(TimerBackend_t::SORTED_SET);
+}
+
+TEST(TimerManager, TimingWheelCancelInCallback) {
+  TestCancelInCallback(TimerBackend_t::TIMING_WHEEL);
+}
+
+TEST(TimerManager, SortedSetStaleHandle) {
+  TestStaleHandle(TimerBackend_t::SORTED_SET);
+}
+
+TEST(TimerManager, TimingWheelStaleHandle) {
+  TestStaleHandle(TimerBackend_t::TIMING_WHEEL);
+}
+
+TEST(TimerManager, TimingWheelLevels) {
+  TimerManager timers(TimerBackend_t::TIMING_WHEEL,
+                      std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+
+  // One event in each level of the wheel and one in the overflow list.
+  std::vector<int64_t> offsets = {
+      200,                    // Level 0
+      300,                    // Level 1
+      70000,                  // Level 2
+      20000000,               // Level 3
+      (int64_t)1 << 32,       // Overflow (first tick past level 3)
+      ((int64_t)1 << 32) + 5  // Overflow
+  };
+
+  std::vector<int64_t> fired;
+
+  for (auto offset : offsets) {
+    timers.ScheduleEvent(start + std::chrono::milliseconds(offset),
+                         [&fired, &timers, start]() {
+                           fired.push_back(Elapsed(timers, start));
+                         });
+  }
+
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    // Nothing may fire a tick early after cascading down the levels.
+    timers.AdvanceClock(std::chrono::milliseconds(
+        offsets[i] - 1 - Elapsed(timers, start)));
+    EXPECT_EQ(i, fired.size());
+
+    timers.AdvanceClock(std::chrono::milliseconds(1));
+    ASSERT_EQ(i + 1, fired.size());
+    EXPECT_EQ(offsets[i], fired.back());
+  }
+
+  EXPECT_EQ(offsets, fired);
+  EXPECT_EQ((uint64_t)0, timers.GetStats().pending);
+}
+
+TEST(TimerManager, TimingWheelResolution) {
+  TimerManager timers(TimerBackend_t::TIMING_WHEEL,
+                      std::chrono::milliseconds(10), true);
+
+  auto start = timers.Now();
+
+  std::vector<int64_t> fired;
+
+  // Events fire on the first tick at or after the time requested.
+  for (int64_t offset : {15, 20, 21}) {
+    timers.ScheduleEvent(start + std::chrono::milliseconds(offset),
+                         [&fired, &timers, start]() {
+                           fired.push_back(Elapsed(timers, start));
+                         });
+  }
+
+  for (int i = 0; i < 40; ++i) {
+    timers.AdvanceClock(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(std::vector<int64_t>({20, 20, 30}), fired);
+}
+
+TEST(TimerManager, WorkerTarget) {
+  TimerManager timers(TimerBackend_t::SORTED_SET,
+                      std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+  auto worker = std::make_shared<Worker>();
+
+  int fired = 0;
+
+  timers.ScheduleWorkerEvent(worker, start + std::chrono::milliseconds(10),
+                             [&fired]() { fired++; });
+
+  // The timer only queues the callback on the worker.
+  timers.AdvanceClock(std::chrono::milliseconds(10));
+  EXPECT_EQ(0, fired);
+
+  // The callback runs 5 ms after it was scheduled.
+  timers.AdvanceClock(std::chrono::milliseconds(5));
+  EXPECT_EQ((size_t)1, RunQueued(*worker));
+  EXPECT_EQ(1, fired);
+
+  auto lateness = timers.GetTargetLateness();
+  ASSERT_EQ((size_t)1, lateness.size());
+  EXPECT_EQ((uint64_t)1, lateness.front().count);
+  EXPECT_EQ((uint64_t)5000, lateness.front().totalLateness);
+  EXPECT_EQ((uint64_t)5000, lateness.front().maxLateness);
+
+  // A second callback 1 ms late adds to the total but not the maximum.
+  timers.ScheduleWorkerEvent(worker,
+                             timers.Now() + std::chrono::milliseconds(4),
+                             [&fired]() { fired++; });
+  timers.AdvanceClock(std::chrono::milliseconds(5));
+  EXPECT_EQ((size_t)1, RunQueued(*worker));
+  EXPECT_EQ(2, fired);
+
+  lateness = timers.GetTargetLateness();
+  ASSERT_EQ((size_t)1, lateness.size());
+  EXPECT_EQ((uint64_t)2, lateness.front().count);
+  EXPECT_EQ((uint64_t)6000, lateness.front().totalLateness);
+  EXPECT_EQ((uint64_t)5000, lateness.front().maxLateness);
+}
+
+TEST(TimerManager, DefaultTarget) {
+  TimerManager timers(TimerBackend_t::SORTED_SET,
+                      std::chrono::milliseconds(1), true);
+
+  auto worker = std::make_shared<Worker>();
+
+  int fired = 0;
+
+  // Events without a target are dispatched to the default target.
+  timers.SetDefaultTarget(worker);
+  timers.ScheduleEventIn(1, [&fired]() { fired++; });
+
+  timers.AdvanceClock(std::chrono::seconds(1));
+  EXPECT_EQ(0, fired);
+  EXPECT_EQ((size_t)1, RunQueued(*worker));
+  EXPECT_EQ(1, fired);
+  EXPECT_EQ((size_t)1, timers.GetTargetLateness().size());
+
+  // Without a default target they run in the thread advancing the clock.
+  timers.SetDefaultTarget(nullptr);
+  timers.ScheduleEventIn(1, [&fired]() { fired++; });
+
+  timers.AdvanceClock(std::chrono::seconds(1));
+  EXPECT_EQ(2, fired);
+  EXPECT_EQ((size_t)0, RunQueued(*worker));
+}
+
+TEST(TimerManager, DeadWorkerTarget) {
+  TimerManager timers(TimerBackend_t::SORTED_SET,
+                      std::chrono::milliseconds(1), true);
+
+  auto worker = std::make_shared<Worker>();
+  auto other = std::make_shared<Worker>();
+
+  int fired = 0;
+
+  timers.ScheduleWorkerPeriodicEvent(worker, std::chrono::milliseconds(10),
+                                     [&fired]() { fired++; });
+  timers.ScheduleWorkerEventIn(other, 1, [&fired]() { fired++; });
+  EXPECT_EQ((size_t)2, timers.GetTargetLateness().size());
+
+  // The target of a worker that is gone is removed and its events dropped.
+  worker.reset();
+  EXPECT_EQ((size_t)1, timers.GetTargetLateness().size());
+
+  timers.AdvanceClock(std::chrono::milliseconds(10));
+  EXPECT_EQ((uint64_t)1, timers.GetStats().pending);
+
+  timers.AdvanceClock(std::chrono::seconds(1));
+  EXPECT_EQ((size_t)1, RunQueued(*other));
+  EXPECT_EQ(1, fired);
+  EXPECT_EQ((uint64_t)0, timers.GetStats().pending);
+}
+
+TEST(TimerManager, OneShotStats) {
+  TimerManager timers(TimerBackend_t::SORTED_SET,
+                      std::chrono::milliseconds(1), true);
+
+  auto start = timers.Now();
+
+  EXPECT_EQ((uint64_t)0, timers.GetStats().oneShotLateness.Percentile(50.0));
+
+  // 90 callbacks on time, 9 that are 3 ms late and 1 that is 100 ms late.
+  for (int i = 0; i < 90; ++i) {
+    timers.ScheduleEvent(start + std::chrono::milliseconds(10), []() {});
+  }
+
+  for (int i = 0; i < 9; ++i) {
+    timers.ScheduleEvent(start + std::chrono::milliseconds(20), []() {});
+  }
+
+  timers.ScheduleEvent(start + std::chrono::milliseconds(30), []() {});
+
+  timers.AdvanceClock(std::chrono::milliseconds(10));
+  timers.AdvanceClock(std::chrono::milliseconds(13));
+  timers.AdvanceClock(std::chrono::milliseconds(107));
+
+  auto stats = timers.GetStats();
+  auto &lateness = stats.oneShotLateness;
+
+  EXPECT_EQ((uint64_t)100, lateness.count);
+  EXPECT_EQ((uint64_t)(9 * 3000 + 100000), lateness.total);
+  EXPECT_EQ((uint64_t)100000, lateness.max);
+
+  // Bucket N counts samples of at least 2^(N-1) and under 2^N us.
+  EXPECT_EQ((uint64_t)90, lateness.buckets[0]);
+  EXPECT_EQ((uint64_t)9, lateness.buckets[12]);
+  EXPECT_EQ((uint64_t)1, lateness.buckets[17]);
+
+  EXPECT_EQ((uint64_t)1, lateness.Percentile(50.0));
+  EXPECT_EQ((uint64_t)4096, lateness.Percentile(99.0));
+  EXPECT_EQ((uint64_t)100000, lateness.Percentile(100.0));
+
+  // The callbacks did not move the clock so none of them took any time.
+  EXPECT_EQ((uint64_t)100, stats.runTime.count);
+  EXPECT_EQ((uint64_t)100, stats.runTime.buckets[0]);
+  EXPECT_EQ((uint64_t)0, stats.periodicLateness.count);
+  EXPECT_EQ((uint64_t)0, stats.periodicOverruns);
+}
+
+TEST(TimerManager, PeriodicStats) {
+  TimerManager timers(TimerBackend_t::SORTED_SET,
+                      std::chrono::milliseconds(1), true);
+
+  auto worker = std::make_shared<Worker>();
+
+  int fired = 0;
+
+  // The first run takes 8 ms so it finishes after the next run is due.
+  auto event = timers.ScheduleWorkerPeriodicEvent(
+      worker, std::chrono::milliseconds(10), [&timers, &fired]() {
+        if (1 == ++fired) {
+          timers.AdvanceClock(std::chrono::milliseconds(8));
+        }
+      });
+
+  // Run the first callback 3 ms late.
+  timers.AdvanceClock(std::chrono::milliseconds(13));
+  EXPECT_EQ((size_t)1, RunQueued(*worker));
+
+  // The second run was queued at 20 ms and runs at 21 ms.
+  EXPECT_EQ((size_t)1, RunQueued(*worker));
+  EXPECT_EQ(2, fired);
+
+  timers.CancelEvent(event);
+
+  auto stats = timers.GetStats();
+
+  EXPECT_EQ((uint64_t)2, stats.periodicLateness.count);
+  EXPECT_EQ((uint64_t)1, stats.periodicLateness.buckets[10]);
+  EXPECT_EQ((uint64_t)1, stats.periodicLateness.buckets[12]);
+  EXPECT_EQ((uint64_t)1024, stats.periodicLateness.Percentile(50.0));
+  EXPECT_EQ((uint64_t)3000, stats.periodicLateness.Percentile(99.0));
+
+  EXPECT_EQ((uint64_t)2, stats.runTime.count);
+  EXPECT_EQ((uint64_t)1, stats.runTime.buckets[0]);
+  EXPECT_EQ((uint64_t)1, stats.runTime.buckets[13]);
+  EXPECT_EQ((uint64_t)8000, stats.runTime.max);
+
+  EXPECT_EQ((uint64_t)1, stats.periodicOverruns);
+  EXPECT_EQ((uint64_t)0, stats.oneShotLateness.count);
+  EXPECT_EQ((uint64_t)0, stats.pending);
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,164 @@
+/**
+ * @file libcomp/tests/UUIDBenchmark.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Benchmark UUID generation and string conversion.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libobjgen Includes
+#include <UUID.h>
+
+// Standard C++11 Includes
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/// Number of UUIDs used by each benchmark.
+static const int UUID_COUNT = 1000000;
+
+/// Number of threads generating UUIDs at once.
+static const int THREAD_COUNT = 8;
+
+/**
+ * Print the time taken by a benchmark step.
+ * @param step Name of the step.
+ * @param start Time the step started.
+ * @param count Number of operations in the step.
+ */
+static void Report(const char *step,
+                   const std::chrono::steady_clock::time_point &start,
+                   int count) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  std::cout << "[ BENCH    ] UUID " << step << ": " << count << " ops in "
+            << elapsed << " us (" << (elapsed * 1000.0 / count) << " ns/op)"
+            << std::endl;
+}
+
+TEST(UUIDBenchmark, Random) {
+  std::vector<libobjgen::UUID> uuids;
+  uuids.reserve(UUID_COUNT);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < UUID_COUNT; ++i) {
+    uuids.push_back(libobjgen::UUID::Random());
+  }
+
+  Report("Random", start, UUID_COUNT);
+
+  EXPECT_FALSE(uuids.back().IsNull());
+}
+
+TEST(UUIDBenchmark, RandomN) {
+  const int batchSize = 100;
+
+  std::vector<libobjgen::UUID> uuids;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < UUID_COUNT; i += batchSize) {
+    uuids = libobjgen::UUID::RandomN((size_t)batchSize);
+  }
+
+  Report("RandomN(100)", start, UUID_COUNT);
+
+  EXPECT_FALSE(uuids.back().IsNull());
+}
+
+TEST(UUIDBenchmark, RandomThreaded) {
+  std::vector<std::thread> threads;
+  std::vector<int> failures(THREAD_COUNT, 0);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < THREAD_COUNT; ++i) {
+    threads.emplace_back([&failures, i]() {
+      for (int j = 0; j < UUID_COUNT / THREAD_COUNT; ++j) {
+        if (libobjgen::UUID::Random().IsNull()) {
+          failures[(size_t)i]++;
+        }
+      }
+    });
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  Report("Random (8 threads)", start, UUID_COUNT);
+
+  for (auto count : failures) {
+    EXPECT_EQ(0, count);
+  }
+}
+
+TEST(UUIDBenchmark, StringConversion) {
+  auto uuids = libobjgen::UUID::RandomN(UUID_COUNT);
+
+  std::vector<std::string> strings;
+  strings.reserve(UUID_COUNT);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (auto &uuid : uuids) {
+    strings.push_back(uuid.ToString());
+  }
+
+  Report("ToString", start, UUID_COUNT);
+
+  size_t matches = 0;
+
+  start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < strings.size(); ++i) {
+    if (libobjgen::UUID(strings[i]) == uuids[i]) {
+      matches++;
+    }
+  }
+
+  Report("FromString", start, UUID_COUNT);
+
+  EXPECT_EQ(uuids.size(), matches);
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
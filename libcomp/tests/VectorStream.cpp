@@ -62,6 +62,35 @@ TEST(VectorStream, ReadWrite) {
   EXPECT_EQ(valueA, valueB);
 }
 
+TEST(VectorStream, ArrayStream) {
+  uint32_t valueA = 0xCAFEBABE;
+  uint32_t valueB = 0xDEADBEEF;
+
+  std::vector<char> data;
+  VectorStream<char> buffer(data);
+
+  std::ostream out(&buffer);
+  out.write(reinterpret_cast<char *>(&valueA), sizeof(valueA));
+  out.write(reinterpret_cast<char *>(&valueB), sizeof(valueB));
+
+  EXPECT_TRUE(out.good());
+  ASSERT_EQ(data.size(), sizeof(valueA) + sizeof(valueB));
+
+  ArrayStream<char> buffer2(&data[0], data.size());
+
+  std::istream in(&buffer2);
+  uint32_t valueC = 0;
+  in.seekg(sizeof(valueA));
+  in.read(reinterpret_cast<char *>(&valueC), sizeof(valueC));
+
+  EXPECT_TRUE(in.good());
+  EXPECT_EQ(valueB, valueC);
+
+  in.read(reinterpret_cast<char *>(&valueC), sizeof(valueC));
+
+  EXPECT_FALSE(in.good());
+}
+
 int main(int argc, char *argv[]) {
   try {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,241 @@
+/**
+ * @file libcomp/tests/Worker.cpp
+ * @ingroup libcomp
+ *
+ * @author COMP Omega <compomega@tutanota.com>
+ *
+ * @brief Test the order messages are handled in by a worker.
+ *
+ * This file is part of the COMP_hack Library (libcomp).
+ *
+ * Copyright (C) 2020 COMP_hack Team <compomega@tutanota.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Ignore warnings
+#include <PopIgnore.h>
+
+// Google Test Includes
+#include <gtest/gtest.h>
+
+// Stop ignoring warnings
+#include <PushIgnore.h>
+
+// libcomp Includes
+#include <BaseLog.h>
+#include <EncryptedConnection.h>
+#include <Manager.h>
+#include <MessagePacket.h>
+#include <Worker.h>
+
+// Standard C++11 Includes
+#include <list>
+#include <memory>
+#include <vector>
+
+using namespace libcomp;
+
+namespace {
+
+/**
+ * Log for the messages of the connection and worker while testing.
+ */
+class TestLog : public BaseLog {
+ public:
+  TestLog() {}
+};
+
+/**
+ * Connection that can be marked as connected without a socket.
+ */
+class TestConnection : public EncryptedConnection {
+ public:
+  TestConnection(asio::io_service& io_service)
+      : EncryptedConnection(io_service) {}
+
+  void SetConnected() { mStatus = STATUS_ENCRYPTED; }
+};
+
+/**
+ * Manager that records the type of each message it is given.
+ */
+class RecordingManager : public Manager {
+ public:
+  std::list<Message::MessageType> GetSupportedTypes() const override {
+    return {Message::MessageType::MESSAGE_TYPE_PACKET,
+            Message::MessageType::MESSAGE_TYPE_CONNECTION};
+  }
+
+  bool ProcessMessage(const libcomp::Message::Message* pMessage) override {
+    types.push_back(pMessage->GetType());
+
+    return true;
+  }
+
+  std::vector<Message::MessageType> types;
+};
+
+}  // namespace
+
+TEST(Worker, ShutdownHandlesQueuedWork) {
+  Worker worker;
+
+  std::vector<int> handled;
+
+  for (int i = 0; i < 100; ++i) {
+    worker.ExecuteInWorkerWithPriority(
+        MessagePriority_t::PRIORITY_LOW,
+        [&handled](int value) { handled.push_back(value); }, i);
+  }
+
+  worker.ExecuteInWorker([&handled]() { handled.push_back(-1); });
+  worker.Shutdown();
+
+  // Run in this thread until the shutdown is handled.
+  worker.Start("test", true);
+
+  EXPECT_FALSE(worker.IsRunning());
+  ASSERT_EQ((size_t)101, handled.size());
+
+  std::list<libcomp::Message::Message*> remaining;
+  worker.GetMessageQueue()->DequeueAny(remaining);
+  EXPECT_TRUE(remaining.empty());
+}
+
+TEST(Worker, ShutdownDropsLaterWork) {
+  Worker worker;
+
+  std::vector<int> handled;
+
+  worker.ExecuteInWorkerWithPriority(
+      MessagePriority_t::PRIORITY_LOW, [&handled]() { handled.push_back(1); });
+  worker.ExecuteInWorker([&handled]() { handled.push_back(2); });
+  worker.Shutdown();
+
+  // Queued after the shutdown in every lane so none of these may run.
+  worker.ExecuteInWorkerWithPriority(
+      MessagePriority_t::PRIORITY_HIGH, [&handled]() { handled.push_back(3); });
+  worker.ExecuteInWorker([&handled]() { handled.push_back(4); });
+  worker.ExecuteInWorkerWithPriority(
+      MessagePriority_t::PRIORITY_LOW, [&handled]() { handled.push_back(5); });
+
+  worker.Start("test", true);
+
+  EXPECT_FALSE(worker.IsRunning());
+
+  // The high priority work queued after the shutdown is still handled
+  // first as the worker was running when it was dequeued.
+  std::vector<int> expected = {3, 2, 1};
+  EXPECT_EQ(expected, handled);
+
+  std::list<libcomp::Message::Message*> remaining;
+  worker.GetMessageQueue()->DequeueAny(remaining);
+  EXPECT_EQ((size_t)2, remaining.size());
+
+  for (auto pMessage : remaining) {
+    delete pMessage;
+  }
+}
+
+TEST(Worker, ConnectionClosedAfterPackets) {
+  asio::io_service service;
+
+  auto manager = std::make_shared<RecordingManager>();
+
+  Worker worker;
+  worker.AddManager(manager);
+
+  auto connection = std::make_shared<TestConnection>(service);
+  connection->SetMessageQueue(worker.GetMessageQueue());
+  connection->SetConnected();
+
+  // Queue the packets the way the connection does once they are parsed.
+  for (uint16_t i = 0; i < 50; ++i) {
+    Packet packet;
+    packet.WriteU16Little(i);
+
+    ReadOnlyPacket copy(std::move(packet));
+
+    worker.GetMessageQueue()->Enqueue(
+        new libcomp::Message::Packet(connection, i, copy));
+  }
+
+  // High priority work queued with the packets must not move the close.
+  for (int i = 0; i < 100; ++i) {
+    worker.ExecuteInWorkerWithPriority(MessagePriority_t::PRIORITY_HIGH,
+                                       []() {});
+  }
+
+  EXPECT_TRUE(connection->Close());
+
+  worker.Shutdown();
+  worker.Start("test", true);
+
+  ASSERT_EQ((size_t)51, manager->types.size());
+
+  for (size_t i = 0; i < 50; ++i) {
+    EXPECT_EQ(Message::MessageType::MESSAGE_TYPE_PACKET, manager->types[i]);
+  }
+
+  EXPECT_EQ(Message::MessageType::MESSAGE_TYPE_CONNECTION,
+            manager->types.back());
+}
+
+TEST(Worker, ForwardKeepsPriority) {
+  auto next = std::make_shared<Worker>();
+
+  Worker worker;
+  worker.SetNextWorker(next);
+
+  int handled = 0;
+
+  worker.ExecuteInWorkerWithPriority(MessagePriority_t::PRIORITY_LOW,
+                                     [&handled]() { handled++; });
+  worker.ExecuteInWorkerWithPriority(MessagePriority_t::PRIORITY_HIGH,
+                                     [&handled]() { handled++; });
+  worker.Shutdown();
+  worker.Start("test", true);
+
+  EXPECT_EQ(2, handled);
+
+  // Each message is forwarded in the lane it was first queued in.
+  auto queue = next->GetMessageQueue();
+
+  EXPECT_EQ((uint64_t)1,
+            queue->GetLaneStats(MessagePriority_t::PRIORITY_HIGH).depth);
+  EXPECT_EQ((uint64_t)1,
+            queue->GetLaneStats(MessagePriority_t::PRIORITY_NORMAL).depth);
+  EXPECT_EQ((uint64_t)1,
+            queue->GetLaneStats(MessagePriority_t::PRIORITY_LOW).depth);
+
+  std::list<libcomp::Message::Message*> forwarded;
+  queue->DequeueAny(forwarded);
+
+  for (auto pMessage : forwarded) {
+    delete pMessage;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    TestLog log;
+
+    return RUN_ALL_TESTS();
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
@@ -5,15 +5,16 @@
         return true;
     }
 
-    std::vector<char> value;
+    const char *data = nullptr;
+    size_t size = 0;
 
-    if(!query.GetValue(@COLUMN_NAME@, value))
+    if(!query.GetBlob(@COLUMN_NAME@, data, size))
     {
         return false;
     }
 
-    libcomp::VectorStream<char> vstream(value);
-    std::istream stream(&vstream);
+    libcomp::ArrayStream<char> astream(data, size);
+    std::istream stream(&astream);
 
     return @LOAD_CODE@;
 }())
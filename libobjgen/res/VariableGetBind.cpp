@@ -1,11 +1,8 @@
 [&]() {
-    std::stringstream stream(std::stringstream::out |
-        std::stringstream::binary);
+    std::vector<char> data;
+    libcomp::VectorStream<char> vstream(data);
+    std::ostream stream(&vstream);
     @SAVE_CODE@;
 
-    auto stringData = stream.str();
-    auto data = std::vector<char>(stringData.c_str(), stringData.c_str() +
-        stringData.size());
-
-    return new libcomp::DatabaseBindBlob(@COLUMN_NAME@, data);
+    return new libcomp::DatabaseBindBlob(@COLUMN_NAME@, std::move(data));
 }
\ No newline at end of file
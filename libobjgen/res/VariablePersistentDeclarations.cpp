@@ -1,4 +1,5 @@
 virtual std::list<libcomp::DatabaseBind*> GetMemberBindValues(bool retrieveAll = false, bool clearChanges = true);
 virtual bool LoadDatabaseValues(libcomp::DatabaseQuery& query);
+virtual void VisitReferences(const ReferenceVisitor& visitor);
 virtual std::shared_ptr<libobjgen::MetaObject> GetObjectMetadata();
 static std::shared_ptr<libobjgen::MetaObject> GetMetadata();
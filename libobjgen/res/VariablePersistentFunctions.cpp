@@ -26,6 +26,24 @@ bool @OBJECT_NAME@::LoadDatabaseValues(libcomp::DatabaseQuery& query)
     return true;
 }
 
+void @OBJECT_NAME@::VisitReferences(const ReferenceVisitor& visitor)
+{
+    std::list<VisitedReference> references;
+
+    {
+        std::lock_guard<std::mutex> lock(mFieldLock);
+
+        @VISIT_REFERENCES@
+    }
+
+    // Call the visitor without the lock so it may use this object.
+    for(auto& ref : references)
+    {
+        visitor(std::get<0>(ref), std::get<1>(ref), std::get<2>(ref),
+            std::get<3>(ref));
+    }
+}
+
 std::shared_ptr<libobjgen::MetaObject> @OBJECT_NAME@::GetObjectMetadata()
 {
     return @OBJECT_NAME@::GetMetadata();
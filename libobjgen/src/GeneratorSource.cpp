@@ -29,7 +29,9 @@
 // libobjgen Includes
 #include "MetaObject.h"
 #include "MetaVariable.h"
+#include "MetaVariableArray.h"
 #include "MetaVariableEnum.h"
+#include "MetaVariableList.h"
 #include "MetaVariableMap.h"
 #include "MetaVariableReference.h"
 
@@ -685,10 +687,66 @@ bool GeneratorSource::GeneratePersistentObjectFunctions(const MetaObject& obj,
     dbValues << std::endl;
   }
 
+  // Collect persistent references held directly or in lists, arrays and map
+  // values. Generic references do not know the type to load.
+  std::stringstream visits;
+  for (auto it = obj.VariablesBegin(); it != obj.VariablesEnd(); ++it) {
+    auto var = *it;
+    auto elementVar = var;
+
+    switch (var->GetMetaType()) {
+      case MetaVariable::MetaVariableType_t::TYPE_ARRAY:
+        elementVar =
+            std::dynamic_pointer_cast<MetaVariableArray>(var)->GetElementType();
+        break;
+      case MetaVariable::MetaVariableType_t::TYPE_LIST:
+        elementVar =
+            std::dynamic_pointer_cast<MetaVariableList>(var)->GetElementType();
+        break;
+      case MetaVariable::MetaVariableType_t::TYPE_MAP:
+        elementVar = std::dynamic_pointer_cast<MetaVariableMap>(var)
+                         ->GetValueElementType();
+        break;
+      default:
+        break;
+    }
+
+    auto ref = std::dynamic_pointer_cast<MetaVariableReference>(elementVar);
+
+    if (!ref || !ref->IsPersistentReference() || ref->IsIndirect()) {
+      continue;
+    }
+
+    std::string args = "\"" + var->GetName() + "\", typeid(" +
+                       ref->GetReferenceType(true) + ").hash_code(), ";
+
+    if (var == elementVar) {
+      std::string name = GetMemberName(var);
+
+      visits << Tab(2) << "references.emplace_back(" << args << name
+             << ".GetUUID(), " << name << ".Get());" << std::endl;
+    } else {
+      bool isMap =
+          var->GetMetaType() == MetaVariable::MetaVariableType_t::TYPE_MAP;
+      std::string loopVar = isMap ? "pair" : "ref";
+      std::string name = isMap ? "pair.second" : "ref";
+
+      visits << Tab(2) << "for(auto& " << loopVar << " : "
+             << GetMemberName(var) << ")" << std::endl;
+      visits << Tab(2) << "{" << std::endl;
+      visits << Tab(3) << "references.emplace_back(" << args << name
+             << ".GetUUID(), " << name << ".Get());" << std::endl;
+      visits << Tab(2) << "}" << std::endl;
+    }
+
+    visits << std::endl;
+  }
+
   std::map<std::string, std::string> replacements;
   replacements["@OBJECT_NAME@"] = obj.GetName();
   replacements["@BINDS@"] = binds.str();
   replacements["@GET_DATABASE_VALUES@"] = dbValues.str();
+  replacements["@VISIT_REFERENCES@"] = visits.str();
 
   std::stringstream savedBytes;
   if (!obj.Save(savedBytes)) {
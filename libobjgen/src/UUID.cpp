@@ -36,10 +36,8 @@
 
 // Standard C++11 Libraries
 #include <algorithm>
+#include <cstring>
 #include <fstream>
-#include <iomanip>
-#include <regex>
-#include <sstream>
 
 #ifdef USE_MBED_TLS
 #ifdef _WIN32
@@ -51,36 +49,89 @@
 #endif  // _WIN32
 #endif  // USE_MBED_TLS
 
-libobjgen::UUID::UUID() : mTimeAndVersion(0), mClockSequenceAndNode(0) {}
+/// Length of the string form of a UUID
+static const size_t UUID_STRING_LENGTH = 36;
+
+/// Lower case hex digits by value
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+/// Value of each hex digit by character (-1 if it is not a hex digit)
+static const int8_t HEX_VALUES[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
 
-libobjgen::UUID::UUID(const std::string &other) {
-  std::string s = other;
+/**
+ * Write the hex digits of a value.
+ * @param pOut Buffer to write the digits to
+ * @param value Value to write
+ * @param digits Number of digits to write
+ */
+static inline void EncodeHex(char *pOut, uint64_t value, int digits) {
+  for (int i = digits - 1; i >= 0; --i) {
+    pOut[i] = HEX_DIGITS[value & 0xF];
+    value >>= 4;
+  }
+}
 
-  std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+/**
+ * Read the value of a run of hex digits.
+ * @param pIn Digits to read
+ * @param digits Number of digits to read
+ * @param value Output parameter to return the value in
+ * @return true if every character was a hex digit, false otherwise
+ */
+static inline bool DecodeHex(const char *pIn, int digits, uint64_t &value) {
+  value = 0;
 
-  static const std::regex re(
-      "^([0-9A-Fa-f]{8})-([0-9A-Fa-f]{4})-"
-      "([0-9A-Fa-f]{4})-([0-9A-Fa-f]{4})-([0-9A-Fa-f]{12})$");
+  for (int i = 0; i < digits; ++i) {
+    int8_t nibble = HEX_VALUES[(uint8_t)pIn[i]];
 
-  std::smatch match;
+    if (0 > nibble) {
+      return false;
+    }
 
-  if (std::regex_match(s, match, re)) {
-    uint32_t a;
-    uint16_t b, c, d;
-    uint64_t e;
+    value = (value << 4) | (uint64_t)nibble;
+  }
 
-    std::stringstream(match[1]) >> std::hex >> a;
-    std::stringstream(match[2]) >> std::hex >> b;
-    std::stringstream(match[3]) >> std::hex >> c;
-    std::stringstream(match[4]) >> std::hex >> d;
-    std::stringstream(match[5]) >> std::hex >> e;
+  return true;
+}
 
-    mTimeAndVersion = (uint64_t)a | ((uint64_t)b << 32) | ((uint64_t)c << 48);
-    mClockSequenceAndNode = ((uint64_t)d << 48) | (uint64_t)e;
-  } else {
-    mTimeAndVersion = 0;
-    mClockSequenceAndNode = 0;
+libobjgen::UUID::UUID() : mTimeAndVersion(0), mClockSequenceAndNode(0) {}
+
+libobjgen::UUID::UUID(const std::string &other)
+    : mTimeAndVersion(0), mClockSequenceAndNode(0) {
+  if (UUID_STRING_LENGTH != other.size()) {
+    return;
+  }
+
+  const char *s = other.c_str();
+
+  uint64_t a, b, c, d, e;
+
+  if ('-' != s[8] || '-' != s[13] || '-' != s[18] || '-' != s[23] ||
+      !DecodeHex(s, 8, a) || !DecodeHex(s + 9, 4, b) ||
+      !DecodeHex(s + 14, 4, c) || !DecodeHex(s + 19, 4, d) ||
+      !DecodeHex(s + 24, 12, e)) {
+    return;
   }
+
+  mTimeAndVersion = a | (b << 32) | (c << 48);
+  mClockSequenceAndNode = (d << 48) | e;
 }
 
 libobjgen::UUID::UUID(const std::vector<char> &data) {
@@ -197,69 +248,157 @@ static int RandomSeed(void *pUserData, uint8_t *pBuffer, size_t bufferSize) {
 }
 #endif  // USE_MBED_TLS
 
-libobjgen::UUID libobjgen::UUID::Random() {
-  libobjgen::UUID uuid;
-
 #ifdef USE_MBED_TLS
-  static bool didInit = false;
-  static mbedtls_ctr_drbg_context ctx;
+/// Bytes generated by a thread before its generator is reseeded
+static const size_t RANDOM_RESEED_BYTES = 1024 * 1024;
 
-  if (!didInit) {
-    mbedtls_ctr_drbg_init(&ctx);
-    mbedtls_ctr_drbg_seed(&ctx, RandomSeed, NULL, NULL, 0);
-    didInit = true;
+/**
+ * Random generator owned by a single thread so generating UUIDs on many
+ * threads needs no locking.
+ */
+class RandomState {
+ public:
+  RandomState() : mSeeded(false), mGenerated(0) {
+    mbedtls_ctr_drbg_init(&mContext);
+
+    mSeeded = 0 == mbedtls_ctr_drbg_seed(&mContext, RandomSeed, NULL, NULL, 0);
   }
 
-  if (0 == mbedtls_ctr_drbg_random(&ctx, (unsigned char *)&uuid.mTimeAndVersion,
-                                   sizeof(uuid.mTimeAndVersion)) &&
-      0 == mbedtls_ctr_drbg_random(&ctx,
-                                   (unsigned char *)&uuid.mClockSequenceAndNode,
-                                   sizeof(uuid.mTimeAndVersion))) {
-    uuid.mTimeAndVersion =
-        (uuid.mTimeAndVersion & 0x0FFFFFFFFFFFFFFFLL) | ((uint64_t)4 << 60);
-    uuid.mClockSequenceAndNode =
-        (uuid.mClockSequenceAndNode & 0x3FFFFFFFFFFFFFFFLL) |
-        0x8000000000000000LL;
-  } else {
-    uuid.mTimeAndVersion = 0;
-    uuid.mClockSequenceAndNode = 0;
+  ~RandomState() { mbedtls_ctr_drbg_free(&mContext); }
+
+  bool Generate(unsigned char *pData, size_t size) {
+    if (!mSeeded) {
+      return false;
+    }
+
+    while (0 < size) {
+      // Mix in new entropy from the system periodically.
+      if (RANDOM_RESEED_BYTES <= mGenerated) {
+        if (0 != mbedtls_ctr_drbg_reseed(&mContext, NULL, 0)) {
+          return false;
+        }
+
+        mGenerated = 0;
+      }
+
+      size_t count = std::min(size, (size_t)MBEDTLS_CTR_DRBG_MAX_REQUEST);
+
+      if (0 != mbedtls_ctr_drbg_random(&mContext, pData, count)) {
+        return false;
+      }
+
+      pData += count;
+      size -= count;
+      mGenerated += count;
+    }
+
+    return true;
   }
 
-  return uuid;
+ private:
+  mbedtls_ctr_drbg_context mContext;
+  bool mSeeded;
+  size_t mGenerated;
+};
 #else   // USE_MBED_TLS
-  if (1 == RAND_bytes((unsigned char *)&uuid.mTimeAndVersion,
-                      sizeof(uuid.mTimeAndVersion)) &&
-      1 == RAND_bytes((unsigned char *)&uuid.mClockSequenceAndNode,
-                      sizeof(uuid.mTimeAndVersion))) {
-    uuid.mTimeAndVersion =
-        (uuid.mTimeAndVersion & 0x0FFFFFFFFFFFFFFFLL) | ((uint64_t)4 << 60);
-    uuid.mClockSequenceAndNode =
-        (uuid.mClockSequenceAndNode & 0x3FFFFFFFFFFFFFFFLL) |
-        0x8000000000000000LL;
-  } else {
-    uuid.mTimeAndVersion = 0;
-    uuid.mClockSequenceAndNode = 0;
+/// Random bytes buffered by each thread
+static const size_t RANDOM_BUFFER_SIZE = 4096;
+
+/**
+ * Buffer of random bytes owned by a single thread. The buffer is refilled
+ * from the (reseeding) OpenSSL generator so most UUIDs only need a copy.
+ */
+class RandomState {
+ public:
+  RandomState() : mOffset(RANDOM_BUFFER_SIZE) {}
+
+  ~RandomState() { memset(mBuffer, 0, sizeof(mBuffer)); }
+
+  bool Generate(unsigned char *pData, size_t size) {
+    // Large requests skip the buffer.
+    if (RANDOM_BUFFER_SIZE < size) {
+      return 1 == RAND_bytes(pData, (int)size);
+    }
+
+    if (RANDOM_BUFFER_SIZE - mOffset < size) {
+      if (1 != RAND_bytes(mBuffer, (int)RANDOM_BUFFER_SIZE)) {
+        return false;
+      }
+
+      mOffset = 0;
+    }
+
+    // Clear the bytes used so they are not kept around.
+    memcpy(pData, mBuffer + mOffset, size);
+    memset(mBuffer + mOffset, 0, size);
+    mOffset += size;
+
+    return true;
   }
 
-  return uuid;
+ private:
+  unsigned char mBuffer[RANDOM_BUFFER_SIZE];
+  size_t mOffset;
+};
 #endif  // USE_MBED_TLS
+
+/**
+ * Generate random bytes with the generator of the calling thread.
+ * @param pData Buffer to write the random bytes to
+ * @param size Number of bytes to generate
+ * @return true if the bytes were generated, false otherwise
+ */
+static bool RandomBytes(void *pData, size_t size) {
+  static thread_local RandomState state;
+
+  return state.Generate((unsigned char *)pData, size);
+}
+
+libobjgen::UUID libobjgen::UUID::Random() {
+  libobjgen::UUID uuid;
+
+  uint64_t data[2];
+
+  if (RandomBytes(data, sizeof(data))) {
+    uuid.SetRandom(data);
+  }
+
+  return uuid;
+}
+
+std::vector<libobjgen::UUID> libobjgen::UUID::RandomN(size_t count) {
+  std::vector<UUID> uuids(count);
+  std::vector<uint64_t> data(count * 2);
+
+  if (0 < count && RandomBytes(&data[0], data.size() * sizeof(uint64_t))) {
+    for (size_t i = 0; i < count; ++i) {
+      uuids[i].SetRandom(&data[i * 2]);
+    }
+  }
+
+  return uuids;
+}
+
+void libobjgen::UUID::SetRandom(const uint64_t *pData) {
+  mTimeAndVersion = (pData[0] & 0x0FFFFFFFFFFFFFFFLL) | ((uint64_t)4 << 60);
+  mClockSequenceAndNode =
+      (pData[1] & 0x3FFFFFFFFFFFFFFFLL) | 0x8000000000000000LL;
 }
 
 std::string libobjgen::UUID::ToString() const {
-  std::stringstream ss;
-
-  ss << std::hex << std::setfill('0');
-  ss << std::setw(8) << (mTimeAndVersion & 0xFFFFFFFF);
-  ss << "-";
-  ss << std::setw(4) << ((mTimeAndVersion >> 32) & 0xFFFF);
-  ss << "-";
-  ss << std::setw(4) << ((mTimeAndVersion >> 48) & 0xFFFF);
-  ss << "-";
-  ss << std::setw(4) << ((mClockSequenceAndNode >> 48) & 0xFFFF);
-  ss << "-";
-  ss << std::setw(12) << (mClockSequenceAndNode & 0xFFFFFFFFFFFFLL);
-
-  return ss.str();
+  char s[UUID_STRING_LENGTH];
+
+  EncodeHex(s, mTimeAndVersion & 0xFFFFFFFF, 8);
+  s[8] = '-';
+  EncodeHex(s + 9, (mTimeAndVersion >> 32) & 0xFFFF, 4);
+  s[13] = '-';
+  EncodeHex(s + 14, (mTimeAndVersion >> 48) & 0xFFFF, 4);
+  s[18] = '-';
+  EncodeHex(s + 19, (mClockSequenceAndNode >> 48) & 0xFFFF, 4);
+  s[23] = '-';
+  EncodeHex(s + 24, mClockSequenceAndNode & 0xFFFFFFFFFFFFLL, 12);
+
+  return std::string(s, UUID_STRING_LENGTH);
 }
 
 std::vector<char> libobjgen::UUID::ToData() const {
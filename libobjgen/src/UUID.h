@@ -46,8 +46,20 @@ class UUID {
   UUID(const std::string& other);
   UUID(const std::vector<char>& data);
 
+  /**
+   * Generate a random (version 4) UUID. Each thread has its own random
+   * generator so this may be called from many threads at once.
+   * @return Random UUID (or a null UUID if no random data was available)
+   */
   static UUID Random();
 
+  /**
+   * Generate many random UUIDs with a single request for random data.
+   * @param count Number of UUIDs to generate
+   * @return Random UUIDs (all null if no random data was available)
+   */
+  static std::vector<UUID> RandomN(size_t count);
+
   std::string ToString() const;
   std::vector<char> ToData() const;
 
@@ -57,6 +69,12 @@ class UUID {
   bool operator!=(const UUID& other) const;
 
  protected:
+  /**
+   * Set the UUID from random data and mark it as a version 4 UUID.
+   * @param pData Two random 64-bit values
+   */
+  void SetRandom(const uint64_t* pData);
+
   uint64_t mTimeAndVersion;
   uint64_t mClockSequenceAndNode;
 };
@@ -70,8 +88,11 @@ struct hash<libobjgen::UUID> {
   typedef std::size_t result_type;
 
   result_type operator()(const argument_type& uuid) const {
-    return std::hash<uint64_t>{}(uuid.mTimeAndVersion) +
-           std::hash<uint64_t>{}(uuid.mClockSequenceAndNode);
+    // Mix the halves so UUIDs that differ in only one half do not collide
+    // when used as the key of an unordered container.
+    result_type seed = std::hash<uint64_t>{}(uuid.mTimeAndVersion);
+    return seed ^ (std::hash<uint64_t>{}(uuid.mClockSequenceAndNode) +
+                   0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
   }
 };
 }  // namespace std
@@ -36,6 +36,10 @@
 // libobjgen Includes
 #include <UUID.h>
 
+// Standard C++11 Includes
+#include <thread>
+#include <unordered_set>
+
 using namespace libobjgen;
 
 TEST(UUID, Null) {
@@ -76,6 +80,71 @@ TEST(UUID, BinaryConversion) {
   EXPECT_EQ(memcmp(&uuidDataCopy[0], &uuidData[0], sizeof(uuidData)), 0);
 }
 
+TEST(UUID, StringConversion) {
+  UUID uuid("E70EBDD0-7A79-4BFF-9E1F-1D8C0A3A6FB6");
+
+  EXPECT_EQ(uuid.ToString(), "e70ebdd0-7a79-4bff-9e1f-1d8c0a3a6fb6");
+  EXPECT_EQ(UUID(uuid.ToString()), uuid);
+
+  EXPECT_TRUE(UUID("").IsNull());
+  EXPECT_TRUE(UUID("e70ebdd0-7a79-4bff-9e1f-1d8c0a3a6fb").IsNull());
+  EXPECT_TRUE(UUID("e70ebdd0-7a79-4bff-9e1f-1d8c0a3a6fb66").IsNull());
+  EXPECT_TRUE(UUID("e70ebdd0_7a79-4bff-9e1f-1d8c0a3a6fb6").IsNull());
+  EXPECT_TRUE(UUID("e70ebdd0-7a79-4bff-9e1f-1d8c0a3a6fbg").IsNull());
+}
+
+TEST(UUID, GenerateMany) {
+  auto uuids = UUID::RandomN(1000);
+
+  ASSERT_EQ(uuids.size(), (size_t)1000);
+
+  std::unordered_set<UUID> unique(uuids.begin(), uuids.end());
+
+  EXPECT_EQ(unique.size(), uuids.size());
+
+  for (auto &uuid : uuids) {
+    auto str = uuid.ToString();
+
+    // Version 4 with the RFC 4122 variant.
+    EXPECT_EQ(str[14], '4');
+    EXPECT_NE(std::string("89ab").find(str[19]), std::string::npos);
+  }
+
+  EXPECT_TRUE(UUID::RandomN(0).empty());
+}
+
+TEST(UUID, GenerateThreaded) {
+  const size_t threadCount = 8;
+  const size_t perThread = 10000;
+
+  std::vector<std::vector<UUID>> results(threadCount);
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&results, i, perThread]() {
+      for (size_t j = 0; j < perThread; ++j) {
+        results[i].push_back(UUID::Random());
+      }
+    });
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  std::unordered_set<UUID> unique;
+
+  for (auto &uuids : results) {
+    for (auto &uuid : uuids) {
+      EXPECT_FALSE(uuid.IsNull());
+
+      unique.insert(uuid);
+    }
+  }
+
+  EXPECT_EQ(unique.size(), threadCount * perThread);
+}
+
 int main(int argc, char *argv[]) {
   try {
     ::testing::InitGoogleTest(&argc, argv);